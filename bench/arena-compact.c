@@ -0,0 +1,148 @@
+/*
+  Sliding compaction (arena_forward_build, arena_forward and arena_compact)
+  versus two-finger compaction (arena_compact_twofinger) of 1 MiB arena of
+  fixed-size objects, including fixing references of live objects.
+
+  Every object has two references to random objects, objects are marked
+  with given probability (marking itself isn't measured). Sliding needs
+  marked objects iterated twice: to fix references through forwarding table
+  and to move them. Two-finger moves only objects above final end into holes
+  below it and then fixes references of compacted objects by forwarding
+  addresses left in moved ones.
+
+  Usage: arena-compact [repetitions, default 200]
+*/
+#include "benchlib.h"
+#include <string.h>
+
+#define FAL_ARENA_DEF_POW       20u /* 1 MiB */
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes */
+#define FAL_ARENA_DEF_NAME      space
+#include <fal/arena.h>
+
+typedef struct obj_t obj_t;
+struct obj_t {
+  obj_t* refs[2];
+  size_t id;
+  size_t pad;
+};
+
+static size_t repetitions;
+
+/* Fill arena with objects pointing to each other, mark live_pct percents
+   of them and return number of marked objects, root is a marked one. */
+static size_t fill(space_t* space, unsigned live_pct, uint64_t* seed,
+  obj_t** root) {
+  static obj_t* objs[space_EFFECTIVE_SIZE / sizeof(obj_t)];
+  size_t count = 0;
+
+  space_init(space);
+  while ((objs[count] = space_bumpalloc(space, sizeof(obj_t)))) {
+    objs[count]->id = count;
+    count++;
+  }
+
+  size_t live = 0;
+  *root = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint64_t rnd = benchlib_rand(seed);
+    objs[i]->refs[0] = objs[(rnd >> 8) % count];
+    objs[i]->refs[1] = objs[(rnd >> 32) % count];
+    if (rnd % 100 < live_pct) {
+      space_mark(objs[i]);
+      *root = objs[i];
+      live++;
+    }
+  }
+
+  /* References to dead objects would dangle after compaction. */
+  for (obj_t* obj = space_first_marked(space); obj;
+    obj = space_next_marked(obj)) {
+    for (size_t r = 0; r < 2; r++) {
+      if (!space_marked(obj->refs[r])) {
+        obj->refs[r] = 0;
+      }
+    }
+  }
+
+  return live;
+}
+
+static uint64_t sliding(space_t* space, obj_t** root) {
+  static space_fwd_t table[space_FWD_LEN];
+
+  uint64_t t = benchlib_now_ns();
+  space_forward_build(space, table);
+  for (obj_t* obj = space_first_marked(space); obj;
+    obj = space_next_marked(obj)) {
+    for (size_t r = 0; r < 2; r++) {
+      if (obj->refs[r]) {
+        obj->refs[r] = space_forward(table, obj->refs[r]);
+      }
+    }
+  }
+  *root = space_forward(table, *root);
+  space_compact(space);
+
+  return benchlib_now_ns() - t;
+}
+
+static uint64_t twofinger(space_t* space, obj_t** root) {
+  uint64_t t = benchlib_now_ns();
+  char* end = space_compact_twofinger(space, sizeof(obj_t));
+  for (obj_t* obj = space_mem_start(space); (char*)obj < end; obj++) {
+    for (size_t r = 0; r < 2; r++) {
+      if ((char*)obj->refs[r] >= end) {
+        obj->refs[r] = *(obj_t**)obj->refs[r];
+      }
+    }
+  }
+  if ((char*)*root >= end) {
+    *root = *(obj_t**)*root;
+  }
+
+  return benchlib_now_ns() - t;
+}
+
+/* Walk a bit from root to make sure references are right. */
+static void check(obj_t* root, size_t live) {
+  obj_t* obj = root;
+  for (size_t i = 0; obj && i < live; i++) {
+    assert(space_used(obj) && !space_marked(obj));
+    obj = obj->refs[i % 2] ? obj->refs[i % 2] : obj->refs[1 - i % 2];
+  }
+}
+
+int main(int argc, char** argv) {
+  repetitions = argc > 1 ? strtoul(argv[1], 0, 0) : 200;
+
+  space_t* space = benchlib_alloc_arena(space_SIZE);
+
+  printf("%zu byte objects, %zu repetitions\n", sizeof(obj_t), repetitions);
+  printf("%6s %12s %14s\n", "live %", "sliding ms", "two-finger ms");
+
+  static const unsigned pcts[] = { 10, 25, 50, 75, 90 };
+  for (size_t p = 0; p < FAL_ARRLEN(pcts); p++) {
+    uint64_t sliding_ns = 0, twofinger_ns = 0;
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+    for (size_t rep = 0; rep < repetitions; rep++) {
+      obj_t* root;
+      uint64_t rep_seed = seed;
+
+      size_t live = fill(space, pcts[p], &seed, &root);
+      sliding_ns += sliding(space, &root);
+      check(root, live);
+
+      fill(space, pcts[p], &rep_seed, &root);
+      twofinger_ns += twofinger(space, &root);
+      check(root, live);
+    }
+
+    printf("%6u %12.3f %14.3f\n", pcts[p],
+      benchlib_ms(sliding_ns) / repetitions,
+      benchlib_ms(twofinger_ns) / repetitions);
+  }
+
+  benchlib_free_arena(space, space_SIZE);
+}
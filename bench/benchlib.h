@@ -0,0 +1,208 @@
+#ifndef __FAL_BENCH_BENCHLIB_H__
+#define __FAL_BENCH_BENCHLIB_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+static inline void* benchlib_alloc_arena(size_t size);
+static inline void benchlib_free_arena(void* arena, size_t size);
+static inline uint64_t benchlib_now_ns();
+
+typedef void (*benchlib_thread_fn)(void* arg);
+
+/* Run fn(args[i]) on count threads at once and wait for all of them. */
+static inline void benchlib_run_threads(size_t count, benchlib_thread_fn fn,
+  void** args);
+static inline size_t benchlib_cpus();
+static inline void benchlib_yield();
+/* Resident set size of the process in bytes or 0 if unknown. */
+static inline size_t benchlib_rss();
+
+enum { BENCHLIB_MAX_THREADS = 256 };
+
+typedef struct benchlib_thread_t {
+  benchlib_thread_fn fn;
+  void* arg;
+} benchlib_thread_t;
+
+#if defined(_WIN32)
+
+#define __VC_EXTRALEAN
+#include <Windows.h>
+#include <psapi.h>
+#undef min
+#undef max
+
+static inline void* benchlib_alloc_arena(size_t size) {
+  void* mem = VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+  assert(mem && "VirtualAlloc");
+
+  return mem;
+}
+
+static inline void benchlib_free_arena(void* arena, size_t size) {
+  (void)size;
+  VirtualFree(arena, 0, MEM_RELEASE);
+}
+
+static inline uint64_t benchlib_now_ns() {
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return (uint64_t)(now.QuadPart * (1e9 / freq.QuadPart));
+}
+
+static DWORD WINAPI benchlib__thread(LPVOID arg) {
+  benchlib_thread_t* thread = (benchlib_thread_t*)arg;
+  thread->fn(thread->arg);
+  return 0;
+}
+
+static inline void benchlib_run_threads(size_t count, benchlib_thread_fn fn,
+  void** args) {
+  static benchlib_thread_t threads[BENCHLIB_MAX_THREADS];
+  static HANDLE handles[BENCHLIB_MAX_THREADS];
+  assert(count <= 64 && "WaitForMultipleObjects limit");
+
+  for (size_t i = 0; i < count; i++) {
+    threads[i].fn = fn;
+    threads[i].arg = args[i];
+    handles[i] = CreateThread(0, 0, benchlib__thread, &threads[i], 0, 0);
+    assert(handles[i] && "CreateThread");
+  }
+  WaitForMultipleObjects((DWORD)count, handles, TRUE, INFINITE);
+  for (size_t i = 0; i < count; i++) {
+    CloseHandle(handles[i]);
+  }
+}
+
+static inline size_t benchlib_cpus() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+}
+
+static inline void benchlib_yield() {
+  SwitchToThread();
+}
+
+static inline size_t benchlib_rss() {
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+    sizeof(counters))) {
+    return 0;
+  }
+  return counters.WorkingSetSize;
+}
+
+#elif defined(linux) || defined(__MINGW32__) || defined(__GNUC__)
+
+#include <sys/mman.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+static inline void* benchlib_alloc_arena(size_t size) {
+  assert(!(size & (size - 1)) && "size must be power of 2");
+
+  void* mem = mmap(0, size*2,
+    PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS,
+    -1,
+    0);
+  assert(mem != MAP_FAILED && "mmap");
+
+  uintptr_t addr = (uintptr_t)mem;
+  uintptr_t mask = size - 1; /* 000..01..111 */
+  if (!(addr & mask)) {
+    munmap((void*)(addr + size), size);
+    return mem;
+  }
+
+  uintptr_t aligned = (addr + size) & ~mask;
+  munmap(mem, aligned - addr);
+  munmap((void*)(aligned + size), size - (aligned - addr));
+
+  return (void*)aligned;
+}
+
+static inline void benchlib_free_arena(void* arena, size_t size) {
+  munmap(arena, size);
+}
+
+static inline uint64_t benchlib_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void* benchlib__thread(void* arg) {
+  benchlib_thread_t* thread = (benchlib_thread_t*)arg;
+  thread->fn(thread->arg);
+  return 0;
+}
+
+static inline void benchlib_run_threads(size_t count, benchlib_thread_fn fn,
+  void** args) {
+  static benchlib_thread_t threads[BENCHLIB_MAX_THREADS];
+  static pthread_t handles[BENCHLIB_MAX_THREADS];
+  assert(count <= BENCHLIB_MAX_THREADS);
+
+  for (size_t i = 0; i < count; i++) {
+    threads[i].fn = fn;
+    threads[i].arg = args[i];
+    int err = pthread_create(&handles[i], 0, benchlib__thread, &threads[i]);
+    assert(!err && "pthread_create");
+    (void)err;
+  }
+  for (size_t i = 0; i < count; i++) {
+    pthread_join(handles[i], 0);
+  }
+}
+
+static inline size_t benchlib_cpus() {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? (size_t)cpus : 1;
+}
+
+static inline void benchlib_yield() {
+  sched_yield();
+}
+
+static inline size_t benchlib_rss() {
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (!statm) {
+    return 0;
+  }
+
+  unsigned long size, resident;
+  int read = fscanf(statm, "%lu %lu", &size, &resident);
+  fclose(statm);
+  return read == 2 ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+#else
+
+#error Dont know how to alloc page on this system.
+
+#endif /* defined(_WIN32) */
+
+/* Deterministic xorshift64* generator, so runs are comparable. */
+static inline uint64_t benchlib_rand(uint64_t* state) {
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1Dull;
+}
+
+static inline double benchlib_ms(uint64_t ns) {
+  return ns / 1e6;
+}
+
+#endif /* __FAL_BENCH_BENCHLIB_H__ */
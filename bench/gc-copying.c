@@ -0,0 +1,274 @@
+/*
+  Copy throughput of Cheney's fal/copygc.h collector versus three-pass
+  semispace collection done as in samples/arena/semispace-gc.c: mark live
+  objects, copy marked ones leaving forwarding addresses, then walk to-space
+  again to fix references.
+
+  Live heap is random graph of objects with 1 to 4 references, every object
+  points to previously allocated one, so whole graph is reachable from the
+  last one, other references point to random earlier objects. Every live
+  object is followed by garbage object of the same size. First collection
+  leaves garbage behind, following ones copy the same live graph again.
+
+  For every live heap size prints time per collection and copy throughput
+  in MB/s (10^6 bytes of live objects copied per second), so results for
+  several sizes can be plotted.
+
+  Usage: gc-copying [max live MiB, default 32] [collections, default 5]
+*/
+#include "benchlib.h"
+#include <string.h>
+
+#define FAL_COPYGC_DEF_POW       20u /* 1 MiB */
+#define FAL_COPYGC_DEF_BLOCK_POW 4u  /* 16 bytes */
+#define FAL_COPYGC_DEF_NAME      cgc
+#include <fal/copygc.h>
+
+#define FAL_ARENA_DEF_POW       20u /* 1 MiB */
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes */
+#define FAL_ARENA_DEF_NAME      space
+#include <fal/arena.h>
+
+enum { MAX_REFS = 4 };
+
+typedef struct obj_t obj_t;
+struct obj_t {
+  size_t len;           /* number of slots */
+  obj_t* slots[MAX_REFS];
+};
+
+static size_t collections;
+
+typedef struct result_t {
+  size_t objects;       /* live objects */
+  size_t bytes;         /* live bytes copied by each collection */
+  uint64_t ns;          /* total time of all collections */
+} result_t;
+
+static void print(const char* name, size_t mib, const result_t* r) {
+  printf("%-10s %8zu %10zu %10.2f %10.1f\n",
+    name, mib, r->objects,
+    benchlib_ms(r->ns) / collections,
+    r->bytes * (double)collections / (r->ns / 1e9) / 1e6);
+}
+
+static size_t obj_size(size_t len) {
+  return offsetof(obj_t, slots) + len * sizeof(obj_t*);
+}
+
+/* Build graph of live objects of about live bytes with mk callback, returns
+   last object. */
+#define DEF_BUILD(Name, Gc_t, Mk)                                             \
+static obj_t* Name(Gc_t* gc, size_t live, void** root, result_t* r) {         \
+  uint64_t seed = 0x9e3779b97f4a7c15ull;                                      \
+  obj_t** objs = malloc(live / obj_size(1) * sizeof(obj_t*));                 \
+  size_t count = 0;                                                           \
+  size_t bytes = 0;                                                           \
+                                                                              \
+  while (bytes < live) {                                                      \
+    uint64_t rnd = benchlib_rand(&seed);                                      \
+    size_t len = 1 + rnd % MAX_REFS;                                          \
+    obj_t* obj = Mk(gc, len);                                                 \
+    (void)Mk(gc, len); /* garbage */                                          \
+                                                                              \
+    obj->slots[0] = count ? objs[count - 1] : 0;                              \
+    for (size_t i = 1; i < len; i++) {                                        \
+      obj->slots[i] = count ? objs[(rnd >> (8 * i)) % count] : 0;             \
+    }                                                                         \
+                                                                              \
+    objs[count++] = obj;                                                      \
+    bytes += obj_size(len);                                                   \
+  }                                                                           \
+                                                                              \
+  *root = objs[count - 1];                                                    \
+  free(objs);                                                                 \
+  r->objects = count;                                                         \
+  return *root;                                                               \
+}
+
+/******************************************************************************/
+/*                                 CHENEY                                     */
+/******************************************************************************/
+static void cgc_trace(cgc_t* gc, void* obj) {
+  obj_t* o = obj;
+  for (size_t i = 0; i < o->len; i++) {
+    cgc_visit(gc, (void**)&o->slots[i]);
+  }
+}
+
+static obj_t* cgc_mk(cgc_t* gc, size_t len) {
+  obj_t* obj;
+  while (!(obj = cgc_alloc(gc, obj_size(len)))) {
+    cgc_add_arena(gc, benchlib_alloc_arena(cgc_arena_SIZE));
+    cgc_add_arena(gc, benchlib_alloc_arena(cgc_arena_SIZE));
+  }
+
+  obj->len = len;
+  return obj;
+}
+
+DEF_BUILD(cgc_build, cgc_t, cgc_mk)
+
+static void run_cheney(size_t live, result_t* r) {
+  cgc_t* gc = malloc(sizeof(cgc_t));
+  cgc_init(gc, cgc_trace);
+
+  void* slot = 0;
+  cgc_root_t root;
+  cgc_add_root(gc, &root, &slot, 1);
+  cgc_build(gc, live, &slot, r);
+
+  for (size_t i = 0; i < collections; i++) {
+    uint64_t t = benchlib_now_ns();
+    cgc_collect(gc);
+    r->ns += benchlib_now_ns() - t;
+  }
+  r->bytes = cgc_stats(gc)->copied_bytes;
+
+  for (cgc_arena_t* arena = cgc_first_arena(gc); arena; ) {
+    cgc_arena_t* next = cgc_next_arena(arena);
+    benchlib_free_arena(arena, cgc_arena_SIZE);
+    arena = next;
+  }
+  for (cgc_arena_t* arena = gc->spare; arena; ) {
+    cgc_arena_t* next = cgc_next_arena(arena);
+    benchlib_free_arena(arena, cgc_arena_SIZE);
+    arena = next;
+  }
+  free(gc);
+}
+
+/******************************************************************************/
+/*                               THREE-PASS                                   */
+/******************************************************************************/
+typedef struct semi_t {
+  space_t** from;
+  space_t** to;
+  size_t from_len;
+  size_t to_len;
+  size_t cap;
+  obj_t** stack;
+} semi_t;
+
+static void* semi_bumpalloc(space_t** spaces, size_t* len, size_t cap,
+  size_t size) {
+  FAL_UNUSED(cap); /* used only by assert */
+  void* obj = *len ? space_bumpalloc(spaces[*len - 1], size) : 0;
+  if (!obj) {
+    assert(*len < cap);
+    space_init(spaces[(*len)++]);
+    obj = space_bumpalloc(spaces[*len - 1], size);
+  }
+
+  return obj;
+}
+
+static obj_t* semi_mk(semi_t* gc, size_t len) {
+  obj_t* obj = semi_bumpalloc(gc->from, &gc->from_len, gc->cap, obj_size(len));
+  obj->len = len;
+  return obj;
+}
+
+DEF_BUILD(semi_build, semi_t, semi_mk)
+
+static void semi_collect(semi_t* gc, void** root, result_t* r) {
+  /* Mark phase. */
+  size_t sp = 0;
+  if (*root) {
+    space_mark(*root);
+    gc->stack[sp++] = *root;
+  }
+  while (sp) {
+    obj_t* obj = gc->stack[--sp];
+    for (size_t i = 0; i < obj->len; i++) {
+      if (obj->slots[i] && !space_marked(obj->slots[i])) {
+        space_mark(obj->slots[i]);
+        gc->stack[sp++] = obj->slots[i];
+      }
+    }
+  }
+
+  /* Copy phase. */
+  r->bytes = 0;
+  gc->to_len = 0;
+  for (size_t a = 0; a < gc->from_len; a++) {
+    for (obj_t* obj = space_first_marked(gc->from[a]); obj;
+      obj = space_next_marked(obj)) {
+      size_t size = space_size(obj);
+      void* copy = semi_bumpalloc(gc->to, &gc->to_len, gc->cap, size);
+      memcpy(copy, obj, size);
+      *(void**)obj = copy;
+      r->bytes += size;
+    }
+  }
+
+  /* Fix phase. */
+  for (size_t a = 0; a < gc->to_len; a++) {
+    for (obj_t* obj = space_first(gc->to[a]); obj; obj = space_next(obj)) {
+      for (size_t i = 0; i < obj->len; i++) {
+        if (obj->slots[i]) {
+          obj->slots[i] = *(obj_t**)obj->slots[i];
+        }
+      }
+    }
+  }
+  if (*root) {
+    *root = *(void**)*root;
+  }
+
+  space_t** tmp = gc->from;
+  gc->from = gc->to;
+  gc->to = tmp;
+  gc->from_len = gc->to_len;
+}
+
+static void run_three_pass(size_t live, result_t* r) {
+  semi_t gc;
+  gc.cap = 3 * live / space_EFFECTIVE_SIZE + 2;
+  gc.from = malloc(gc.cap * sizeof(space_t*));
+  gc.to = malloc(gc.cap * sizeof(space_t*));
+  for (size_t i = 0; i < gc.cap; i++) {
+    gc.from[i] = benchlib_alloc_arena(space_SIZE);
+    gc.to[i] = benchlib_alloc_arena(space_SIZE);
+  }
+  gc.from_len = gc.to_len = 0;
+  gc.stack = malloc(live / obj_size(1) * sizeof(obj_t*));
+
+  void* root = 0;
+  semi_build(&gc, live, &root, r);
+
+  for (size_t i = 0; i < collections; i++) {
+    uint64_t t = benchlib_now_ns();
+    semi_collect(&gc, &root, r);
+    r->ns += benchlib_now_ns() - t;
+  }
+
+  for (size_t i = 0; i < gc.cap; i++) {
+    benchlib_free_arena(gc.from[i], space_SIZE);
+    benchlib_free_arena(gc.to[i], space_SIZE);
+  }
+  free(gc.from);
+  free(gc.to);
+  free(gc.stack);
+}
+
+int main(int argc, char** argv) {
+  size_t max_mib = argc > 1 ? strtoul(argv[1], 0, 0) : 32;
+  collections = argc > 2 ? strtoul(argv[2], 0, 0) : 5;
+
+  printf("%zu collections per run, 1 MiB arenas\n", collections);
+  printf("%-10s %8s %10s %10s %10s\n",
+    "collector", "live MiB", "objects", "ms/gc", "MB/s");
+
+  for (size_t mib = 1; mib <= max_mib; mib *= 2) {
+    result_t r;
+
+    memset(&r, 0, sizeof(r));
+    run_three_pass(mib << 20, &r);
+    print("three-pass", mib, &r);
+
+    memset(&r, 0, sizeof(r));
+    run_cheney(mib << 20, &r);
+    print("cheney", mib, &r);
+  }
+}
@@ -0,0 +1,319 @@
+/*
+  Throughput of generational fal/gengc.h collection versus full-heap fal/gc.h
+  one on workload where most objects die young.
+
+  Live heap is a three-level tree of pointer tables with nodes in its leaves.
+  Every mutator operation allocates a short chain of temporary nodes and with
+  probability 1/KEEP_EVERY stores its head into random leaf slot, so old node
+  becomes garbage and new one survives.
+
+  Full-heap collector runs gc_collect when bytes allocated since previous
+  collection exceed live bytes or heap is full. Generational collector runs
+  gengc_minor when nursery is full and gengc_collect when bytes promoted since
+  previous major collection exceed live bytes of old space or old space is
+  full. Both grow heap (old space) to twice of live bytes after collection.
+
+  Usage: gc-generational [fanout, default 64] [operations, default 10000000]
+*/
+#include "benchlib.h"
+#include <string.h>
+
+#define FAL_GC_DEF_POW        20u   /* 1 MiB */
+#define FAL_GC_DEF_BLOCK_POW  4u    /* 16 bytes */
+#define FAL_GC_DEF_MARK_STACK 65536
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+#define FAL_GENGC_DEF_POW         20u /* 1 MiB */
+#define FAL_GENGC_DEF_NURSERY_POW 18u /* 256 KiB */
+#define FAL_GENGC_DEF_BLOCK_POW   4u  /* 16 bytes */
+#define FAL_GENGC_DEF_MARK_STACK  65536
+#define FAL_GENGC_DEF_NAME        sgen
+#include <fal/gengc.h>
+
+#define FAL_GENGC_DEF_POW         20u /* 1 MiB */
+#define FAL_GENGC_DEF_NURSERY_POW 22u /* 4 MiB */
+#define FAL_GENGC_DEF_BLOCK_POW   4u  /* 16 bytes */
+#define FAL_GENGC_DEF_MARK_STACK  65536
+#define FAL_GENGC_DEF_NAME        bgen
+#include <fal/gengc.h>
+
+enum { CHAIN = 4, KEEP_EVERY = 32 };
+
+typedef struct obj_t obj_t;
+struct obj_t {
+  size_t len;           /* 0 for nodes, number of slots for tables */
+  obj_t* slots[1];      /* next node for nodes */
+};
+
+static size_t fanout;
+static size_t operations;
+
+typedef struct result_t {
+  size_t minor;
+  size_t major;
+  size_t arenas;
+  size_t heap;          /* bytes of heap memory at the end */
+  uint64_t gc_ns;
+  uint64_t total_ns;
+} result_t;
+
+static void print(const char* name, const result_t* r) {
+  printf("%-22s %7zu %7zu %9.1f %9.1f %8.1f %9.2f\n",
+    name, r->minor, r->major,
+    benchlib_ms(r->gc_ns), benchlib_ms(r->total_ns),
+    r->heap / 1048576.0,
+    operations * CHAIN / (r->total_ns / 1e9) / 1e6);
+}
+
+/******************************************************************************/
+/*                               FULL-HEAP                                    */
+/******************************************************************************/
+static void gc_trace(gc_t* gc, void* obj) {
+  obj_t* o = obj;
+  size_t len = o->len ? o->len : 1;
+  for (size_t i = 0; i < len; i++) {
+    gc_visit(gc, (void**)&o->slots[i]);
+  }
+}
+
+static void gc_full(gc_t* gc, result_t* r) {
+  uint64_t t = benchlib_now_ns();
+  gc_collect(gc);
+  r->gc_ns += benchlib_now_ns() - t;
+  r->major++;
+
+  const gc_stats_t* stats = gc_stats(gc);
+  while (stats->live_bytes * 2 > stats->arenas * gc_arena_EFFECTIVE_SIZE) {
+    gc_add_arena(gc, benchlib_alloc_arena(gc_arena_SIZE));
+  }
+}
+
+static obj_t* gc_mk(gc_t* gc, size_t len, result_t* r) {
+  size_t size = sizeof(obj_t) + (len ? len - 1 : 0) * sizeof(obj_t*);
+  obj_t* obj = gc_alloc(gc, size);
+  if (!obj) {
+    gc_full(gc, r);
+    obj = gc_alloc(gc, size);
+    if (!obj) {
+      gc_add_arena(gc, benchlib_alloc_arena(gc_arena_SIZE));
+      obj = gc_alloc(gc, size);
+    }
+  }
+
+  assert(obj);
+  obj->len = len;
+  return obj;
+}
+
+static void run_gc(result_t* r) {
+  gc_t* gc = malloc(sizeof(gc_t));
+  gc_init(gc, gc_trace);
+  gc_add_arena(gc, benchlib_alloc_arena(gc_arena_SIZE));
+
+  obj_t* root = 0;
+  obj_t* chain = 0;
+  void* slots[2] = { 0, 0 };
+  gc_root_t groot;
+  gc_add_root(gc, &groot, slots, 2);
+
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  uint64_t start = benchlib_now_ns();
+
+  slots[0] = root = gc_mk(gc, fanout, r);
+  for (size_t a = 0; a < fanout; a++) {
+    root->slots[a] = gc_mk(gc, fanout, r);
+    for (size_t b = 0; b < fanout; b++) {
+      obj_t* leaf = root->slots[a]->slots[b] = gc_mk(gc, fanout, r);
+      for (size_t c = 0; c < fanout; c++) {
+        leaf->slots[c] = gc_mk(gc, 0, r);
+      }
+    }
+  }
+
+  size_t allocated = 0;
+  size_t threshold = 0;
+  for (size_t op = 0; op < operations; op++) {
+    uint64_t rnd = benchlib_rand(&seed);
+
+    slots[1] = 0;
+    for (size_t i = 0; i < CHAIN; i++) {
+      obj_t* node = gc_mk(gc, 0, r);
+      node->slots[0] = slots[1];
+      slots[1] = node;
+    }
+    chain = slots[1];
+    allocated += CHAIN * gc_arena_size(chain);
+
+    if (rnd % KEEP_EVERY == 0) {
+      obj_t* leaf = root->slots[(rnd >> 8) % fanout]->slots[(rnd >> 24) % fanout];
+      leaf->slots[(rnd >> 40) % fanout] = chain;
+    }
+
+    if (allocated > threshold) {
+      gc_full(gc, r);
+      allocated = 0;
+      threshold = gc_stats(gc)->live_bytes;
+    }
+  }
+
+  r->total_ns = benchlib_now_ns() - start;
+  r->arenas = gc_stats(gc)->arenas;
+  r->heap = r->arenas * gc_arena_SIZE;
+
+  for (gc_arena_t* arena = gc_first_arena(gc); arena; ) {
+    gc_arena_t* next = gc_next_arena(arena);
+    benchlib_free_arena(arena, gc_arena_SIZE);
+    arena = next;
+  }
+  free(gc);
+}
+
+/******************************************************************************/
+/*                              GENERATIONAL                                  */
+/******************************************************************************/
+#define DEF_RUN_GENGC(Name)                                                   \
+static void Name##_trace(Name##_t* gc, void* obj) {                           \
+  obj_t* o = obj;                                                             \
+  size_t len = o->len ? o->len : 1;                                           \
+  for (size_t i = 0; i < len; i++) {                                          \
+    Name##_visit(gc, (void**)&o->slots[i]);                                   \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+static void Name##_full(Name##_t* gc, result_t* r, size_t* threshold) {       \
+  Name##_collect(gc);                                                         \
+  r->major++;                                                                 \
+  const Name##_old_stats_t* stats = Name##_old_stats(Name##_old(gc));        \
+  size_t failed = Name##_stats(gc)->promotion_failures;                       \
+  *threshold = stats->live_bytes;                                             \
+  while (stats->live_bytes * 2 > stats->arenas * Name##_old_arena_EFFECTIVE_SIZE \
+    || failed) {                                                              \
+    Name##_add_arena(gc, benchlib_alloc_arena(Name##_old_arena_SIZE));        \
+    failed = 0;                                                               \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+static obj_t* Name##_mk(Name##_t* gc, size_t len, result_t* r,                \
+  size_t* promoted, size_t* threshold) {                                      \
+  size_t size = sizeof(obj_t) + (len ? len - 1 : 0) * sizeof(obj_t*);         \
+  obj_t* obj;                                                                 \
+  while (!(obj = Name##_alloc(gc, size))) {                                   \
+    uint64_t t = benchlib_now_ns();                                           \
+    if (size >= Name##_PRETENURE) {                                           \
+      Name##_full(gc, r, threshold);                                          \
+      if (!(obj = Name##_alloc(gc, size))) {                                  \
+        Name##_add_arena(gc, benchlib_alloc_arena(Name##_old_arena_SIZE));    \
+      }                                                                       \
+    } else {                                                                  \
+      Name##_minor(gc);                                                       \
+      r->minor++;                                                             \
+      *promoted += Name##_stats(gc)->promoted_bytes;                          \
+      if (*promoted > *threshold || Name##_stats(gc)->promotion_failures) {   \
+        Name##_full(gc, r, threshold);                                        \
+        *promoted = 0;                                                        \
+      }                                                                       \
+    }                                                                         \
+    r->gc_ns += benchlib_now_ns() - t;                                        \
+  }                                                                           \
+                                                                              \
+  obj->len = len;                                                             \
+  return obj;                                                                 \
+}                                                                             \
+                                                                              \
+static void run_##Name(result_t* r) {                                         \
+  Name##_t* gc = malloc(sizeof(Name##_t));                                    \
+  Name##_init(gc, Name##_trace,                                               \
+    benchlib_alloc_arena(Name##_nursery_SIZE),                                \
+    benchlib_alloc_arena(Name##_nursery_SIZE));                               \
+  Name##_add_arena(gc, benchlib_alloc_arena(Name##_old_arena_SIZE));          \
+                                                                              \
+  obj_t* root = 0;                                                            \
+  obj_t* chain = 0;                                                           \
+  void* slots[2] = { 0, 0 };                                                  \
+  Name##_root_t groot;                                                        \
+  Name##_add_root(gc, &groot, slots, 2);                                      \
+                                                                              \
+  size_t promoted = 0;                                                        \
+  size_t threshold = 0;                                                       \
+  uint64_t seed = 0x9e3779b97f4a7c15ull;                                      \
+  uint64_t start = benchlib_now_ns();                                         \
+                                                                              \
+  slots[0] = root = Name##_mk(gc, fanout, r, &promoted, &threshold);          \
+  for (size_t a = 0; a < fanout; a++) {                                       \
+    obj_t* table = Name##_mk(gc, fanout, r, &promoted, &threshold);           \
+    root = slots[0];                                                          \
+    Name##_write(gc, (void**)&root->slots[a], table);                         \
+    for (size_t b = 0; b < fanout; b++) {                                     \
+      obj_t* leaf = Name##_mk(gc, fanout, r, &promoted, &threshold);          \
+      root = slots[0];                                                        \
+      Name##_write(gc, (void**)&root->slots[a]->slots[b], leaf);              \
+      for (size_t c = 0; c < fanout; c++) {                                   \
+        obj_t* node = Name##_mk(gc, 0, r, &promoted, &threshold);             \
+        root = slots[0];                                                      \
+        Name##_write(gc, (void**)&root->slots[a]->slots[b]->slots[c], node);  \
+      }                                                                       \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  for (size_t op = 0; op < operations; op++) {                                \
+    uint64_t rnd = benchlib_rand(&seed);                                      \
+                                                                              \
+    slots[1] = 0;                                                             \
+    for (size_t i = 0; i < CHAIN; i++) {                                      \
+      obj_t* node = Name##_mk(gc, 0, r, &promoted, &threshold);               \
+      node->slots[0] = slots[1]; /* node is young, no barrier needed */       \
+      slots[1] = node;                                                        \
+    }                                                                         \
+    chain = slots[1];                                                         \
+                                                                              \
+    if (rnd % KEEP_EVERY == 0) {                                              \
+      root = slots[0];                                                        \
+      obj_t* leaf = root->slots[(rnd >> 8) % fanout]                          \
+        ->slots[(rnd >> 24) % fanout];                                        \
+      Name##_write(gc, (void**)&leaf->slots[(rnd >> 40) % fanout], chain);    \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  r->total_ns = benchlib_now_ns() - start;                                    \
+  r->arenas = Name##_old_stats(Name##_old(gc))->arenas;                       \
+  r->heap = r->arenas * Name##_old_arena_SIZE + 2 * Name##_nursery_SIZE;      \
+                                                                              \
+  for (Name##_old_arena_t* arena = Name##_old_first_arena(Name##_old(gc));    \
+    arena; ) {                                                                \
+    Name##_old_arena_t* next = Name##_old_next_arena(arena);                  \
+    benchlib_free_arena(arena, Name##_old_arena_SIZE);                        \
+    arena = next;                                                             \
+  }                                                                           \
+  benchlib_free_arena(gc->from, Name##_nursery_SIZE);                         \
+  benchlib_free_arena(gc->to, Name##_nursery_SIZE);                           \
+  free(gc);                                                                   \
+}
+
+DEF_RUN_GENGC(sgen)
+DEF_RUN_GENGC(bgen)
+
+int main(int argc, char** argv) {
+  fanout = argc > 1 ? strtoul(argv[1], 0, 0) : 64;
+  operations = argc > 2 ? strtoul(argv[2], 0, 0) : 10000000;
+
+  printf("%zu leaves, %zu operations, %d allocations per operation, "
+    "1/%d survives\n",
+    fanout * fanout * fanout, operations, CHAIN, KEEP_EVERY);
+  printf("%-22s %7s %7s %9s %9s %8s %9s\n",
+    "collector", "minor", "major", "gc ms", "total ms", "heap MiB", "Malloc/s");
+
+  result_t r;
+
+  memset(&r, 0, sizeof(r));
+  run_gc(&r);
+  print("mark&sweep", &r);
+
+  memset(&r, 0, sizeof(r));
+  run_sgen(&r);
+  print("generational 256 KiB", &r);
+
+  memset(&r, 0, sizeof(r));
+  run_bgen(&r);
+  print("generational 4 MiB", &r);
+}
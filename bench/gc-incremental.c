@@ -0,0 +1,209 @@
+/*
+  Pause times of incremental fal/gc.h collection versus stop-the-world one.
+
+  Live heap is a three-level tree of pointer tables with random nodes in its
+  leaves, each node also references another random node. Mutator replaces
+  random leaf with new node, storing pointer with gc_write, so it produces
+  garbage at constant rate.
+
+  Cycle is started when allocated bytes since end of previous one exceed
+  live bytes. Stop-the-world mode runs gc_collect then, incremental modes run
+  gc_step_ns/gc_step after every STEP_EVERY mutator operations while cycle is
+  in progress. Every gc_collect/gc_step call is a pause. If allocation fails
+  during incremental cycle, cycle is finished at once (counted as forced).
+
+  Usage: gc-incremental [fanout, default 100] [operations, default 10000000]
+*/
+#include "benchlib.h"
+#include <string.h>
+
+#define FAL_GC_DEF_POW        20u   /* 1 MiB */
+#define FAL_GC_DEF_BLOCK_POW  4u    /* 16 bytes */
+#define FAL_GC_DEF_MARK_STACK 65536
+#define FAL_GC_DEF_CLOCK()    benchlib_now_ns()
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+enum { STEP_EVERY = 256 };
+
+typedef struct obj_t obj_t;
+struct obj_t {
+  size_t len;           /* 0 for nodes, number of slots for tables */
+  obj_t* slots[1];      /* next node for nodes */
+};
+
+static void trace(gc_t* gc, void* obj) {
+  obj_t* o = obj;
+  size_t len = o->len ? o->len : 1;
+  for (size_t i = 0; i < len; i++) {
+    gc_visit(gc, (void**)&o->slots[i]);
+  }
+}
+
+static int cmp_u64(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+typedef struct gcmode_t {
+  const char* name;
+  uint64_t budget_ns;   /* gc_step_ns budget, 0 to use budget_units */
+  size_t budget_units;  /* gc_step budget, 0 for stop-the-world */
+} gcmode_t;
+
+static size_t fanout;
+static size_t operations;
+
+static obj_t* mktable(gc_t* gc) {
+  obj_t* table = gc_alloc(gc, sizeof(obj_t) + (fanout - 1) * sizeof(obj_t*));
+  assert(table);
+  table->len = fanout;
+  return table;
+}
+
+static void run(const gcmode_t* mode) {
+  gc_t* gc = malloc(sizeof(gc_t));
+  gc_init(gc, trace);
+
+  size_t leaves = fanout * fanout * fanout;
+  size_t heap = 6 * leaves * 16 + 2 * fanout * fanout * fanout * 8;
+  size_t arenas = heap / gc_arena_EFFECTIVE_SIZE + 2;
+  for (size_t i = 0; i < arenas; i++) {
+    gc_add_arena(gc, benchlib_alloc_arena(gc_arena_SIZE));
+  }
+
+  obj_t* root = 0;
+  gc_root_t groot;
+  gc_add_root(gc, &groot, (void**)&root, 1);
+
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+  root = mktable(gc);
+  for (size_t a = 0; a < fanout; a++) {
+    root->slots[a] = mktable(gc);
+    for (size_t b = 0; b < fanout; b++) {
+      obj_t* leaf = root->slots[a]->slots[b] = mktable(gc);
+      for (size_t c = 0; c < fanout; c++) {
+        leaf->slots[c] = gc_alloc(gc, sizeof(obj_t));
+        assert(leaf->slots[c]);
+      }
+    }
+  }
+
+  gc_collect(gc);
+  size_t threshold = gc_stats(gc)->live_bytes;
+  size_t allocated = 0;
+  size_t forced = 0;
+
+  size_t pauses_cap = 1024, pauses_len = 0;
+  uint64_t* pauses = malloc(pauses_cap * sizeof(uint64_t));
+
+  uint64_t start = benchlib_now_ns();
+  for (size_t op = 0; op < operations; op++) {
+    uint64_t r = benchlib_rand(&seed);
+    obj_t* leaf = root->slots[r % fanout]->slots[(r >> 16) % fanout];
+    obj_t* other = root->slots[(r >> 32) % fanout]->slots[(r >> 40) % fanout];
+
+    obj_t* node = gc_alloc(gc, sizeof(obj_t));
+    if (!node) {
+      /* Heap exhausted before incremental cycle has finished. */
+      uint64_t t = benchlib_now_ns();
+      gc_collect(gc);
+      t = benchlib_now_ns() - t;
+      if (pauses_len == pauses_cap) {
+        pauses = realloc(pauses, (pauses_cap *= 2) * sizeof(uint64_t));
+      }
+      pauses[pauses_len++] = t;
+      forced++;
+      allocated = 0;
+      node = gc_alloc(gc, sizeof(obj_t));
+      assert(node && "heap is too small");
+    }
+
+    allocated += sizeof(obj_t) + 16;
+    gc_write(gc, (void**)&node->slots[0], other->slots[(r >> 48) % fanout]);
+    gc_write(gc, (void**)&leaf->slots[(r >> 24) % fanout], node);
+
+    int collecting = gc_collecting(gc);
+    if (!(collecting ? op % STEP_EVERY == 0 : allocated > threshold)) {
+      continue;
+    }
+
+    uint64_t t = benchlib_now_ns();
+    if (!mode->budget_ns && !mode->budget_units) {
+      gc_collect(gc);
+    } else if (mode->budget_ns) {
+      gc_step_ns(gc, mode->budget_ns);
+    } else {
+      gc_step(gc, mode->budget_units);
+    }
+    t = benchlib_now_ns() - t;
+
+    if (pauses_len == pauses_cap) {
+      pauses = realloc(pauses, (pauses_cap *= 2) * sizeof(uint64_t));
+    }
+    pauses[pauses_len++] = t;
+
+    if (!gc_collecting(gc)) {
+      allocated = 0;
+      threshold = gc_stats(gc)->live_bytes;
+    }
+  }
+  uint64_t total = benchlib_now_ns() - start;
+
+  qsort(pauses, pauses_len, sizeof(uint64_t), cmp_u64);
+
+  printf("%-14s %7zu %8zu %9.1f %9.1f %9.1f %9.1f %9.1f %7zu %9.2f\n",
+    mode->name,
+    gc_stats(gc)->collections,
+    pauses_len,
+    pauses[pauses_len / 2] / 1e3,
+    pauses[pauses_len * 90 / 100] / 1e3,
+    pauses[pauses_len * 99 / 100] / 1e3,
+    pauses[pauses_len * 999 / 1000] / 1e3,
+    pauses[pauses_len - 1] / 1e3,
+    forced,
+    operations / (total / 1e9) / 1e6);
+
+  /* Histogram of pauses, powers of two microseconds. */
+  printf("%-14s", "");
+  for (uint64_t bound = 16000, ix = 0; ix < pauses_len; bound *= 2) {
+    size_t count = 0;
+    for (; ix < pauses_len && pauses[ix] < bound; ix++) {
+      count++;
+    }
+    printf(" <%lluus:%zu", (unsigned long long)bound / 1000, count);
+  }
+  printf("\n");
+
+  free(pauses);
+  for (gc_arena_t* arena = gc_first_arena(gc); arena; ) {
+    gc_arena_t* next = gc_next_arena(arena);
+    benchlib_free_arena(arena, gc_arena_SIZE);
+    arena = next;
+  }
+  free(gc);
+}
+
+int main(int argc, char** argv) {
+  fanout = argc > 1 ? strtoul(argv[1], 0, 0) : 100;
+  operations = argc > 2 ? strtoul(argv[2], 0, 0) : 10000000;
+
+  printf("%zu leaves, %zu operations, step every %d operations\n",
+    fanout * fanout * fanout, operations, STEP_EVERY);
+  printf("%-14s %7s %8s %9s %9s %9s %9s %9s %7s %9s\n",
+    "mode", "cycles", "pauses", "p50 us", "p90 us", "p99 us", "p99.9 us",
+    "max us", "forced", "Mops/s");
+
+  static const gcmode_t modes[] = {
+    { "stop-the-world", 0, 0 },
+    { "step 50us", 50000, 0 },
+    { "step 100us", 100000, 0 },
+    { "step 500us", 500000, 0 },
+    { "step 2000 obj", 0, 2000 },
+  };
+
+  for (size_t i = 0; i < FAL_ARRLEN(modes); i++) {
+    run(&modes[i]);
+  }
+}
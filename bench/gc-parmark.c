@@ -0,0 +1,223 @@
+/*
+  Mark phase scaling of fal/parmark.h from 1 thread to all cores versus
+  sequential marking with explicit stack and arena_mark, as fal/gc.h does.
+
+  Heap is random graph of 32 byte objects spread over 1 MiB arenas, every
+  object has two references to random objects anywhere in the heap, so
+  marking is pointer chasing with poor locality. Roots are few random
+  objects, about 80% of the heap is reachable from them.
+
+  For every number of threads prints best time of mark phase and speedup
+  relative to sequential marker. Speedup can't exceed number of physical
+  cores, and on a single core machine parallel marker only shows its
+  overhead.
+
+  Usage: gc-parmark [heap MiB, default 64] [max threads, default all cores]
+                    [repetitions, default 5]
+*/
+#include "benchlib.h"
+#include <string.h>
+
+#define FAL_ARENA_DEF_POW       20u /* 1 MiB */
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes */
+#define FAL_ARENA_DEF_NAME      space
+#include <fal/arena.h>
+
+#define FAL_PARMARK_DEF_NAME      pm
+#define FAL_PARMARK_DEF_MARK(Ptr) space_mark_atomic(Ptr)
+#define FAL_PARMARK_DEF_YIELD()   benchlib_yield()
+#include <fal/parmark.h>
+
+enum { ROOTS = 16 };
+
+typedef struct obj_t obj_t;
+struct obj_t {
+  obj_t* refs[2];
+  size_t id;
+  size_t pad;
+};
+
+static space_t** spaces;
+static size_t spaces_len;
+static obj_t* roots[ROOTS];
+
+static void build(size_t heap) {
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  size_t count = 0;
+
+  spaces_len = heap / space_EFFECTIVE_SIZE + 1;
+  spaces = malloc(spaces_len * sizeof(space_t*));
+  obj_t** objs = malloc(spaces_len * (space_EFFECTIVE_SIZE / sizeof(obj_t))
+    * sizeof(obj_t*));
+
+  for (size_t a = 0; a < spaces_len; a++) {
+    spaces[a] = benchlib_alloc_arena(space_SIZE);
+    space_init(spaces[a]);
+
+    obj_t* obj;
+    while ((obj = space_bumpalloc(spaces[a], sizeof(obj_t)))) {
+      obj->id = count;
+      objs[count++] = obj;
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    uint64_t rnd = benchlib_rand(&seed);
+    objs[i]->refs[0] = objs[(rnd >> 8) % count];
+    objs[i]->refs[1] = rnd % 4 ? objs[(rnd >> 32) % count] : 0;
+  }
+  for (size_t i = 0; i < ROOTS; i++) {
+    roots[i] = objs[benchlib_rand(&seed) % count];
+  }
+
+  free(objs);
+}
+
+static void unmark(void) {
+  for (size_t a = 0; a < spaces_len; a++) {
+    for (void* obj = space_first(spaces[a]); obj; obj = space_next(obj)) {
+      space_unmark(obj);
+    }
+  }
+}
+
+static size_t count_marked(void) {
+  size_t marked = 0;
+  for (size_t a = 0; a < spaces_len; a++) {
+    for (void* obj = space_first_marked(spaces[a]); obj;
+      obj = space_next_marked(obj)) {
+      marked++;
+    }
+  }
+
+  return marked;
+}
+
+/******************************************************************************/
+/*                                SEQUENTIAL                                  */
+/******************************************************************************/
+static obj_t** stack;
+
+static uint64_t sequential(void) {
+  uint64_t t = benchlib_now_ns();
+  size_t sp = 0;
+
+  for (size_t i = 0; i < ROOTS; i++) {
+    if (!space_marked(roots[i])) {
+      space_mark(roots[i]);
+      stack[sp++] = roots[i];
+    }
+  }
+  while (sp) {
+    obj_t* obj = stack[--sp];
+    for (size_t r = 0; r < 2; r++) {
+      if (obj->refs[r] && !space_marked(obj->refs[r])) {
+        space_mark(obj->refs[r]);
+        stack[sp++] = obj->refs[r];
+      }
+    }
+  }
+
+  return benchlib_now_ns() - t;
+}
+
+/******************************************************************************/
+/*                                 PARALLEL                                   */
+/******************************************************************************/
+static pm_t marker;
+static pm_worker_t* workers;
+
+static void trace(pm_worker_t* worker, void* obj) {
+  obj_t* o = obj;
+  pm_visit(worker, o->refs[0]);
+  pm_visit(worker, o->refs[1]);
+}
+
+static void work(void* worker) {
+  pm_work(worker);
+}
+
+static uint64_t parallel(size_t threads, size_t* steals) {
+  void* args[BENCHLIB_MAX_THREADS];
+  for (size_t i = 0; i < threads; i++) {
+    args[i] = &workers[i];
+  }
+
+  uint64_t t = benchlib_now_ns();
+  pm_init(&marker, trace, workers, threads);
+  for (size_t i = 0; i < ROOTS; i++) {
+    pm_root(&marker, roots[i]);
+  }
+
+  benchlib_run_threads(threads, work, args);
+  while (pm_overflowed(&marker)) {
+    for (size_t a = 0; a < spaces_len; a++) {
+      for (void* obj = space_first_marked(spaces[a]); obj;
+        obj = space_next_marked(obj)) {
+        pm_retrace(&marker, obj);
+      }
+    }
+    benchlib_run_threads(threads, work, args);
+  }
+  t = benchlib_now_ns() - t;
+
+  *steals = 0;
+  for (size_t i = 0; i < threads; i++) {
+    *steals += pm_stats(&workers[i])->steals;
+  }
+
+  return t;
+}
+
+int main(int argc, char** argv) {
+  size_t heap_mib = argc > 1 ? strtoul(argv[1], 0, 0) : 64;
+  size_t max_threads = argc > 2 ? strtoul(argv[2], 0, 0) : benchlib_cpus();
+  size_t repetitions = argc > 3 ? strtoul(argv[3], 0, 0) : 5;
+  assert(max_threads && max_threads <= BENCHLIB_MAX_THREADS);
+
+  build(heap_mib << 20);
+  stack = malloc(spaces_len * (space_EFFECTIVE_SIZE / sizeof(obj_t))
+    * sizeof(obj_t*));
+  workers = malloc(max_threads * sizeof(pm_worker_t));
+
+  uint64_t best = UINT64_MAX;
+  for (size_t rep = 0; rep < repetitions; rep++) {
+    unmark();
+    uint64_t ns = sequential();
+    best = ns < best ? ns : best;
+  }
+  size_t live = count_marked();
+
+  printf("%zu MiB heap, %zu live objects, %zu cores, best of %zu\n",
+    heap_mib, live, benchlib_cpus(), repetitions);
+  printf("%-10s %8s %10s %8s %10s\n",
+    "marker", "threads", "ms", "speedup", "steals");
+  printf("%-10s %8d %10.2f %8.2f %10d\n",
+    "sequential", 1, benchlib_ms(best), 1.0, 0);
+
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    uint64_t par_best = UINT64_MAX;
+    size_t steals = 0;
+
+    for (size_t rep = 0; rep < repetitions; rep++) {
+      unmark();
+      uint64_t ns = parallel(threads, &steals);
+      par_best = ns < par_best ? ns : par_best;
+    }
+    assert(count_marked() == live);
+
+    printf("%-10s %8zu %10.2f %8.2f %10zu\n", "parallel", threads,
+      benchlib_ms(par_best), (double)best / par_best, steals);
+
+    if (threads < max_threads && threads * 2 > max_threads) {
+      threads = max_threads / 2; /* always measure all cores */
+    }
+  }
+
+  for (size_t a = 0; a < spaces_len; a++) {
+    benchlib_free_arena(spaces[a], space_SIZE);
+  }
+  free(spaces);
+  free(stack);
+  free(workers);
+}
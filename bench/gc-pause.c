@@ -0,0 +1,109 @@
+/*
+  Collection pause of fal/gc.h versus live heap size.
+
+  Heap is a random graph of 32 byte nodes: a binary tree over shuffled nodes
+  plus one random cross reference per node, interleaved with the same amount
+  of garbage. First collection frees garbage, second one only marks and
+  sweeps live objects.
+
+  Usage: gc-pause [max live objects, default 4194304]
+*/
+#include "benchlib.h"
+
+#define FAL_GC_DEF_POW        20u   /* 1 MiB */
+#define FAL_GC_DEF_BLOCK_POW  4u    /* 16 bytes */
+#define FAL_GC_DEF_MARK_STACK 65536
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+typedef struct node_t node_t;
+struct node_t {
+  node_t* left;
+  node_t* right;
+  node_t* cross;
+  size_t id;
+};
+
+static void trace(gc_t* gc, void* obj) {
+  node_t* node = obj;
+  gc_visit(gc, (void**)&node->left);
+  gc_visit(gc, (void**)&node->right);
+  gc_visit(gc, (void**)&node->cross);
+}
+
+static void run(size_t live) {
+  gc_t* gc = malloc(sizeof(gc_t));
+  gc_init(gc, trace);
+
+  size_t arenas = 2 * live * sizeof(node_t) / gc_arena_EFFECTIVE_SIZE + 1;
+  for (size_t i = 0; i < arenas; i++) {
+    gc_add_arena(gc, benchlib_alloc_arena(gc_arena_SIZE));
+  }
+
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  node_t** nodes = malloc(live * sizeof(node_t*));
+  for (size_t i = 0; i < live; i++) {
+    nodes[i] = gc_alloc(gc, sizeof(node_t));
+    node_t* garbage = gc_alloc(gc, sizeof(node_t));
+    assert(nodes[i] && garbage);
+    nodes[i]->id = i;
+    garbage->cross = nodes[i];
+  }
+
+  /* Shuffle, so tree edges point all over the heap. */
+  for (size_t i = live - 1; i > 0; i--) {
+    size_t j = benchlib_rand(&seed) % (i + 1);
+    node_t* tmp = nodes[i];
+    nodes[i] = nodes[j];
+    nodes[j] = tmp;
+  }
+
+  for (size_t i = 0; i < live; i++) {
+    nodes[i]->left = 2 * i + 1 < live ? nodes[2 * i + 1] : 0;
+    nodes[i]->right = 2 * i + 2 < live ? nodes[2 * i + 2] : 0;
+    nodes[i]->cross = nodes[benchlib_rand(&seed) % live];
+  }
+
+  node_t* root = nodes[0];
+  free(nodes);
+
+  gc_root_t groot;
+  gc_add_root(gc, &groot, (void**)&root, 1);
+
+  uint64_t start = benchlib_now_ns();
+  gc_collect(gc);
+  uint64_t first = benchlib_now_ns() - start;
+
+  assert(gc_stats(gc)->live_bytes == live * gc_arena_size(root));
+
+  start = benchlib_now_ns();
+  gc_collect(gc);
+  uint64_t second = benchlib_now_ns() - start;
+
+  printf("%10zu %10.1f %10.1f %12.2f %12.2f %10.1f\n",
+    live,
+    live * gc_arena_size(root) / 1048576.0,
+    arenas * gc_arena_SIZE / 1048576.0,
+    benchlib_ms(first),
+    benchlib_ms(second),
+    (double)second / live);
+
+  for (gc_arena_t* arena = gc_first_arena(gc); arena; ) {
+    gc_arena_t* next = gc_next_arena(arena);
+    benchlib_free_arena(arena, gc_arena_SIZE);
+    arena = next;
+  }
+
+  free(gc);
+}
+
+int main(int argc, char** argv) {
+  size_t max = argc > 1 ? strtoul(argv[1], 0, 0) : 4u << 20;
+
+  printf("%10s %10s %10s %12s %12s %10s\n",
+    "live objs", "live MiB", "heap MiB", "pause ms", "no-garb ms", "ns/obj");
+
+  for (size_t live = 1u << 16; live <= max; live *= 2) {
+    run(live);
+  }
+}
@@ -0,0 +1,186 @@
+/*
+  Heap size, collection pause and traversal time of fal/gc.h with full
+  pointers versus 32-bit compressed references (gc_ref_t).
+
+  Heap is a complete binary tree of nodes with two children and 8 byte
+  payload: 24 bytes with pointers, rounded up to 32 with 16 byte blocks,
+  and 16 bytes with compressed references. Nodes are allocated in random
+  order over the heap, so traversal is pointer chasing with poor locality.
+  Arenas of compressed heap are carved from one reserved range.
+
+  Usage: gc-refs [tree depth, default 22] [repetitions, default 5]
+*/
+#include "benchlib.h"
+
+#define FAL_GC_DEF_POW        20u   /* 1 MiB */
+#define FAL_GC_DEF_BLOCK_POW  4u    /* 16 bytes */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+typedef struct pnode_t pnode_t;
+struct pnode_t {
+  pnode_t* kids[2];
+  size_t value;
+};
+
+typedef struct cnode_t {
+  gc_ref_t kids[2];
+  size_t value;
+} cnode_t;
+
+static gc_ref_heap_t heap;
+
+static void trace_pnode(gc_t* gc, void* obj) {
+  pnode_t* node = obj;
+  gc_visit(gc, (void**)&node->kids[0]);
+  gc_visit(gc, (void**)&node->kids[1]);
+}
+
+static void trace_cnode(gc_t* gc, void* obj) {
+  cnode_t* node = obj;
+  gc_visit_ref(gc, &heap, &node->kids[0]);
+  gc_visit_ref(gc, &heap, &node->kids[1]);
+}
+
+static size_t sum_pnode(pnode_t* node) {
+  return node ? node->value + sum_pnode(node->kids[0])
+    + sum_pnode(node->kids[1]) : 0;
+}
+
+static size_t sum_cnode(cnode_t* node) {
+  return node ? node->value
+    + sum_cnode(gc_ref_decompress(&heap, node->kids[0]))
+    + sum_cnode(gc_ref_decompress(&heap, node->kids[1])) : 0;
+}
+
+/* Allocate count objects and shuffle them. */
+static void** alloc_shuffled(gc_t* gc, size_t count, size_t size) {
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  void** objs = malloc(count * sizeof(void*));
+  for (size_t i = 0; i < count; i++) {
+    objs[i] = gc_alloc(gc, size);
+    assert(objs[i]);
+  }
+  for (size_t i = count - 1; i > 0; i--) {
+    size_t j = benchlib_rand(&seed) % (i + 1);
+    void* tmp = objs[i];
+    objs[i] = objs[j];
+    objs[j] = tmp;
+  }
+  return objs;
+}
+
+static size_t arenas_for(size_t bytes) {
+  size_t arenas = 1;
+  while (arenas * gc_arena_EFFECTIVE_SIZE < bytes) {
+    arenas *= 2;
+  }
+  return arenas;
+}
+
+static uint64_t best_of(size_t repetitions, gc_t* gc, void* root,
+  size_t (*sum)(void*), size_t expected, uint64_t* walk) {
+  uint64_t best = UINT64_MAX;
+  *walk = UINT64_MAX;
+  for (size_t rep = 0; rep < repetitions; rep++) {
+    uint64_t start = benchlib_now_ns();
+    gc_collect(gc);
+    uint64_t ns = benchlib_now_ns() - start;
+    best = ns < best ? ns : best;
+
+    start = benchlib_now_ns();
+    size_t s = sum(root);
+    ns = benchlib_now_ns() - start;
+    *walk = ns < *walk ? ns : *walk;
+    assert(s == expected);
+    FAL_UNUSED(s);
+    FAL_UNUSED(expected);
+  }
+  return best;
+}
+
+static size_t sum_p(void* root) {
+  return sum_pnode(root);
+}
+
+static size_t sum_c(void* root) {
+  return sum_cnode(root);
+}
+
+int main(int argc, char** argv) {
+  size_t depth = argc > 1 ? strtoul(argv[1], 0, 0) : 22;
+  size_t repetitions = argc > 2 ? strtoul(argv[2], 0, 0) : 5;
+  size_t count = ((size_t)1 << depth) - 1;
+  size_t expected = count * (count - 1) / 2;
+
+  printf("%zu nodes, best of %zu\n", count, repetitions);
+  printf("%-10s %10s %10s %10s\n", "refs", "live MiB", "pause ms", "walk ms");
+
+  /* Full pointers, arenas anywhere. */
+  {
+    gc_t* gc = malloc(sizeof(gc_t));
+    gc_init(gc, trace_pnode);
+    size_t arenas = arenas_for(count * 32);
+    for (size_t a = 0; a < arenas; a++) {
+      gc_add_arena(gc, benchlib_alloc_arena(gc_arena_SIZE));
+    }
+
+    pnode_t** nodes = (pnode_t**)alloc_shuffled(gc, count, sizeof(pnode_t));
+    for (size_t i = 0; i < count; i++) {
+      nodes[i]->value = i;
+      nodes[i]->kids[0] = 2 * i + 1 < count ? nodes[2 * i + 1] : 0;
+      nodes[i]->kids[1] = 2 * i + 2 < count ? nodes[2 * i + 2] : 0;
+    }
+    pnode_t* root = nodes[0];
+    free(nodes);
+    gc_root_t groot;
+    gc_add_root(gc, &groot, (void**)&root, 1);
+
+    uint64_t walk;
+    uint64_t pause = best_of(repetitions, gc, root, sum_p, expected, &walk);
+    printf("%-10s %10.2f %10.2f %10.2f\n", "pointers",
+      (double)gc_stats(gc)->live_bytes / (1 << 20), benchlib_ms(pause),
+      benchlib_ms(walk));
+
+    for (gc_arena_t* arena = gc_first_arena(gc); arena; ) {
+      gc_arena_t* next = gc_next_arena(arena);
+      benchlib_free_arena(arena, gc_arena_SIZE);
+      arena = next;
+    }
+    free(gc);
+  }
+
+  /* Compressed references, arenas in one range. */
+  {
+    gc_t* gc = malloc(sizeof(gc_t));
+    gc_init(gc, trace_cnode);
+    size_t arenas = arenas_for(count * 16);
+    char* base = benchlib_alloc_arena(arenas * gc_arena_SIZE);
+    gc_ref_init(&heap, base, arenas * gc_arena_SIZE);
+    for (size_t a = 0; a < arenas; a++) {
+      gc_add_arena(gc, base + a * gc_arena_SIZE);
+    }
+
+    cnode_t** nodes = (cnode_t**)alloc_shuffled(gc, count, sizeof(cnode_t));
+    for (size_t i = 0; i < count; i++) {
+      nodes[i]->value = i;
+      nodes[i]->kids[0] = 2 * i + 1 < count
+        ? gc_ref_compress(&heap, nodes[2 * i + 1]) : 0;
+      nodes[i]->kids[1] = 2 * i + 2 < count
+        ? gc_ref_compress(&heap, nodes[2 * i + 2]) : 0;
+    }
+    cnode_t* root = nodes[0];
+    free(nodes);
+    gc_root_t groot;
+    gc_add_root(gc, &groot, (void**)&root, 1);
+
+    uint64_t walk;
+    uint64_t pause = best_of(repetitions, gc, root, sum_c, expected, &walk);
+    printf("%-10s %10.2f %10.2f %10.2f\n", "compressed",
+      (double)gc_stats(gc)->live_bytes / (1 << 20), benchlib_ms(pause),
+      benchlib_ms(walk));
+
+    benchlib_free_arena(base, arenas * gc_arena_SIZE);
+    free(gc);
+  }
+}
@@ -0,0 +1,105 @@
+/*
+  Heap sizing of fal/gc.h with FAL_GC_DEF_ARENA_ALLOC: memory versus time
+  spent collecting for different heap_ratio values and cpu_budget.
+
+  Workload keeps sliding window of live 32 byte nodes (ring of references
+  from root array) and allocates garbage nodes between replacements, so live
+  size is constant and every collection has the same work. With fixed
+  ratio rows cpu_budget is 100%, i.e. ratio never changes, budget rows
+  start at 150% and let collector grow heap until collections take less
+  than budget.
+
+  Usage: gc-sizing [live MiB, default 16] [allocated MiB, default 1024]
+*/
+#include "benchlib.h"
+
+static size_t peak_arenas;
+static size_t arenas;
+
+static void* arena_alloc(void) {
+  if (++arenas > peak_arenas) {
+    peak_arenas = arenas;
+  }
+  return benchlib_alloc_arena(1u << 20);
+}
+
+static void arena_free(void* mem) {
+  arenas--;
+  benchlib_free_arena(mem, 1u << 20);
+}
+
+#define FAL_GC_DEF_POW            20u   /* 1 MiB */
+#define FAL_GC_DEF_BLOCK_POW      4u    /* 16 bytes */
+#define FAL_GC_DEF_CLOCK()        benchlib_now_ns()
+#define FAL_GC_DEF_ARENA_ALLOC()  arena_alloc()
+#define FAL_GC_DEF_ARENA_FREE(Mem) arena_free(Mem)
+#define FAL_GC_DEF_NAME           gc
+#include <fal/gc.h>
+
+typedef struct node_t node_t;
+struct node_t {
+  node_t* next;
+  size_t pad[3];
+};
+
+static void trace(gc_t* gc, void* obj) {
+  gc_visit(gc, (void**)&((node_t*)obj)->next);
+}
+
+static void run(size_t live, size_t total, size_t ratio, size_t budget) {
+  gc_t* gc = malloc(sizeof(gc_t));
+  gc_init(gc, trace);
+  gc_tuning(gc)->heap_ratio = ratio;
+  gc_tuning(gc)->cpu_budget = budget;
+  peak_arenas = arenas = 0;
+
+  size_t slots = live / sizeof(node_t);
+  node_t** window = calloc(slots, sizeof(node_t*));
+  gc_root_t root;
+  gc_add_root(gc, &root, (void**)window, slots);
+
+  uint64_t start = benchlib_now_ns();
+  size_t count = total / sizeof(node_t);
+  for (size_t i = 0; i < count; i++) {
+    node_t* node = gc_alloc(gc, sizeof(node_t));
+    assert(node);
+    if (i % 4 == 0) {
+      window[(i / 4) % slots] = node;
+    }
+  }
+  uint64_t ns = benchlib_now_ns() - start;
+
+  const gc_stats_t* stats = gc_stats(gc);
+  printf("%6zu%% %6zu%% %6zu%% %8zu %8zu %8zu %10.2f %10.2f %6.1f%%\n",
+    ratio, budget, stats->heap_ratio, stats->triggered, peak_arenas,
+    stats->arenas, benchlib_ms(ns), benchlib_ms(stats->gc_ns),
+    100.0 * stats->gc_ns / ns);
+
+  for (gc_arena_t* arena = gc_first_arena(gc); arena; ) {
+    gc_arena_t* next = gc_next_arena(arena);
+    arena_free(arena);
+    arena = next;
+  }
+  free(window);
+  free(gc);
+}
+
+int main(int argc, char** argv) {
+  size_t live_mib = argc > 1 ? strtoul(argv[1], 0, 0) : 16;
+  size_t total_mib = argc > 2 ? strtoul(argv[2], 0, 0) : 1024;
+
+  printf("%zu MiB live, %zu MiB allocated, heap in 1 MiB arenas\n",
+    live_mib, total_mib);
+  printf("%7s %7s %7s %8s %8s %8s %10s %10s %7s\n", "ratio", "budget",
+    "final", "GCs", "peak", "arenas", "total ms", "gc ms", "gc");
+
+  static const size_t ratios[] = { 125, 150, 200, 300, 400, 800 };
+  for (size_t i = 0; i < sizeof(ratios) / sizeof(ratios[0]); i++) {
+    run(live_mib << 20, total_mib << 20, ratios[i], 100);
+  }
+
+  static const size_t budgets[] = { 20, 10, 5 };
+  for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+    run(live_mib << 20, total_mib << 20, 150, budgets[i]);
+  }
+}
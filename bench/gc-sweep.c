@@ -0,0 +1,136 @@
+/*
+  Collection pause of fal/gc.h with fixed live set and growing heap:
+    full     - gc_collect, marks and sweeps every arena
+    lazy     - gc_collect_lazy, only marks, arenas are swept by gc_alloc
+    parallel - gc_collect_lazy, then arenas are swept by gc_sweep_part on
+               all cores and gc_finish ends the cycle
+  For lazy mode also prints time of refilling the heap with gc_alloc after
+  collection versus the same after full collection, i.e. where sweeping went.
+
+  Live objects are 32 byte nodes of a list spread evenly over the heap, the
+  rest of heap is filled with garbage nodes before every collection.
+
+  Usage: gc-sweep [live MiB, default 8] [max heap MiB, default 512]
+                  [threads, default all cores]
+*/
+#include "benchlib.h"
+
+#define FAL_GC_DEF_POW        20u   /* 1 MiB */
+#define FAL_GC_DEF_BLOCK_POW  4u    /* 16 bytes */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+typedef struct node_t node_t;
+struct node_t {
+  node_t* next;
+  size_t pad[3];
+};
+
+static gc_t* gc;
+static size_t threads;
+
+static void trace(gc_t* gc, void* obj) {
+  gc_visit(gc, (void**)&((node_t*)obj)->next);
+}
+
+/* Allocate until heap is full, returns time spent. */
+static uint64_t fill(void) {
+  uint64_t start = benchlib_now_ns();
+  while (gc_alloc(gc, sizeof(node_t))) {
+  }
+  return benchlib_now_ns() - start;
+}
+
+typedef struct part_t {
+  size_t part;
+} part_t;
+
+static void sweep(void* arg) {
+  gc_sweep_part(gc, ((part_t*)arg)->part, threads);
+}
+
+static void run(size_t live, size_t heap) {
+  gc = malloc(sizeof(gc_t));
+  gc_init(gc, trace);
+
+  size_t arenas = heap / gc_arena_SIZE;
+  for (size_t i = 0; i < arenas; i++) {
+    gc_add_arena(gc, benchlib_alloc_arena(gc_arena_SIZE));
+  }
+
+  /* Every step-th node is live. */
+  size_t step = heap / live;
+  size_t count = 0;
+  node_t* list = 0;
+  node_t* node;
+  while ((node = gc_alloc(gc, sizeof(node_t)))) {
+    if (count++ % step == 0) {
+      node->next = list;
+      list = node;
+    }
+  }
+
+  gc_root_t root;
+  gc_add_root(gc, &root, (void**)&list, 1);
+  gc_collect(gc);
+  size_t live_bytes = gc_stats(gc)->live_bytes;
+  FAL_UNUSED(live_bytes); /* used only by asserts */
+
+  /* Full collection and refill. */
+  fill();
+  uint64_t start = benchlib_now_ns();
+  gc_collect(gc);
+  uint64_t full = benchlib_now_ns() - start;
+  uint64_t full_fill = fill();
+
+  /* Lazy collection, sweeping happens during refill. */
+  start = benchlib_now_ns();
+  gc_collect_lazy(gc);
+  uint64_t lazy = benchlib_now_ns() - start;
+  uint64_t lazy_fill = fill();
+  gc_finish(gc);
+  assert(gc_stats(gc)->live_bytes == live_bytes);
+
+  /* Lazy collection with parallel sweep. */
+  part_t parts[BENCHLIB_MAX_THREADS];
+  void* args[BENCHLIB_MAX_THREADS];
+  for (size_t i = 0; i < threads; i++) {
+    parts[i].part = i;
+    args[i] = &parts[i];
+  }
+
+  start = benchlib_now_ns();
+  gc_collect_lazy(gc);
+  benchlib_run_threads(threads, sweep, args);
+  gc_finish(gc);
+  uint64_t parallel = benchlib_now_ns() - start;
+  assert(gc_stats(gc)->live_bytes == live_bytes);
+
+  printf("%8zu %10.2f %10.2f %10.2f %12.2f %12.2f\n",
+    heap >> 20,
+    benchlib_ms(full), benchlib_ms(lazy), benchlib_ms(parallel),
+    benchlib_ms(full_fill), benchlib_ms(lazy_fill));
+
+  for (gc_arena_t* arena = gc_first_arena(gc); arena; ) {
+    gc_arena_t* next = gc_next_arena(arena);
+    benchlib_free_arena(arena, gc_arena_SIZE);
+    arena = next;
+  }
+  free(gc);
+}
+
+int main(int argc, char** argv) {
+  size_t live_mib = argc > 1 ? strtoul(argv[1], 0, 0) : 8;
+  size_t max_mib = argc > 2 ? strtoul(argv[2], 0, 0) : 512;
+  threads = argc > 3 ? strtoul(argv[3], 0, 0) : benchlib_cpus();
+  assert(threads && threads <= BENCHLIB_MAX_THREADS);
+
+  printf("%zu MiB live, %zu sweep threads, pauses and refill times in ms\n",
+    live_mib, threads);
+  printf("%8s %10s %10s %10s %12s %12s\n",
+    "heap MiB", "full", "lazy", "parallel", "fill (full)", "fill (lazy)");
+
+  for (size_t mib = 2 * live_mib; mib <= max_mib; mib *= 2) {
+    run(live_mib << 20, mib << 20);
+  }
+}
@@ -0,0 +1,150 @@
+/*
+  Heap size and collection time of fal/gc.h with objects of two kinds:
+    tagged - every object starts with type word, one trace callback
+             switches on it, all objects share arenas
+    typed  - each kind lives in arenas of its gc_type_t, objects have no
+             type word, pairs have their own trace callback and integers
+             have none, so they are marked without going to mark stack
+
+  Heap is a list of 16 byte pairs (car, cdr), car of every pair points to
+  16 byte boxed integer. Type word makes tagged pair 24 bytes, which is
+  rounded up to 32 with 16 byte blocks, tagged integer still fits 16.
+
+  Usage: gc-typed [pairs in millions, default 2] [repetitions, default 5]
+*/
+#include "benchlib.h"
+
+#define FAL_GC_DEF_POW        20u   /* 1 MiB */
+#define FAL_GC_DEF_BLOCK_POW  4u    /* 16 bytes */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+enum { TAG_PAIR, TAG_INT };
+
+typedef struct tagged_t tagged_t;
+struct tagged_t {
+  size_t tag;
+  union {
+    struct {
+      tagged_t* car;
+      tagged_t* cdr;
+    } pair;
+    int64_t value;
+  } u;
+};
+
+typedef struct pair_t pair_t;
+struct pair_t {
+  void* car;
+  pair_t* cdr;
+};
+
+typedef struct int_t {
+  int64_t value;
+  int64_t pad;
+} int_t;
+
+static void trace_tagged(gc_t* gc, void* obj) {
+  tagged_t* t = obj;
+  if (t->tag == TAG_PAIR) {
+    gc_visit(gc, (void**)&t->u.pair.car);
+    gc_visit(gc, (void**)&t->u.pair.cdr);
+  }
+}
+
+static void trace_pair(gc_t* gc, void* obj) {
+  pair_t* p = obj;
+  gc_visit(gc, &p->car);
+  gc_visit(gc, (void**)&p->cdr);
+}
+
+static gc_t* setup(size_t bytes, gc_trace_fn trace) {
+  gc_t* gc = malloc(sizeof(gc_t));
+  gc_init(gc, trace);
+  for (size_t i = 0; i < bytes / gc_arena_EFFECTIVE_SIZE + 2; i++) {
+    gc_add_arena(gc, benchlib_alloc_arena(gc_arena_SIZE));
+  }
+  return gc;
+}
+
+static void teardown(gc_t* gc) {
+  for (gc_arena_t* arena = gc_first_arena(gc); arena; ) {
+    gc_arena_t* next = gc_next_arena(arena);
+    benchlib_free_arena(arena, gc_arena_SIZE);
+    arena = next;
+  }
+  free(gc);
+}
+
+static uint64_t collect(gc_t* gc, size_t repetitions) {
+  uint64_t best = UINT64_MAX;
+  for (size_t rep = 0; rep < repetitions; rep++) {
+    uint64_t start = benchlib_now_ns();
+    gc_collect(gc);
+    uint64_t ns = benchlib_now_ns() - start;
+    best = ns < best ? ns : best;
+  }
+  return best;
+}
+
+static void print(const char* name, gc_t* gc, uint64_t ns) {
+  printf("%-8s %10.2f %10zu %10.2f\n", name,
+    (double)gc_stats(gc)->live_bytes / (1 << 20), gc_stats(gc)->arenas,
+    benchlib_ms(ns));
+}
+
+int main(int argc, char** argv) {
+  size_t pairs = (argc > 1 ? strtoul(argv[1], 0, 0) : 2) * 1000000;
+  size_t repetitions = argc > 2 ? strtoul(argv[2], 0, 0) : 5;
+
+  printf("%zu pairs of pair and boxed int, best of %zu collections\n",
+    pairs, repetitions);
+  printf("%-8s %10s %10s %10s\n", "objects", "live MiB", "arenas", "pause ms");
+
+  /* Tagged, 48 bytes per pair and integer. */
+  {
+    gc_t* gc = setup(pairs * 48, trace_tagged);
+    tagged_t* list = 0;
+    gc_root_t root;
+    gc_add_root(gc, &root, (void**)&list, 1);
+    for (size_t i = 0; i < pairs; i++) {
+      tagged_t* value = gc_alloc(gc, 2 * sizeof(size_t));
+      tagged_t* pair = gc_alloc(gc, sizeof(tagged_t));
+      assert(value && pair);
+      value->tag = TAG_INT;
+      value->u.value = (int64_t)i;
+      pair->tag = TAG_PAIR;
+      pair->u.pair.car = value;
+      pair->u.pair.cdr = list;
+      list = pair;
+    }
+
+    print("tagged", gc, collect(gc, repetitions));
+    teardown(gc);
+  }
+
+  /* Typed arenas, 32 bytes per pair and integer. */
+  {
+    gc_t* gc = setup(pairs * 32, 0);
+    gc_type_t pair_type;
+    gc_type_t int_type;
+    gc_add_type(gc, &pair_type, sizeof(pair_t), trace_pair);
+    gc_add_type(gc, &int_type, sizeof(int_t), 0); /* no pointers */
+
+    pair_t* list = 0;
+    gc_root_t root;
+    gc_add_root(gc, &root, (void**)&list, 1);
+    for (size_t i = 0; i < pairs; i++) {
+      int_t* value = gc_alloc_typed(gc, &int_type);
+      pair_t* pair = gc_alloc_typed(gc, &pair_type);
+      assert(value && pair);
+      value->value = (int64_t)i;
+      pair->car = value;
+      pair->cdr = list;
+      list = pair;
+    }
+
+    print("typed", gc, collect(gc, repetitions));
+    teardown(gc);
+  }
+}
@@ -0,0 +1,97 @@
+/*
+  Mid-size allocations of samples/arena/microalloc.h with and without
+  medium tier versus libc malloc.
+
+  Table of slots is filled and churned like in microalloc-mixed, but sizes
+  are log-uniform from microalloc's small limit up to its medium limit, i.e.
+  about 1..32 KiB. Without medium tier (mc_tuning.medium_max = 0) every one
+  of them is separate os mapping.
+
+  Prints ns per churn step (free + alloc), os calls made during churn and
+  RSS growth with the live set in place after churn.
+
+  Usage: microalloc-medium [slots, default 1024] [churn steps, default 200000]
+*/
+#include "benchlib.h"
+#include "../samples/arena/microalloc.h"
+
+typedef struct allocator_t {
+  const char* name;
+  void* (*alloc)(size_t size);
+  void (*free)(void* ptr);
+  size_t medium_max;
+} allocator_t;
+
+static void* mc_alloc_fn(size_t size) {
+  return mc_alloc(size);
+}
+
+static void mc_free_fn(void* ptr) {
+  mc_free(ptr);
+}
+
+/* Log-uniform in (mc_SMALL_MAX, mc_MEDIUM_MAX]. */
+static size_t random_size(uint64_t* seed) {
+  uint64_t rnd = benchlib_rand(seed);
+  size_t size = (size_t)mc_SMALL_MAX << (rnd % 6);
+  size += (rnd >> 8) % size;
+  return size < mc_MEDIUM_MAX ? size + 1 : mc_MEDIUM_MAX;
+}
+
+static void run(const allocator_t* a, size_t slots, size_t steps) {
+  void** ptrs = calloc(slots, sizeof(void*));
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  size_t rss = benchlib_rss();
+  mc_tuning.medium_max = a->medium_max;
+
+  for (size_t i = 0; i < slots; i++) {
+    ptrs[i] = a->alloc(random_size(&seed));
+    *(char*)ptrs[i] = 1;
+  }
+
+  mc_stats_t before = mc_stats();
+  uint64_t start = benchlib_now_ns();
+  for (size_t step = 0; step < steps; step++) {
+    size_t i = benchlib_rand(&seed) % slots;
+    a->free(ptrs[i]);
+    ptrs[i] = a->alloc(random_size(&seed));
+    *(char*)ptrs[i] = 1;
+  }
+  uint64_t churn = benchlib_now_ns() - start;
+  mc_stats_t after = mc_stats();
+  rss = benchlib_rss() - rss;
+
+  for (size_t i = 0; i < slots; i++) {
+    a->free(ptrs[i]);
+  }
+  mc_trim();
+
+  printf("%-12s %10.1f %12zu %12zu %10.2f\n", a->name,
+    steps ? (double)churn / steps : 0.0,
+    after.maps - before.maps, after.unmaps - before.unmaps,
+    rss / 1048576.0);
+
+  free(ptrs);
+}
+
+int main(int argc, char** argv) {
+  size_t slots = argc > 1 ? strtoul(argv[1], 0, 0) : 1024;
+  size_t steps = argc > 2 ? strtoul(argv[2], 0, 0) : 200000;
+  assert(slots);
+
+  const allocator_t allocators[] = {
+    {"no medium", mc_alloc_fn, mc_free_fn, 0},
+    {"medium", mc_alloc_fn, mc_free_fn, mc_MEDIUM_MAX},
+    {"libc", malloc, free, mc_MEDIUM_MAX}
+  };
+
+  mc_init();
+
+  printf("%zu slots, %zu churn steps, sizes %u..%u bytes\n", slots, steps,
+    (unsigned)mc_SMALL_MAX + 1, (unsigned)mc_MEDIUM_MAX);
+  printf("%-12s %10s %12s %12s %10s\n",
+    "allocator", "step ns", "maps", "unmaps", "RSS MiB");
+  for (size_t i = 0; i < FAL_ARRLEN(allocators); i++) {
+    run(&allocators[i], slots, steps);
+  }
+}
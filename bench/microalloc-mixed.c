@@ -0,0 +1,113 @@
+/*
+  Throughput and memory of samples/arena/microalloc.h versus libc malloc on
+  mixed small sizes.
+
+  Table of slots is filled with allocations and then churned: every step
+  frees random slot and allocates new one of random size in its place. Sizes
+  are 60% 8..64 bytes, 30% 64..256 bytes and 10% 256 bytes up to microalloc's
+  small limit, so everything stays in buckets.
+
+  Prints time of filling, ns per churn step (free + alloc), time of freeing
+  everything and RSS growth with the live set in place after churn. Live
+  bytes are the sum of requested sizes, i.e. lower bound for RSS.
+
+  microalloc-mixed-trace is the same with MC_TRACE, i.e. every allocation
+  event recorded in fal/trace.h ring, to show what tracing costs.
+  microalloc-mixed-profile is the same with MC_PROFILE at default sampling
+  rate, to show what the countdown on every allocation costs.
+
+  Usage: microalloc-mixed [slots, default 65536] [churn steps, default 2M]
+*/
+#include "benchlib.h"
+#include "../samples/arena/microalloc.h"
+
+typedef struct allocator_t {
+  const char* name;
+  void* (*alloc)(size_t size);
+  void (*free)(void* ptr);
+} allocator_t;
+
+static void* mc_alloc_fn(size_t size) {
+  return mc_alloc(size);
+}
+
+static void mc_free_fn(void* ptr) {
+  mc_free(ptr);
+}
+
+static size_t random_size(uint64_t* seed) {
+  uint64_t rnd = benchlib_rand(seed);
+  size_t kind = rnd % 10;
+  rnd >>= 8;
+
+  if (kind < 6) {
+    return 8 + rnd % 57;
+  } else if (kind < 9) {
+    return 64 + rnd % 193;
+  }
+  return 256 + rnd % (mc_SMALL_MAX - 256 + 1);
+}
+
+static void run(const allocator_t* a, size_t slots, size_t steps) {
+  void** ptrs = calloc(slots, sizeof(void*));
+  size_t* sizes = calloc(slots, sizeof(size_t));
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  size_t live = 0;
+  size_t rss = benchlib_rss();
+
+  uint64_t start = benchlib_now_ns();
+  for (size_t i = 0; i < slots; i++) {
+    sizes[i] = random_size(&seed);
+    ptrs[i] = a->alloc(sizes[i]);
+    *(char*)ptrs[i] = 1;
+    live += sizes[i];
+  }
+  uint64_t fill = benchlib_now_ns() - start;
+
+  start = benchlib_now_ns();
+  for (size_t step = 0; step < steps; step++) {
+    size_t i = benchlib_rand(&seed) % slots;
+    a->free(ptrs[i]);
+    live -= sizes[i];
+
+    sizes[i] = random_size(&seed);
+    ptrs[i] = a->alloc(sizes[i]);
+    *(char*)ptrs[i] = 1;
+    live += sizes[i];
+  }
+  uint64_t churn = benchlib_now_ns() - start;
+  rss = benchlib_rss() - rss;
+
+  start = benchlib_now_ns();
+  for (size_t i = 0; i < slots; i++) {
+    a->free(ptrs[i]);
+  }
+  uint64_t drain = benchlib_now_ns() - start;
+
+  printf("%-12s %10.2f %10.1f %10.2f %10.2f %10.2f\n", a->name,
+    benchlib_ms(fill), steps ? (double)churn / steps : 0.0,
+    benchlib_ms(drain), live / 1048576.0, rss / 1048576.0);
+
+  free(ptrs);
+  free(sizes);
+}
+
+int main(int argc, char** argv) {
+  size_t slots = argc > 1 ? strtoul(argv[1], 0, 0) : 65536;
+  size_t steps = argc > 2 ? strtoul(argv[2], 0, 0) : 2000000;
+  assert(slots);
+
+  static const allocator_t allocators[] = {
+    {"microalloc", mc_alloc_fn, mc_free_fn},
+    {"libc", malloc, free}
+  };
+
+  mc_init();
+
+  printf("%zu slots, %zu churn steps\n", slots, steps);
+  printf("%-12s %10s %10s %10s %10s %10s\n",
+    "allocator", "fill ms", "step ns", "free ms", "live MiB", "RSS MiB");
+  for (size_t i = 0; i < FAL_ARRLEN(allocators); i++) {
+    run(&allocators[i], slots, steps);
+  }
+}
@@ -0,0 +1,61 @@
+/*
+  Empty bucket retention of samples/arena/microalloc.h on allocations which
+  oscillate around bucket boundary: every round allocates batch of same size
+  blocks and then frees all of them, so every round empties all buckets it
+  filled.
+
+  Runs with retention disabled (mc_tuning.retain_max = 0) and with default
+  tuning, prints ns per alloc+free pair and os calls made and avoided.
+
+  Usage: microalloc-retain [batch, default 128] [size, default 512]
+                           [rounds, default 20000]
+*/
+#include "benchlib.h"
+#include "../samples/arena/microalloc.h"
+
+static void run(const char* name, size_t batch, size_t size, size_t rounds) {
+  void** ptrs = malloc(batch * sizeof(void*));
+  mc_stats_t before = mc_stats();
+
+  uint64_t start = benchlib_now_ns();
+  for (size_t round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < batch; i++) {
+      ptrs[i] = mc_alloc(size);
+      *(char*)ptrs[i] = 1;
+    }
+    for (size_t i = 0; i < batch; i++) {
+      mc_free(ptrs[i]);
+    }
+  }
+  uint64_t ns = benchlib_now_ns() - start;
+  mc_trim();
+
+  mc_stats_t after = mc_stats();
+  printf("%-10s %10.1f %12zu %12zu %12zu %12zu\n", name,
+    (double)ns / (batch * rounds),
+    after.maps - before.maps, after.unmaps - before.unmaps,
+    after.maps_avoided - before.maps_avoided,
+    after.unmaps_avoided - before.unmaps_avoided);
+
+  free(ptrs);
+}
+
+int main(int argc, char** argv) {
+  size_t batch = argc > 1 ? strtoul(argv[1], 0, 0) : 128;
+  size_t size = argc > 2 ? strtoul(argv[2], 0, 0) : 512;
+  size_t rounds = argc > 3 ? strtoul(argv[3], 0, 0) : 20000;
+  assert(batch && size && size <= mc_SMALL_MAX);
+
+  mc_init();
+
+  printf("%zu x %zu bytes, %zu rounds\n", batch, size, rounds);
+  printf("%-10s %10s %12s %12s %12s %12s\n", "retention", "ns/pair",
+    "maps", "unmaps", "maps saved", "unmaps saved");
+
+  mc_tuning_t tuning = mc_tuning;
+  mc_tuning.retain_max = 0;
+  run("off", batch, size, rounds);
+
+  mc_tuning = tuning;
+  run("on", batch, size, rounds);
+}
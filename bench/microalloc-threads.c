@@ -0,0 +1,178 @@
+/*
+  Multi-threaded throughput of samples/arena/microalloc.h versus libc malloc:
+    local    - every thread churns its own table of mixed 8..512 byte
+               allocations, so all frees are local
+    prodcons - threads are split into producer/consumer pairs, producer
+               allocates and passes pointers through ring to consumer which
+               frees them, so all frees are remote
+
+  Prints millions of alloc+free pairs per second for every thread count.
+
+  Usage: microalloc-threads [max threads, default all cores but at least 2]
+                            [ops per thread, default 1M]
+*/
+#include "benchlib.h"
+#include <fal/atomic.h>
+#include "../samples/arena/microalloc.h"
+
+enum { SLOTS = 4096, RING = 1024 };
+
+typedef struct allocator_t {
+  const char* name;
+  void* (*alloc)(size_t size);
+  void (*free)(void* ptr);
+  void (*exit)(void);
+} allocator_t;
+
+static void* mc_alloc_fn(size_t size) {
+  return mc_alloc(size);
+}
+
+static void mc_free_fn(void* ptr) {
+  mc_free(ptr);
+}
+
+static void mc_exit_fn(void) {
+  mc_thread_exit();
+}
+
+static void libc_exit_fn(void) {
+}
+
+typedef struct ring_t {
+  volatile size_t head;
+  char pad0[64 - sizeof(size_t)];
+  volatile size_t tail;
+  char pad1[64 - sizeof(size_t)];
+  void* slots[RING];
+} ring_t;
+
+typedef struct worker_t {
+  const allocator_t* a;
+  ring_t* ring;     /* 0 for local mode */
+  int producer;
+  size_t ops;
+  uint64_t seed;
+} worker_t;
+
+static size_t random_size(uint64_t* seed) {
+  return 8 + benchlib_rand(seed) % 505;
+}
+
+static void local(worker_t* w) {
+  void* ptrs[SLOTS] = {0};
+  for (size_t op = 0; op < w->ops; op++) {
+    size_t i = benchlib_rand(&w->seed) % SLOTS;
+    if (ptrs[i]) {
+      w->a->free(ptrs[i]);
+    }
+    ptrs[i] = w->a->alloc(random_size(&w->seed));
+    *(char*)ptrs[i] = 1;
+  }
+
+  for (size_t i = 0; i < SLOTS; i++) {
+    if (ptrs[i]) {
+      w->a->free(ptrs[i]);
+    }
+  }
+}
+
+static void produce(worker_t* w) {
+  ring_t* ring = w->ring;
+  for (size_t op = 0; op < w->ops; op++) {
+    void* ptr = w->a->alloc(random_size(&w->seed));
+    *(char*)ptr = 1;
+
+    size_t tail = ring->tail;
+    while (tail - fal_atomic_load(&ring->head, FAL_ATOMIC_ACQUIRE) == RING) {
+      benchlib_yield();
+    }
+    ring->slots[tail % RING] = ptr;
+    fal_atomic_store(&ring->tail, tail + 1, FAL_ATOMIC_RELEASE);
+  }
+}
+
+static void consume(worker_t* w) {
+  ring_t* ring = w->ring;
+  for (size_t op = 0; op < w->ops; op++) {
+    size_t head = ring->head;
+    while (fal_atomic_load(&ring->tail, FAL_ATOMIC_ACQUIRE) == head) {
+      benchlib_yield();
+    }
+    void* ptr = ring->slots[head % RING];
+    fal_atomic_store(&ring->head, head + 1, FAL_ATOMIC_RELEASE);
+
+    w->a->free(ptr);
+  }
+}
+
+static void work(void* arg) {
+  worker_t* w = arg;
+  if (!w->ring) {
+    local(w);
+  } else if (w->producer) {
+    produce(w);
+  } else {
+    consume(w);
+  }
+  w->a->exit();
+}
+
+static double run(const allocator_t* a, int pairs, size_t threads,
+  size_t ops) {
+  static worker_t workers[BENCHLIB_MAX_THREADS];
+  static ring_t rings[BENCHLIB_MAX_THREADS / 2];
+  void* args[BENCHLIB_MAX_THREADS];
+
+  for (size_t i = 0; i < threads; i++) {
+    workers[i].a = a;
+    workers[i].ring = pairs ? &rings[i / 2] : 0;
+    workers[i].producer = !(i % 2);
+    workers[i].ops = ops;
+    workers[i].seed = 0x9e3779b97f4a7c15ull * (i / 2 + 1);
+    args[i] = &workers[i];
+  }
+  for (size_t i = 0; i < threads / 2; i++) {
+    rings[i].head = rings[i].tail = 0;
+  }
+
+  uint64_t start = benchlib_now_ns();
+  benchlib_run_threads(threads, work, args);
+  uint64_t ns = benchlib_now_ns() - start;
+
+  /* Pair does ops allocations and frees between two threads. */
+  size_t total = pairs ? threads / 2 * ops : threads * ops;
+  return total / (ns / 1e3);
+}
+
+int main(int argc, char** argv) {
+  size_t cpus = benchlib_cpus();
+  size_t max_threads = argc > 1 ? strtoul(argv[1], 0, 0)
+    : cpus < 2 ? 2 : cpus;
+  size_t ops = argc > 2 ? strtoul(argv[2], 0, 0) : 1000000;
+  assert(max_threads >= 2 && max_threads <= BENCHLIB_MAX_THREADS);
+
+  static const allocator_t allocators[] = {
+    {"microalloc", mc_alloc_fn, mc_free_fn, mc_exit_fn},
+    {"libc", malloc, free, libc_exit_fn}
+  };
+
+  mc_init();
+
+  printf("%zu ops per thread, %zu cores, Mops/s\n", ops, cpus);
+  printf("%-10s %8s %12s %12s\n", "mode", "threads", "microalloc", "libc");
+  for (int pairs = 0; pairs < 2; pairs++) {
+    size_t limit = pairs ? max_threads & ~(size_t)1 : max_threads;
+    for (size_t threads = pairs ? 2 : 1; threads <= limit; threads *= 2) {
+      printf("%-10s %8zu", pairs ? "prodcons" : "local", threads);
+      for (size_t i = 0; i < FAL_ARRLEN(allocators); i++) {
+        printf(" %12.2f", run(&allocators[i], pairs, threads, ops));
+      }
+      printf("\n");
+
+      if (threads < limit && threads * 2 > limit) {
+        threads = limit / 2; /* always measure all threads */
+      }
+    }
+  }
+}
@@ -0,0 +1,97 @@
+/*
+  Growing vector on huge allocations of samples/arena/microalloc.h with and
+  without resizing in mapping versus libc realloc.
+
+  Vector of size_t starts at 64 KiB and every time it fills up its capacity
+  is doubled with realloc, until it reaches the limit. Then it is shrunk by
+  halves back to 64 KiB. With mc_tuning.remap = 0 every growth copies whole
+  vector into new mapping, with it os grows or moves mapping (mremap) and
+  shrinking unmaps the tail.
+
+  Prints total ms of filling, ms spent in growing reallocs, ms spent in
+  shrinking reallocs and os calls made.
+
+  Usage: microalloc-vector [limit MiB, default 256] [rounds, default 4]
+*/
+#include "benchlib.h"
+#include "../samples/arena/microalloc.h"
+
+typedef struct allocator_t {
+  const char* name;
+  void* (*alloc)(size_t size);
+  void* (*realloc)(void* ptr, size_t size);
+  void (*free)(void* ptr);
+  int remap;
+} allocator_t;
+
+static void* mc_alloc_fn(size_t size) {
+  return mc_alloc(size);
+}
+
+static void* mc_realloc_fn(void* ptr, size_t size) {
+  return mc_realloc(ptr, size);
+}
+
+static void mc_free_fn(void* ptr) {
+  mc_free(ptr);
+}
+
+static void run(const allocator_t* a, size_t limit, size_t rounds) {
+  uint64_t total = 0, grow = 0, shrink = 0;
+  mc_tuning.remap = a->remap;
+  mc_stats_t before = mc_stats();
+
+  for (size_t round = 0; round < rounds; round++) {
+    size_t cap = 65536 / sizeof(size_t);
+    size_t* vec = a->alloc(cap * sizeof(size_t));
+
+    uint64_t start = benchlib_now_ns();
+    for (size_t len = 0; len < limit / sizeof(size_t); len++) {
+      if (len == cap) {
+        uint64_t t = benchlib_now_ns();
+        cap *= 2;
+        vec = a->realloc(vec, cap * sizeof(size_t));
+        grow += benchlib_now_ns() - t;
+      }
+      vec[len] = len;
+    }
+    total += benchlib_now_ns() - start;
+
+    uint64_t t = benchlib_now_ns();
+    while (cap > 65536 / sizeof(size_t)) {
+      cap /= 2;
+      vec = a->realloc(vec, cap * sizeof(size_t));
+      assert(vec[cap - 1] == cap - 1);
+    }
+    shrink += benchlib_now_ns() - t;
+
+    a->free(vec);
+  }
+
+  mc_stats_t after = mc_stats();
+  printf("%-10s %10.2f %10.2f %10.2f %8zu %8zu %8zu\n", a->name,
+    benchlib_ms(total / rounds), benchlib_ms(grow / rounds),
+    benchlib_ms(shrink / rounds), after.maps - before.maps,
+    after.unmaps - before.unmaps, after.remaps - before.remaps);
+}
+
+int main(int argc, char** argv) {
+  size_t limit = (argc > 1 ? strtoul(argv[1], 0, 0) : 256) << 20;
+  size_t rounds = argc > 2 ? strtoul(argv[2], 0, 0) : 4;
+  assert(limit >= 65536 && rounds);
+
+  static const allocator_t allocators[] = {
+    {"copy", mc_alloc_fn, mc_realloc_fn, mc_free_fn, 0},
+    {"remap", mc_alloc_fn, mc_realloc_fn, mc_free_fn, 1},
+    {"libc", malloc, realloc, free, 1}
+  };
+
+  mc_init();
+
+  printf("64 KiB..%zu MiB, %zu rounds, ms per round\n", limit >> 20, rounds);
+  printf("%-10s %10s %10s %10s %8s %8s %8s\n", "realloc", "fill",
+    "grow", "shrink", "maps", "unmaps", "remaps");
+  for (size_t i = 0; i < FAL_ARRLEN(allocators); i++) {
+    run(&allocators[i], limit, rounds);
+  }
+}
@@ -19,15 +19,27 @@
                                       the start of the efective blocks of arena
     (opt) FAL_ARENA_DEF_INCOMPACT - store internal data in the effective blocks,
                                     not in the unused part of bitset
+    (opt) FAL_ARENA_DEF_EXTRA_BITS - default: 0; number of extra bits per
+                                     allocation (e.g. age, color, pinned),
+                                     each one is another bitset after B
+    (opt) FAL_ARENA_DEF_HOOKS     - prefix of functions called on allocation
+                                    events, see Hooks below; not defined -
+                                    no calls are compiled in at all
 
     (opt) FAL_ARENA_DEF_NO_UNDEF  - do not undefined all compile-time parameters
 
+  Header can be included multiple times with different FAL_ARENA_DEF_NAME to
+  get several arena types in one translation unit.
+
   Compile-time constraints:
     1. FAL_ARENA_DEF_INCOMPACT must be defined or UnusedBits must be enough to
-       store unsigned short (2 bytes).
+       store bump top: unsigned short (2 bytes) or uint32_t (4 bytes) for
+       arenas of 2^16 blocks and more.
                             2 * ArenaSize
           UnusedBits = ----------------------
                        CHAR_BIT * BlockSize^2
+    2. Arena must consist of at least 64 blocks, i.e. ArenaSize >= 64*BlockSize,
+       so bitsets can be processed by 64-bit words.
 
 
   Run-time constraints:
@@ -39,6 +51,7 @@
 
     Types:
       arena_t - opaque struct, should be used only as arena_t*.
+      arena_fwd_t - entry of forwarding table, see arena_forward_build.
 
     Initializing:
       void arena_init(arena_t*)
@@ -49,6 +62,9 @@
         allocate memory at the end of the arena or return 0 if arena is full
       void* arena_alloc(arena_t*, size_t)
         tries arena_bumpalloc first and fallbacks to looking for freed blocks
+      void* arena_alloc_from(arena_t*, size_t, size_t from)
+        same as arena_alloc, but looks for freed blocks starting at block from,
+        e.g. end of previous allocation for next-fit allocation
       int arena_extend(void* ptr, size_t newsize)
         tries to extend/shrink allocation to newsize
       void arena_free(void*)
@@ -71,8 +87,77 @@
         unmark allocation
       int arena_marked(void*)
         check if allocation is marked
+      int arena_mark_atomic(void*)
+        atomically mark allocation, returns 1 if it wasn't marked before,
+        so exactly one of threads marking it concurrently gets 1
       void arena_mark_all(arena_t*, int marked)
-        mark/unmark all blocks
+        mark/unmark all allocations, works on whole bitset words
+      size_t arena_sweep(arena_t*)
+        free all unmarked allocations and unmark marked ones,
+        works on whole bitset words, returns number of blocks left allocated
+
+    Extra bits (only if FAL_ARENA_DEF_EXTRA_BITS > 0):
+      Bits are kept in side bitsets by start block of allocation, so they
+      never touch its cache lines. Allocating functions (including
+      arena_emplace) clear them, moving functions (arena_compact,
+      arena_emplace_run, arena_evacuate_run, arena_compact_twofinger) carry
+      them with allocations, freeing leaves them as garbage.
+      int arena_extra_get(void*, unsigned bit)
+        get extra bit (0..arena_EXTRA_BITS-1) of allocation
+      void arena_extra_set(void*, unsigned bit, int value)
+        set extra bit of allocation
+      unsigned arena_extra_load(void*)
+        get all extra bits of allocation as number, bit i is bit i of value
+      void arena_extra_store(void*, unsigned value)
+        set all extra bits of allocation from number
+      void arena_extra_clear_all(arena_t*, unsigned bit)
+        clear extra bit of all allocations, works on whole bitset words
+      void* arena_extra_bitset(arena_t*, unsigned bit)
+        get raw bitset of extra bit for word-level operations with
+        fal/bitset.h, bit i belongs to block i, only bits of start blocks
+        below arena_bumptop are meaningful
+
+    Hooks (only if FAL_ARENA_DEF_HOOKS is defined, prefix is hooks_ here):
+      Sizes are in bytes rounded up to blocks. Only functions allocating or
+      freeing one allocation call them, bulk ones (arena_init, arena_sweep,
+      arena_emplace*, compacting) don't. fal/trace.h implements them.
+      void hooks_on_alloc(void* ptr, size_t size)
+        after arena_bumpalloc, arena_alloc or arena_alloc_from succeeded
+      void hooks_on_free(void* ptr, size_t size)
+        in arena_free, after allocation is freed
+      void hooks_on_extend(void* ptr, size_t oldsize, size_t size)
+        after arena_extend changed size of allocation
+
+    Compacting:
+      size_t arena_forward_build(arena_t*, arena_fwd_t* table)
+        fill table of arena_FWD_LEN entries with number of blocks of marked
+        allocations before each 64 blocks, returns number of marked blocks
+      void* arena_forward(const arena_fwd_t* table, void* ptr)
+        get address marked allocation will have after arena_compact in O(1),
+        table must be built after marking and before compacting
+      void arena_compact(arena_t*)
+        slide marked allocations to the start of arena keeping their order,
+        unmark them and free everything else, each run of adjacent marked
+        allocations is moved at once
+      void* arena_first_run(arena_t*, size_t* size)
+        get first run of adjacent marked allocations and its size in bytes
+      void* arena_next_run(void* run, size_t* size)
+        get next run after run of *size bytes and its size, bits of run
+        must be intact (e.g. run was copied with arena_evacuate_run)
+      void arena_emplace_run(void* where, void* run, size_t size)
+        emplace allocations laid out as in run of size bytes at where, all
+        unmarked, usually after memmove of run (doesn't change bump top)
+      void* arena_evacuate_run(arena_t* to, void* run, size_t size)
+        bump allocate size bytes in another arena and copy run there with one
+        memcpy and arena_emplace_run, returns new address of run or 0 if it
+        doesn't fit, allocations keep offsets within run
+      void* arena_compact_twofinger(arena_t*, size_t size)
+        compact arena where all allocations are size bytes and were bump
+        allocated: move marked allocations from the end into unmarked slots
+        from the start, unmark them and free everything else, returns end
+        of compacted allocations, moved allocation leaves its new address
+        in its first word, so pointer p >= end is replaced by *(void**)p
+        (valid until next allocation)
 
     Querying:
       int arena_used(void*)
@@ -83,6 +168,9 @@
         get size in bytes of allocation
       arena_t* arena_for(void*)
         get arena used to allocate passed memory
+      void* arena_owner(void*)
+        get allocation containing passed address (which may point inside of it)
+        or 0 if address is not allocated
       size_t arena_bumptop(arena_t*)
         get bump allocator position (between arena_BEGIN and arena_END)
         no blocks are allocated above this position
@@ -113,6 +201,18 @@
         get next allocation, skipping freed blocks
       void* arena_next_noskip(void*)
         get next allocation, including freed blocks (use arena_used)
+      void* arena_first_marked(arena_t*)
+        get first marked allocation
+      void* arena_next_marked(void*)
+        get next marked allocation
+      void* arena_last(arena_t*)
+        get last allocation
+      void* arena_prev(void*)
+        get previous allocation, skipping freed blocks
+      void* arena_last_marked(arena_t*)
+        get last marked allocation
+      void* arena_prev_marked(void*)
+        get previous marked allocation
 
     Constants:
       arena_SIZE           - arena size in bytes
@@ -125,6 +225,8 @@
       arena_USER_LO_BYTES  - number of bytes available for user fata in LO place
       arena_USER_HI_BYTES  - number of bytes available for user fata in HI place
       arena_HEADER_SIZE    - number of bytes used for header
+      arena_FWD_LEN        - number of entries in forwarding table
+      arena_EXTRA_BITS     - number of extra bits per allocation
 
   Arena layout example is for 16 KiB arena with 16 byte blocks.
     XXXXYYYY MMMM~~~~MMMM ZZZZZZZZ BBBB~~~~BBBB OOOO~~~~OOOO
@@ -146,7 +248,11 @@
         1    0   Start of allocation, flag is unset.
         1    1   Start of allocation, flag is set.
 
-    X space is used to store ix of first free block in unsigned short (2 bytes).
+    Extra bitsets E (if any) follow B, each one also has unused bits at its
+    start, header follows them.
+
+    X space is used to store ix of first free block in unsigned short (2 bytes),
+    or uint32_t (4 bytes) if arena has 2^16 blocks or more.
 
     Y and Z space is used for user data:
       Y = user LO bytes
@@ -161,6 +267,9 @@
 
 #include "utils.h"
 #include "bitset.h"
+#include "atomic.h"
+
+#endif /* __FAL_ARENA_H__ */
 
 #ifdef __cplusplus
 extern "C" {
@@ -174,12 +283,17 @@ extern "C" {
   must be defined.
 #endif
 
+#ifndef FAL_ARENA_DEF_EXTRA_BITS
+#define FAL_ARENA_DEF_EXTRA_BITS 0
+#endif
+
 /* Public and internal functions helpers. */
 #define FAL__PUB(X)             FAL_CONCAT(FAL_ARENA_DEF_NAME, FAL_CONCAT(_, X))
 #define FAL__INT(X)             FAL_CONCAT(FAL_ARENA_DEF_NAME, FAL_CONCAT(__, X))
 
 /* Public */
 #define FAL__T                      FAL__PUB(t)
+#define FAL__FWD_T                  FAL__PUB(fwd_t)
 
 #define FAL_ARENA_TOTAL             FAL__PUB(TOTAL)
 #define FAL_ARENA_SIZE              FAL__PUB(SIZE)
@@ -189,6 +303,8 @@ extern "C" {
 #define FAL_ARENA_END               FAL__PUB(END)
 #define FAL_ARENA_USER_LO_BYTES     FAL__PUB(USER_LO_BYTES)
 #define FAL_ARENA_USER_HI_BYTES     FAL__PUB(USER_HI_BYTES)
+#define FAL_ARENA_FWD_LEN           FAL__PUB(FWD_LEN)
+#define FAL_ARENA_EXTRA_BITS        FAL__PUB(EXTRA_BITS)
 /* Internal */
 #define FAL_ARENA__BLOCK_POW        FAL__INT(BLOCK_POW)
 #define FAL_ARENA__POW              FAL__INT(POW)
@@ -206,8 +322,33 @@ extern "C" {
 /* ISO C restricts enumerator values to range of ‘int’ */
 #define FAL_ARENA__MASK             (~(uintptr_t)FAL_ARENA__BLOCK_MASK)
 
+/* Hooks compile to nothing without FAL_ARENA_DEF_HOOKS. */
+#ifdef FAL_ARENA_DEF_HOOKS
+#define FAL_ARENA__ON_ALLOC(Ptr, Size) \
+  FAL_CONCAT(FAL_ARENA_DEF_HOOKS, _on_alloc)(Ptr, Size)
+#define FAL_ARENA__ON_FREE(Ptr, Size) \
+  FAL_CONCAT(FAL_ARENA_DEF_HOOKS, _on_free)(Ptr, Size)
+#define FAL_ARENA__ON_EXTEND(Ptr, OldSize, Size) \
+  FAL_CONCAT(FAL_ARENA_DEF_HOOKS, _on_extend)(Ptr, OldSize, Size)
+#else
+#define FAL_ARENA__ON_ALLOC(Ptr, Size) ((void)0)
+#define FAL_ARENA__ON_FREE(Ptr, Size) ((void)0)
+#define FAL_ARENA__ON_EXTEND(Ptr, OldSize, Size) ((void)0)
+#endif
+
+/* Type of bump top, it must be able to store FAL_ARENA_END. */
+#if FAL_ARENA_DEF_POW - FAL_ARENA_DEF_BLOCK_POW < 16
+#define FAL_ARENA__TOP_T            unsigned short
+#else
+#define FAL_ARENA__TOP_T            uint32_t
+#endif
+
 typedef struct FAL__T FAL__T;
 
+/* Number of marked blocks before 64 blocks shifted left by one, lowest bit
+   tells if last block before them belongs to unmarked allocation. */
+typedef uint32_t FAL__FWD_T;
+
 enum FAL__INT(defs) {
   FAL_ARENA__BLOCK_POW = FAL_ARENA_DEF_BLOCK_POW,
   FAL_ARENA__POW = FAL_ARENA_DEF_POW,
@@ -215,7 +356,7 @@ enum FAL__INT(defs) {
   FAL_ARENA_BLOCK_SIZE = 1u << FAL_ARENA__BLOCK_POW,
 
 #ifdef FAL_ARENA_DEF_INCOMPACT
-  FAL_ARENA__HEADER_TOP_SIZE = sizeof(unsigned short),
+  FAL_ARENA__HEADER_TOP_SIZE = sizeof(FAL_ARENA__TOP_T),
 #else
   FAL_ARENA__HEADER_TOP_SIZE = 0,
 #endif
@@ -232,7 +373,10 @@ enum FAL__INT(defs) {
 
   FAL_ARENA__HEADER_BLOCKS = (FAL_ARENA__HEADER_SIZE + FAL_ARENA_BLOCK_SIZE - 1)
     / FAL_ARENA_BLOCK_SIZE,
-  FAL_ARENA__HEADER_BEGIN = 2 *   FAL_ARENA__BITSET_SIZE / FAL_ARENA_BLOCK_SIZE,
+  FAL_ARENA_EXTRA_BITS = FAL_ARENA_DEF_EXTRA_BITS,
+
+  FAL_ARENA__HEADER_BEGIN = (2 + FAL_ARENA_EXTRA_BITS) * FAL_ARENA__BITSET_SIZE
+    / FAL_ARENA_BLOCK_SIZE,
 
   FAL_ARENA_BEGIN = FAL_ARENA__HEADER_BEGIN + FAL_ARENA__HEADER_BLOCKS,
   FAL_ARENA_END = FAL_ARENA__BLOCKS,
@@ -245,10 +389,12 @@ enum FAL__INT(defs) {
 #ifdef FAL_ARENA_DEF_INCOMPACT
   FAL_ARENA_USER_LO_BYTES = FAL_ARENA__UNUSED_BYTES,
 #else
-  FAL_ARENA_USER_LO_BYTES = FAL_ARENA__UNUSED_BYTES - sizeof(unsigned short),
+  FAL_ARENA_USER_LO_BYTES = FAL_ARENA__UNUSED_BYTES - sizeof(FAL_ARENA__TOP_T),
 #endif
 
-  FAL_ARENA_USER_HI_BYTES = FAL_ARENA__UNUSED_BYTES
+  FAL_ARENA_USER_HI_BYTES = FAL_ARENA__UNUSED_BYTES,
+
+  FAL_ARENA_FWD_LEN = FAL_ARENA__BLOCKS / 64
 };
 
 /******************************************************************************/
@@ -259,20 +405,38 @@ static inline int FAL__INT(ix_for)(void* ptr);
 static inline void* FAL__INT(block)(FAL__T* arena, int ix);
 static inline void* FAL__INT(mark_bs)(FAL__T* arena);
 static inline void* FAL__INT(block_bs)(FAL__T* arena);
-static inline unsigned short* FAL__INT(top_ptr)(FAL__T* arena);
+static inline FAL_ARENA__TOP_T* FAL__INT(top_ptr)(FAL__T* arena);
 static inline void* FAL__INT(markalloc)(FAL__T* arena, size_t start, size_t size);
 static inline void FAL__INT(adjust_bumptop)(void* mark_bs, void* block_bs,
-  unsigned short* top, size_t oldend, size_t end);
+  FAL_ARENA__TOP_T* top, size_t oldend, size_t end);
 static inline int FAL__INT(is_guts)(void* mark_bs, void* block_bs, size_t ix);
 static inline int FAL__INT(is_start)(void* mark_bs, void* block_bs, size_t ix);
 static inline int FAL__INT(is_free)(void* mark_bs, void* block_bs, size_t ix);
 static inline size_t FAL__INT(bsize)(void* mark_bs, void* block_bs,
   size_t top, size_t start);
+static inline size_t FAL__INT(find_free)(void* mark_bs, void* block_bs,
+  size_t size, size_t from);
+static inline void* FAL__INT(find_marked)(FAL__T* arena, size_t from);
+static inline size_t FAL__INT(find_last)(FAL__T* arena, size_t before,
+  int marked);
+static inline uint64_t FAL__INT(live64)(void* mark_bs, void* block_bs,
+  size_t top, size_t w, uint64_t* carry);
+static inline uint64_t FAL__INT(bits64)(void* bs, size_t ix);
+static inline size_t FAL__INT(find_run)(FAL__T* arena, size_t from,
+  size_t* len);
+static inline void FAL__INT(emplace_bits)(FAL__T* arena, size_t start,
+  void* src_block_bs, size_t src, size_t len);
+#if FAL_ARENA_DEF_EXTRA_BITS > 0
+static inline void* FAL__INT(extra_bs)(FAL__T* arena, unsigned bit);
+#endif
+static inline void FAL__INT(move_extra)(FAL__T* arena, size_t start,
+  FAL__T* src_arena, size_t src, size_t len);
 
 static inline void FAL__PUB(init)(FAL__T* arena);
 
 static inline FAL__T* FAL__PUB(for)(void* ptr);
 static inline int FAL__PUB(used)(void* ptr);
+static inline void* FAL__PUB(owner)(void* ptr);
 static inline size_t FAL__PUB(size)(void* ptr);
 static inline size_t FAL__PUB(bsize)(void* ptr);
 static inline int FAL__PUB(marked)(void* ptr);
@@ -282,6 +446,8 @@ static inline void* FAL__PUB(user_hi)(FAL__T* arena);
 
 static inline void* FAL__PUB(bumpalloc)(FAL__T* arena, size_t size);
 static inline void* FAL__PUB(alloc)(FAL__T* arena, size_t size);
+static inline void* FAL__PUB(alloc_from)(FAL__T* arena, size_t size,
+  size_t from);
 static inline int FAL__PUB(extend)(void* ptr, size_t size);
 static inline void FAL__PUB(free)(void* ptr);
 static inline void FAL__PUB(emplace)(void* where, size_t size);
@@ -289,12 +455,38 @@ static inline void FAL__PUB(emplace_end)(void* where);
 
 static inline void FAL__PUB(mark)(void* ptr);
 static inline void FAL__PUB(unmark)(void* ptr);
+static inline int FAL__PUB(mark_atomic)(void* ptr);
 static inline void FAL__PUB(mark_all)(FAL__T* arena, int mark);
+static inline size_t FAL__PUB(sweep)(FAL__T* arena);
+
+#if FAL_ARENA_DEF_EXTRA_BITS > 0
+static inline int FAL__PUB(extra_get)(void* ptr, unsigned bit);
+static inline void FAL__PUB(extra_set)(void* ptr, unsigned bit, int value);
+static inline unsigned FAL__PUB(extra_load)(void* ptr);
+static inline void FAL__PUB(extra_store)(void* ptr, unsigned value);
+static inline void FAL__PUB(extra_clear_all)(FAL__T* arena, unsigned bit);
+static inline void* FAL__PUB(extra_bitset)(FAL__T* arena, unsigned bit);
+#endif
+
+static inline size_t FAL__PUB(forward_build)(FAL__T* arena, FAL__FWD_T* table);
+static inline void* FAL__PUB(forward)(const FAL__FWD_T* table, void* ptr);
+static inline void FAL__PUB(compact)(FAL__T* arena);
+static inline void* FAL__PUB(first_run)(FAL__T* arena, size_t* size);
+static inline void* FAL__PUB(next_run)(void* run, size_t* size);
+static inline void FAL__PUB(emplace_run)(void* where, void* run, size_t size);
+static inline void* FAL__PUB(evacuate_run)(FAL__T* to, void* run, size_t size);
+static inline void* FAL__PUB(compact_twofinger)(FAL__T* arena, size_t size);
 
 static inline void* FAL__PUB(first)(FAL__T* arena);
 static inline void* FAL__PUB(first_noskip)(FAL__T* arena);
 static inline void* FAL__PUB(next)(void* ptr);
 static inline void* FAL__PUB(next_noskip)(void* ptr);
+static inline void* FAL__PUB(first_marked)(FAL__T* arena);
+static inline void* FAL__PUB(next_marked)(void* ptr);
+static inline void* FAL__PUB(last)(FAL__T* arena);
+static inline void* FAL__PUB(prev)(void* ptr);
+static inline void* FAL__PUB(last_marked)(FAL__T* arena);
+static inline void* FAL__PUB(prev_marked)(void* ptr);
 
 /******************************************************************************/
 /*                                INTERNALS                                   */
@@ -303,11 +495,18 @@ static inline void FAL__INT(asertions)() {
 #ifndef FAL_ARENA_DEF_INCOMPACT
   /* Ensure there's enough unused bits at the beginning of each bitset
      to store additional data. */
-  FAL_STATIC_ASSERT(FAL_ARENA__UNUSED_BITS >= sizeof(unsigned short) * CHAR_BIT);
+  FAL_STATIC_ASSERT(FAL_ARENA__UNUSED_BITS >= sizeof(FAL_ARENA__TOP_T) * CHAR_BIT);
 #endif
 
-  /* Ensure bump allocation positions will wit in unsigned short */
-  FAL_STATIC_ASSERT(FAL_ARENA_TOTAL < (unsigned long long)USHRT_MAX);
+  /* Ensure bump allocation positions will fit in top type */
+  FAL_STATIC_ASSERT(FAL_ARENA_END
+    <= (unsigned long long)(FAL_ARENA__TOP_T)~(FAL_ARENA__TOP_T)0);
+
+  /* Ensure bitsets consist of whole 64-bit words. */
+  FAL_STATIC_ASSERT(FAL_ARENA__BLOCKS % 64 == 0);
+
+  /* Ensure extra bits fit into value of arena_extra_load. */
+  FAL_STATIC_ASSERT(FAL_ARENA_EXTRA_BITS <= sizeof(unsigned) * CHAR_BIT);
 }
 
 static inline int FAL__INT(ix_for)(void* ptr) {
@@ -327,11 +526,11 @@ static inline void* FAL__INT(block_bs)(FAL__T* arena) {
   return (char*)(void*)arena + FAL_ARENA__BITSET_SIZE;
 }
 
-static inline unsigned short* FAL__INT(top_ptr)(FAL__T* arena) {
+static inline FAL_ARENA__TOP_T* FAL__INT(top_ptr)(FAL__T* arena) {
 #ifdef FAL_ARENA_DEF_INCOMPACT
-  return (unsigned short*)FAL__INT(block)(arena, FAL_ARENA__HEADER_BEGIN);
+  return (FAL_ARENA__TOP_T*)FAL__INT(block)(arena, FAL_ARENA__HEADER_BEGIN);
 #else
-  return (unsigned short*)(void*)arena;
+  return (FAL_ARENA__TOP_T*)(void*)arena;
 #endif
 }
 
@@ -341,6 +540,11 @@ static inline void* FAL__INT(markalloc)(FAL__T* arena, size_t start, size_t size
 
   fal_bitset_clear(mark_bs, start);
   fal_bitset_set(block_bs, start);
+#if FAL_ARENA_DEF_EXTRA_BITS > 0
+  for (unsigned bit = 0; bit < FAL_ARENA_EXTRA_BITS; bit++) {
+    fal_bitset_clear(FAL__INT(extra_bs)(arena, bit), start);
+  }
+#endif
 
   for (size_t ix = 1; ix < size; ix++) {
     fal_bitset_set(mark_bs, start + ix);
@@ -384,6 +588,215 @@ static inline size_t FAL__INT(bsize)(void* mark_bs, void* block_bs,
   return end - start;
 }
 
+/* Find first run of size free blocks starting at block from,
+   return FAL_ARENA_END if there's none. */
+static inline size_t FAL__INT(find_free)(void* mark_bs, void* block_bs,
+  size_t size, size_t from) {
+  size_t run = 0;
+  size_t run_start = FAL_ARENA_END;
+
+  from = from < FAL_ARENA_BEGIN ? FAL_ARENA_BEGIN : from;
+  for (size_t w = from / 64; w < FAL_ARENA__BLOCKS / 64; w++) {
+    uint64_t free = ~(fal_bitset_load64(mark_bs, w)
+      | fal_bitset_load64(block_bs, w))
+      & fal_bitset_range64(w, from, FAL_ARENA_END);
+
+    size_t bit = 0;
+    while (bit < 64) {
+      uint64_t rest = free >> bit;
+      size_t len;
+      if (rest & 1) {
+        len = ~rest ? (size_t)fal_ctz64(~rest) : 64;
+        len = len < 64 - bit ? len : 64 - bit;
+        if (!run) {
+          run_start = w * 64 + bit;
+        }
+
+        run += len;
+        if (run >= size) {
+          return run_start;
+        }
+      } else {
+        len = rest ? (size_t)fal_ctz64(rest) : 64 - bit;
+        run = 0;
+      }
+
+      bit += len;
+    }
+  }
+
+  return FAL_ARENA_END;
+}
+
+/* Find first marked allocation starting at block from. */
+static inline void* FAL__INT(find_marked)(FAL__T* arena, size_t from) {
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+  size_t top = *FAL__INT(top_ptr)(arena);
+
+  for (size_t w = from / 64; w * 64 < top; w++) {
+    uint64_t marked = fal_bitset_load64(mark_bs, w)
+      & fal_bitset_load64(block_bs, w)
+      & fal_bitset_range64(w, from, top);
+
+    if (marked) {
+      return FAL__INT(block)(arena, w * 64 + fal_ctz64(marked));
+    }
+  }
+
+  return 0;
+}
+
+/* Find last (marked) allocation starting before block before, return
+   FAL_ARENA_END if there's none. */
+static inline size_t FAL__INT(find_last)(FAL__T* arena, size_t before,
+  int marked) {
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+
+  for (size_t w = (before + 63) / 64; w-- > FAL_ARENA_BEGIN / 64; ) {
+    uint64_t starts = fal_bitset_load64(block_bs, w)
+      & (marked ? fal_bitset_load64(mark_bs, w) : ~(uint64_t)0)
+      & fal_bitset_range64(w, FAL_ARENA_BEGIN, before);
+
+    if (starts) {
+      return w * 64 + 63 - fal_clz64(starts);
+    }
+  }
+
+  return FAL_ARENA_END;
+}
+
+/* Get blocks of marked allocations (starts and guts) in word w of bitsets,
+   carry tells if last block of previous word belongs to unmarked allocation
+   and is updated for the next word. */
+static inline uint64_t FAL__INT(live64)(void* mark_bs, void* block_bs,
+  size_t top, size_t w, uint64_t* carry) {
+  uint64_t mask = fal_bitset_range64(w, FAL_ARENA_BEGIN, top);
+  uint64_t mark = fal_bitset_load64(mark_bs, w);
+  uint64_t block = fal_bitset_load64(block_bs, w);
+
+  uint64_t starts = block & mark & mask;
+  uint64_t dead = block & ~mark & mask;
+  uint64_t guts = mark & ~block & mask;
+
+  /* Adding 1 to the first block of each run of dead guts carries through
+     the whole run and clears it, guts of live allocations stay intact. */
+  uint64_t dead_first = ((dead << 1) | *carry) & guts;
+  uint64_t live_guts = (guts + dead_first) & guts;
+
+  *carry = ((dead | (guts & ~live_guts)) >> 63) & 1;
+
+  return starts | live_guts;
+}
+
+/* Get 64 bits of bitset starting at bit ix, bits past the end are zeros. */
+static inline uint64_t FAL__INT(bits64)(void* bs, size_t ix) {
+  size_t w = ix / 64;
+  size_t bit = ix % 64;
+  uint64_t bits = fal_bitset_load64(bs, w) >> bit;
+
+  if (bit && w + 1 < FAL_ARENA__BLOCKS / 64) {
+    bits |= fal_bitset_load64(bs, w + 1) << (64 - bit);
+  }
+
+  return bits;
+}
+
+/* Find first run of live blocks at or after from, return its start or
+   FAL_ARENA_END if there's none. Block from must not be guts, so there's
+   no allocation crossing it and bits below it don't matter. */
+static inline size_t FAL__INT(find_run)(FAL__T* arena, size_t from,
+  size_t* len) {
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+  size_t top = *FAL__INT(top_ptr)(arena);
+
+  size_t start = FAL_ARENA_END;
+  uint64_t carry = 0;
+  for (size_t w = from / 64; w * 64 < top; w++) {
+    uint64_t live = FAL__INT(live64)(mark_bs, block_bs, top, w, &carry)
+      & fal_bitset_range64(w, from, top);
+
+    if (start == FAL_ARENA_END) {
+      if (!live) {
+        continue;
+      }
+      start = w * 64 + fal_ctz64(live);
+    }
+
+    uint64_t gap = ~live & fal_bitset_range64(w, start, top);
+    if (gap) {
+      *len = w * 64 + fal_ctz64(gap) - start;
+      return start;
+    }
+  }
+
+  if (start != FAL_ARENA_END) {
+    *len = top - start;
+  }
+
+  return start;
+}
+
+/* Set bits of len blocks from start as live run with allocations starting
+   where src_block_bs has them from src, all unmarked. Bits are processed
+   upwards, so runs may overlap if start <= src within one arena. */
+static inline void FAL__INT(emplace_bits)(FAL__T* arena, size_t start,
+  void* src_block_bs, size_t src, size_t len) {
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+  size_t end = start + len;
+
+  for (size_t w = start / 64; w * 64 < end; w++) {
+    uint64_t mask = fal_bitset_range64(w, start, end);
+    uint64_t starts = w * 64 < start
+      ? FAL__INT(bits64)(src_block_bs, src) << (start - w * 64)
+      : FAL__INT(bits64)(src_block_bs, src + w * 64 - start);
+
+    fal_bitset_store64(block_bs, w,
+      (fal_bitset_load64(block_bs, w) & ~mask) | (starts & mask));
+    fal_bitset_store64(mark_bs, w,
+      (fal_bitset_load64(mark_bs, w) & ~mask) | (~starts & mask));
+  }
+}
+
+#if FAL_ARENA_DEF_EXTRA_BITS > 0
+static inline void* FAL__INT(extra_bs)(FAL__T* arena, unsigned bit) {
+  return (char*)(void*)arena + (2 + bit) * FAL_ARENA__BITSET_SIZE;
+}
+#endif
+
+/* Copy extra bits of len blocks from src of src_arena to start, upwards
+   like emplace_bits. */
+static inline void FAL__INT(move_extra)(FAL__T* arena, size_t start,
+  FAL__T* src_arena, size_t src, size_t len) {
+#if FAL_ARENA_DEF_EXTRA_BITS > 0
+  size_t end = start + len;
+
+  for (unsigned bit = 0; bit < FAL_ARENA_EXTRA_BITS; bit++) {
+    void* bs = FAL__INT(extra_bs)(arena, bit);
+    void* src_bs = FAL__INT(extra_bs)(src_arena, bit);
+
+    for (size_t w = start / 64; w * 64 < end; w++) {
+      uint64_t mask = fal_bitset_range64(w, start, end);
+      uint64_t bits = w * 64 < start
+        ? FAL__INT(bits64)(src_bs, src) << (start - w * 64)
+        : FAL__INT(bits64)(src_bs, src + w * 64 - start);
+
+      fal_bitset_store64(bs, w, (fal_bitset_load64(bs, w) & ~mask)
+        | (bits & mask));
+    }
+  }
+#else
+  FAL_UNUSED(arena);
+  FAL_UNUSED(start);
+  FAL_UNUSED(src_arena);
+  FAL_UNUSED(src);
+  FAL_UNUSED(len);
+#endif
+}
+
 /******************************************************************************/
 /*                              INITIALIZATION                                */
 /******************************************************************************/
@@ -420,7 +833,7 @@ static inline int FAL__PUB(empty)(FAL__T* arena) {
 
 static inline int FAL__PUB(used)(void* ptr) {
   FAL__T* arena = FAL__PUB(for)(ptr);
-  unsigned short top = *FAL__INT(top_ptr)(arena);
+  FAL_ARENA__TOP_T top = *FAL__INT(top_ptr)(arena);
   void* mark_bs = FAL__INT(mark_bs)(arena);
   void* block_bs = FAL__INT(block_bs)(arena);
 
@@ -429,11 +842,34 @@ static inline int FAL__PUB(used)(void* ptr) {
   return ix < top && !FAL__INT(is_free)(mark_bs, block_bs, ix);
 }
 
+static inline void* FAL__PUB(owner)(void* ptr) {
+  FAL__T* arena = FAL__PUB(for)(ptr);
+  FAL_ARENA__TOP_T top = *FAL__INT(top_ptr)(arena);
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+
+  size_t ix = FAL__INT(ix_for)(ptr);
+  if (ix < FAL_ARENA_BEGIN || ix >= top
+    || FAL__INT(is_free)(mark_bs, block_bs, ix)) {
+    return 0;
+  }
+
+  /* Only guts lay between start of allocation and any of its blocks. */
+  for (size_t w = ix / 64;; w--) {
+    uint64_t starts = fal_bitset_load64(block_bs, w)
+      & fal_bitset_range64(w, FAL_ARENA_BEGIN, ix + 1);
+
+    if (starts) {
+      return FAL__INT(block)(arena, w * 64 + 63 - fal_clz64(starts));
+    }
+  }
+}
+
 static inline size_t FAL__PUB(bsize)(void* ptr) {
   assert(ptr && "[" FAL_STR(FAL__PUB(bsize)) "] ptr cannot be NULL");
 
   FAL__T* arena = FAL__PUB(for)(ptr);
-  unsigned short top = *FAL__INT(top_ptr)(arena);
+  FAL_ARENA__TOP_T top = *FAL__INT(top_ptr)(arena);
   void* mark_bs = FAL__INT(mark_bs)(arena);
   void* block_bs = FAL__INT(block_bs)(arena);
 
@@ -461,7 +897,7 @@ static inline size_t FAL__PUB(bumptop)(FAL__T* arena) {
 }
 
 static inline void* FAL__PUB(user_lo)(FAL__T* arena) {
-  return (char*)FAL__INT(top_ptr)(arena) + sizeof(unsigned short);
+  return (char*)FAL__INT(top_ptr)(arena) + sizeof(FAL_ARENA__TOP_T);
 }
 
 static inline void* FAL__PUB(user_hi)(FAL__T* arena) {
@@ -495,13 +931,14 @@ static inline void* FAL__PUB(mem_end)(FAL__T* arena) {
 static inline void* FAL__PUB(bumpalloc)(FAL__T* arena, size_t size) {
   assert(size != 0 && "[" FAL_STR(FAL__PUB(bumpalloc)) "] size cannot be zero");
   size = (size + FAL_ARENA_BLOCK_SIZE - 1) / FAL_ARENA_BLOCK_SIZE;
-  unsigned short* top = FAL__INT(top_ptr)(arena);
+  FAL_ARENA__TOP_T* top = FAL__INT(top_ptr)(arena);
   if (*top + size > FAL_ARENA__BLOCKS) {
     return 0;
   }
 
   void* result = FAL__INT(markalloc)(arena, *top, size);
   *top += size;
+  FAL_ARENA__ON_ALLOC(result, size * FAL_ARENA_BLOCK_SIZE);
 
   return result;
 }
@@ -509,6 +946,13 @@ static inline void* FAL__PUB(bumpalloc)(FAL__T* arena, size_t size) {
 static inline void* FAL__PUB(alloc)(FAL__T* arena, size_t size) {
   assert(size != 0 && "[" FAL_STR(FAL__PUB(alloc)) "] size cannot be zero");
 
+  return FAL__PUB(alloc_from)(arena, size, FAL_ARENA_BEGIN);
+}
+
+static inline void* FAL__PUB(alloc_from)(FAL__T* arena, size_t size,
+  size_t from) {
+  assert(size != 0 && "[" FAL_STR(FAL__PUB(alloc_from)) "] size cannot be zero");
+
   /* Try faster bumpalloc first. */
   void* mem = FAL__PUB(bumpalloc)(arena, size);
   if (mem) {
@@ -519,29 +963,21 @@ static inline void* FAL__PUB(alloc)(FAL__T* arena, size_t size) {
 
   void* mark_bs = FAL__INT(mark_bs)(arena);
   void* block_bs = FAL__INT(block_bs)(arena);
+  FAL_ARENA__TOP_T* top = FAL__INT(top_ptr)(arena);
 
-  size_t start = FAL_ARENA_BEGIN;
-  for (; start < FAL_ARENA_TOTAL; ) {
-    size_t free = 0;
-    for (; free < size; free++) {
-      if (fal_bitset_test(mark_bs, start + free)
-        || fal_bitset_test(block_bs, start + free)) {
-        break;
-      }
-    }
-
-    if (free == size) {
-      break;
-    }
-
-    start += free + 1;
+  size_t start = FAL__INT(find_free)(mark_bs, block_bs, size, from);
+  if (start == FAL_ARENA_END) {
+    return 0;
   }
 
-  if (start > FAL_ARENA_TOTAL) {
-    return 0;
+  if (start + size > *top) {
+    *top = start + size;
   }
 
-  return FAL__INT(markalloc)(arena, start, size);
+  mem = FAL__INT(markalloc)(arena, start, size);
+  FAL_ARENA__ON_ALLOC(mem, size * FAL_ARENA_BLOCK_SIZE);
+
+  return mem;
 }
 
 static inline void FAL__PUB(emplace)(void* where, size_t size) {
@@ -567,7 +1003,7 @@ static inline int FAL__PUB(extend)(void* ptr, size_t newsize) {
   FAL__T* arena = FAL__PUB(for)(ptr);
   void* mark_bs = FAL__INT(mark_bs)(arena);
   void* block_bs = FAL__INT(block_bs)(arena);
-  unsigned short* top = FAL__INT(top_ptr)(arena);
+  FAL_ARENA__TOP_T* top = FAL__INT(top_ptr)(arena);
 
   size_t start = FAL__INT(ix_for)(ptr);
   size_t oldsize = FAL__INT(bsize)(mark_bs, block_bs, *top, start);
@@ -588,6 +1024,8 @@ static inline int FAL__PUB(extend)(void* ptr, size_t newsize) {
     }
 
     FAL__INT(adjust_bumptop)(mark_bs, block_bs, top, oldend, newend);
+    FAL_ARENA__ON_EXTEND(ptr, oldsize * FAL_ARENA_BLOCK_SIZE,
+      newsize * FAL_ARENA_BLOCK_SIZE);
 
     return 1;
   }
@@ -612,6 +1050,8 @@ static inline int FAL__PUB(extend)(void* ptr, size_t newsize) {
   }
 
   FAL__INT(adjust_bumptop)(mark_bs, block_bs, top, oldend, newend);
+  FAL_ARENA__ON_EXTEND(ptr, oldsize * FAL_ARENA_BLOCK_SIZE,
+    newsize * FAL_ARENA_BLOCK_SIZE);
 
   return 1;
 }
@@ -633,7 +1073,7 @@ static inline void FAL__PUB(free)(void* ptr) {
   fal_bitset_clear(mark_bs, start);
   fal_bitset_clear(block_bs, start);
 
-  unsigned short* top = FAL__INT(top_ptr)(arena);
+  FAL_ARENA__TOP_T* top = FAL__INT(top_ptr)(arena);
   size_t end = start + 1;
   while (end < *top && FAL__INT(is_guts)(mark_bs, block_bs, end)) {
     fal_bitset_clear(mark_bs, end);
@@ -641,6 +1081,8 @@ static inline void FAL__PUB(free)(void* ptr) {
     end++;
   }
 
+  FAL_ARENA__ON_FREE(ptr, (end - start) * FAL_ARENA_BLOCK_SIZE);
+
   if (end < *top) {
     return;
   }
@@ -649,7 +1091,7 @@ static inline void FAL__PUB(free)(void* ptr) {
 }
 
 static inline void FAL__INT(adjust_bumptop)(void* mark_bs, void* block_bs,
-  unsigned short* top, size_t oldend, size_t end) {
+  FAL_ARENA__TOP_T* top, size_t oldend, size_t end) {
   if (oldend < *top) {
     return;
   }
@@ -659,7 +1101,7 @@ static inline void FAL__INT(adjust_bumptop)(void* mark_bs, void* block_bs,
     return;
   }
 
-  unsigned short new_top = end;
+  FAL_ARENA__TOP_T new_top = end;
   while (new_top > FAL_ARENA_BEGIN
     && FAL__INT(is_free)(mark_bs, block_bs, new_top - 1)) {
     new_top--;
@@ -681,6 +1123,23 @@ static inline void FAL__PUB(mark)(void* ptr) {
   fal_bitset_set(mark_bs, start);
 }
 
+static inline int FAL__PUB(mark_atomic)(void* ptr) {
+  assert(ptr && "[" FAL_STR(FAL__PUB(mark_atomic)) "] ptr cannot be NULL");
+
+  FAL__T* arena = FAL__PUB(for)(ptr);
+  size_t start = FAL__INT(ix_for)(ptr);
+  unsigned char* mark_bs = (unsigned char*)FAL__INT(mark_bs)(arena);
+  unsigned char bit = (unsigned char)fal_bitset__mask(start);
+
+  /* Most visits find object already marked, plain load is much cheaper than
+     locked or, and cache line stays shared between cores. */
+  if (fal_atomic_load8(&mark_bs[start / CHAR_BIT], FAL_ATOMIC_RELAXED) & bit) {
+    return 0;
+  }
+
+  return !(fal_atomic_or8(&mark_bs[start / CHAR_BIT], bit) & bit);
+}
+
 static inline void FAL__PUB(unmark)(void* ptr) {
   assert(ptr && "[" FAL_STR(FAL__PUB(unmark)) "] ptr cannot be NULL");
 
@@ -693,14 +1152,305 @@ static inline void FAL__PUB(unmark)(void* ptr) {
 static inline void FAL__PUB(mark_all)(FAL__T* arena, int mark) {
   assert(arena && "[" FAL_STR(FAL__PUB(mark_all)) "] arena cannot be NULL");
 
-  /* TODO: optimize, get bitsets here, make internal arena_mark and arena_next. */
-  for (void* ptr = FAL__PUB(first)(arena); ptr; ptr = FAL__PUB(next)(ptr)) {
-    if (mark) {
-      FAL__PUB(mark)(ptr);
-    } else {
-      FAL__PUB(unmark)(ptr);
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+  size_t top = *FAL__INT(top_ptr)(arena);
+
+  /* Only mark bits of starts change, guts keep theirs set. */
+  for (size_t w = FAL_ARENA_BEGIN / 64; w * 64 < top; w++) {
+    uint64_t starts = fal_bitset_load64(block_bs, w)
+      & fal_bitset_range64(w, FAL_ARENA_BEGIN, top);
+    uint64_t bits = fal_bitset_load64(mark_bs, w);
+
+    fal_bitset_store64(mark_bs, w, mark ? bits | starts : bits & ~starts);
+  }
+}
+
+static inline size_t FAL__PUB(sweep)(FAL__T* arena) {
+  assert(arena && "[" FAL_STR(FAL__PUB(sweep)) "] arena cannot be NULL");
+
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+  FAL_ARENA__TOP_T* top = FAL__INT(top_ptr)(arena);
+
+  size_t live = 0;
+  size_t new_top = FAL_ARENA_BEGIN;
+
+  /* Whether last block of previous word belongs to freed allocation. */
+  uint64_t carry = 0;
+
+  for (size_t w = FAL_ARENA_BEGIN / 64; w * 64 < *top; w++) {
+    uint64_t mask = fal_bitset_range64(w, FAL_ARENA_BEGIN, *top);
+    uint64_t mark = fal_bitset_load64(mark_bs, w);
+    uint64_t block = fal_bitset_load64(block_bs, w);
+    uint64_t used = FAL__INT(live64)(mark_bs, block_bs, *top, w, &carry);
+
+    /* Marked starts become unmarked, only guts of live allocations stay. */
+    fal_bitset_store64(mark_bs, w, (mark & ~mask) | (used & ~block));
+    fal_bitset_store64(block_bs, w, (block & ~mask) | (used & block));
+
+    if (used) {
+      live += fal_popcount64(used);
+      new_top = w * 64 + 64 - fal_clz64(used);
+    }
+  }
+
+  *top = new_top;
+
+  return live;
+}
+
+/******************************************************************************/
+/*                                EXTRA BITS                                  */
+/******************************************************************************/
+#if FAL_ARENA_DEF_EXTRA_BITS > 0
+static inline int FAL__PUB(extra_get)(void* ptr, unsigned bit) {
+  assert(bit < FAL_ARENA_EXTRA_BITS
+    && "[" FAL_STR(FAL__PUB(extra_get)) "] no such extra bit");
+  assert(FAL__PUB(used)(ptr)
+    && "[" FAL_STR(FAL__PUB(extra_get)) "] expected allocation");
+
+  return fal_bitset_test(FAL__INT(extra_bs)(FAL__PUB(for)(ptr), bit),
+    FAL__INT(ix_for)(ptr));
+}
+
+static inline void FAL__PUB(extra_set)(void* ptr, unsigned bit, int value) {
+  assert(bit < FAL_ARENA_EXTRA_BITS
+    && "[" FAL_STR(FAL__PUB(extra_set)) "] no such extra bit");
+  assert(FAL__PUB(used)(ptr)
+    && "[" FAL_STR(FAL__PUB(extra_set)) "] expected allocation");
+
+  void* bs = FAL__INT(extra_bs)(FAL__PUB(for)(ptr), bit);
+  if (value) {
+    fal_bitset_set(bs, FAL__INT(ix_for)(ptr));
+  } else {
+    fal_bitset_clear(bs, FAL__INT(ix_for)(ptr));
+  }
+}
+
+static inline unsigned FAL__PUB(extra_load)(void* ptr) {
+  unsigned value = 0;
+  for (unsigned bit = 0; bit < FAL_ARENA_EXTRA_BITS; bit++) {
+    value |= (unsigned)FAL__PUB(extra_get)(ptr, bit) << bit;
+  }
+
+  return value;
+}
+
+static inline void FAL__PUB(extra_store)(void* ptr, unsigned value) {
+  for (unsigned bit = 0; bit < FAL_ARENA_EXTRA_BITS; bit++) {
+    FAL__PUB(extra_set)(ptr, bit, (value >> bit) & 1);
+  }
+}
+
+static inline void FAL__PUB(extra_clear_all)(FAL__T* arena, unsigned bit) {
+  assert(bit < FAL_ARENA_EXTRA_BITS
+    && "[" FAL_STR(FAL__PUB(extra_clear_all)) "] no such extra bit");
+
+  void* bs = FAL__INT(extra_bs)(arena, bit);
+  size_t top = *FAL__INT(top_ptr)(arena);
+  for (size_t w = FAL_ARENA_BEGIN / 64; w * 64 < top; w++) {
+    uint64_t mask = fal_bitset_range64(w, FAL_ARENA_BEGIN, top);
+    fal_bitset_store64(bs, w, fal_bitset_load64(bs, w) & ~mask);
+  }
+}
+
+static inline void* FAL__PUB(extra_bitset)(FAL__T* arena, unsigned bit) {
+  assert(bit < FAL_ARENA_EXTRA_BITS
+    && "[" FAL_STR(FAL__PUB(extra_bitset)) "] no such extra bit");
+
+  return FAL__INT(extra_bs)(arena, bit);
+}
+#endif /* FAL_ARENA_DEF_EXTRA_BITS > 0 */
+
+/******************************************************************************/
+/*                                 COMPACTING                                 */
+/******************************************************************************/
+static inline size_t FAL__PUB(forward_build)(FAL__T* arena, FAL__FWD_T* table) {
+  assert(arena && "[" FAL_STR(FAL__PUB(forward_build)) "] arena cannot be NULL");
+  assert(table && "[" FAL_STR(FAL__PUB(forward_build)) "] table cannot be NULL");
+
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+  size_t top = *FAL__INT(top_ptr)(arena);
+
+  size_t live = 0;
+  uint64_t carry = 0;
+  for (size_t w = 0; w < FAL_ARENA_FWD_LEN; w++) {
+    table[w] = (FAL__FWD_T)(live << 1 | carry);
+    if (w * 64 < top) {
+      live += fal_popcount64(FAL__INT(live64)(mark_bs, block_bs, top, w, &carry));
+    }
+  }
+
+  return live;
+}
+
+static inline void* FAL__PUB(forward)(const FAL__FWD_T* table, void* ptr) {
+  assert(ptr && FAL__PUB(marked)(ptr)
+    && "[" FAL_STR(FAL__PUB(forward)) "] expected marked allocation");
+
+  FAL__T* arena = FAL__PUB(for)(ptr);
+  size_t ix = FAL__INT(ix_for)(ptr);
+  size_t w = ix / 64;
+
+  uint64_t carry = table[w] & 1;
+  uint64_t live = FAL__INT(live64)(FAL__INT(mark_bs)(arena),
+    FAL__INT(block_bs)(arena), *FAL__INT(top_ptr)(arena), w, &carry);
+  uint64_t before = live & ~(~(uint64_t)0 << (ix % 64));
+
+  return FAL__INT(block)(arena,
+    FAL_ARENA_BEGIN + (table[w] >> 1) + fal_popcount64(before));
+}
+
+static inline void FAL__PUB(compact)(FAL__T* arena) {
+  assert(arena && "[" FAL_STR(FAL__PUB(compact)) "] arena cannot be NULL");
+
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+  FAL_ARENA__TOP_T* top = FAL__INT(top_ptr)(arena);
+
+  /* Runs only move down, so bits after current one are intact. */
+  size_t end = FAL_ARENA_BEGIN;
+  size_t len = 0;
+  for (size_t start = FAL__INT(find_run)(arena, FAL_ARENA_BEGIN, &len);
+    start != FAL_ARENA_END;
+    start = FAL__INT(find_run)(arena, start + len, &len)) {
+    FAL__INT(emplace_bits)(arena, end, block_bs, start, len);
+    FAL__INT(move_extra)(arena, end, arena, start, len);
+    if (end != start) {
+      memmove(FAL__INT(block)(arena, end), FAL__INT(block)(arena, start),
+        len * FAL_ARENA_BLOCK_SIZE);
+    }
+
+    end += len;
+  }
+
+  for (size_t w = end / 64; w * 64 < *top; w++) {
+    uint64_t mask = fal_bitset_range64(w, end, *top);
+    fal_bitset_store64(mark_bs, w, fal_bitset_load64(mark_bs, w) & ~mask);
+    fal_bitset_store64(block_bs, w, fal_bitset_load64(block_bs, w) & ~mask);
+  }
+
+  *top = end;
+}
+
+static inline void* FAL__PUB(first_run)(FAL__T* arena, size_t* size) {
+  assert(arena && "[" FAL_STR(FAL__PUB(first_run)) "] arena cannot be NULL");
+
+  size_t len = 0;
+  size_t start = FAL__INT(find_run)(arena, FAL_ARENA_BEGIN, &len);
+  if (start == FAL_ARENA_END) {
+    return 0;
+  }
+
+  *size = len * FAL_ARENA_BLOCK_SIZE;
+  return FAL__INT(block)(arena, start);
+}
+
+static inline void* FAL__PUB(next_run)(void* run, size_t* size) {
+  if (!run) {
+    return 0;
+  }
+
+  FAL__T* arena = FAL__PUB(for)(run);
+  size_t len = 0;
+  size_t start = FAL__INT(find_run)(arena,
+    FAL__INT(ix_for)(run) + *size / FAL_ARENA_BLOCK_SIZE, &len);
+  if (start == FAL_ARENA_END) {
+    return 0;
+  }
+
+  *size = len * FAL_ARENA_BLOCK_SIZE;
+  return FAL__INT(block)(arena, start);
+}
+
+static inline void FAL__PUB(emplace_run)(void* where, void* run, size_t size) {
+  assert(where && run
+    && "[" FAL_STR(FAL__PUB(emplace_run)) "] where and run cannot be NULL");
+
+  FAL__INT(emplace_bits)(FAL__PUB(for)(where), FAL__INT(ix_for)(where),
+    FAL__INT(block_bs)(FAL__PUB(for)(run)), FAL__INT(ix_for)(run),
+    size / FAL_ARENA_BLOCK_SIZE);
+  FAL__INT(move_extra)(FAL__PUB(for)(where), FAL__INT(ix_for)(where),
+    FAL__PUB(for)(run), FAL__INT(ix_for)(run), size / FAL_ARENA_BLOCK_SIZE);
+}
+
+static inline void* FAL__PUB(evacuate_run)(FAL__T* to, void* run, size_t size) {
+  assert(to && run
+    && "[" FAL_STR(FAL__PUB(evacuate_run)) "] to and run cannot be NULL");
+  assert(FAL__PUB(for)(run) != to
+    && "[" FAL_STR(FAL__PUB(evacuate_run)) "] run must be in another arena");
+
+  size_t len = size / FAL_ARENA_BLOCK_SIZE;
+  FAL_ARENA__TOP_T* top = FAL__INT(top_ptr)(to);
+  if (*top + len > FAL_ARENA__BLOCKS) {
+    return 0;
+  }
+
+  void* where = FAL__INT(block)(to, *top);
+  memcpy(where, run, size);
+  FAL__PUB(emplace_run)(where, run, size);
+  *top += len;
+
+  return where;
+}
+
+static inline void* FAL__PUB(compact_twofinger)(FAL__T* arena, size_t size) {
+  assert(arena && "[" FAL_STR(FAL__PUB(compact_twofinger)) "] arena cannot be NULL");
+  assert(size && "[" FAL_STR(FAL__PUB(compact_twofinger)) "] size cannot be zero");
+
+  size = (size + FAL_ARENA_BLOCK_SIZE - 1) / FAL_ARENA_BLOCK_SIZE;
+
+  void* mark_bs = FAL__INT(mark_bs)(arena);
+  void* block_bs = FAL__INT(block_bs)(arena);
+  FAL_ARENA__TOP_T* top = FAL__INT(top_ptr)(arena);
+
+  /* Free finger goes up over slots, live finger goes down over marked
+     allocations, moved allocations stay marked, but are above live finger. */
+  size_t end = FAL_ARENA_BEGIN;
+  size_t free = FAL_ARENA_BEGIN;
+  for (size_t live = FAL__INT(find_last)(arena, *top, 1);
+    live != FAL_ARENA_END; live = FAL__INT(find_last)(arena, live, 1)) {
+    assert(FAL__INT(bsize)(mark_bs, block_bs, *top, live) == size
+      && "[" FAL_STR(FAL__PUB(compact_twofinger)) "] allocation of other size");
+
+    while (free < live && fal_bitset_test(mark_bs, free)
+      && fal_bitset_test(block_bs, free)) {
+      free += size;
     }
+
+    /* Everything below free finger is live already. */
+    if (free >= live) {
+      end = free > live ? free : live + size;
+      break;
+    }
+
+    void* from = FAL__INT(block)(arena, live);
+    void* to = FAL__INT(block)(arena, free);
+    memcpy(to, from, size * FAL_ARENA_BLOCK_SIZE);
+    *(void**)from = to;
+    fal_bitset_set(block_bs, free);
+    FAL__INT(move_extra)(arena, free, arena, live, 1);
+
+    free += size;
+    end = free;
   }
+
+  /* Every slot below end is allocation now, only its guts are marked. */
+  for (size_t w = FAL_ARENA_BEGIN / 64; w * 64 < *top; w++) {
+    uint64_t used = fal_bitset_range64(w, FAL_ARENA_BEGIN, end);
+    uint64_t mask = fal_bitset_range64(w, FAL_ARENA_BEGIN, *top);
+    uint64_t block = fal_bitset_load64(block_bs, w);
+
+    fal_bitset_store64(block_bs, w, (block & ~mask) | (block & used));
+    fal_bitset_store64(mark_bs, w,
+      (fal_bitset_load64(mark_bs, w) & ~mask) | (~block & used));
+  }
+
+  *top = end;
+
+  return FAL__INT(block)(arena, end);
 }
 
 /******************************************************************************/
@@ -733,7 +1483,7 @@ static inline void* FAL__PUB(next_noskip)(void* ptr) {
   }
 
   FAL__T* arena = FAL__PUB(for)(ptr);
-  unsigned short *top = FAL__INT(top_ptr)(arena);
+  FAL_ARENA__TOP_T *top = FAL__INT(top_ptr)(arena);
   void* mark_bs = FAL__INT(mark_bs)(arena);
   void* block_bs = FAL__INT(block_bs)(arena);
 
@@ -747,17 +1497,73 @@ static inline void* FAL__PUB(next_noskip)(void* ptr) {
   return FAL__INT(block)(arena, start + size);
 }
 
+static inline void* FAL__PUB(first_marked)(FAL__T* arena) {
+  assert(arena && "[" FAL_STR(FAL__PUB(first_marked)) "] arena cannot be NULL");
+
+  return FAL__INT(find_marked)(arena, FAL_ARENA_BEGIN);
+}
+
+static inline void* FAL__PUB(next_marked)(void* ptr) {
+  if (!ptr) {
+    return 0;
+  }
+
+  return FAL__INT(find_marked)(FAL__PUB(for)(ptr), FAL__INT(ix_for)(ptr) + 1);
+}
+
+static inline void* FAL__PUB(last)(FAL__T* arena) {
+  assert(arena && "[" FAL_STR(FAL__PUB(last)) "] arena cannot be NULL");
+
+  size_t ix = FAL__INT(find_last)(arena, *FAL__INT(top_ptr)(arena), 0);
+
+  return ix != FAL_ARENA_END ? FAL__INT(block)(arena, ix) : 0;
+}
+
+static inline void* FAL__PUB(prev)(void* ptr) {
+  if (!ptr) {
+    return 0;
+  }
+
+  FAL__T* arena = FAL__PUB(for)(ptr);
+  size_t ix = FAL__INT(find_last)(arena, FAL__INT(ix_for)(ptr), 0);
+
+  return ix != FAL_ARENA_END ? FAL__INT(block)(arena, ix) : 0;
+}
+
+static inline void* FAL__PUB(last_marked)(FAL__T* arena) {
+  assert(arena && "[" FAL_STR(FAL__PUB(last_marked)) "] arena cannot be NULL");
+
+  size_t ix = FAL__INT(find_last)(arena, *FAL__INT(top_ptr)(arena), 1);
+
+  return ix != FAL_ARENA_END ? FAL__INT(block)(arena, ix) : 0;
+}
+
+static inline void* FAL__PUB(prev_marked)(void* ptr) {
+  if (!ptr) {
+    return 0;
+  }
+
+  FAL__T* arena = FAL__PUB(for)(ptr);
+  size_t ix = FAL__INT(find_last)(arena, FAL__INT(ix_for)(ptr), 1);
+
+  return ix != FAL_ARENA_END ? FAL__INT(block)(arena, ix) : 0;
+}
+
 #undef FAL__PUB
 #undef FAL__INT
 #undef FAL__T
+#undef FAL__FWD_T
 
 #undef FAL_ARENA_SIZE
+#undef FAL_ARENA_EFFECTIVE_SIZE
 #undef FAL_ARENA_BLOCK_SIZE
 #undef FAL_ARENA_BEGIN
 #undef FAL_ARENA_END
 #undef FAL_ARENA_TOTAL
 #undef FAL_ARENA_USER_LO_BYTES
 #undef FAL_ARENA_USER_HI_BYTES
+#undef FAL_ARENA_FWD_LEN
+#undef FAL_ARENA_EXTRA_BITS
 
 #undef FAL_ARENA__BLOCK_POW
 #undef FAL_ARENA__POW
@@ -771,12 +1577,17 @@ static inline void* FAL__PUB(next_noskip)(void* ptr) {
 #undef FAL_ARENA__HEADER_BEGIN
 #undef FAL_ARENA__HEADER_TOP_SIZE
 #undef FAL_ARENA__HEADER_SIZE
+#undef FAL_ARENA__TOP_T
+#undef FAL_ARENA__ON_ALLOC
+#undef FAL_ARENA__ON_FREE
+#undef FAL_ARENA__ON_EXTEND
 
 /* Undef compile-time parameters. */
 #ifndef FAL_ARENA_DEF_NO_UNDEF
 #undef FAL_ARENA_DEF_BLOCK_POW
 #undef FAL_ARENA_DEF_POW
 #undef FAL_ARENA_DEF_NAME
+#undef FAL_ARENA_DEF_EXTRA_BITS
 
 #ifdef FAL_ARENA_DEF_HEADER_SIZE
 #undef FAL_ARENA_DEF_HEADER_SIZE
@@ -785,10 +1596,12 @@ static inline void* FAL__PUB(next_noskip)(void* ptr) {
 #ifdef FAL_ARENA_DEF_INCOMPACT
 #undef FAL_ARENA_DEF_INCOMPACT
 #endif
+
+#ifdef FAL_ARENA_DEF_HOOKS
+#undef FAL_ARENA_DEF_HOOKS
+#endif
 #endif /* FAL_ARENA_DEF_NO_UNDEF */
 
 #ifdef __cplusplus
 }
 #endif
-
-#endif
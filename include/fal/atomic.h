@@ -0,0 +1,143 @@
+/* Copyright (c) 2016 Andrey Roenko
+ * This file is part of fal project which is released under MIT license.
+ * See file LICENSE or go to https://opensource.org/licenses/MIT for full
+ * license details.
+*/
+#ifndef __FAL_ATOMIC_H__
+#define __FAL_ATOMIC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Minimal atomics for C99: GCC/Clang __atomic builtins or MSVC intrinsics.
+  Loads and stores take memory order, read-modify-write operations are
+  sequentially consistent.
+*/
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#include <intrin.h>
+
+#define FAL_ATOMIC_RELAXED 0
+#define FAL_ATOMIC_ACQUIRE 0
+#define FAL_ATOMIC_RELEASE 0
+#define FAL_ATOMIC_SEQ_CST 0
+
+/* MSVC volatile accesses have acquire/release semantics. */
+static inline size_t fal_atomic_load(const volatile size_t* p, int order) {
+  (void)order;
+  return *p;
+}
+
+static inline void fal_atomic_store(volatile size_t* p, size_t value,
+  int order) {
+  (void)order;
+  *p = value;
+}
+
+static inline void* fal_atomic_load_ptr(void* const volatile* p, int order) {
+  (void)order;
+  return *p;
+}
+
+static inline void fal_atomic_store_ptr(void* volatile* p, void* value,
+  int order) {
+  (void)order;
+  *p = value;
+}
+
+static inline int fal_atomic_cas(volatile size_t* p, size_t expected,
+  size_t desired) {
+#if defined(_WIN64)
+  return (size_t)_InterlockedCompareExchange64((volatile __int64*)p,
+    (__int64)desired, (__int64)expected) == expected;
+#else
+  return (size_t)_InterlockedCompareExchange((volatile long*)p,
+    (long)desired, (long)expected) == expected;
+#endif
+}
+
+static inline size_t fal_atomic_add(volatile size_t* p, size_t value) {
+#if defined(_WIN64)
+  return (size_t)_InterlockedExchangeAdd64((volatile __int64*)p, (__int64)value);
+#else
+  return (size_t)_InterlockedExchangeAdd((volatile long*)p, (long)value);
+#endif
+}
+
+static inline unsigned char fal_atomic_load8(const volatile unsigned char* p,
+  int order) {
+  (void)order;
+  return *p;
+}
+
+static inline unsigned char fal_atomic_or8(volatile unsigned char* p,
+  unsigned char value) {
+  return (unsigned char)_InterlockedOr8((volatile char*)p, (char)value);
+}
+
+/* Interlocked operations are full barriers. */
+static inline void fal_atomic_fence(void) {
+  volatile long dummy = 0;
+  _InterlockedExchange(&dummy, 0);
+}
+
+#elif defined(__GNUC__)
+
+#define FAL_ATOMIC_RELAXED __ATOMIC_RELAXED
+#define FAL_ATOMIC_ACQUIRE __ATOMIC_ACQUIRE
+#define FAL_ATOMIC_RELEASE __ATOMIC_RELEASE
+#define FAL_ATOMIC_SEQ_CST __ATOMIC_SEQ_CST
+
+static inline size_t fal_atomic_load(const volatile size_t* p, int order) {
+  return __atomic_load_n(p, order);
+}
+
+static inline void fal_atomic_store(volatile size_t* p, size_t value,
+  int order) {
+  __atomic_store_n(p, value, order);
+}
+
+static inline void* fal_atomic_load_ptr(void* const volatile* p, int order) {
+  return __atomic_load_n(p, order);
+}
+
+static inline void fal_atomic_store_ptr(void* volatile* p, void* value,
+  int order) {
+  __atomic_store_n(p, value, order);
+}
+
+/* Replace *p with desired if it equals expected, returns 1 on success. */
+static inline int fal_atomic_cas(volatile size_t* p, size_t expected,
+  size_t desired) {
+  return __atomic_compare_exchange_n(p, &expected, desired, 0,
+    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* Add value to *p, returns previous value. */
+static inline size_t fal_atomic_add(volatile size_t* p, size_t value) {
+  return __atomic_fetch_add(p, value, __ATOMIC_SEQ_CST);
+}
+
+static inline unsigned char fal_atomic_load8(const volatile unsigned char* p,
+  int order) {
+  return __atomic_load_n(p, order);
+}
+
+/* Or value into *p, returns previous value. */
+static inline unsigned char fal_atomic_or8(volatile unsigned char* p,
+  unsigned char value) {
+  return __atomic_fetch_or(p, value, __ATOMIC_SEQ_CST);
+}
+
+static inline void fal_atomic_fence(void) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#else
+
+#error Dont know how to do atomics with this compiler.
+
+#endif /* defined(_MSC_VER) */
+
+#endif /* __FAL_ATOMIC_H__ */
@@ -7,6 +7,9 @@
 #define __FAL_BITSET_H__
 
 #include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 #define fal_bitset__mask(Ix) (1 << ((Ix) % CHAR_BIT))
 #define fal_bitset__slot(BitSet, Ix) ((char*)BitSet)[(Ix) / CHAR_BIT]
@@ -23,4 +26,83 @@
 #define fal_bitset_assign(BitSet, Ix, Value) \
   ((Value) ? fal_bitset_set(BitSet, (Ix)) : fal_bitset_clear(BitSet, (Ix)))
 
+/*
+  Word-level access.
+  Bit Ix of bitset is bit (Ix % 64) of word (Ix / 64) regardless of byte order,
+  so bitset must be padded to multiple of 8 bytes to be accessed by words.
+*/
+#define fal_bitset_words(Len) \
+  (((Len) + 63) / 64)
+
+static inline uint64_t fal_bitset_load64(const void* bs, size_t wix) {
+  uint64_t word;
+  memcpy(&word, (const char*)bs + wix * sizeof(word), sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64(word);
+#endif
+  return word;
+}
+
+static inline void fal_bitset_store64(void* bs, size_t wix, uint64_t word) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64(word);
+#endif
+  memcpy((char*)bs + wix * sizeof(word), &word, sizeof(word));
+}
+
+/* Mask of bits of word wix which lay in [lo, hi). */
+static inline uint64_t fal_bitset_range64(size_t wix, size_t lo, size_t hi) {
+  size_t first = wix * 64;
+  uint64_t mask = ~(uint64_t)0;
+
+  if (lo > first) {
+    mask &= lo - first >= 64 ? 0 : mask << (lo - first);
+  }
+
+  if (hi < first + 64) {
+    mask &= hi <= first ? 0 : ~(uint64_t)0 >> (first + 64 - hi);
+  }
+
+  return mask;
+}
+
+static inline int fal_popcount64(uint64_t word) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(word);
+#else
+  word = word - ((word >> 1) & 0x5555555555555555ull);
+  word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+  word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+  return (int)((word * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/* Number of trailing zeros, word must not be 0. */
+static inline int fal_ctz64(uint64_t word) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(word);
+#else
+  int n = 0;
+  while (!(word & 1)) {
+    word >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+/* Number of leading zeros, word must not be 0. */
+static inline int fal_clz64(uint64_t word) {
+#if defined(__GNUC__)
+  return __builtin_clzll(word);
+#else
+  int n = 0;
+  while (!(word >> 63)) {
+    word <<= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
 #endif /* __FAL_BITSET_H__ */
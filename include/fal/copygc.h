@@ -0,0 +1,488 @@
+/* Copyright (c) 2016 Andrey Roenko
+ * This file is part of fal project which is released under MIT license.
+ * See file LICENSE or go to https://opensource.org/licenses/MIT for full
+ * license details.
+*/
+
+/*
+  Copying garbage collector over list of arenas (Cheney's algorithm).
+
+  Compile-time parameters:
+    (req) FAL_COPYGC_DEF_NAME       - prefix for resulting types and functions
+    (req) FAL_COPYGC_DEF_POW        - power of arena size
+                                      (i.e. 20 means 1 MiB arenas)
+    (req) FAL_COPYGC_DEF_BLOCK_POW  - power of block size
+                                      (i.e. 4 means 16 byte blocks)
+
+    (opt) FAL_COPYGC_DEF_NO_UNDEF   - do not undefined all compile-time parameters
+
+  Header instantiates fal/arena.h with copygc_arena prefix and collector's
+  header, so all arena functions are available too, e.g. copygc_arena_SIZE or
+  copygc_arena_size(obj).
+
+  Collector never maps memory itself. User gives it memory for arenas with
+  copygc_add_arena. Arenas are either used (from-space, objects are allocated
+  in them by bumping pointer) or spare (to-space of next collection).
+
+  Collection copies objects reachable from roots into spare arenas in one
+  breadth-first pass without mark phase: to-space itself is the queue of
+  objects to trace. Copied object leaves forwarding address in its first word
+  and its mark bit is set, so object size must be at least sizeof(void*).
+  Scan pointer walks to-space arenas in order they were taken, so objects
+  spanning several to-space arenas are traced as one queue. Then used arenas
+  become spare and to-space becomes used.
+
+  Copying may need more arenas than were used, since objects are packed in
+  different order and arena tail too small for next object is wasted. Tail
+  is shorter than the largest object, so every to-space arena but the last
+  holds at least EffectiveSize - LargestObject + BlockSize bytes. A single
+  arena may hold much less than half of it when the next object is close
+  to EffectiveSize, but then the next arena holds that object, so two
+  adjacent arenas together hold more than EffectiveSize. Hence to-space of
+  n + 1 arenas holds more than n times
+  max(EffectiveSize - LargestObject + BlockSize, EffectiveSize / 2) bytes,
+  the second bound holding on average over pairs of arenas. Mutator
+  allocates only while bytes in used arenas fit into spare arenas filled
+  that much, so collection never runs out of them. With small objects this
+  is about half of heap.
+
+  Objects are traced by single user-supplied callback which must call
+  copygc_visit for address of every pointer field of object.
+
+  API:
+    copygc_ prefix is overriden by <FAL_COPYGC_DEF_NAME>_.
+    Everything with __ (two underscores) in name should be considered internal.
+
+    Types:
+      copygc_t - collector state, should be used only as copygc_t*
+      copygc_arena_t - arena, see fal/arena.h
+      copygc_root_t - root registration record, owned by user
+      copygc_stats_t - counters, see copygc_stats
+      void (*copygc_trace_fn)(copygc_t*, void* obj)
+        must call copygc_visit for each pointer field of obj
+
+    Initializing:
+      void copygc_init(copygc_t*, copygc_trace_fn trace)
+        initialize collector without arenas
+      void copygc_add_arena(copygc_t*, void* mem)
+        add copygc_arena_SIZE bytes of memory aligned to copygc_arena_SIZE
+        to heap as spare arena
+
+    Roots:
+      void copygc_add_root(copygc_t*, copygc_root_t*, void** slots, size_t len)
+        register len pointer slots as roots, record must stay valid until
+        copygc_remove_root
+      void copygc_remove_root(copygc_t*, copygc_root_t*)
+        unregister roots
+
+    Allocating:
+      void* copygc_alloc(copygc_t*, size_t size)
+        allocate zeroed object or return 0 if current arena is full and no
+        spare arena can be taken, usually followed by copygc_collect,
+        copygc_add_arena or both
+
+    Collecting:
+      void copygc_collect(copygc_t*)
+        copy everything reachable from roots to spare arenas and make
+        arenas used before spare
+      void copygc_visit(copygc_t*, void** slot)
+        copy object *slot (if any) unless it's copied already and update slot,
+        must be called only from trace callback
+
+    Querying:
+      const copygc_stats_t* copygc_stats(copygc_t*)
+        get counters
+      copygc_arena_t* copygc_first_arena(copygc_t*)
+        get first used arena
+      copygc_arena_t* copygc_next_arena(copygc_arena_t*)
+        get next used arena
+*/
+
+#ifndef __FAL_COPYGC_H__
+#define __FAL_COPYGC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "utils.h"
+
+#endif /* __FAL_COPYGC_H__ */
+
+#if !defined(FAL_COPYGC_DEF_POW) \
+  || !defined(FAL_COPYGC_DEF_BLOCK_POW) \
+  || !defined(FAL_COPYGC_DEF_NAME)
+#error FAL_COPYGC: compile-time parameters \
+  FAL_COPYGC_DEF_POW, FAL_COPYGC_DEF_BLOCK_POW and FAL_COPYGC_DEF_NAME \
+  must be defined.
+#endif
+
+/* Public and internal functions helpers. */
+#define FAL_COPYGC__PUB(X)    FAL_CONCAT(FAL_COPYGC_DEF_NAME, FAL_CONCAT(_, X))
+#define FAL_COPYGC__INT(X)    FAL_CONCAT(FAL_COPYGC_DEF_NAME, FAL_CONCAT(__, X))
+#define FAL_COPYGC__ARENA(X)  \
+  FAL_CONCAT(FAL_COPYGC_DEF_NAME, FAL_CONCAT(_arena_, X))
+
+/* Public */
+#define FAL_COPYGC__T         FAL_COPYGC__PUB(t)
+#define FAL_COPYGC__ROOT_T    FAL_COPYGC__PUB(root_t)
+#define FAL_COPYGC__STATS_T   FAL_COPYGC__PUB(stats_t)
+#define FAL_COPYGC__TRACE_FN  FAL_COPYGC__PUB(trace_fn)
+#define FAL_COPYGC__ARENA_T   FAL_COPYGC__ARENA(t)
+/* Internal */
+#define FAL_COPYGC__HEADER_T  FAL_COPYGC__INT(header_t)
+
+typedef struct FAL_COPYGC__HEADER_T FAL_COPYGC__HEADER_T;
+struct FAL_COPYGC__HEADER_T {
+  struct FAL_COPYGC__ARENA_T* next;
+  int to; /* arena was taken as to-space by current collection */
+};
+
+#define FAL_ARENA_DEF_NAME        FAL_CONCAT(FAL_COPYGC_DEF_NAME, _arena)
+#define FAL_ARENA_DEF_POW         FAL_COPYGC_DEF_POW
+#define FAL_ARENA_DEF_BLOCK_POW   FAL_COPYGC_DEF_BLOCK_POW
+#define FAL_ARENA_DEF_HEADER_SIZE sizeof(FAL_COPYGC__HEADER_T)
+#include "arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct FAL_COPYGC__T FAL_COPYGC__T;
+typedef struct FAL_COPYGC__ROOT_T FAL_COPYGC__ROOT_T;
+typedef struct FAL_COPYGC__STATS_T FAL_COPYGC__STATS_T;
+typedef void (*FAL_COPYGC__TRACE_FN)(FAL_COPYGC__T* gc, void* obj);
+
+struct FAL_COPYGC__ROOT_T {
+  FAL_COPYGC__ROOT_T* next;
+  void** slots;
+  size_t len;
+};
+
+struct FAL_COPYGC__STATS_T {
+  size_t collections;     /* number of finished collections */
+  size_t arenas;          /* number of arenas in heap */
+  size_t used_arenas;     /* number of arenas with objects */
+  size_t copied_bytes;    /* bytes copied by last collection */
+  size_t copied_objects;  /* objects copied by last collection */
+};
+
+struct FAL_COPYGC__T {
+  FAL_COPYGC__TRACE_FN trace;
+  FAL_COPYGC__ROOT_T* roots;
+  FAL_COPYGC__ARENA_T* used;    /* arenas in order they were taken */
+  FAL_COPYGC__ARENA_T* current; /* last used arena, objects are bumped there */
+  FAL_COPYGC__ARENA_T* spare;
+  FAL_COPYGC__STATS_T stats;
+  size_t bytes;                 /* bytes of objects in used arenas */
+  size_t max_size;              /* largest object in used arenas */
+
+  FAL_COPYGC__ARENA_T* to;      /* to-space arenas of current collection */
+  FAL_COPYGC__ARENA_T* to_current;
+};
+
+/******************************************************************************/
+/*                            FORWARD DECLARATION                             */
+/******************************************************************************/
+static inline FAL_COPYGC__HEADER_T* FAL_COPYGC__INT(header)(
+  FAL_COPYGC__ARENA_T* arena);
+static inline FAL_COPYGC__ARENA_T* FAL_COPYGC__INT(take)(FAL_COPYGC__T* gc,
+  FAL_COPYGC__ARENA_T** head, FAL_COPYGC__ARENA_T** tail);
+static inline size_t FAL_COPYGC__INT(fill)(size_t max_size);
+static inline void* FAL_COPYGC__INT(copy)(FAL_COPYGC__T* gc, void* obj);
+static inline void FAL_COPYGC__INT(scan)(FAL_COPYGC__T* gc);
+
+static inline void FAL_COPYGC__PUB(init)(FAL_COPYGC__T* gc,
+  FAL_COPYGC__TRACE_FN trace);
+static inline void FAL_COPYGC__PUB(add_arena)(FAL_COPYGC__T* gc, void* mem);
+
+static inline void FAL_COPYGC__PUB(add_root)(FAL_COPYGC__T* gc,
+  FAL_COPYGC__ROOT_T* root, void** slots, size_t len);
+static inline void FAL_COPYGC__PUB(remove_root)(FAL_COPYGC__T* gc,
+  FAL_COPYGC__ROOT_T* root);
+
+static inline void* FAL_COPYGC__PUB(alloc)(FAL_COPYGC__T* gc, size_t size);
+
+static inline void FAL_COPYGC__PUB(collect)(FAL_COPYGC__T* gc);
+static inline void FAL_COPYGC__PUB(visit)(FAL_COPYGC__T* gc, void** slot);
+
+static inline const FAL_COPYGC__STATS_T* FAL_COPYGC__PUB(stats)(
+  FAL_COPYGC__T* gc);
+static inline FAL_COPYGC__ARENA_T* FAL_COPYGC__PUB(first_arena)(
+  FAL_COPYGC__T* gc);
+static inline FAL_COPYGC__ARENA_T* FAL_COPYGC__PUB(next_arena)(
+  FAL_COPYGC__ARENA_T* arena);
+
+/******************************************************************************/
+/*                                INTERNALS                                   */
+/******************************************************************************/
+static inline FAL_COPYGC__HEADER_T* FAL_COPYGC__INT(header)(
+  FAL_COPYGC__ARENA_T* arena) {
+  return (FAL_COPYGC__HEADER_T*)FAL_COPYGC__ARENA(header)(arena);
+}
+
+/* Move spare arena to the end of list given by head and tail. */
+static inline FAL_COPYGC__ARENA_T* FAL_COPYGC__INT(take)(FAL_COPYGC__T* gc,
+  FAL_COPYGC__ARENA_T** head, FAL_COPYGC__ARENA_T** tail) {
+  FAL_COPYGC__ARENA_T* arena = gc->spare;
+  FAL_COPYGC__HEADER_T* header = FAL_COPYGC__INT(header)(arena);
+  gc->spare = header->next;
+  header->next = 0;
+
+  if (*tail) {
+    FAL_COPYGC__INT(header)(*tail)->next = arena;
+  } else {
+    *head = arena;
+  }
+  *tail = arena;
+
+  return arena;
+}
+
+/* Bytes to-space arenas but the last hold at least on average, when
+   objects are at most max_size bytes: each of them more than arena less
+   the largest object, every two adjacent ones more than arena. */
+static inline size_t FAL_COPYGC__INT(fill)(size_t max_size) {
+  size_t fill = FAL_COPYGC__ARENA(EFFECTIVE_SIZE) - max_size
+    + FAL_COPYGC__ARENA(BLOCK_SIZE);
+  return 2 * fill > FAL_COPYGC__ARENA(EFFECTIVE_SIZE) ? fill
+    : FAL_COPYGC__ARENA(EFFECTIVE_SIZE) / 2;
+}
+
+static inline void* FAL_COPYGC__INT(copy)(FAL_COPYGC__T* gc, void* obj) {
+  size_t size = FAL_COPYGC__ARENA(size)(obj);
+
+  void* copy = gc->to_current
+    ? FAL_COPYGC__ARENA(bumpalloc)(gc->to_current, size) : 0;
+  if (!copy) {
+    assert(gc->spare
+      && "[" FAL_STR(FAL_COPYGC__PUB(collect)) "] spare arenas are exhausted");
+
+    FAL_COPYGC__ARENA_T* arena =
+      FAL_COPYGC__INT(take)(gc, &gc->to, &gc->to_current);
+    FAL_COPYGC__INT(header)(arena)->to = 1;
+    copy = FAL_COPYGC__ARENA(bumpalloc)(arena, size);
+    assert(copy);
+  }
+
+  memcpy(copy, obj, size);
+  gc->stats.copied_bytes += size;
+  gc->stats.copied_objects++;
+  gc->max_size = size > gc->max_size ? size : gc->max_size;
+
+  /* Leave forwarding address in from-space, marked objects are forwarded. */
+  *(void**)obj = copy;
+  FAL_COPYGC__ARENA(mark)(obj);
+
+  return copy;
+}
+
+/* Trace to-space objects in order they were copied, tracing copies more
+   objects to the end of to-space, so scan is done when it catches up. */
+static inline void FAL_COPYGC__INT(scan)(FAL_COPYGC__T* gc) {
+  for (FAL_COPYGC__ARENA_T* arena = gc->to; arena;
+    arena = FAL_COPYGC__INT(header)(arena)->next) {
+    char* obj = (char*)FAL_COPYGC__ARENA(mem_start)(arena);
+
+    /* Bump top grows while arena is traced. */
+    while (obj < (char*)arena
+      + FAL_COPYGC__ARENA(bumptop)(arena) * FAL_COPYGC__ARENA(BLOCK_SIZE)) {
+      size_t size = FAL_COPYGC__ARENA(size)(obj);
+      gc->trace(gc, obj);
+      obj += size;
+    }
+  }
+}
+
+/******************************************************************************/
+/*                              INITIALIZATION                                */
+/******************************************************************************/
+static inline void FAL_COPYGC__PUB(init)(FAL_COPYGC__T* gc,
+  FAL_COPYGC__TRACE_FN trace) {
+  assert(trace && "[" FAL_STR(FAL_COPYGC__PUB(init)) "] trace cannot be NULL");
+  assert(FAL_COPYGC__ARENA(BLOCK_SIZE) >= sizeof(void*)
+    && "[" FAL_STR(FAL_COPYGC__PUB(init)) "] block cannot fit forwarding address");
+
+  gc->trace = trace;
+  gc->roots = 0;
+  gc->used = 0;
+  gc->current = 0;
+  gc->spare = 0;
+  gc->to = 0;
+  gc->to_current = 0;
+  memset(&gc->stats, 0, sizeof(gc->stats));
+  gc->bytes = 0;
+  gc->max_size = 0;
+}
+
+static inline void FAL_COPYGC__PUB(add_arena)(FAL_COPYGC__T* gc, void* mem) {
+  assert(mem && "[" FAL_STR(FAL_COPYGC__PUB(add_arena)) "] mem cannot be NULL");
+
+  FAL_COPYGC__ARENA_T* arena = (FAL_COPYGC__ARENA_T*)mem;
+  FAL_COPYGC__ARENA(init)(arena);
+
+  FAL_COPYGC__HEADER_T* header = FAL_COPYGC__INT(header)(arena);
+  header->next = gc->spare;
+  header->to = 0;
+  gc->spare = arena;
+  gc->stats.arenas++;
+}
+
+/******************************************************************************/
+/*                                   ROOTS                                    */
+/******************************************************************************/
+static inline void FAL_COPYGC__PUB(add_root)(FAL_COPYGC__T* gc,
+  FAL_COPYGC__ROOT_T* root, void** slots, size_t len) {
+  root->slots = slots;
+  root->len = len;
+  root->next = gc->roots;
+  gc->roots = root;
+}
+
+static inline void FAL_COPYGC__PUB(remove_root)(FAL_COPYGC__T* gc,
+  FAL_COPYGC__ROOT_T* root) {
+  for (FAL_COPYGC__ROOT_T** it = &gc->roots; *it; it = &(*it)->next) {
+    if (*it == root) {
+      *it = root->next;
+      return;
+    }
+  }
+
+  assert(0 && "[" FAL_STR(FAL_COPYGC__PUB(remove_root)) "] root is not registered");
+}
+
+/******************************************************************************/
+/*                                ALLOCATING                                  */
+/******************************************************************************/
+static inline void* FAL_COPYGC__PUB(alloc)(FAL_COPYGC__T* gc, size_t size) {
+  assert(size && "[" FAL_STR(FAL_COPYGC__PUB(alloc)) "] size cannot be zero");
+
+  if (size > FAL_COPYGC__ARENA(EFFECTIVE_SIZE)) {
+    return 0;
+  }
+
+  size_t blocks = (size + FAL_COPYGC__ARENA(BLOCK_SIZE) - 1)
+    / FAL_COPYGC__ARENA(BLOCK_SIZE);
+  size_t bytes = blocks * FAL_COPYGC__ARENA(BLOCK_SIZE);
+  size_t max_size = bytes > gc->max_size ? bytes : gc->max_size;
+  int take = !gc->current
+    || FAL_COPYGC__ARENA(bumptop)(gc->current) + blocks > FAL_COPYGC__ARENA(END);
+
+  /* Keep enough spare arenas to copy everything in used ones. */
+  size_t used = gc->stats.used_arenas + take;
+  if (used > gc->stats.arenas || gc->bytes + bytes
+    > (gc->stats.arenas - used) * FAL_COPYGC__INT(fill)(max_size)) {
+    return 0;
+  }
+
+  if (take) {
+    FAL_COPYGC__INT(take)(gc, &gc->used, &gc->current);
+    gc->stats.used_arenas++;
+  }
+
+  void* obj = FAL_COPYGC__ARENA(bumpalloc)(gc->current, size);
+  assert(obj);
+  gc->bytes += bytes;
+  gc->max_size = max_size;
+
+  return memset(obj, 0, size);
+}
+
+/******************************************************************************/
+/*                                COLLECTING                                  */
+/******************************************************************************/
+static inline void FAL_COPYGC__PUB(visit)(FAL_COPYGC__T* gc, void** slot) {
+  void* obj = *slot;
+  if (!obj) {
+    return;
+  }
+
+  if (FAL_COPYGC__INT(header)(FAL_COPYGC__ARENA(for)(obj))->to) {
+    return;
+  }
+
+  *slot = FAL_COPYGC__ARENA(marked)(obj)
+    ? *(void**)obj : FAL_COPYGC__INT(copy)(gc, obj);
+}
+
+static inline void FAL_COPYGC__PUB(collect)(FAL_COPYGC__T* gc) {
+  gc->stats.copied_bytes = 0;
+  gc->stats.copied_objects = 0;
+  gc->max_size = 0;
+  gc->to = 0;
+  gc->to_current = 0;
+
+  for (FAL_COPYGC__ROOT_T* root = gc->roots; root; root = root->next) {
+    for (size_t ix = 0; ix < root->len; ix++) {
+      FAL_COPYGC__PUB(visit)(gc, &root->slots[ix]);
+    }
+  }
+
+  FAL_COPYGC__INT(scan)(gc);
+
+  /* Flip: from-space becomes spare, to-space becomes used. */
+  size_t used_arenas = 0;
+  for (FAL_COPYGC__ARENA_T* arena = gc->to; arena;
+    arena = FAL_COPYGC__INT(header)(arena)->next) {
+    FAL_COPYGC__INT(header)(arena)->to = 0;
+    used_arenas++;
+  }
+
+  for (FAL_COPYGC__ARENA_T* arena = gc->used; arena; ) {
+    FAL_COPYGC__ARENA_T* next = FAL_COPYGC__INT(header)(arena)->next;
+    FAL_COPYGC__ARENA(init)(arena);
+    FAL_COPYGC__INT(header)(arena)->next = gc->spare;
+    FAL_COPYGC__INT(header)(arena)->to = 0;
+    gc->spare = arena;
+    arena = next;
+  }
+
+  gc->used = gc->to;
+  gc->current = gc->to_current;
+  gc->to = 0;
+  gc->to_current = 0;
+  gc->stats.used_arenas = used_arenas;
+  gc->stats.collections++;
+  gc->bytes = gc->stats.copied_bytes;
+}
+
+/******************************************************************************/
+/*                                  QUERYING                                  */
+/******************************************************************************/
+static inline const FAL_COPYGC__STATS_T* FAL_COPYGC__PUB(stats)(
+  FAL_COPYGC__T* gc) {
+  return &gc->stats;
+}
+
+static inline FAL_COPYGC__ARENA_T* FAL_COPYGC__PUB(first_arena)(
+  FAL_COPYGC__T* gc) {
+  return gc->used;
+}
+
+static inline FAL_COPYGC__ARENA_T* FAL_COPYGC__PUB(next_arena)(
+  FAL_COPYGC__ARENA_T* arena) {
+  return FAL_COPYGC__INT(header)(arena)->next;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef FAL_COPYGC__PUB
+#undef FAL_COPYGC__INT
+#undef FAL_COPYGC__ARENA
+
+#undef FAL_COPYGC__T
+#undef FAL_COPYGC__ROOT_T
+#undef FAL_COPYGC__STATS_T
+#undef FAL_COPYGC__TRACE_FN
+#undef FAL_COPYGC__ARENA_T
+#undef FAL_COPYGC__HEADER_T
+
+/* Undef compile-time parameters. */
+#ifndef FAL_COPYGC_DEF_NO_UNDEF
+#undef FAL_COPYGC_DEF_NAME
+#undef FAL_COPYGC_DEF_POW
+#undef FAL_COPYGC_DEF_BLOCK_POW
+#endif /* FAL_COPYGC_DEF_NO_UNDEF */
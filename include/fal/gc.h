@@ -0,0 +1,1136 @@
+/* Copyright (c) 2016 Andrey Roenko
+ * This file is part of fal project which is released under MIT license.
+ * See file LICENSE or go to https://opensource.org/licenses/MIT for full
+ * license details.
+*/
+
+/*
+  Mark&sweep garbage collector over list of arenas.
+
+  Compile-time parameters:
+    (req) FAL_GC_DEF_NAME       - prefix for resulting types and functions
+    (req) FAL_GC_DEF_POW        - power of arena size
+                                  (i.e. 20 means 1 MiB arenas)
+    (req) FAL_GC_DEF_BLOCK_POW  - power of block size
+                                  (i.e. 4 means 16 byte blocks)
+    (opt) FAL_GC_DEF_INCOMPACT  - passed to arena as FAL_ARENA_DEF_INCOMPACT
+    (opt) FAL_GC_DEF_MARK_STACK - default: 4096; capacity of mark stack
+    (opt) FAL_GC_DEF_CLOCK()    - expression returning monotonic time in
+                                  nanoseconds as uint64_t, enables gc_step_ns
+    (opt) FAL_GC_DEF_STEP_SLICE - default: 64; work units done by gc_step_ns
+                                  between clock checks
+    (opt) FAL_GC_DEF_EXTRA_ROOTS(Gc) - statement executed at start of each
+                                  cycle after registered roots are marked,
+                                  may call gc_visit for more root slots
+    (opt) FAL_GC_DEF_ARENA_ALLOC() - expression returning gc_arena_SIZE bytes
+                                  aligned to gc_arena_SIZE or 0, enables heap
+                                  sizing (see below)
+    (opt) FAL_GC_DEF_ARENA_FREE(Mem) - statement releasing memory returned
+                                  by FAL_GC_DEF_ARENA_ALLOC, required with it
+
+    (opt) FAL_GC_DEF_NO_UNDEF   - do not undefined all compile-time parameters
+
+  Header instantiates fal/arena.h with gc_arena prefix and collector's header,
+  so all arena functions are available too, e.g. gc_arena_SIZE or
+  gc_arena_size(obj).
+
+  Collector never maps memory itself. User gives it memory for arenas with
+  gc_add_arena and decides what to do when gc_alloc fails: collect garbage,
+  add another arena or both.
+
+  Or user defines FAL_GC_DEF_ARENA_ALLOC and FAL_GC_DEF_ARENA_FREE and
+  allocation functions decide it themselves, keeping heap at target ratio to
+  live bytes (gc_tuning_t.heap_ratio, in percent). After every collection
+  target heap is live * heap_ratio / 100 bytes but no less than min_arenas
+  arenas, and the difference is allocation budget: gc_alloc runs gc_collect
+  once more than that many bytes were allocated since last collection. When
+  allocation fails before that, heap grows by one arena, when heap can't
+  grow (max_arenas or allocator returned 0) it collects. Empty arenas above
+  target are released after each collection. With FAL_GC_DEF_CLOCK, time of
+  these collections is measured too: if it exceeds cpu_budget percent of
+  time between them, the ratio's excess over 100% is doubled (up to 64
+  times), if it's below half of budget, excess is halved back towards
+  heap_ratio. Allocation never triggers collection while cycle is marking.
+
+  Objects are traced by user-supplied callback which must call gc_visit for
+  address of every pointer field of object. Marking uses explicit
+  stack of FAL_GC_DEF_MARK_STACK entries instead of recursion. When it
+  overflows, objects are still marked but not pushed and their arenas are
+  flagged, after stack is drained marked objects of flagged arenas are traced
+  again until no overflow happens. Retracing counts against step budget and
+  resumes where it stopped. So marking never fails and never uses more
+  memory than gc_t, only gets slower for deep and wide graphs.
+
+  Objects can be segregated by type (big bag of pages): arena gets
+  dedicated to gc_type_t on first gc_alloc_typed and holds only objects of
+  that type until it's empty again. Type is stored once in arena header,
+  gc_type_of finds it by masking pointer, so objects don't need type word
+  of their own, and such objects are traced by trace callback of their type.
+  Objects of type without pointers are only marked, never pushed to mark
+  stack.
+
+  Sweeping frees unmarked objects by whole bitset words (see arena_sweep).
+  Every arena is swept independently, so sweeping can be spread over
+  threads with gc_sweep_part or deferred: gc_alloc sweeps arena itself the
+  first time it wants to allocate from it after marking. gc_collect_lazy
+  does only marking and leaves all sweeping to gc_alloc, so its pause is
+  proportional to roots and live objects, not to heap size.
+
+  Marks are never cleared by separate pass. Every arena remembers cycle its
+  mark bits belong to (mark epoch) and cycle whose garbage it had freed, so
+  arena which wasn't swept after some cycle still can be swept any time
+  later: marker sweeps it when it marks first object in it during next
+  cycle, gc_alloc - when it allocates from it. Arena which got no marks
+  during cycle holds only garbage and is simply reinitialized. Arenas nobody
+  touches stay cold across any number of cycles.
+
+  Collection can be done at once with gc_collect or incrementally with
+  gc_step, which does bounded amount of work and returns. Work unit is either
+  one traced object or one swept bitset word (arena is swept at once, so
+  sweeping arena costs gc_arena_SIZE/gc_arena_BLOCK_SIZE/64 units).
+  Incremental cycle is:
+    1. Roots are marked at once (snapshot of roots).
+    2. Marked objects (gray) are traced from mark stack in steps.
+       Mutator must store pointers into heap objects via gc_write, which
+       marks overwritten value (Yuasa's deletion barrier), so everything
+       reachable at snapshot gets marked. Roots may be changed freely.
+    3. Arenas are swept in steps, gc_alloc sweeps arena before allocating
+       from it if it wasn't swept yet.
+  Objects allocated during marking are allocated marked (black), so they
+  survive current cycle.
+
+  Pointer fields may be stored as 32-bit compressed references (see
+  fal/ref.h) when all arenas are carved from one reserved range described by
+  gc_ref_heap_t, scaled by block size. Such fields are traced with
+  gc_visit_ref and written with gc_write_ref.
+
+  API:
+    gc_ prefix is overriden by <FAL_GC_DEF_NAME>_.
+    Everything with __ (two underscores) in name should be considered internal.
+
+    Types:
+      gc_t - collector state, should be used only as gc_t*
+      gc_arena_t - arena, see fal/arena.h
+      gc_root_t - root registration record, owned by user
+      gc_stats_t - counters, see gc_stats
+      gc_type_t - type of objects, owned by user, see gc_add_type
+      gc_tuning_t - heap sizing parameters, see gc_tuning
+      gc_ref_t, gc_ref_heap_t - compressed reference and reserved range,
+        fal/ref.h instantiated with gc_arena_BLOCK_POW scale, i.e. also
+        gc_ref_init, gc_ref_compress, gc_ref_decompress and gc_ref_contains
+      void (*gc_trace_fn)(gc_t*, void* obj)
+        must call gc_visit for each pointer field of obj
+
+    Initializing:
+      void gc_init(gc_t*, gc_trace_fn trace)
+        initialize collector without arenas, trace is used for objects
+        allocated with gc_alloc and may be 0 if there are none
+      void gc_add_arena(gc_t*, void* mem)
+        add gc_arena_SIZE bytes of memory aligned to gc_arena_SIZE to heap
+      void gc_add_type(gc_t*, gc_type_t*, size_t size, gc_trace_fn trace)
+        register type of objects of given size traced by trace, or without
+        pointers if trace is 0, record must stay valid while collector is
+        used
+
+    Roots:
+      void gc_add_root(gc_t*, gc_root_t*, void** slots, size_t len)
+        register len pointer slots as roots, record must stay valid until
+        gc_remove_root
+      void gc_remove_root(gc_t*, gc_root_t*)
+        unregister roots
+
+    Allocating:
+      void* gc_alloc(gc_t*, size_t size)
+        allocate zeroed object or return 0 if no arena has enough space
+      void* gc_alloc_typed(gc_t*, gc_type_t*)
+        allocate zeroed object of type in arena dedicated to type or in
+        empty arena which becomes dedicated, return 0 if there's none
+
+    Collecting:
+      void gc_collect(gc_t*)
+        finish current cycle if any, then mark everything reachable
+        from roots and free everything else
+      void gc_collect_lazy(gc_t*)
+        finish current cycle if any, then mark everything reachable from
+        roots and leave arenas to be swept by gc_alloc, gc_step or
+        gc_sweep_part
+      size_t gc_sweep_part(gc_t*, size_t part, size_t parts)
+        sweep every parts-th arena starting from part-th (from 0), which
+        wasn't swept yet, returns number of swept arenas; may be called
+        concurrently for different parts (e.g. part per thread), but not
+        concurrently with anything else; call gc_finish afterwards
+      void gc_finish(gc_t*)
+        finish current cycle if any
+      int gc_step(gc_t*, size_t budget)
+        start cycle if there's none and do about budget units of work,
+        returns 0 if cycle is finished, 1 otherwise
+      int gc_step_ns(gc_t*, uint64_t budget_ns)
+        same as gc_step, but budget is in nanoseconds,
+        available only if FAL_GC_DEF_CLOCK is defined
+      int gc_collecting(gc_t*)
+        check if cycle is in progress
+      void gc_visit(gc_t*, void** slot)
+        mark object *slot (if any) and schedule it for tracing,
+        must be called only from trace callback or FAL_GC_DEF_EXTRA_ROOTS
+      void gc_write(gc_t*, void** slot, void* value)
+        store value into pointer field of heap object with write barrier
+      void gc_visit_ref(gc_t*, const gc_ref_heap_t*, gc_ref_t* slot)
+        same as gc_visit for compressed reference field
+      void gc_write_ref(gc_t*, const gc_ref_heap_t*, gc_ref_t* slot,
+        gc_ref_t value)
+        same as gc_write for compressed reference field
+
+    Querying:
+      const gc_stats_t* gc_stats(gc_t*)
+        get counters
+      gc_tuning_t* gc_tuning(gc_t*)
+        get heap sizing parameters for modification, used only with
+        FAL_GC_DEF_ARENA_ALLOC, changes take effect on next collection:
+          size_t heap_ratio - default: 200; target heap to live percent,
+                              must be more than 100
+          size_t min_arenas - default: 1; arenas heap may shrink to
+          size_t max_arenas - default: 0; arenas heap may grow to, 0 means
+                              no limit besides allocator
+          size_t cpu_budget - default: 10; percent of time collections may
+                              take, used only with FAL_GC_DEF_CLOCK
+      gc_type_t* gc_type_of(void* obj)
+        get type of object allocated with gc_alloc_typed in O(1) or 0 for
+        gc_alloc one
+      gc_arena_t* gc_first_arena(gc_t*)
+        get first arena of heap
+      gc_arena_t* gc_next_arena(gc_arena_t*)
+        get next arena of heap
+
+    Constants:
+      gc_MARK_STACK - capacity of mark stack
+*/
+
+#ifndef __FAL_GC_H__
+#define __FAL_GC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "atomic.h"
+
+#endif /* __FAL_GC_H__ */
+
+#if !defined(FAL_GC_DEF_POW) \
+  || !defined(FAL_GC_DEF_BLOCK_POW) \
+  || !defined(FAL_GC_DEF_NAME)
+#error FAL_GC: compile-time parameters \
+  FAL_GC_DEF_POW, FAL_GC_DEF_BLOCK_POW and FAL_GC_DEF_NAME must be defined.
+#endif
+
+#ifndef FAL_GC_DEF_MARK_STACK
+#define FAL_GC_DEF_MARK_STACK 4096
+#endif
+
+#ifndef FAL_GC_DEF_STEP_SLICE
+#define FAL_GC_DEF_STEP_SLICE 64
+#endif
+
+#if defined(FAL_GC_DEF_ARENA_ALLOC) != defined(FAL_GC_DEF_ARENA_FREE)
+#error FAL_GC: compile-time parameters \
+  FAL_GC_DEF_ARENA_ALLOC and FAL_GC_DEF_ARENA_FREE must be defined together.
+#endif
+
+/* Public and internal functions helpers. */
+#define FAL_GC__PUB(X)      FAL_CONCAT(FAL_GC_DEF_NAME, FAL_CONCAT(_, X))
+#define FAL_GC__INT(X)      FAL_CONCAT(FAL_GC_DEF_NAME, FAL_CONCAT(__, X))
+#define FAL_GC__ARENA(X)    FAL_CONCAT(FAL_GC_DEF_NAME, FAL_CONCAT(_arena_, X))
+#define FAL_GC__REF(X)      FAL_CONCAT(FAL_GC_DEF_NAME, FAL_CONCAT(_ref_, X))
+
+/* Public */
+#define FAL_GC__T           FAL_GC__PUB(t)
+#define FAL_GC__ROOT_T      FAL_GC__PUB(root_t)
+#define FAL_GC__STATS_T     FAL_GC__PUB(stats_t)
+#define FAL_GC__TRACE_FN    FAL_GC__PUB(trace_fn)
+#define FAL_GC__TYPE_T      FAL_GC__PUB(type_t)
+#define FAL_GC__TUNING_T    FAL_GC__PUB(tuning_t)
+#define FAL_GC__ARENA_T     FAL_GC__ARENA(t)
+#define FAL_GC__REF_T       FAL_GC__REF(t)
+#define FAL_GC__REF_HEAP_T  FAL_GC__REF(heap_t)
+#define FAL_GC_MARK_STACK   FAL_GC__PUB(MARK_STACK)
+/* Internal */
+#define FAL_GC__HEADER_T    FAL_GC__INT(header_t)
+#define FAL_GC__IDLE        FAL_GC__INT(IDLE)
+#define FAL_GC__MARKING     FAL_GC__INT(MARKING)
+#define FAL_GC__SWEEPING    FAL_GC__INT(SWEEPING)
+#define FAL_GC__SWEEP_COST  FAL_GC__INT(SWEEP_COST)
+
+typedef struct FAL_GC__HEADER_T FAL_GC__HEADER_T;
+struct FAL_GC__HEADER_T {
+  struct FAL_GC__ARENA_T* next;
+  struct FAL_GC__TYPE_T* type; /* type arena is dedicated to, if any */
+  int overflow; /* some marked objects of arena weren't pushed to mark stack */
+  size_t epoch; /* cycle mark bits belong to */
+  size_t swept; /* cycle whose garbage was freed */
+  size_t cursor; /* block to look for free blocks from, see gc_alloc */
+};
+
+#define FAL_ARENA_DEF_NAME        FAL_CONCAT(FAL_GC_DEF_NAME, _arena)
+#define FAL_ARENA_DEF_POW         FAL_GC_DEF_POW
+#define FAL_ARENA_DEF_BLOCK_POW   FAL_GC_DEF_BLOCK_POW
+#define FAL_ARENA_DEF_HEADER_SIZE sizeof(FAL_GC__HEADER_T)
+#ifdef FAL_GC_DEF_INCOMPACT
+#define FAL_ARENA_DEF_INCOMPACT
+#endif
+#include "arena.h"
+
+#define FAL_REF_DEF_NAME          FAL_CONCAT(FAL_GC_DEF_NAME, _ref)
+#define FAL_REF_DEF_SHIFT         FAL_GC_DEF_BLOCK_POW
+#include "ref.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct FAL_GC__T FAL_GC__T;
+typedef struct FAL_GC__ROOT_T FAL_GC__ROOT_T;
+typedef struct FAL_GC__STATS_T FAL_GC__STATS_T;
+typedef struct FAL_GC__TYPE_T FAL_GC__TYPE_T;
+typedef struct FAL_GC__TUNING_T FAL_GC__TUNING_T;
+typedef void (*FAL_GC__TRACE_FN)(FAL_GC__T* gc, void* obj);
+
+enum FAL_GC__INT(defs) {
+  FAL_GC_MARK_STACK = FAL_GC_DEF_MARK_STACK,
+  FAL_GC__SWEEP_COST = FAL_GC__ARENA(SIZE) / FAL_GC__ARENA(BLOCK_SIZE) / 64
+};
+
+enum FAL_GC__INT(phase) {
+  FAL_GC__IDLE = 0,
+  FAL_GC__MARKING,
+  FAL_GC__SWEEPING
+};
+
+struct FAL_GC__ROOT_T {
+  FAL_GC__ROOT_T* next;
+  void** slots;
+  size_t len;
+};
+
+struct FAL_GC__TYPE_T {
+  FAL_GC__TYPE_T* next;
+  FAL_GC__TRACE_FN trace;
+  size_t size;
+  FAL_GC__ARENA_T* current; /* arena gc_alloc_typed allocates from */
+};
+
+struct FAL_GC__STATS_T {
+  size_t collections;     /* number of finished collections */
+  size_t arenas;          /* number of arenas in heap */
+  size_t live_bytes;      /* bytes allocated after last sweep */
+  size_t freed_bytes;     /* bytes freed by last sweep */
+  size_t mark_overflows;  /* objects not pushed due to full mark stack */
+  size_t steps;           /* number of gc_step calls */
+  size_t allocated_bytes; /* bytes allocated since last collection */
+  /* Heap sizing, see FAL_GC_DEF_ARENA_ALLOC. */
+  size_t trigger_bytes;   /* allocated_bytes which trigger collection */
+  size_t heap_ratio;      /* current target heap to live percent */
+  size_t triggered;       /* collections run by allocation */
+  size_t arenas_grown;    /* arenas added by allocation */
+  size_t arenas_released; /* empty arenas freed after collections */
+  uint64_t gc_ns;         /* time of triggered collections */
+};
+
+struct FAL_GC__TUNING_T {
+  size_t heap_ratio;
+  size_t min_arenas;
+  size_t max_arenas;
+  size_t cpu_budget;
+};
+
+struct FAL_GC__T {
+  FAL_GC__TRACE_FN trace;
+  FAL_GC__ARENA_T* arenas;
+  FAL_GC__ARENA_T* current; /* arena gc_alloc allocates from */
+  FAL_GC__ROOT_T* roots;
+  FAL_GC__TYPE_T* types;
+  FAL_GC__STATS_T stats;
+  FAL_GC__TUNING_T tuning;
+#ifdef FAL_GC_DEF_CLOCK
+  uint64_t pace_start;      /* start of last triggered collection */
+  uint64_t pace_ns;         /* its duration */
+#endif
+
+  int phase;
+  size_t cycle;             /* number of started cycles */
+  size_t marked;            /* last cycle with finished marking */
+  FAL_GC__ARENA_T* sweep;   /* next arena to sweep */
+  volatile size_t sweep_live; /* bytes left allocated by sweeps of cycle */
+  size_t marked_bytes;      /* allocated_bytes when marking finished */
+  size_t late_bytes;        /* allocated after marking of last cycle */
+
+  int overflow;
+  FAL_GC__ARENA_T* rescan;  /* next arena of retracing pass */
+  void* rescan_obj;         /* next object to retrace in previous arena */
+  size_t mark_len;
+  void* mark_stack[FAL_GC_MARK_STACK];
+};
+
+/******************************************************************************/
+/*                            FORWARD DECLARATION                             */
+/******************************************************************************/
+static inline FAL_GC__HEADER_T* FAL_GC__INT(header)(FAL_GC__ARENA_T* arena);
+static inline void FAL_GC__INT(push)(FAL_GC__T* gc, void* obj);
+static inline void FAL_GC__INT(trace)(FAL_GC__T* gc, void* obj);
+static inline void FAL_GC__INT(prepare)(FAL_GC__T* gc, FAL_GC__ARENA_T* arena);
+static inline void* FAL_GC__INT(alloc_in)(FAL_GC__T* gc,
+  FAL_GC__ARENA_T* arena, size_t size);
+static inline void* FAL_GC__INT(find)(FAL_GC__T* gc, FAL_GC__TYPE_T* type,
+  size_t size);
+#ifdef FAL_GC_DEF_ARENA_ALLOC
+static inline void FAL_GC__INT(resize)(FAL_GC__T* gc);
+static inline void FAL_GC__INT(pace)(FAL_GC__T* gc);
+static inline void FAL_GC__INT(trigger)(FAL_GC__T* gc);
+static inline int FAL_GC__INT(grow)(FAL_GC__T* gc, int* collected);
+#endif
+static inline void FAL_GC__INT(start)(FAL_GC__T* gc);
+static inline size_t FAL_GC__INT(mark)(FAL_GC__T* gc, size_t budget);
+static inline int FAL_GC__INT(settle)(FAL_GC__T* gc, FAL_GC__ARENA_T* arena);
+static inline void FAL_GC__INT(enter)(FAL_GC__T* gc, FAL_GC__ARENA_T* arena);
+static inline size_t FAL_GC__INT(sweep)(FAL_GC__T* gc, size_t budget);
+static inline void FAL_GC__INT(close)(FAL_GC__T* gc);
+
+static inline void FAL_GC__PUB(init)(FAL_GC__T* gc, FAL_GC__TRACE_FN trace);
+static inline void FAL_GC__PUB(add_arena)(FAL_GC__T* gc, void* mem);
+static inline void FAL_GC__PUB(add_type)(FAL_GC__T* gc, FAL_GC__TYPE_T* type,
+  size_t size, FAL_GC__TRACE_FN trace);
+
+static inline void FAL_GC__PUB(add_root)(FAL_GC__T* gc, FAL_GC__ROOT_T* root,
+  void** slots, size_t len);
+static inline void FAL_GC__PUB(remove_root)(FAL_GC__T* gc, FAL_GC__ROOT_T* root);
+
+static inline void* FAL_GC__PUB(alloc)(FAL_GC__T* gc, size_t size);
+static inline void* FAL_GC__PUB(alloc_typed)(FAL_GC__T* gc,
+  FAL_GC__TYPE_T* type);
+
+static inline void FAL_GC__PUB(collect)(FAL_GC__T* gc);
+static inline void FAL_GC__PUB(collect_lazy)(FAL_GC__T* gc);
+static inline size_t FAL_GC__PUB(sweep_part)(FAL_GC__T* gc, size_t part,
+  size_t parts);
+static inline void FAL_GC__PUB(finish)(FAL_GC__T* gc);
+static inline int FAL_GC__PUB(step)(FAL_GC__T* gc, size_t budget);
+#ifdef FAL_GC_DEF_CLOCK
+static inline int FAL_GC__PUB(step_ns)(FAL_GC__T* gc, uint64_t budget_ns);
+#endif
+static inline int FAL_GC__PUB(collecting)(FAL_GC__T* gc);
+static inline void FAL_GC__PUB(visit)(FAL_GC__T* gc, void** slot);
+static inline void FAL_GC__PUB(write)(FAL_GC__T* gc, void** slot, void* value);
+static inline void FAL_GC__PUB(visit_ref)(FAL_GC__T* gc,
+  const FAL_GC__REF_HEAP_T* heap, FAL_GC__REF_T* slot);
+static inline void FAL_GC__PUB(write_ref)(FAL_GC__T* gc,
+  const FAL_GC__REF_HEAP_T* heap, FAL_GC__REF_T* slot, FAL_GC__REF_T value);
+
+static inline const FAL_GC__STATS_T* FAL_GC__PUB(stats)(FAL_GC__T* gc);
+static inline FAL_GC__TUNING_T* FAL_GC__PUB(tuning)(FAL_GC__T* gc);
+static inline FAL_GC__TYPE_T* FAL_GC__PUB(type_of)(void* obj);
+static inline FAL_GC__ARENA_T* FAL_GC__PUB(first_arena)(FAL_GC__T* gc);
+static inline FAL_GC__ARENA_T* FAL_GC__PUB(next_arena)(FAL_GC__ARENA_T* arena);
+
+/******************************************************************************/
+/*                                INTERNALS                                   */
+/******************************************************************************/
+static inline FAL_GC__HEADER_T* FAL_GC__INT(header)(FAL_GC__ARENA_T* arena) {
+  return (FAL_GC__HEADER_T*)FAL_GC__ARENA(header)(arena);
+}
+
+static inline void FAL_GC__INT(push)(FAL_GC__T* gc, void* obj) {
+  if (gc->mark_len < FAL_GC_MARK_STACK) {
+    gc->mark_stack[gc->mark_len++] = obj;
+    return;
+  }
+
+  /* Object is already marked, remember to rescan its arena later. */
+  FAL_GC__INT(header)(FAL_GC__ARENA(for)(obj))->overflow = 1;
+  gc->overflow = 1;
+  gc->stats.mark_overflows++;
+}
+
+/* Trace object with callback of its arena's type. */
+static inline void FAL_GC__INT(trace)(FAL_GC__T* gc, void* obj) {
+  FAL_GC__TYPE_T* type =
+    FAL_GC__INT(header)(FAL_GC__ARENA(for)(obj))->type;
+  (type ? type->trace : gc->trace)(gc, obj);
+}
+
+/* Bring arena up to date before allocating from it. */
+static inline void FAL_GC__INT(prepare)(FAL_GC__T* gc, FAL_GC__ARENA_T* arena) {
+  if (gc->phase == FAL_GC__MARKING) {
+    FAL_GC__INT(enter)(gc, arena);
+  } else {
+    FAL_GC__INT(settle)(gc, arena);
+  }
+}
+
+/* Allocate zeroed object in prepared arena after its cursor or return 0. */
+static inline void* FAL_GC__INT(alloc_in)(FAL_GC__T* gc,
+  FAL_GC__ARENA_T* arena, size_t size) {
+  FAL_GC__HEADER_T* header = FAL_GC__INT(header)(arena);
+  size_t top = FAL_GC__ARENA(bumptop)(arena);
+  void* obj = FAL_GC__ARENA(alloc_from)(arena, size, header->cursor);
+  if (!obj) {
+    return 0;
+  }
+
+  /* Bump allocation doesn't skip holes below the top. */
+  size_t end = ((char*)obj - (char*)arena
+    + size + FAL_GC__ARENA(BLOCK_SIZE) - 1) / FAL_GC__ARENA(BLOCK_SIZE);
+  if (end <= top) {
+    header->cursor = end;
+  }
+
+  /* Objects allocated during marking survive current cycle, arenas
+     are swept before allocating from them, so other objects are white. */
+  if (gc->phase == FAL_GC__MARKING) {
+    FAL_GC__ARENA(mark)(obj);
+  }
+
+  gc->stats.allocated_bytes += (size + FAL_GC__ARENA(BLOCK_SIZE) - 1)
+    & ~(size_t)(FAL_GC__ARENA(BLOCK_SIZE) - 1);
+  return memset(obj, 0, size);
+}
+
+/* Allocate object of type (0 for untyped) from arenas after its current one.
+   Arenas before current one are known to be full since last sweep.
+   Allocation in arena is next-fit, holes before its cursor are not
+   revisited until next sweep, so filling arena stays linear. Typed
+   allocation claims empty arenas on the way. Arenas of other types and
+   non-empty untyped ones can't become usable before next sweep, which
+   rewinds type->current. */
+static inline void* FAL_GC__INT(find)(FAL_GC__T* gc, FAL_GC__TYPE_T* type,
+  size_t size) {
+  FAL_GC__ARENA_T** current = type ? &type->current : &gc->current;
+  for (; *current; *current = FAL_GC__INT(header)(*current)->next) {
+    FAL_GC__HEADER_T* header = FAL_GC__INT(header)(*current);
+    FAL_GC__INT(prepare)(gc, *current);
+    if (header->type != type) {
+      if (!type || header->type || !FAL_GC__ARENA(empty)(*current)) {
+        continue;
+      }
+      header->type = type;
+    }
+
+    void* obj = FAL_GC__INT(alloc_in)(gc, *current, size);
+    if (obj) {
+      return obj;
+    }
+  }
+
+  return 0;
+}
+
+static inline void FAL_GC__INT(start)(FAL_GC__T* gc) {
+  assert(!gc->mark_len && !gc->overflow && !gc->rescan && !gc->rescan_obj);
+
+  gc->phase = FAL_GC__MARKING;
+  gc->cycle++;
+
+  for (FAL_GC__ROOT_T* root = gc->roots; root; root = root->next) {
+    for (size_t ix = 0; ix < root->len; ix++) {
+      FAL_GC__PUB(visit)(gc, &root->slots[ix]);
+    }
+  }
+
+#ifdef FAL_GC_DEF_EXTRA_ROOTS
+  FAL_GC_DEF_EXTRA_ROOTS(gc);
+#endif
+}
+
+static inline size_t FAL_GC__INT(mark)(FAL_GC__T* gc, size_t budget) {
+  size_t work = 0;
+
+  for (;;) {
+    while (gc->mark_len && work < budget) {
+      void* obj = gc->mark_stack[--gc->mark_len];
+      FAL_GC__INT(trace)(gc, obj);
+      work++;
+    }
+
+    if (gc->mark_len) {
+      return work;
+    }
+
+    if (!gc->overflow && !gc->rescan && !gc->rescan_obj) {
+      break;
+    }
+
+    if (work >= budget) {
+      return work;
+    }
+
+    /* Retrace marked objects which didn't fit into mark stack, one object or
+       arena at a time so stack is drained in between. Tracing object twice
+       is harmless since its children are already marked. */
+    if (gc->rescan_obj) {
+      void* obj = gc->rescan_obj;
+      gc->rescan_obj = FAL_GC__ARENA(next_marked)(obj);
+      FAL_GC__INT(trace)(gc, obj);
+    } else if (gc->rescan) {
+      FAL_GC__HEADER_T* header = FAL_GC__INT(header)(gc->rescan);
+      if (header->overflow) {
+        header->overflow = 0;
+        gc->rescan_obj = FAL_GC__ARENA(first_marked)(gc->rescan);
+      }
+      gc->rescan = header->next;
+    } else {
+      gc->overflow = 0;
+      gc->rescan = gc->arenas;
+    }
+    work++;
+  }
+
+  /* Allocation starts over from the first arena, sweeping arenas as it
+     reaches them. */
+  gc->phase = FAL_GC__SWEEPING;
+  gc->marked = gc->cycle;
+  gc->sweep = gc->arenas;
+  gc->sweep_live = 0;
+  gc->marked_bytes = gc->stats.allocated_bytes;
+  gc->current = gc->arenas;
+  for (FAL_GC__TYPE_T* type = gc->types; type; type = type->next) {
+    type->current = gc->arenas;
+  }
+
+  return work;
+}
+
+/* Free garbage of the last marked cycle in arena unless it's already done,
+   returns 1 if arena was swept. Safe to run concurrently for different
+   arenas. */
+static inline int FAL_GC__INT(settle)(FAL_GC__T* gc, FAL_GC__ARENA_T* arena) {
+  FAL_GC__HEADER_T* header = FAL_GC__INT(header)(arena);
+  if (header->swept >= gc->marked) {
+    return 0;
+  }
+
+  /* Nothing was marked in arena during that cycle, marks of older one
+     don't matter. */
+  size_t live = 0;
+  if (header->epoch != gc->marked) {
+    FAL_GC__ARENA(init)(arena);
+  } else {
+    live = FAL_GC__ARENA(sweep)(arena) * FAL_GC__ARENA(BLOCK_SIZE);
+    fal_atomic_add(&gc->sweep_live, live);
+  }
+
+  /* Empty arena can be dedicated to any type again. */
+  if (!live) {
+    header->type = 0;
+  }
+
+  header->swept = gc->marked;
+  header->cursor = FAL_GC__ARENA(BEGIN);
+  return 1;
+}
+
+/* Make mark bits of arena belong to current cycle before marking in it. */
+static inline void FAL_GC__INT(enter)(FAL_GC__T* gc, FAL_GC__ARENA_T* arena) {
+  FAL_GC__HEADER_T* header = FAL_GC__INT(header)(arena);
+  if (header->epoch != gc->cycle) {
+    FAL_GC__INT(settle)(gc, arena);
+    header->epoch = gc->cycle;
+  }
+}
+
+static inline size_t FAL_GC__INT(sweep)(FAL_GC__T* gc, size_t budget) {
+  size_t work = 0;
+
+  while (gc->sweep && work < budget) {
+    FAL_GC__ARENA_T* arena = gc->sweep;
+    gc->sweep = FAL_GC__INT(header)(arena)->next;
+
+    /* Arena may be already swept by gc_alloc or gc_sweep_part. */
+    work += FAL_GC__INT(settle)(gc, arena) ? FAL_GC__SWEEP_COST : 1;
+  }
+
+  if (!gc->sweep) {
+    FAL_GC__INT(close)(gc);
+  }
+
+  return work;
+}
+
+/* End cycle, arenas not swept yet are left for gc_alloc and marker.
+   Sweeps saw everything allocated before marking finished, later objects
+   are in swept arenas and are left for the next cycle. */
+static inline void FAL_GC__INT(close)(FAL_GC__T* gc) {
+  /* Arenas left unswept by lazy collection hold what was marked there. */
+  for (FAL_GC__ARENA_T* arena = gc->sweep; arena;
+    arena = FAL_GC__INT(header)(arena)->next) {
+    FAL_GC__HEADER_T* header = FAL_GC__INT(header)(arena);
+    if (header->swept >= gc->marked || header->epoch != gc->marked) {
+      continue;
+    }
+
+    for (void* obj = FAL_GC__ARENA(first_marked)(arena); obj;
+      obj = FAL_GC__ARENA(next_marked)(obj)) {
+      gc->sweep_live += FAL_GC__ARENA(size)(obj);
+    }
+  }
+
+  size_t before = gc->stats.live_bytes + gc->late_bytes + gc->marked_bytes;
+  gc->stats.freed_bytes = before > gc->sweep_live
+    ? before - gc->sweep_live : 0;
+  gc->stats.live_bytes = gc->sweep_live;
+  gc->late_bytes = gc->stats.allocated_bytes - gc->marked_bytes;
+  gc->stats.allocated_bytes = 0;
+  gc->stats.collections++;
+  gc->phase = FAL_GC__IDLE;
+  gc->sweep = 0;
+#ifdef FAL_GC_DEF_ARENA_ALLOC
+  FAL_GC__INT(resize)(gc);
+#endif
+}
+
+#ifdef FAL_GC_DEF_ARENA_ALLOC
+/* Set allocation budget from live bytes and release empty arenas above
+   target. Lazily collected arenas may be not swept yet, those are kept. */
+static inline void FAL_GC__INT(resize)(FAL_GC__T* gc) {
+  FAL_GC__TUNING_T* tuning = &gc->tuning;
+  assert(tuning->heap_ratio > 100
+    && "[" FAL_STR(FAL_GC__PUB(tuning)) "] heap_ratio must be more than 100");
+
+#ifdef FAL_GC_DEF_CLOCK
+  if (gc->stats.heap_ratio < tuning->heap_ratio) {
+    gc->stats.heap_ratio = tuning->heap_ratio;
+  }
+#else
+  gc->stats.heap_ratio = tuning->heap_ratio;
+#endif
+
+  size_t live = gc->stats.live_bytes;
+  size_t ratio = gc->stats.heap_ratio;
+  size_t target = live / 100 * ratio + live % 100 * ratio / 100;
+  size_t min = tuning->min_arenas * FAL_GC__ARENA(EFFECTIVE_SIZE);
+  if (target < min) {
+    target = min;
+  }
+  gc->stats.trigger_bytes = target - live;
+
+  size_t target_arenas = (target + FAL_GC__ARENA(EFFECTIVE_SIZE) - 1)
+    / FAL_GC__ARENA(EFFECTIVE_SIZE);
+  if (target_arenas < tuning->min_arenas) {
+    target_arenas = tuning->min_arenas;
+  }
+
+  int released = 0;
+  for (FAL_GC__ARENA_T** it = &gc->arenas;
+    *it && gc->stats.arenas > target_arenas; ) {
+    FAL_GC__ARENA_T* arena = *it;
+    FAL_GC__HEADER_T* header = FAL_GC__INT(header)(arena);
+    if (header->swept < gc->marked || !FAL_GC__ARENA(empty)(arena)) {
+      it = &header->next;
+      continue;
+    }
+
+    *it = header->next;
+    FAL_GC_DEF_ARENA_FREE(arena);
+    gc->stats.arenas--;
+    gc->stats.arenas_released++;
+    released = 1;
+  }
+
+  if (released) {
+    gc->current = gc->arenas;
+    for (FAL_GC__TYPE_T* type = gc->types; type; type = type->next) {
+      type->current = gc->arenas;
+    }
+  }
+}
+
+/* Collect if allocation budget is spent. */
+static inline void FAL_GC__INT(pace)(FAL_GC__T* gc) {
+  if (gc->stats.allocated_bytes >= gc->stats.trigger_bytes
+    && gc->phase != FAL_GC__MARKING) {
+    FAL_GC__INT(trigger)(gc);
+  }
+}
+
+/* Collect on behalf of allocation. */
+static inline void FAL_GC__INT(trigger)(FAL_GC__T* gc) {
+#ifdef FAL_GC_DEF_CLOCK
+  /* Adjust ratio by share of time previous collection took. */
+  uint64_t start = (uint64_t)(FAL_GC_DEF_CLOCK());
+  uint64_t period = start - gc->pace_start;
+  size_t excess = gc->stats.heap_ratio - 100;
+  size_t base = gc->tuning.heap_ratio - 100;
+  if (gc->stats.triggered && period) {
+    if (gc->pace_ns * 100 > period * gc->tuning.cpu_budget) {
+      excess = excess * 2 > base * 64 ? base * 64 : excess * 2;
+    } else if (gc->pace_ns * 200 < period * gc->tuning.cpu_budget) {
+      excess = excess / 2 < base ? base : excess / 2;
+    }
+  }
+  gc->stats.heap_ratio = 100 + (excess < base ? base : excess);
+  gc->pace_start = start;
+#endif
+
+  gc->stats.triggered++;
+  FAL_GC__PUB(collect)(gc);
+
+#ifdef FAL_GC_DEF_CLOCK
+  gc->pace_ns = (uint64_t)(FAL_GC_DEF_CLOCK()) - start;
+  gc->stats.gc_ns += gc->pace_ns;
+#endif
+}
+
+/* Make room after failed allocation: add arena or, if heap can't grow,
+   collect once per allocation. Returns 0 if neither is possible. */
+static inline int FAL_GC__INT(grow)(FAL_GC__T* gc, int* collected) {
+  if (!gc->tuning.max_arenas || gc->stats.arenas < gc->tuning.max_arenas) {
+    void* mem = FAL_GC_DEF_ARENA_ALLOC();
+    if (mem) {
+      FAL_GC__PUB(add_arena)(gc, mem);
+      gc->stats.arenas_grown++;
+      return 1;
+    }
+  }
+
+  if (*collected || gc->phase == FAL_GC__MARKING) {
+    return 0;
+  }
+
+  *collected = 1;
+  FAL_GC__INT(trigger)(gc);
+  return 1;
+}
+#endif
+
+/******************************************************************************/
+/*                              INITIALIZATION                                */
+/******************************************************************************/
+static inline void FAL_GC__PUB(init)(FAL_GC__T* gc, FAL_GC__TRACE_FN trace) {
+  gc->trace = trace;
+  gc->arenas = 0;
+  gc->current = 0;
+  gc->roots = 0;
+  gc->types = 0;
+  memset(&gc->stats, 0, sizeof(gc->stats));
+  gc->tuning.heap_ratio = 200;
+  gc->tuning.min_arenas = 1;
+  gc->tuning.max_arenas = 0;
+  gc->tuning.cpu_budget = 10;
+  gc->stats.heap_ratio = gc->tuning.heap_ratio;
+  gc->stats.trigger_bytes = FAL_GC__ARENA(EFFECTIVE_SIZE);
+#ifdef FAL_GC_DEF_CLOCK
+  gc->pace_start = 0;
+  gc->pace_ns = 0;
+#endif
+  gc->phase = FAL_GC__IDLE;
+  gc->cycle = 0;
+  gc->marked = 0;
+  gc->sweep = 0;
+  gc->sweep_live = 0;
+  gc->marked_bytes = 0;
+  gc->late_bytes = 0;
+  gc->overflow = 0;
+  gc->rescan = 0;
+  gc->rescan_obj = 0;
+  gc->mark_len = 0;
+}
+
+static inline void FAL_GC__PUB(add_arena)(FAL_GC__T* gc, void* mem) {
+  FAL_GC__ARENA_T* arena = (FAL_GC__ARENA_T*)mem;
+  FAL_GC__ARENA(init)(arena);
+
+  FAL_GC__HEADER_T* header = FAL_GC__INT(header)(arena);
+  header->next = gc->arenas;
+  header->type = 0;
+  header->overflow = 0;
+  header->epoch = gc->cycle;
+  /* Nothing to sweep in empty arena, unless marking is under way and
+     objects allocated black into it must be swept after it. */
+  header->swept = gc->phase == FAL_GC__MARKING ? gc->marked : gc->cycle;
+  header->cursor = FAL_GC__ARENA(BEGIN);
+
+  gc->arenas = arena;
+  gc->current = arena;
+  for (FAL_GC__TYPE_T* type = gc->types; type; type = type->next) {
+    type->current = arena;
+  }
+  gc->stats.arenas++;
+}
+
+static inline void FAL_GC__PUB(add_type)(FAL_GC__T* gc, FAL_GC__TYPE_T* type,
+  size_t size, FAL_GC__TRACE_FN trace) {
+  assert(size && "[" FAL_STR(FAL_GC__PUB(add_type)) "] size cannot be zero");
+
+  type->trace = trace;
+  type->size = size;
+  type->current = gc->arenas;
+  type->next = gc->types;
+  gc->types = type;
+}
+
+/******************************************************************************/
+/*                                   ROOTS                                    */
+/******************************************************************************/
+static inline void FAL_GC__PUB(add_root)(FAL_GC__T* gc, FAL_GC__ROOT_T* root,
+  void** slots, size_t len) {
+  root->slots = slots;
+  root->len = len;
+  root->next = gc->roots;
+  gc->roots = root;
+}
+
+static inline void FAL_GC__PUB(remove_root)(FAL_GC__T* gc, FAL_GC__ROOT_T* root) {
+  for (FAL_GC__ROOT_T** it = &gc->roots; *it; it = &(*it)->next) {
+    if (*it == root) {
+      *it = root->next;
+      return;
+    }
+  }
+
+  assert(0 && "[" FAL_STR(FAL_GC__PUB(remove_root)) "] root is not registered");
+}
+
+/******************************************************************************/
+/*                                ALLOCATING                                  */
+/******************************************************************************/
+static inline void* FAL_GC__PUB(alloc)(FAL_GC__T* gc, size_t size) {
+  assert(size && "[" FAL_STR(FAL_GC__PUB(alloc)) "] size cannot be zero");
+  assert(gc->trace && "[" FAL_STR(FAL_GC__PUB(alloc)) "] no trace for "
+    "untyped objects, see gc_init");
+
+#ifdef FAL_GC_DEF_ARENA_ALLOC
+  if (size > FAL_GC__ARENA(EFFECTIVE_SIZE)) {
+    return 0;
+  }
+
+  FAL_GC__INT(pace)(gc);
+  int collected = 0;
+  void* obj = FAL_GC__INT(find)(gc, 0, size);
+  while (!obj && FAL_GC__INT(grow)(gc, &collected)) {
+    obj = FAL_GC__INT(find)(gc, 0, size);
+  }
+  return obj;
+#else
+  return FAL_GC__INT(find)(gc, 0, size);
+#endif
+}
+
+static inline void* FAL_GC__PUB(alloc_typed)(FAL_GC__T* gc,
+  FAL_GC__TYPE_T* type) {
+#ifdef FAL_GC_DEF_ARENA_ALLOC
+  if (type->size > FAL_GC__ARENA(EFFECTIVE_SIZE)) {
+    return 0;
+  }
+
+  FAL_GC__INT(pace)(gc);
+  int collected = 0;
+  void* obj = FAL_GC__INT(find)(gc, type, type->size);
+  while (!obj && FAL_GC__INT(grow)(gc, &collected)) {
+    obj = FAL_GC__INT(find)(gc, type, type->size);
+  }
+  return obj;
+#else
+  return FAL_GC__INT(find)(gc, type, type->size);
+#endif
+}
+
+/******************************************************************************/
+/*                                COLLECTING                                  */
+/******************************************************************************/
+static inline void FAL_GC__PUB(visit)(FAL_GC__T* gc, void** slot) {
+  void* obj = *slot;
+  if (!obj) {
+    return;
+  }
+
+  /* Marks of arena may be left from previous cycle. */
+  FAL_GC__INT(enter)(gc, FAL_GC__ARENA(for)(obj));
+  if (FAL_GC__ARENA(marked)(obj)) {
+    return;
+  }
+
+  FAL_GC__ARENA(mark)(obj);
+  FAL_GC__TYPE_T* type = FAL_GC__INT(header)(FAL_GC__ARENA(for)(obj))->type;
+  if (!type || type->trace) {
+    FAL_GC__INT(push)(gc, obj);
+  }
+}
+
+static inline void FAL_GC__PUB(write)(FAL_GC__T* gc, void** slot, void* value) {
+  if (gc->phase == FAL_GC__MARKING) {
+    FAL_GC__PUB(visit)(gc, slot);
+  }
+
+  *slot = value;
+}
+
+static inline void FAL_GC__PUB(visit_ref)(FAL_GC__T* gc,
+  const FAL_GC__REF_HEAP_T* heap, FAL_GC__REF_T* slot) {
+  void* obj = FAL_GC__REF(decompress)(heap, *slot);
+  FAL_GC__PUB(visit)(gc, &obj); /* non-moving, slot stays valid */
+}
+
+static inline void FAL_GC__PUB(write_ref)(FAL_GC__T* gc,
+  const FAL_GC__REF_HEAP_T* heap, FAL_GC__REF_T* slot, FAL_GC__REF_T value) {
+  if (gc->phase == FAL_GC__MARKING) {
+    FAL_GC__PUB(visit_ref)(gc, heap, slot);
+  }
+
+  *slot = value;
+}
+
+static inline int FAL_GC__PUB(step)(FAL_GC__T* gc, size_t budget) {
+  size_t work = 0;
+  if (gc->phase == FAL_GC__IDLE) {
+    FAL_GC__INT(start)(gc);
+  }
+
+  if (gc->phase == FAL_GC__MARKING) {
+    work += FAL_GC__INT(mark)(gc, budget);
+  }
+
+  if (gc->phase == FAL_GC__SWEEPING && work < budget) {
+    work += FAL_GC__INT(sweep)(gc, budget - work);
+  }
+
+  gc->stats.steps++;
+
+  return gc->phase != FAL_GC__IDLE;
+}
+
+#ifdef FAL_GC_DEF_CLOCK
+static inline int FAL_GC__PUB(step_ns)(FAL_GC__T* gc, uint64_t budget_ns) {
+  uint64_t deadline = (uint64_t)(FAL_GC_DEF_CLOCK()) + budget_ns;
+
+  do {
+    if (!FAL_GC__PUB(step)(gc, FAL_GC_DEF_STEP_SLICE)) {
+      return 0;
+    }
+  } while ((uint64_t)(FAL_GC_DEF_CLOCK()) < deadline);
+
+  return 1;
+}
+#endif
+
+static inline int FAL_GC__PUB(collecting)(FAL_GC__T* gc) {
+  return gc->phase != FAL_GC__IDLE;
+}
+
+static inline void FAL_GC__PUB(collect)(FAL_GC__T* gc) {
+  FAL_GC__PUB(finish)(gc);
+  FAL_GC__PUB(step)(gc, SIZE_MAX);
+}
+
+static inline void FAL_GC__PUB(collect_lazy)(FAL_GC__T* gc) {
+  if (gc->phase == FAL_GC__MARKING) {
+    FAL_GC__INT(mark)(gc, SIZE_MAX);
+  }
+  if (gc->phase == FAL_GC__SWEEPING) {
+    FAL_GC__INT(close)(gc);
+  }
+
+  FAL_GC__INT(start)(gc);
+  FAL_GC__INT(mark)(gc, SIZE_MAX);
+}
+
+static inline size_t FAL_GC__PUB(sweep_part)(FAL_GC__T* gc, size_t part,
+  size_t parts) {
+  assert(part < parts
+    && "[" FAL_STR(FAL_GC__PUB(sweep_part)) "] part must be less than parts");
+
+  if (gc->phase != FAL_GC__SWEEPING) {
+    return 0;
+  }
+
+  /* Every part touches only headers of its own arenas, next pointers are
+     never written during sweeping. */
+  size_t swept = 0;
+  size_t ix = 0;
+  for (FAL_GC__ARENA_T* arena = gc->sweep; arena;
+    arena = FAL_GC__INT(header)(arena)->next, ix++) {
+    if (ix % parts == part) {
+      swept += FAL_GC__INT(settle)(gc, arena);
+    }
+  }
+
+  return swept;
+}
+
+static inline void FAL_GC__PUB(finish)(FAL_GC__T* gc) {
+  if (gc->phase != FAL_GC__IDLE) {
+    FAL_GC__PUB(step)(gc, SIZE_MAX);
+  }
+}
+
+/******************************************************************************/
+/*                                  QUERYING                                  */
+/******************************************************************************/
+static inline const FAL_GC__STATS_T* FAL_GC__PUB(stats)(FAL_GC__T* gc) {
+  return &gc->stats;
+}
+
+static inline FAL_GC__TUNING_T* FAL_GC__PUB(tuning)(FAL_GC__T* gc) {
+  return &gc->tuning;
+}
+
+static inline FAL_GC__TYPE_T* FAL_GC__PUB(type_of)(void* obj) {
+  return FAL_GC__INT(header)(FAL_GC__ARENA(for)(obj))->type;
+}
+
+static inline FAL_GC__ARENA_T* FAL_GC__PUB(first_arena)(FAL_GC__T* gc) {
+  return gc->arenas;
+}
+
+static inline FAL_GC__ARENA_T* FAL_GC__PUB(next_arena)(FAL_GC__ARENA_T* arena) {
+  return FAL_GC__INT(header)(arena)->next;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef FAL_GC__PUB
+#undef FAL_GC__INT
+#undef FAL_GC__ARENA
+
+#undef FAL_GC__T
+#undef FAL_GC__ROOT_T
+#undef FAL_GC__STATS_T
+#undef FAL_GC__TRACE_FN
+#undef FAL_GC__TYPE_T
+#undef FAL_GC__TUNING_T
+#undef FAL_GC__ARENA_T
+#undef FAL_GC__REF
+#undef FAL_GC__REF_T
+#undef FAL_GC__REF_HEAP_T
+#undef FAL_GC_MARK_STACK
+#undef FAL_GC__HEADER_T
+#undef FAL_GC__IDLE
+#undef FAL_GC__MARKING
+#undef FAL_GC__SWEEPING
+#undef FAL_GC__SWEEP_COST
+
+/* Undef compile-time parameters. */
+#ifndef FAL_GC_DEF_NO_UNDEF
+#undef FAL_GC_DEF_NAME
+#undef FAL_GC_DEF_POW
+#undef FAL_GC_DEF_BLOCK_POW
+#undef FAL_GC_DEF_MARK_STACK
+#undef FAL_GC_DEF_STEP_SLICE
+
+#ifdef FAL_GC_DEF_CLOCK
+#undef FAL_GC_DEF_CLOCK
+#endif
+
+#ifdef FAL_GC_DEF_EXTRA_ROOTS
+#undef FAL_GC_DEF_EXTRA_ROOTS
+#endif
+
+#ifdef FAL_GC_DEF_INCOMPACT
+#undef FAL_GC_DEF_INCOMPACT
+#endif
+
+#ifdef FAL_GC_DEF_ARENA_ALLOC
+#undef FAL_GC_DEF_ARENA_ALLOC
+#undef FAL_GC_DEF_ARENA_FREE
+#endif
+#endif /* FAL_GC_DEF_NO_UNDEF */
@@ -0,0 +1,658 @@
+/* Copyright (c) 2016 Andrey Roenko
+ * This file is part of fal project which is released under MIT license.
+ * See file LICENSE or go to https://opensource.org/licenses/MIT for full
+ * license details.
+*/
+
+/*
+  Generational garbage collector: semispace nursery and mark&sweep old space.
+
+  Compile-time parameters:
+    (req) FAL_GENGC_DEF_NAME        - prefix for resulting types and functions
+    (req) FAL_GENGC_DEF_POW         - power of old space arena size
+                                      (i.e. 20 means 1 MiB arenas)
+    (req) FAL_GENGC_DEF_BLOCK_POW   - power of block size
+                                      (i.e. 4 means 16 byte blocks)
+    (opt) FAL_GENGC_DEF_NURSERY_POW - default: FAL_GENGC_DEF_POW; power of
+                                      size of each nursery semispace
+    (opt) FAL_GENGC_DEF_PRETENURE   - default: 1/8 of nursery; objects of this
+                                      size and bigger are allocated in old space
+    (opt) FAL_GENGC_DEF_PROMOTE_STACK - default: 4096; capacity of stack of
+                                      promoted objects waiting for tracing
+    (opt) FAL_GENGC_DEF_MARK_STACK  - passed to old space as FAL_GC_DEF_MARK_STACK
+
+    (opt) FAL_GENGC_DEF_NO_UNDEF    - do not undefined all compile-time parameters
+
+  Header instantiates fal/gc.h with gengc_old prefix for old space and
+  fal/arena.h with gengc_nursery prefix for nursery, so their functions are
+  available too, e.g. gengc_old_stats(gengc_old(gc)) or gengc_old_arena_SIZE.
+
+  Collector never maps memory itself. User gives it two semispaces of nursery
+  at gengc_init and memory for old space with gengc_add_arena.
+
+  Objects are allocated by bumping pointer in from-space of nursery. Minor
+  collection copies live nursery objects to to-space (Cheney's algorithm),
+  objects which already survived one minor collection are promoted to old
+  space instead, then semispaces are flipped. If old space has no room for
+  promoted object, it's copied to to-space too, so minor collection never
+  fails, nursery just stays fuller.
+
+  Minor collection traces only roots, nursery and old objects which may point
+  to nursery. Such objects are found with card table: each old arena is split
+  into gengc_CARDS cards of gengc_CARD_SIZE bytes, one dirty bit per card is
+  stored in user hi bytes of arena (see arena_user_hi). Mutator must store
+  pointers into heap objects via gengc_write, which dirties card of slot if
+  young object is stored. Minor collection traces all objects overlapping dirty
+  cards and cleans cards which don't point to nursery anymore.
+
+  Major collection (gengc_collect) promotes all nursery objects and runs
+  stop-the-world collection of old space, objects left in nursery are its roots.
+
+  Objects are traced by single user-supplied callback which must call
+  gengc_visit for address of every pointer field of object. Object size must
+  be at least sizeof(void*), since its first word stores forwarding address.
+
+  API:
+    gengc_ prefix is overriden by <FAL_GENGC_DEF_NAME>_.
+    Everything with __ (two underscores) in name should be considered internal.
+
+    Types:
+      gengc_t - collector state, should be used only as gengc_t*
+      gengc_old_t - old space collector, see fal/gc.h
+      gengc_nursery_t - nursery semispace arena, see fal/arena.h
+      gengc_root_t - root registration record, owned by user
+      gengc_stats_t - counters, see gengc_stats
+      void (*gengc_trace_fn)(gengc_t*, void* obj)
+        must call gengc_visit for each pointer field of obj
+
+    Initializing:
+      void gengc_init(gengc_t*, gengc_trace_fn trace, void* from, void* to)
+        initialize collector with nursery semispaces and without old arenas,
+        from and to are gengc_nursery_SIZE bytes aligned to gengc_nursery_SIZE
+      void gengc_add_arena(gengc_t*, void* mem)
+        add gengc_old_arena_SIZE bytes of memory aligned to gengc_old_arena_SIZE
+        to old space
+
+    Roots:
+      void gengc_add_root(gengc_t*, gengc_root_t*, void** slots, size_t len)
+        register len pointer slots as roots, record must stay valid until
+        gengc_remove_root
+      void gengc_remove_root(gengc_t*, gengc_root_t*)
+        unregister roots
+
+    Allocating:
+      void* gengc_alloc(gengc_t*, size_t size)
+        allocate zeroed object or return 0 if nursery is full (or old space
+        is full for objects of gengc_PRETENURE bytes and bigger), usually
+        followed by gengc_minor, gengc_collect or gengc_add_arena
+
+    Collecting:
+      void gengc_minor(gengc_t*)
+        collect nursery
+      void gengc_collect(gengc_t*)
+        collect nursery promoting everything and then collect old space
+      void gengc_visit(gengc_t*, void** slot)
+        forward or mark object *slot (if any) and schedule it for tracing,
+        must be called only from trace callback
+      void gengc_write(gengc_t*, void** slot, void* value)
+        store value into pointer field of heap object with write barrier
+
+    Querying:
+      const gengc_stats_t* gengc_stats(gengc_t*)
+        get counters
+      gengc_old_t* gengc_old(gengc_t*)
+        get old space collector, e.g. for its stats and arenas
+      int gengc_young(gengc_t*, void* ptr)
+        check if ptr points to nursery object
+
+    Constants:
+      gengc_CARDS         - number of cards per old arena
+      gengc_CARD_SIZE     - card size in bytes
+      gengc_PRETENURE     - size of objects allocated in old space directly
+      gengc_PROMOTE_STACK - capacity of stack of promoted objects
+*/
+
+#ifndef __FAL_GENGC_H__
+#define __FAL_GENGC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+
+#include "utils.h"
+#include "bitset.h"
+
+#endif /* __FAL_GENGC_H__ */
+
+#if !defined(FAL_GENGC_DEF_POW) \
+  || !defined(FAL_GENGC_DEF_BLOCK_POW) \
+  || !defined(FAL_GENGC_DEF_NAME)
+#error FAL_GENGC: compile-time parameters \
+  FAL_GENGC_DEF_POW, FAL_GENGC_DEF_BLOCK_POW and FAL_GENGC_DEF_NAME \
+  must be defined.
+#endif
+
+#ifndef FAL_GENGC_DEF_NURSERY_POW
+#define FAL_GENGC_DEF_NURSERY_POW FAL_GENGC_DEF_POW
+#endif
+
+#ifndef FAL_GENGC_DEF_PROMOTE_STACK
+#define FAL_GENGC_DEF_PROMOTE_STACK 4096
+#endif
+
+/* Public and internal functions helpers. */
+#define FAL_GENGC__PUB(X)     FAL_CONCAT(FAL_GENGC_DEF_NAME, FAL_CONCAT(_, X))
+#define FAL_GENGC__INT(X)     FAL_CONCAT(FAL_GENGC_DEF_NAME, FAL_CONCAT(__, X))
+#define FAL_GENGC__OLD(X)     FAL_CONCAT(FAL_GENGC_DEF_NAME, FAL_CONCAT(_old_, X))
+#define FAL_GENGC__OLD_ARENA(X) \
+  FAL_CONCAT(FAL_GENGC_DEF_NAME, FAL_CONCAT(_old_arena_, X))
+#define FAL_GENGC__NURSERY(X) \
+  FAL_CONCAT(FAL_GENGC_DEF_NAME, FAL_CONCAT(_nursery_, X))
+
+/* Public */
+#define FAL_GENGC__T              FAL_GENGC__PUB(t)
+#define FAL_GENGC__ROOT_T         FAL_GENGC__PUB(root_t)
+#define FAL_GENGC__STATS_T        FAL_GENGC__PUB(stats_t)
+#define FAL_GENGC__TRACE_FN       FAL_GENGC__PUB(trace_fn)
+#define FAL_GENGC__OLD_T          FAL_GENGC__OLD(t)
+#define FAL_GENGC__OLD_ARENA_T    FAL_GENGC__OLD_ARENA(t)
+#define FAL_GENGC__NURSERY_T      FAL_GENGC__NURSERY(t)
+#define FAL_GENGC_CARDS           FAL_GENGC__PUB(CARDS)
+#define FAL_GENGC_CARD_SIZE       FAL_GENGC__PUB(CARD_SIZE)
+#define FAL_GENGC_PRETENURE       FAL_GENGC__PUB(PRETENURE)
+#define FAL_GENGC_PROMOTE_STACK   FAL_GENGC__PUB(PROMOTE_STACK)
+/* Internal */
+#define FAL_GENGC__IDLE           FAL_GENGC__INT(IDLE)
+#define FAL_GENGC__MINOR          FAL_GENGC__INT(MINOR)
+#define FAL_GENGC__MAJOR          FAL_GENGC__INT(MAJOR)
+
+/* Old space calls back into generational collector, which isn't defined yet. */
+struct FAL_GENGC__OLD_T;
+static inline void FAL_GENGC__INT(old_trace)(struct FAL_GENGC__OLD_T* old,
+  void* obj);
+static inline void FAL_GENGC__INT(old_roots)(struct FAL_GENGC__OLD_T* old);
+
+#define FAL_GC_DEF_NAME         FAL_CONCAT(FAL_GENGC_DEF_NAME, _old)
+#define FAL_GC_DEF_POW          FAL_GENGC_DEF_POW
+#define FAL_GC_DEF_BLOCK_POW    FAL_GENGC_DEF_BLOCK_POW
+#define FAL_GC_DEF_EXTRA_ROOTS(Gc) FAL_GENGC__INT(old_roots)(Gc)
+#ifdef FAL_GENGC_DEF_MARK_STACK
+#define FAL_GC_DEF_MARK_STACK   FAL_GENGC_DEF_MARK_STACK
+#endif
+#include "gc.h"
+
+#define FAL_ARENA_DEF_NAME      FAL_CONCAT(FAL_GENGC_DEF_NAME, _nursery)
+#define FAL_ARENA_DEF_POW       FAL_GENGC_DEF_NURSERY_POW
+#define FAL_ARENA_DEF_BLOCK_POW FAL_GENGC_DEF_BLOCK_POW
+#include "arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct FAL_GENGC__T FAL_GENGC__T;
+typedef struct FAL_GENGC__ROOT_T FAL_GENGC__ROOT_T;
+typedef struct FAL_GENGC__STATS_T FAL_GENGC__STATS_T;
+typedef void (*FAL_GENGC__TRACE_FN)(FAL_GENGC__T* gc, void* obj);
+
+enum FAL_GENGC__INT(defs) {
+  FAL_GENGC_CARDS = FAL_GENGC__OLD_ARENA(USER_HI_BYTES) * CHAR_BIT,
+  FAL_GENGC_CARD_SIZE = (FAL_GENGC__OLD_ARENA(SIZE) + FAL_GENGC_CARDS - 1)
+    / FAL_GENGC_CARDS,
+#ifdef FAL_GENGC_DEF_PRETENURE
+  FAL_GENGC_PRETENURE = FAL_GENGC_DEF_PRETENURE,
+#else
+  FAL_GENGC_PRETENURE = FAL_GENGC__NURSERY(EFFECTIVE_SIZE) / 8,
+#endif
+  FAL_GENGC_PROMOTE_STACK = FAL_GENGC_DEF_PROMOTE_STACK
+};
+
+enum FAL_GENGC__INT(mode) {
+  FAL_GENGC__IDLE = 0,
+  FAL_GENGC__MINOR,
+  FAL_GENGC__MAJOR
+};
+
+struct FAL_GENGC__ROOT_T {
+  FAL_GENGC__ROOT_T* next;
+  void** slots;
+  size_t len;
+};
+
+struct FAL_GENGC__STATS_T {
+  size_t minor_collections;   /* number of minor collections */
+  size_t major_collections;   /* number of major collections */
+  size_t survived_bytes;      /* bytes copied to to-space by last minor */
+  size_t promoted_bytes;      /* bytes promoted to old space by last minor */
+  size_t promotion_failures;  /* objects not promoted by last minor */
+  size_t dirty_cards;         /* dirty cards scanned by last minor */
+};
+
+struct FAL_GENGC__T {
+  FAL_GENGC__OLD_T old;
+  FAL_GENGC__TRACE_FN trace;
+  FAL_GENGC__ROOT_T* roots;
+  FAL_GENGC__NURSERY_T* from;   /* semispace objects are allocated in */
+  FAL_GENGC__NURSERY_T* to;
+  char* aged;                   /* end of survivors of last minor in from */
+  char* scan;                   /* next to-space object to trace */
+  FAL_GENGC__STATS_T stats;
+
+  int mode;
+  int promote_all;
+  int young_seen;               /* traced object points to nursery */
+  int rescan;                   /* promoted objects didn't fit into stack */
+  size_t promote_len;
+  void* promote_stack[FAL_GENGC_PROMOTE_STACK];
+};
+
+/******************************************************************************/
+/*                            FORWARD DECLARATION                             */
+/******************************************************************************/
+static inline FAL_GENGC__T* FAL_GENGC__INT(of)(FAL_GENGC__OLD_T* old);
+static inline char* FAL_GENGC__INT(to_top)(FAL_GENGC__T* gc);
+static inline void FAL_GENGC__INT(dirty)(void* ptr);
+static inline void* FAL_GENGC__INT(copy)(FAL_GENGC__T* gc, void* obj);
+static inline void FAL_GENGC__INT(scan_cards)(FAL_GENGC__T* gc,
+  FAL_GENGC__OLD_ARENA_T* arena);
+static inline void FAL_GENGC__INT(drain)(FAL_GENGC__T* gc);
+static inline void FAL_GENGC__INT(evacuate)(FAL_GENGC__T* gc, int promote_all);
+
+static inline void FAL_GENGC__PUB(init)(FAL_GENGC__T* gc,
+  FAL_GENGC__TRACE_FN trace, void* from, void* to);
+static inline void FAL_GENGC__PUB(add_arena)(FAL_GENGC__T* gc, void* mem);
+
+static inline void FAL_GENGC__PUB(add_root)(FAL_GENGC__T* gc,
+  FAL_GENGC__ROOT_T* root, void** slots, size_t len);
+static inline void FAL_GENGC__PUB(remove_root)(FAL_GENGC__T* gc,
+  FAL_GENGC__ROOT_T* root);
+
+static inline void* FAL_GENGC__PUB(alloc)(FAL_GENGC__T* gc, size_t size);
+
+static inline void FAL_GENGC__PUB(minor)(FAL_GENGC__T* gc);
+static inline void FAL_GENGC__PUB(collect)(FAL_GENGC__T* gc);
+static inline void FAL_GENGC__PUB(visit)(FAL_GENGC__T* gc, void** slot);
+static inline void FAL_GENGC__PUB(write)(FAL_GENGC__T* gc, void** slot,
+  void* value);
+
+static inline const FAL_GENGC__STATS_T* FAL_GENGC__PUB(stats)(FAL_GENGC__T* gc);
+static inline FAL_GENGC__OLD_T* FAL_GENGC__PUB(old)(FAL_GENGC__T* gc);
+static inline int FAL_GENGC__PUB(young)(FAL_GENGC__T* gc, void* ptr);
+
+/******************************************************************************/
+/*                                INTERNALS                                   */
+/******************************************************************************/
+static inline FAL_GENGC__T* FAL_GENGC__INT(of)(FAL_GENGC__OLD_T* old) {
+  return (FAL_GENGC__T*)(void*)((char*)old - offsetof(FAL_GENGC__T, old));
+}
+
+static inline void FAL_GENGC__INT(old_trace)(struct FAL_GENGC__OLD_T* old,
+  void* obj) {
+  FAL_GENGC__T* gc = FAL_GENGC__INT(of)(old);
+  gc->trace(gc, obj);
+}
+
+/* Roots are kept by generational collector, so old space never sees young
+   objects, objects left in nursery are roots of old space too. */
+static inline void FAL_GENGC__INT(old_roots)(struct FAL_GENGC__OLD_T* old) {
+  FAL_GENGC__T* gc = FAL_GENGC__INT(of)(old);
+  assert(gc->mode == FAL_GENGC__MAJOR);
+
+  for (FAL_GENGC__ROOT_T* root = gc->roots; root; root = root->next) {
+    for (size_t ix = 0; ix < root->len; ix++) {
+      FAL_GENGC__PUB(visit)(gc, &root->slots[ix]);
+    }
+  }
+
+  for (void* obj = FAL_GENGC__NURSERY(first)(gc->from); obj;
+    obj = FAL_GENGC__NURSERY(next)(obj)) {
+    gc->trace(gc, obj);
+  }
+}
+
+static inline char* FAL_GENGC__INT(to_top)(FAL_GENGC__T* gc) {
+  return (char*)gc->to
+    + FAL_GENGC__NURSERY(bumptop)(gc->to) * FAL_GENGC__NURSERY(BLOCK_SIZE);
+}
+
+static inline void FAL_GENGC__INT(dirty)(void* ptr) {
+  size_t card = ((uintptr_t)ptr & (FAL_GENGC__OLD_ARENA(SIZE) - 1))
+    / FAL_GENGC_CARD_SIZE;
+  fal_bitset_set(FAL_GENGC__OLD_ARENA(user_hi)(FAL_GENGC__OLD_ARENA(for)(ptr)),
+    card);
+}
+
+static inline void* FAL_GENGC__INT(copy)(FAL_GENGC__T* gc, void* obj) {
+  size_t size = FAL_GENGC__NURSERY(size)(obj);
+  void* copy = 0;
+
+  if (gc->promote_all || (char*)obj < gc->aged) {
+    copy = FAL_GENGC__OLD(alloc)(&gc->old, size);
+    if (copy) {
+      gc->stats.promoted_bytes += size;
+      if (gc->promote_len < FAL_GENGC_PROMOTE_STACK) {
+        gc->promote_stack[gc->promote_len++] = copy;
+      } else {
+        /* Object will be traced by card scanning. */
+        FAL_GENGC__INT(dirty)(copy);
+        gc->rescan = 1;
+      }
+    } else {
+      gc->stats.promotion_failures++;
+    }
+  }
+
+  if (!copy) {
+    /* To-space is as big as from-space, so it always has room. */
+    copy = FAL_GENGC__NURSERY(bumpalloc)(gc->to, size);
+    assert(copy);
+    gc->stats.survived_bytes += size;
+  }
+
+  memcpy(copy, obj, size);
+
+  /* Leave forwarding address in from-space, marked objects are forwarded. */
+  *(void**)obj = copy;
+  FAL_GENGC__NURSERY(mark)(obj);
+
+  return copy;
+}
+
+static inline void FAL_GENGC__INT(scan_cards)(FAL_GENGC__T* gc,
+  FAL_GENGC__OLD_ARENA_T* arena) {
+  unsigned char* cards = (unsigned char*)FAL_GENGC__OLD_ARENA(user_hi)(arena);
+  char* start = (char*)FAL_GENGC__OLD_ARENA(mem_start)(arena);
+
+  for (size_t byte = 0; byte < FAL_GENGC_CARDS / CHAR_BIT; byte++) {
+    for (size_t bit = 0; cards[byte] >> bit; bit++) {
+      if (!((cards[byte] >> bit) & 1)) {
+        continue;
+      }
+
+      /* Promotions bump-allocate past top while cards are traced. */
+      char* top = (char*)arena + FAL_GENGC__OLD_ARENA(bumptop)(arena)
+        * FAL_GENGC__OLD_ARENA(BLOCK_SIZE);
+      size_t card = byte * CHAR_BIT + bit;
+      char* lo = (char*)arena + card * FAL_GENGC_CARD_SIZE;
+      char* hi = lo + FAL_GENGC_CARD_SIZE;
+      lo = lo < start ? start : lo;
+      hi = hi > top ? top : hi;
+
+      /* Card is cleaned before tracing, so promotion which overflowed stack
+         into this card dirties it again. */
+      gc->stats.dirty_cards++;
+      gc->young_seen = 0;
+      fal_bitset_clear(cards, card);
+
+      /* Trace every object overlapping card, including one started before. */
+      void* obj = lo < hi ? FAL_GENGC__OLD_ARENA(owner)(lo) : 0;
+      obj = obj ? obj : lo;
+      for (; obj && (char*)obj < hi; obj = FAL_GENGC__OLD_ARENA(next_noskip)(obj)) {
+        if (FAL_GENGC__OLD_ARENA(used)(obj)) {
+          gc->trace(gc, obj);
+        }
+      }
+
+      if (gc->young_seen) {
+        fal_bitset_set(cards, card);
+      }
+    }
+  }
+}
+
+static inline void FAL_GENGC__INT(drain)(FAL_GENGC__T* gc) {
+  for (;;) {
+    if (gc->promote_len) {
+      void* obj = gc->promote_stack[--gc->promote_len];
+      gc->young_seen = 0;
+      gc->trace(gc, obj);
+      if (gc->young_seen) {
+        FAL_GENGC__INT(dirty)(obj);
+      }
+    } else if (gc->scan < FAL_GENGC__INT(to_top)(gc)) {
+      void* obj = gc->scan;
+      gc->scan += FAL_GENGC__NURSERY(size)(obj);
+      gc->trace(gc, obj);
+    } else {
+      return;
+    }
+  }
+}
+
+static inline void FAL_GENGC__INT(evacuate)(FAL_GENGC__T* gc, int promote_all) {
+  gc->mode = FAL_GENGC__MINOR;
+  gc->promote_all = promote_all;
+  gc->stats.survived_bytes = 0;
+  gc->stats.promoted_bytes = 0;
+  gc->stats.promotion_failures = 0;
+  gc->stats.dirty_cards = 0;
+
+  FAL_GENGC__NURSERY(init)(gc->to);
+  gc->scan = (char*)FAL_GENGC__NURSERY(mem_start)(gc->to);
+
+  for (FAL_GENGC__ROOT_T* root = gc->roots; root; root = root->next) {
+    for (size_t ix = 0; ix < root->len; ix++) {
+      FAL_GENGC__PUB(visit)(gc, &root->slots[ix]);
+    }
+  }
+
+  /* Card scanning is repeated only if promote stack overflowed. */
+  gc->rescan = 1;
+  while (gc->rescan) {
+    gc->rescan = 0;
+    for (FAL_GENGC__OLD_ARENA_T* arena = FAL_GENGC__OLD(first_arena)(&gc->old);
+      arena; arena = FAL_GENGC__OLD(next_arena)(arena)) {
+      FAL_GENGC__INT(scan_cards)(gc, arena);
+      FAL_GENGC__INT(drain)(gc);
+    }
+
+    FAL_GENGC__INT(drain)(gc);
+  }
+
+  FAL_GENGC__NURSERY_T* tmp = gc->from;
+  gc->from = gc->to;
+  gc->to = tmp;
+  gc->aged = gc->scan;
+  gc->mode = FAL_GENGC__IDLE;
+  gc->stats.minor_collections++;
+}
+
+/******************************************************************************/
+/*                              INITIALIZATION                                */
+/******************************************************************************/
+static inline void FAL_GENGC__PUB(init)(FAL_GENGC__T* gc,
+  FAL_GENGC__TRACE_FN trace, void* from, void* to) {
+  assert(trace && "[" FAL_STR(FAL_GENGC__PUB(init)) "] trace cannot be NULL");
+  assert(from && to && from != to
+    && "[" FAL_STR(FAL_GENGC__PUB(init)) "] two semispaces are required");
+  assert(FAL_GENGC__NURSERY(BLOCK_SIZE) >= sizeof(void*)
+    && "[" FAL_STR(FAL_GENGC__PUB(init)) "] block cannot fit forwarding address");
+
+  FAL_GENGC__OLD(init)(&gc->old, FAL_GENGC__INT(old_trace));
+  gc->trace = trace;
+  gc->roots = 0;
+  gc->from = (FAL_GENGC__NURSERY_T*)from;
+  gc->to = (FAL_GENGC__NURSERY_T*)to;
+  FAL_GENGC__NURSERY(init)(gc->from);
+  FAL_GENGC__NURSERY(init)(gc->to);
+  gc->aged = (char*)FAL_GENGC__NURSERY(mem_start)(gc->from);
+  gc->scan = 0;
+  memset(&gc->stats, 0, sizeof(gc->stats));
+
+  gc->mode = FAL_GENGC__IDLE;
+  gc->promote_all = 0;
+  gc->young_seen = 0;
+  gc->rescan = 0;
+  gc->promote_len = 0;
+}
+
+static inline void FAL_GENGC__PUB(add_arena)(FAL_GENGC__T* gc, void* mem) {
+  FAL_GENGC__OLD(add_arena)(&gc->old, mem);
+  memset(FAL_GENGC__OLD_ARENA(user_hi)((FAL_GENGC__OLD_ARENA_T*)mem), 0,
+    FAL_GENGC_CARDS / CHAR_BIT);
+}
+
+/******************************************************************************/
+/*                                   ROOTS                                    */
+/******************************************************************************/
+static inline void FAL_GENGC__PUB(add_root)(FAL_GENGC__T* gc,
+  FAL_GENGC__ROOT_T* root, void** slots, size_t len) {
+  root->slots = slots;
+  root->len = len;
+  root->next = gc->roots;
+  gc->roots = root;
+}
+
+static inline void FAL_GENGC__PUB(remove_root)(FAL_GENGC__T* gc,
+  FAL_GENGC__ROOT_T* root) {
+  for (FAL_GENGC__ROOT_T** it = &gc->roots; *it; it = &(*it)->next) {
+    if (*it == root) {
+      *it = root->next;
+      return;
+    }
+  }
+
+  assert(0 && "[" FAL_STR(FAL_GENGC__PUB(remove_root)) "] root is not registered");
+}
+
+/******************************************************************************/
+/*                                ALLOCATING                                  */
+/******************************************************************************/
+static inline void* FAL_GENGC__PUB(alloc)(FAL_GENGC__T* gc, size_t size) {
+  assert(size && "[" FAL_STR(FAL_GENGC__PUB(alloc)) "] size cannot be zero");
+
+  if (size >= FAL_GENGC_PRETENURE) {
+    return FAL_GENGC__OLD(alloc)(&gc->old, size);
+  }
+
+  void* obj = FAL_GENGC__NURSERY(bumpalloc)(gc->from, size);
+
+  return obj ? memset(obj, 0, size) : 0;
+}
+
+/******************************************************************************/
+/*                                COLLECTING                                  */
+/******************************************************************************/
+static inline void FAL_GENGC__PUB(visit)(FAL_GENGC__T* gc, void** slot) {
+  void* obj = *slot;
+  if (!obj) {
+    return;
+  }
+
+  FAL_GENGC__NURSERY_T* space = FAL_GENGC__NURSERY(for)(obj);
+
+  if (gc->mode == FAL_GENGC__MAJOR) {
+    /* Nursery objects are roots of old space collection. */
+    if (space != gc->from) {
+      FAL_GENGC__OLD(visit)(&gc->old, slot);
+    }
+    return;
+  }
+
+  if (space == gc->to) {
+    gc->young_seen = 1;
+    return;
+  }
+
+  if (space != gc->from) {
+    return;
+  }
+
+  void* copy = FAL_GENGC__NURSERY(marked)(obj)
+    ? *(void**)obj : FAL_GENGC__INT(copy)(gc, obj);
+  *slot = copy;
+
+  if (FAL_GENGC__NURSERY(for)(copy) == gc->to) {
+    gc->young_seen = 1;
+  }
+}
+
+static inline void FAL_GENGC__PUB(write)(FAL_GENGC__T* gc, void** slot,
+  void* value) {
+  *slot = value;
+
+  if (value && FAL_GENGC__NURSERY(for)(value) == gc->from
+    && FAL_GENGC__NURSERY(for)(slot) != gc->from) {
+    FAL_GENGC__INT(dirty)(slot);
+  }
+}
+
+static inline void FAL_GENGC__PUB(minor)(FAL_GENGC__T* gc) {
+  FAL_GENGC__INT(evacuate)(gc, 0);
+}
+
+static inline void FAL_GENGC__PUB(collect)(FAL_GENGC__T* gc) {
+  FAL_GENGC__INT(evacuate)(gc, 1);
+
+  gc->mode = FAL_GENGC__MAJOR;
+  FAL_GENGC__OLD(collect)(&gc->old);
+  gc->mode = FAL_GENGC__IDLE;
+  gc->stats.major_collections++;
+
+  /* Without nursery objects there are no old-to-young pointers. */
+  if (FAL_GENGC__NURSERY(empty)(gc->from)) {
+    for (FAL_GENGC__OLD_ARENA_T* arena = FAL_GENGC__OLD(first_arena)(&gc->old);
+      arena; arena = FAL_GENGC__OLD(next_arena)(arena)) {
+      memset(FAL_GENGC__OLD_ARENA(user_hi)(arena), 0, FAL_GENGC_CARDS / CHAR_BIT);
+    }
+  }
+}
+
+/******************************************************************************/
+/*                                  QUERYING                                  */
+/******************************************************************************/
+static inline const FAL_GENGC__STATS_T* FAL_GENGC__PUB(stats)(FAL_GENGC__T* gc) {
+  return &gc->stats;
+}
+
+static inline FAL_GENGC__OLD_T* FAL_GENGC__PUB(old)(FAL_GENGC__T* gc) {
+  return &gc->old;
+}
+
+static inline int FAL_GENGC__PUB(young)(FAL_GENGC__T* gc, void* ptr) {
+  return ptr && FAL_GENGC__NURSERY(for)(ptr) == gc->from;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef FAL_GENGC__PUB
+#undef FAL_GENGC__INT
+#undef FAL_GENGC__OLD
+#undef FAL_GENGC__OLD_ARENA
+#undef FAL_GENGC__NURSERY
+
+#undef FAL_GENGC__T
+#undef FAL_GENGC__ROOT_T
+#undef FAL_GENGC__STATS_T
+#undef FAL_GENGC__TRACE_FN
+#undef FAL_GENGC__OLD_T
+#undef FAL_GENGC__OLD_ARENA_T
+#undef FAL_GENGC__NURSERY_T
+#undef FAL_GENGC_CARDS
+#undef FAL_GENGC_CARD_SIZE
+#undef FAL_GENGC_PRETENURE
+#undef FAL_GENGC_PROMOTE_STACK
+#undef FAL_GENGC__IDLE
+#undef FAL_GENGC__MINOR
+#undef FAL_GENGC__MAJOR
+
+/* Undef compile-time parameters. */
+#ifndef FAL_GENGC_DEF_NO_UNDEF
+#undef FAL_GENGC_DEF_NAME
+#undef FAL_GENGC_DEF_POW
+#undef FAL_GENGC_DEF_BLOCK_POW
+#undef FAL_GENGC_DEF_NURSERY_POW
+#undef FAL_GENGC_DEF_PROMOTE_STACK
+
+#ifdef FAL_GENGC_DEF_PRETENURE
+#undef FAL_GENGC_DEF_PRETENURE
+#endif
+
+#ifdef FAL_GENGC_DEF_MARK_STACK
+#undef FAL_GENGC_DEF_MARK_STACK
+#endif
+#endif /* FAL_GENGC_DEF_NO_UNDEF */
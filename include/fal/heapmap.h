@@ -0,0 +1,278 @@
+/* Copyright (c) 2016 Andrey Roenko
+ * This file is part of fal project which is released under MIT license.
+ * See file LICENSE or go to https://opensource.org/licenses/MIT for full
+ * license details.
+*/
+
+/*
+  Two-level radix map from address to owner tag.
+
+  Address space is split into granules of size 2^FAL_HEAPMAP_DEF_POW. Every
+  granule has one byte, called tag, which is 0 if granule doesn't belong to
+  heap or user-defined nonzero value (e.g. arena type or size class) otherwise.
+  Since arenas are aligned to their size, registering arena of any size
+  not less than granule fills whole granules.
+
+  Lookup takes two loads: root slot and leaf byte. Leaves are allocated lazily
+  on first heapmap_set into the range they cover and are never freed until
+  heapmap_destroy.
+
+  Compile-time parameters:
+    (req) FAL_HEAPMAP_DEF_NAME  - prefix for resulting type and functions
+    (req) FAL_HEAPMAP_DEF_POW   - power of granule size, i.e. power of the
+                                  smallest arena registered in the map
+                                  (i.e. 12 means 4 KiB granules)
+    (opt) FAL_HEAPMAP_DEF_ADDRESS_BITS - default: 48 on 64-bit platforms and
+                                         32 otherwise; number of significant
+                                         bits in addresses
+    (opt) FAL_HEAPMAP_DEF_ALLOC(Size) - default: calloc(1, Size); must return
+                                        zero-initialized memory or 0
+    (opt) FAL_HEAPMAP_DEF_FREE(Ptr, Size) - default: free(Ptr)
+
+    (opt) FAL_HEAPMAP_DEF_NO_UNDEF - do not undefined all compile-time parameters
+
+  API:
+    heapmap_ prefix is overriden by <FAL_HEAPMAP_DEF_NAME>_.
+    Everything with __ (two underscores) in name should be considered internal.
+
+    Types:
+      heapmap_t - struct, must be zero-initialized or passed to heapmap_init.
+                  It is large (heapmap_ROOT_LEN pointers), so prefer static
+                  storage.
+
+    Initializing:
+      void heapmap_init(heapmap_t*)
+        initialize empty map
+      void heapmap_destroy(heapmap_t*)
+        free all leaves, map becomes empty
+
+    Modifying:
+      int heapmap_set(heapmap_t*, void* start, size_t size, unsigned tag)
+        assign tag to all granules in [start, start + size),
+        start and size must be multiples of heapmap_GRANULE,
+        returns 0 if leaf allocation failed
+      void heapmap_clear(heapmap_t*, void* start, size_t size)
+        same as heapmap_set with tag 0, never allocates
+
+    Querying:
+      unsigned heapmap_owner(heapmap_t*, void* ptr)
+        get tag of granule containing ptr or 0 if ptr doesn't belong to heap,
+        any value (including garbage) can be passed
+
+    Constants:
+      heapmap_GRANULE  - granule size in bytes
+      heapmap_ROOT_LEN - number of leaves
+      heapmap_LEAF_LEN - number of granules in one leaf
+*/
+
+#ifndef __FAL_HEAPMAP_H__
+#define __FAL_HEAPMAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+
+#include "utils.h"
+
+#endif /* __FAL_HEAPMAP_H__ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if !defined(FAL_HEAPMAP_DEF_POW) || !defined(FAL_HEAPMAP_DEF_NAME)
+#error FAL_HEAPMAP: compile-time parameters \
+  FAL_HEAPMAP_DEF_POW and FAL_HEAPMAP_DEF_NAME must be defined.
+#endif
+
+#ifndef FAL_HEAPMAP_DEF_ADDRESS_BITS
+# if UINTPTR_MAX > 0xFFFFFFFFu
+#  define FAL_HEAPMAP_DEF_ADDRESS_BITS 48
+# else
+#  define FAL_HEAPMAP_DEF_ADDRESS_BITS 32
+# endif
+#endif
+
+#if !defined(FAL_HEAPMAP_DEF_ALLOC) || !defined(FAL_HEAPMAP_DEF_FREE)
+# include <stdlib.h>
+#endif
+
+#ifndef FAL_HEAPMAP_DEF_ALLOC
+# define FAL_HEAPMAP_DEF_ALLOC(Size) calloc(1, (Size))
+#endif
+
+#ifndef FAL_HEAPMAP_DEF_FREE
+# define FAL_HEAPMAP_DEF_FREE(Ptr, Size) (FAL_UNUSED(Size), free(Ptr))
+#endif
+
+/* Public and internal functions helpers. */
+#define FAL_HEAPMAP__PUB(X) FAL_CONCAT(FAL_HEAPMAP_DEF_NAME, FAL_CONCAT(_, X))
+#define FAL_HEAPMAP__INT(X) FAL_CONCAT(FAL_HEAPMAP_DEF_NAME, FAL_CONCAT(__, X))
+
+/* Public */
+#define FAL_HEAPMAP__T              FAL_HEAPMAP__PUB(t)
+#define FAL_HEAPMAP_GRANULE         FAL_HEAPMAP__PUB(GRANULE)
+#define FAL_HEAPMAP_ROOT_LEN        FAL_HEAPMAP__PUB(ROOT_LEN)
+#define FAL_HEAPMAP_LEAF_LEN        FAL_HEAPMAP__PUB(LEAF_LEN)
+/* Internal */
+#define FAL_HEAPMAP__POW            FAL_HEAPMAP__INT(POW)
+#define FAL_HEAPMAP__KEY_BITS       FAL_HEAPMAP__INT(KEY_BITS)
+#define FAL_HEAPMAP__ROOT_BITS      FAL_HEAPMAP__INT(ROOT_BITS)
+#define FAL_HEAPMAP__LEAF_BITS      FAL_HEAPMAP__INT(LEAF_BITS)
+
+typedef struct FAL_HEAPMAP__T FAL_HEAPMAP__T;
+
+enum FAL_HEAPMAP__INT(defs) {
+  FAL_HEAPMAP__POW = FAL_HEAPMAP_DEF_POW,
+  FAL_HEAPMAP__KEY_BITS = FAL_HEAPMAP_DEF_ADDRESS_BITS - FAL_HEAPMAP_DEF_POW,
+  FAL_HEAPMAP__ROOT_BITS = FAL_HEAPMAP__KEY_BITS / 2,
+  FAL_HEAPMAP__LEAF_BITS = FAL_HEAPMAP__KEY_BITS - FAL_HEAPMAP__ROOT_BITS,
+
+  FAL_HEAPMAP_GRANULE = 1u << FAL_HEAPMAP__POW,
+  FAL_HEAPMAP_ROOT_LEN = 1u << FAL_HEAPMAP__ROOT_BITS,
+  FAL_HEAPMAP_LEAF_LEN = 1u << FAL_HEAPMAP__LEAF_BITS
+};
+
+struct FAL_HEAPMAP__T {
+  unsigned char* root[FAL_HEAPMAP_ROOT_LEN];
+};
+
+/******************************************************************************/
+/*                            FORWARD DECLARATION                             */
+/******************************************************************************/
+static inline void FAL_HEAPMAP__INT(asertions)();
+static inline int FAL_HEAPMAP__INT(assign)(FAL_HEAPMAP__T* map,
+  void* start, size_t size, unsigned tag, int alloc);
+
+static inline void FAL_HEAPMAP__PUB(init)(FAL_HEAPMAP__T* map);
+static inline void FAL_HEAPMAP__PUB(destroy)(FAL_HEAPMAP__T* map);
+static inline int FAL_HEAPMAP__PUB(set)(FAL_HEAPMAP__T* map,
+  void* start, size_t size, unsigned tag);
+static inline void FAL_HEAPMAP__PUB(clear)(FAL_HEAPMAP__T* map,
+  void* start, size_t size);
+static inline unsigned FAL_HEAPMAP__PUB(owner)(FAL_HEAPMAP__T* map, void* ptr);
+
+/******************************************************************************/
+/*                                INTERNALS                                   */
+/******************************************************************************/
+static inline void FAL_HEAPMAP__INT(asertions)() {
+  /* Ensure key fits into uintptr_t shifted by granule power. */
+  FAL_STATIC_ASSERT(FAL_HEAPMAP_DEF_ADDRESS_BITS <= sizeof(uintptr_t) * CHAR_BIT);
+  FAL_STATIC_ASSERT(FAL_HEAPMAP_DEF_POW < FAL_HEAPMAP_DEF_ADDRESS_BITS);
+}
+
+static inline int FAL_HEAPMAP__INT(assign)(FAL_HEAPMAP__T* map,
+  void* start, size_t size, unsigned tag, int alloc) {
+  assert(!((uintptr_t)start & (FAL_HEAPMAP_GRANULE - 1))
+    && "[" FAL_STR(FAL_HEAPMAP__PUB(set)) "] start is not aligned to granule");
+  assert(!(size & (FAL_HEAPMAP_GRANULE - 1))
+    && "[" FAL_STR(FAL_HEAPMAP__PUB(set)) "] size is not multiple of granule");
+  assert(tag <= UCHAR_MAX
+    && "[" FAL_STR(FAL_HEAPMAP__PUB(set)) "] tag doesn't fit into byte");
+
+  uintptr_t key = (uintptr_t)start >> FAL_HEAPMAP__POW;
+  uintptr_t end = key + (size >> FAL_HEAPMAP__POW);
+
+  assert((end == key || ((end - 1) >> FAL_HEAPMAP__KEY_BITS) == 0)
+    && "[" FAL_STR(FAL_HEAPMAP__PUB(set)) "] range exceeds address bits");
+
+  while (key < end) {
+    uintptr_t rootix = key >> FAL_HEAPMAP__LEAF_BITS;
+    uintptr_t leafix = key & (FAL_HEAPMAP_LEAF_LEN - 1);
+    uintptr_t len = FAL_HEAPMAP_LEAF_LEN - leafix;
+    if (len > end - key) {
+      len = end - key;
+    }
+
+    unsigned char* leaf = map->root[rootix];
+    if (!leaf) {
+      if (!alloc) {
+        key += len;
+        continue;
+      }
+
+      leaf = (unsigned char*)FAL_HEAPMAP_DEF_ALLOC(FAL_HEAPMAP_LEAF_LEN);
+      if (!leaf) {
+        return 0;
+      }
+
+      map->root[rootix] = leaf;
+    }
+
+    memset(leaf + leafix, (int)tag, len);
+    key += len;
+  }
+
+  return 1;
+}
+
+/******************************************************************************/
+/*                              INITIALIZATION                                */
+/******************************************************************************/
+static inline void FAL_HEAPMAP__PUB(init)(FAL_HEAPMAP__T* map) {
+  memset(map, 0, sizeof(*map));
+}
+
+static inline void FAL_HEAPMAP__PUB(destroy)(FAL_HEAPMAP__T* map) {
+  for (size_t ix = 0; ix < FAL_HEAPMAP_ROOT_LEN; ix++) {
+    if (map->root[ix]) {
+      FAL_HEAPMAP_DEF_FREE(map->root[ix], FAL_HEAPMAP_LEAF_LEN);
+      map->root[ix] = 0;
+    }
+  }
+}
+
+/******************************************************************************/
+/*                                 MODIFYING                                  */
+/******************************************************************************/
+static inline int FAL_HEAPMAP__PUB(set)(FAL_HEAPMAP__T* map,
+  void* start, size_t size, unsigned tag) {
+  return FAL_HEAPMAP__INT(assign)(map, start, size, tag, tag != 0);
+}
+
+static inline void FAL_HEAPMAP__PUB(clear)(FAL_HEAPMAP__T* map,
+  void* start, size_t size) {
+  FAL_HEAPMAP__INT(assign)(map, start, size, 0, 0);
+}
+
+/******************************************************************************/
+/*                                  QUERYING                                  */
+/******************************************************************************/
+static inline unsigned FAL_HEAPMAP__PUB(owner)(FAL_HEAPMAP__T* map, void* ptr) {
+  uintptr_t key = (uintptr_t)ptr >> FAL_HEAPMAP__POW;
+  uintptr_t rootix = key >> FAL_HEAPMAP__LEAF_BITS;
+  if (rootix >= FAL_HEAPMAP_ROOT_LEN) {
+    return 0;
+  }
+
+  unsigned char* leaf = map->root[rootix];
+  return leaf ? leaf[key & (FAL_HEAPMAP_LEAF_LEN - 1)] : 0;
+}
+
+#undef FAL_HEAPMAP__PUB
+#undef FAL_HEAPMAP__INT
+#undef FAL_HEAPMAP__T
+
+#undef FAL_HEAPMAP_GRANULE
+#undef FAL_HEAPMAP_ROOT_LEN
+#undef FAL_HEAPMAP_LEAF_LEN
+
+#undef FAL_HEAPMAP__POW
+#undef FAL_HEAPMAP__KEY_BITS
+#undef FAL_HEAPMAP__ROOT_BITS
+#undef FAL_HEAPMAP__LEAF_BITS
+
+/* Undef compile-time parameters. */
+#ifndef FAL_HEAPMAP_DEF_NO_UNDEF
+#undef FAL_HEAPMAP_DEF_NAME
+#undef FAL_HEAPMAP_DEF_POW
+#undef FAL_HEAPMAP_DEF_ADDRESS_BITS
+#undef FAL_HEAPMAP_DEF_ALLOC
+#undef FAL_HEAPMAP_DEF_FREE
+#endif /* FAL_HEAPMAP_DEF_NO_UNDEF */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,417 @@
+/* Copyright (c) 2016 Andrey Roenko
+ * This file is part of fal project which is released under MIT license.
+ * See file LICENSE or go to https://opensource.org/licenses/MIT for full
+ * license details.
+*/
+
+/*
+  Parallel marking with per-thread work-stealing deques.
+
+  Compile-time parameters:
+    (req) FAL_PARMARK_DEF_NAME       - prefix for resulting types and functions
+    (req) FAL_PARMARK_DEF_MARK(Ptr)  - expression atomically marking object
+                                       and returning nonzero if it wasn't
+                                       marked, e.g. arena_mark_atomic(Ptr)
+    (opt) FAL_PARMARK_DEF_DEQUE_POW  - default: 12; power of capacity of each
+                                       worker's deque (i.e. 12 means 4096)
+    (opt) FAL_PARMARK_DEF_YIELD()    - statement executed by idle worker
+                                       while waiting for work, e.g.
+                                       sched_yield(), nothing by default
+
+    (opt) FAL_PARMARK_DEF_NO_UNDEF   - do not undefined all compile-time parameters
+
+  Marker never creates threads itself. User gives it array of workers and
+  runs parmark_work for every worker on its own thread.
+
+  Every worker owns Chase-Lev deque: it pushes and takes objects at the
+  bottom, idle workers steal from the top of others. Object is pushed only
+  by thread which marked it with FAL_PARMARK_DEF_MARK, so every object is
+  traced exactly once. Worker which has no work and can't steal any becomes
+  idle, when all workers are idle at once all deques are empty and nobody
+  can push anymore, so marking is finished and every parmark_work returns.
+
+  Deques don't grow. When deque is full, object is still marked but not
+  pushed and overflow flag is set. After parmark_work returned on all
+  threads user checks parmark_overflowed, and if it's set, calls
+  parmark_retrace for every marked object (e.g. iterating arenas with
+  arena_first_marked) and runs parmark_work on all threads again. Every
+  round marks something new, so it finishes, like fal/gc.h mark stack does.
+
+  Objects are traced by single user-supplied callback which must call
+  parmark_visit for every pointer stored in object. Callback is called
+  concurrently from all workers.
+
+  API:
+    parmark_ prefix is overriden by <FAL_PARMARK_DEF_NAME>_.
+    Everything with __ (two underscores) in name should be considered internal.
+
+    Types:
+      parmark_t - shared marker state, should be used only as parmark_t*
+      parmark_worker_t - per-thread state with deque, owned by user
+      parmark_stats_t - counters of worker, see parmark_stats
+      void (*parmark_trace_fn)(parmark_worker_t*, void* obj)
+        must call parmark_visit for each pointer stored in obj
+
+    Initializing:
+      void parmark_init(parmark_t*, parmark_trace_fn trace,
+        parmark_worker_t* workers, size_t count)
+        initialize marker with count workers
+
+    Marking:
+      void parmark_root(parmark_t*, void* obj)
+        mark root object and give it to one of workers, must be called
+        while no worker runs
+      void parmark_work(parmark_worker_t*)
+        trace objects until everything reachable is marked, must be called
+        concurrently for all workers
+      void parmark_visit(parmark_worker_t*, void* obj)
+        mark obj (if any) and push it to deque of worker if it wasn't marked,
+        must be called only from trace callback
+      int parmark_overflowed(parmark_t*)
+        check if deque overflowed since last call and reset flag
+      void parmark_retrace(parmark_t*, void* obj)
+        trace marked object again, so its unmarked children are given to
+        workers, must be called while no worker runs
+
+    Querying:
+      const parmark_stats_t* parmark_stats(parmark_worker_t*)
+        get counters of worker since initialization
+      parmark_t* parmark_of(parmark_worker_t*)
+        get marker worker belongs to, e.g. in trace callback
+
+    Constants:
+      parmark_DEQUE - capacity of each deque
+*/
+
+#ifndef __FAL_PARMARK_H__
+#define __FAL_PARMARK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "utils.h"
+#include "atomic.h"
+
+#endif /* __FAL_PARMARK_H__ */
+
+#if !defined(FAL_PARMARK_DEF_NAME) || !defined(FAL_PARMARK_DEF_MARK)
+#error FAL_PARMARK: compile-time parameters \
+  FAL_PARMARK_DEF_NAME and FAL_PARMARK_DEF_MARK must be defined.
+#endif
+
+#ifndef FAL_PARMARK_DEF_DEQUE_POW
+#define FAL_PARMARK_DEF_DEQUE_POW 12
+#endif
+
+#ifndef FAL_PARMARK_DEF_YIELD
+#define FAL_PARMARK_DEF_YIELD()
+#endif
+
+/* Public and internal functions helpers. */
+#define FAL_PARMARK__PUB(X)   FAL_CONCAT(FAL_PARMARK_DEF_NAME, FAL_CONCAT(_, X))
+#define FAL_PARMARK__INT(X)   FAL_CONCAT(FAL_PARMARK_DEF_NAME, FAL_CONCAT(__, X))
+
+/* Public */
+#define FAL_PARMARK__T        FAL_PARMARK__PUB(t)
+#define FAL_PARMARK__WORKER_T FAL_PARMARK__PUB(worker_t)
+#define FAL_PARMARK__STATS_T  FAL_PARMARK__PUB(stats_t)
+#define FAL_PARMARK__TRACE_FN FAL_PARMARK__PUB(trace_fn)
+#define FAL_PARMARK_DEQUE     FAL_PARMARK__PUB(DEQUE)
+/* Internal */
+#define FAL_PARMARK__LINE     FAL_PARMARK__INT(LINE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct FAL_PARMARK__T FAL_PARMARK__T;
+typedef struct FAL_PARMARK__WORKER_T FAL_PARMARK__WORKER_T;
+typedef struct FAL_PARMARK__STATS_T FAL_PARMARK__STATS_T;
+typedef void (*FAL_PARMARK__TRACE_FN)(FAL_PARMARK__WORKER_T* worker, void* obj);
+
+enum FAL_PARMARK__INT(defs) {
+  FAL_PARMARK_DEQUE = 1 << FAL_PARMARK_DEF_DEQUE_POW,
+  FAL_PARMARK__LINE = 64 /* cache line, keeps deque ends apart */
+};
+
+struct FAL_PARMARK__STATS_T {
+  size_t traced;  /* objects traced by worker */
+  size_t steals;  /* objects stolen from other workers */
+};
+
+struct FAL_PARMARK__WORKER_T {
+  FAL_PARMARK__T* marker;
+  size_t id;
+  FAL_PARMARK__STATS_T stats;
+
+  char pad_top[FAL_PARMARK__LINE];
+  volatile size_t top;      /* next object to steal, moved by thieves */
+  char pad_bottom[FAL_PARMARK__LINE];
+  volatile size_t bottom;   /* next free slot, moved by owner */
+  char pad_deque[FAL_PARMARK__LINE];
+  void* volatile deque[FAL_PARMARK_DEQUE];
+};
+
+struct FAL_PARMARK__T {
+  FAL_PARMARK__TRACE_FN trace;
+  FAL_PARMARK__WORKER_T* workers;
+  size_t count;
+  size_t next;              /* worker to give next root to */
+
+  char pad_idle[FAL_PARMARK__LINE];
+  volatile size_t idle;     /* number of idle workers */
+  volatile size_t overflow;
+};
+
+/******************************************************************************/
+/*                            FORWARD DECLARATION                             */
+/******************************************************************************/
+static inline int FAL_PARMARK__INT(push)(FAL_PARMARK__WORKER_T* worker,
+  void* obj);
+static inline void* FAL_PARMARK__INT(take)(FAL_PARMARK__WORKER_T* worker);
+static inline void* FAL_PARMARK__INT(steal)(FAL_PARMARK__WORKER_T* victim);
+static inline void* FAL_PARMARK__INT(steal_any)(FAL_PARMARK__WORKER_T* worker);
+static inline int FAL_PARMARK__INT(has_work)(FAL_PARMARK__T* marker);
+
+static inline void FAL_PARMARK__PUB(init)(FAL_PARMARK__T* marker,
+  FAL_PARMARK__TRACE_FN trace, FAL_PARMARK__WORKER_T* workers, size_t count);
+
+static inline void FAL_PARMARK__PUB(root)(FAL_PARMARK__T* marker, void* obj);
+static inline void FAL_PARMARK__PUB(work)(FAL_PARMARK__WORKER_T* worker);
+static inline void FAL_PARMARK__PUB(visit)(FAL_PARMARK__WORKER_T* worker,
+  void* obj);
+static inline int FAL_PARMARK__PUB(overflowed)(FAL_PARMARK__T* marker);
+static inline void FAL_PARMARK__PUB(retrace)(FAL_PARMARK__T* marker,
+  void* obj);
+
+static inline const FAL_PARMARK__STATS_T* FAL_PARMARK__PUB(stats)(
+  FAL_PARMARK__WORKER_T* worker);
+static inline FAL_PARMARK__T* FAL_PARMARK__PUB(of)(
+  FAL_PARMARK__WORKER_T* worker);
+
+/******************************************************************************/
+/*                                INTERNALS                                   */
+/******************************************************************************/
+/* Push object to the bottom of own deque, returns 0 if deque is full. */
+static inline int FAL_PARMARK__INT(push)(FAL_PARMARK__WORKER_T* worker,
+  void* obj) {
+  size_t bottom = fal_atomic_load(&worker->bottom, FAL_ATOMIC_RELAXED);
+  size_t top = fal_atomic_load(&worker->top, FAL_ATOMIC_ACQUIRE);
+  if (bottom - top >= FAL_PARMARK_DEQUE) {
+    return 0;
+  }
+
+  fal_atomic_store_ptr(&worker->deque[bottom % FAL_PARMARK_DEQUE], obj,
+    FAL_ATOMIC_RELAXED);
+  fal_atomic_store(&worker->bottom, bottom + 1, FAL_ATOMIC_RELEASE);
+
+  return 1;
+}
+
+/* Take object from the bottom of own deque, racing with thieves only for
+   the last one. */
+static inline void* FAL_PARMARK__INT(take)(FAL_PARMARK__WORKER_T* worker) {
+  size_t bottom = fal_atomic_load(&worker->bottom, FAL_ATOMIC_RELAXED);
+  if (bottom == fal_atomic_load(&worker->top, FAL_ATOMIC_RELAXED)) {
+    return 0; /* top never passes bottom, so deque is empty */
+  }
+
+  bottom--;
+  fal_atomic_store(&worker->bottom, bottom, FAL_ATOMIC_RELAXED);
+  fal_atomic_fence();
+  size_t top = fal_atomic_load(&worker->top, FAL_ATOMIC_RELAXED);
+
+  void* obj = 0;
+  if (top <= bottom) {
+    obj = fal_atomic_load_ptr(&worker->deque[bottom % FAL_PARMARK_DEQUE],
+      FAL_ATOMIC_RELAXED);
+    if (top != bottom) {
+      return obj;
+    }
+
+    if (!fal_atomic_cas(&worker->top, top, top + 1)) {
+      obj = 0; /* stolen */
+    }
+  }
+
+  fal_atomic_store(&worker->bottom, bottom + 1, FAL_ATOMIC_RELAXED);
+
+  return obj;
+}
+
+/* Steal object from the top of victim's deque, returns 0 if deque is empty
+   or another thread won the race. */
+static inline void* FAL_PARMARK__INT(steal)(FAL_PARMARK__WORKER_T* victim) {
+  size_t top = fal_atomic_load(&victim->top, FAL_ATOMIC_ACQUIRE);
+  fal_atomic_fence();
+  size_t bottom = fal_atomic_load(&victim->bottom, FAL_ATOMIC_ACQUIRE);
+  if (top >= bottom) {
+    return 0;
+  }
+
+  void* obj = fal_atomic_load_ptr(&victim->deque[top % FAL_PARMARK_DEQUE],
+    FAL_ATOMIC_RELAXED);
+
+  return fal_atomic_cas(&victim->top, top, top + 1) ? obj : 0;
+}
+
+/* Try to steal once from every other worker starting from the next one. */
+static inline void* FAL_PARMARK__INT(steal_any)(FAL_PARMARK__WORKER_T* worker) {
+  FAL_PARMARK__T* marker = worker->marker;
+
+  for (size_t ix = 1; ix < marker->count; ix++) {
+    void* obj = FAL_PARMARK__INT(steal)(
+      &marker->workers[(worker->id + ix) % marker->count]);
+    if (obj) {
+      worker->stats.steals++;
+      return obj;
+    }
+  }
+
+  return 0;
+}
+
+static inline int FAL_PARMARK__INT(has_work)(FAL_PARMARK__T* marker) {
+  for (size_t ix = 0; ix < marker->count; ix++) {
+    FAL_PARMARK__WORKER_T* worker = &marker->workers[ix];
+    if (fal_atomic_load(&worker->top, FAL_ATOMIC_ACQUIRE)
+      < fal_atomic_load(&worker->bottom, FAL_ATOMIC_ACQUIRE)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/******************************************************************************/
+/*                              INITIALIZATION                                */
+/******************************************************************************/
+static inline void FAL_PARMARK__PUB(init)(FAL_PARMARK__T* marker,
+  FAL_PARMARK__TRACE_FN trace, FAL_PARMARK__WORKER_T* workers, size_t count) {
+  assert(trace && "[" FAL_STR(FAL_PARMARK__PUB(init)) "] trace cannot be NULL");
+  assert(workers && count
+    && "[" FAL_STR(FAL_PARMARK__PUB(init)) "] at least one worker is required");
+
+  marker->trace = trace;
+  marker->workers = workers;
+  marker->count = count;
+  marker->next = 0;
+  marker->idle = 0;
+  marker->overflow = 0;
+
+  for (size_t ix = 0; ix < count; ix++) {
+    workers[ix].marker = marker;
+    workers[ix].id = ix;
+    workers[ix].top = 0;
+    workers[ix].bottom = 0;
+    memset(&workers[ix].stats, 0, sizeof(workers[ix].stats));
+  }
+}
+
+/******************************************************************************/
+/*                                 MARKING                                    */
+/******************************************************************************/
+static inline void FAL_PARMARK__PUB(root)(FAL_PARMARK__T* marker, void* obj) {
+  marker->idle = 0;
+  FAL_PARMARK__PUB(visit)(&marker->workers[marker->next++ % marker->count],
+    obj);
+}
+
+static inline void FAL_PARMARK__PUB(work)(FAL_PARMARK__WORKER_T* worker) {
+  FAL_PARMARK__T* marker = worker->marker;
+
+  for (;;) {
+    void* obj = FAL_PARMARK__INT(take)(worker);
+    if (!obj) {
+      obj = FAL_PARMARK__INT(steal_any)(worker);
+    }
+
+    if (obj) {
+      worker->stats.traced++;
+      marker->trace(worker, obj);
+      continue;
+    }
+
+    /* Worker is idle only with empty deque and goes back to work only to
+       steal, so when everybody is idle nobody will push anymore. */
+    fal_atomic_add(&marker->idle, 1);
+    for (;;) {
+      if (fal_atomic_load(&marker->idle, FAL_ATOMIC_ACQUIRE) == marker->count) {
+        return;
+      }
+
+      if (FAL_PARMARK__INT(has_work)(marker)) {
+        fal_atomic_add(&marker->idle, (size_t)-1);
+        break;
+      }
+
+      FAL_PARMARK_DEF_YIELD();
+    }
+  }
+}
+
+static inline void FAL_PARMARK__PUB(visit)(FAL_PARMARK__WORKER_T* worker,
+  void* obj) {
+  if (!obj || !(FAL_PARMARK_DEF_MARK(obj))) {
+    return;
+  }
+
+  if (!FAL_PARMARK__INT(push)(worker, obj)) {
+    fal_atomic_store(&worker->marker->overflow, 1, FAL_ATOMIC_RELAXED);
+  }
+}
+
+static inline int FAL_PARMARK__PUB(overflowed)(FAL_PARMARK__T* marker) {
+  int overflow = marker->overflow != 0;
+  marker->overflow = 0;
+
+  return overflow;
+}
+
+static inline void FAL_PARMARK__PUB(retrace)(FAL_PARMARK__T* marker,
+  void* obj) {
+  assert(obj && "[" FAL_STR(FAL_PARMARK__PUB(retrace)) "] obj cannot be NULL");
+
+  FAL_PARMARK__WORKER_T* worker =
+    &marker->workers[marker->next++ % marker->count];
+  marker->idle = 0;
+  worker->stats.traced++;
+  marker->trace(worker, obj);
+}
+
+/******************************************************************************/
+/*                                  QUERYING                                  */
+/******************************************************************************/
+static inline const FAL_PARMARK__STATS_T* FAL_PARMARK__PUB(stats)(
+  FAL_PARMARK__WORKER_T* worker) {
+  return &worker->stats;
+}
+
+static inline FAL_PARMARK__T* FAL_PARMARK__PUB(of)(
+  FAL_PARMARK__WORKER_T* worker) {
+  return worker->marker;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef FAL_PARMARK__PUB
+#undef FAL_PARMARK__INT
+
+#undef FAL_PARMARK__T
+#undef FAL_PARMARK__WORKER_T
+#undef FAL_PARMARK__STATS_T
+#undef FAL_PARMARK__TRACE_FN
+#undef FAL_PARMARK_DEQUE
+#undef FAL_PARMARK__LINE
+
+/* Undef compile-time parameters. */
+#ifndef FAL_PARMARK_DEF_NO_UNDEF
+#undef FAL_PARMARK_DEF_NAME
+#undef FAL_PARMARK_DEF_MARK
+#undef FAL_PARMARK_DEF_DEQUE_POW
+#undef FAL_PARMARK_DEF_YIELD
+#endif /* FAL_PARMARK_DEF_NO_UNDEF */
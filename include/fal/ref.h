@@ -0,0 +1,175 @@
+/* Copyright (c) 2016 Andrey Roenko
+ * This file is part of fal project which is released under MIT license.
+ * See file LICENSE or go to https://opensource.org/licenses/MIT for full
+ * license details.
+*/
+
+/*
+  Compressed 32-bit references into contiguous heap.
+
+  When all arenas of a heap are carved from one reserved range of address
+  space, any object can be addressed by its offset from start of the range.
+  Objects are aligned to block size, so offset is stored divided by it:
+  32 bits address 4 GiB heap with 1 byte scale, 64 GiB with 16 byte blocks.
+  Reference 0 is null, so start of the range must never be an object, which
+  holds for arenas since they begin with bitsets.
+
+  Library doesn't reserve memory itself, user reserves range (e.g. mmap with
+  PROT_NONE) aligned to arena size, passes it to ref_init and commits arenas
+  inside of it as needed.
+
+  Compile-time parameters:
+    (req) FAL_REF_DEF_NAME  - prefix for resulting type and functions
+    (req) FAL_REF_DEF_SHIFT - power of reference scale, i.e. block power of
+                              arenas in the heap (i.e. 4 means 16 bytes)
+
+    (opt) FAL_REF_DEF_NO_UNDEF - do not undefined all compile-time parameters
+
+  API:
+    ref_ prefix is overriden by <FAL_REF_DEF_NAME>_.
+    Everything with __ (two underscores) in name should be considered internal.
+
+    Types:
+      ref_t - uint32_t, compressed reference, 0 is null
+      ref_heap_t - struct, reserved range
+
+    Initializing:
+      void ref_init(ref_heap_t*, void* base, size_t size)
+        use [base, base + size) as heap, base must be aligned to ref_SCALE
+        and size must not exceed 2^32 * ref_SCALE
+
+    Converting:
+      ref_t ref_compress(const ref_heap_t*, void* ptr)
+        get reference to ptr or 0 if ptr is 0, ptr must belong to heap and
+        be aligned to ref_SCALE
+      void* ref_decompress(const ref_heap_t*, ref_t ref)
+        get pointer by reference or 0 if ref is 0
+
+    Querying:
+      int ref_contains(const ref_heap_t*, void* ptr)
+        check if ptr belongs to heap, any value can be passed
+
+    Constants:
+      ref_SHIFT - power of reference scale
+      ref_SCALE - bytes per unit of reference
+*/
+
+#ifndef __FAL_REF_H__
+#define __FAL_REF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "utils.h"
+
+#endif /* __FAL_REF_H__ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if !defined(FAL_REF_DEF_SHIFT) || !defined(FAL_REF_DEF_NAME)
+#error FAL_REF: compile-time parameters \
+  FAL_REF_DEF_SHIFT and FAL_REF_DEF_NAME must be defined.
+#endif
+
+/* Public and internal functions helpers. */
+#define FAL_REF__PUB(X) FAL_CONCAT(FAL_REF_DEF_NAME, FAL_CONCAT(_, X))
+#define FAL_REF__INT(X) FAL_CONCAT(FAL_REF_DEF_NAME, FAL_CONCAT(__, X))
+
+/* Public */
+#define FAL_REF__T          FAL_REF__PUB(t)
+#define FAL_REF__HEAP_T     FAL_REF__PUB(heap_t)
+#define FAL_REF_SHIFT       FAL_REF__PUB(SHIFT)
+#define FAL_REF_SCALE       FAL_REF__PUB(SCALE)
+
+typedef uint32_t FAL_REF__T;
+typedef struct FAL_REF__HEAP_T FAL_REF__HEAP_T;
+
+enum FAL_REF__INT(defs) {
+  FAL_REF_SHIFT = FAL_REF_DEF_SHIFT,
+  FAL_REF_SCALE = 1u << FAL_REF_SHIFT
+};
+
+struct FAL_REF__HEAP_T {
+  char* base;
+  size_t size;
+};
+
+/******************************************************************************/
+/*                            FORWARD DECLARATION                             */
+/******************************************************************************/
+static inline void FAL_REF__PUB(init)(FAL_REF__HEAP_T* heap, void* base,
+  size_t size);
+
+static inline FAL_REF__T FAL_REF__PUB(compress)(const FAL_REF__HEAP_T* heap,
+  void* ptr);
+static inline void* FAL_REF__PUB(decompress)(const FAL_REF__HEAP_T* heap,
+  FAL_REF__T ref);
+
+static inline int FAL_REF__PUB(contains)(const FAL_REF__HEAP_T* heap,
+  void* ptr);
+
+/******************************************************************************/
+/*                              INITIALIZATION                                */
+/******************************************************************************/
+static inline void FAL_REF__PUB(init)(FAL_REF__HEAP_T* heap, void* base,
+  size_t size) {
+  assert(!((uintptr_t)base & (FAL_REF_SCALE - 1))
+    && "[" FAL_STR(FAL_REF__PUB(init)) "] base is not aligned to scale");
+  assert((!size || (uint64_t)(size - 1) >> FAL_REF_SHIFT <= UINT32_MAX)
+    && "[" FAL_STR(FAL_REF__PUB(init)) "] heap is too large for 32-bit refs");
+
+  heap->base = (char*)base;
+  heap->size = size;
+}
+
+/******************************************************************************/
+/*                                CONVERTING                                  */
+/******************************************************************************/
+static inline FAL_REF__T FAL_REF__PUB(compress)(const FAL_REF__HEAP_T* heap,
+  void* ptr) {
+  if (!ptr) {
+    return 0;
+  }
+
+  assert(FAL_REF__PUB(contains)(heap, ptr) && (char*)ptr != heap->base
+    && "[" FAL_STR(FAL_REF__PUB(compress)) "] ptr doesn't belong to heap");
+  assert(!((uintptr_t)ptr & (FAL_REF_SCALE - 1))
+    && "[" FAL_STR(FAL_REF__PUB(compress)) "] ptr is not aligned to scale");
+
+  return (FAL_REF__T)(((char*)ptr - heap->base) >> FAL_REF_SHIFT);
+}
+
+static inline void* FAL_REF__PUB(decompress)(const FAL_REF__HEAP_T* heap,
+  FAL_REF__T ref) {
+  /* Branchless would map 0 to base, but null must stay null. */
+  return ref ? heap->base + ((size_t)ref << FAL_REF_SHIFT) : 0;
+}
+
+/******************************************************************************/
+/*                                  QUERYING                                  */
+/******************************************************************************/
+static inline int FAL_REF__PUB(contains)(const FAL_REF__HEAP_T* heap,
+  void* ptr) {
+  return (uintptr_t)ptr - (uintptr_t)heap->base < heap->size;
+}
+
+#undef FAL_REF__PUB
+#undef FAL_REF__INT
+#undef FAL_REF__T
+#undef FAL_REF__HEAP_T
+
+#undef FAL_REF_SHIFT
+#undef FAL_REF_SCALE
+
+/* Undef compile-time parameters. */
+#ifndef FAL_REF_DEF_NO_UNDEF
+#undef FAL_REF_DEF_NAME
+#undef FAL_REF_DEF_SHIFT
+#endif /* FAL_REF_DEF_NO_UNDEF */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,326 @@
+/* Copyright (c) 2016 Andrey Roenko
+ * This file is part of fal project which is released under MIT license.
+ * See file LICENSE or go to https://opensource.org/licenses/MIT for full
+ * license details.
+*/
+#ifndef __FAL_TRACE_H__
+#define __FAL_TRACE_H__
+
+/*
+  Per-thread ring buffers of allocator events, default implementation of
+  arena hooks:
+    #define FAL_ARENA_DEF_HOOKS fal_trace
+
+  Thread takes ring on its first event and is the only writer of it, so
+  recording event is a clock read, a few plain stores and one release store
+  of ring head: no locks, no atomic read-modify-write after the first event.
+  Ring keeps last FAL_TRACE_RING_LEN events, older ones are overwritten.
+  Rings are mapped from os on demand and fal_trace_thread_exit gives ring
+  of exiting thread to the next new one, which continues it, so memory
+  stays proportional to threads alive at once. Events are dropped and
+  counted only when os refuses to map ring.
+
+  Compile-time parameters (define before the first include):
+    (opt) FAL_TRACE_DEF_RING_POW    - default: 12; power of events per ring
+    (opt) FAL_TRACE_DEF_CLOCK()     - default: TSC on x86, monotonic ns
+                                      otherwise; uint64_t timestamp
+    (opt) FAL_TRACE_DEF_MAP(Size)   - default: mmap or VirtualAlloc; map
+                                      zeroed memory for ring or dump buffer,
+                                      0 on failure, must not record events
+    (opt) FAL_TRACE_DEF_UNMAP(Ptr, Size) - required with FAL_TRACE_DEF_MAP;
+                                      release mapped dump buffer
+
+  API:
+    Types:
+      fal_trace_event_t - recorded event
+      fal_trace_file_t - header of dump
+      fal_trace_ring_t - header of ring in dump, followed by its events
+
+    Recording:
+      void fal_trace(unsigned kind, void* ptr, size_t size, size_t arg)
+        record event of kind (fal_trace_kind_t or user's starting with
+        FAL_TRACE_USER) in calling thread's ring
+      void fal_trace_on_alloc(void* ptr, size_t size)
+      void fal_trace_on_free(void* ptr, size_t size)
+      void fal_trace_on_extend(void* ptr, size_t oldsize, size_t size)
+        arena hooks, see FAL_ARENA_DEF_HOOKS in fal/arena.h
+      void fal_trace_on_os_map(void* ptr, size_t size)
+      void fal_trace_on_os_unmap(void* ptr, size_t size)
+        hooks for code which maps arenas, arena doesn't call them
+      void fal_trace_thread_exit()
+        give ring of calling thread to the next thread which records event,
+        call when thread exits (microalloc's mc_thread_exit does)
+
+    Dumping:
+      size_t fal_trace_dump(FILE*)
+        write all rings in binary, returns number of events written,
+        may be called from any thread at any time: events overwritten while
+        they were copied are skipped
+      size_t fal_trace_dropped()
+        number of events dropped because ring couldn't be mapped
+
+  Dump format, native endianness and sizes:
+    fal_trace_file_t, then fal_trace_file_t.rings times fal_trace_ring_t
+    followed by fal_trace_ring_t.events fal_trace_event_t, oldest first.
+    samples/arena/trace-dump.c prints it as text.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "utils.h"
+#include "atomic.h"
+
+#ifndef FAL_TRACE_DEF_RING_POW
+#define FAL_TRACE_DEF_RING_POW 12
+#endif
+
+#if !defined(FAL_TRACE_DEF_MAP)
+# if defined(_WIN32)
+#  define __VC_EXTRALEAN
+#  include <Windows.h>
+#  define FAL_TRACE_DEF_MAP(Size) \
+  VirtualAlloc(0, Size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)
+#  define FAL_TRACE_DEF_UNMAP(Ptr, Size) VirtualFree(Ptr, 0, MEM_RELEASE)
+# else
+#  include <sys/mman.h>
+   static inline void* fal_trace__map(size_t size) {
+     void* mem = mmap(0, size, PROT_READ | PROT_WRITE,
+       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+     return mem == MAP_FAILED ? 0 : mem;
+   }
+#  define FAL_TRACE_DEF_MAP(Size) fal_trace__map(Size)
+#  define FAL_TRACE_DEF_UNMAP(Ptr, Size) munmap(Ptr, Size)
+# endif
+#endif
+
+#if defined(_MSC_VER)
+# define FAL_TRACE__THREAD_LOCAL __declspec(thread)
+#else
+# define FAL_TRACE__THREAD_LOCAL __thread
+#endif
+
+#if defined(FAL_TRACE_DEF_CLOCK)
+# define FAL_TRACE__CLOCK() FAL_TRACE_DEF_CLOCK()
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+# include <intrin.h>
+# define FAL_TRACE__CLOCK() ((uint64_t)__rdtsc())
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define FAL_TRACE__CLOCK() ((uint64_t)__builtin_ia32_rdtsc())
+#else
+# include <time.h>
+  static inline uint64_t fal_trace__clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+  }
+# define FAL_TRACE__CLOCK() fal_trace__clock()
+#endif
+
+typedef enum fal_trace_kind_t {
+  FAL_TRACE_ALLOC = 1,  /* ptr, size */
+  FAL_TRACE_FREE,       /* ptr, size */
+  FAL_TRACE_EXTEND,     /* ptr, size, arg = old size */
+  FAL_TRACE_OS_MAP,     /* ptr, size */
+  FAL_TRACE_OS_UNMAP,   /* ptr, size */
+  FAL_TRACE_USER = 64   /* first kind free for user events */
+} fal_trace_kind_t;
+
+enum fal_trace_defs_t {
+  FAL_TRACE_RING_LEN = 1u << FAL_TRACE_DEF_RING_POW,
+  FAL_TRACE_VERSION = 1
+};
+
+typedef struct fal_trace_event_t fal_trace_event_t;
+struct fal_trace_event_t {
+  uint64_t time;
+  uint64_t ptr;
+  uint64_t size;
+  uint64_t arg;
+  uint32_t kind;
+  uint32_t reserved;
+};
+
+typedef struct fal_trace_file_t fal_trace_file_t;
+struct fal_trace_file_t {
+  char magic[8];         /* "FALTRACE" */
+  uint32_t version;      /* FAL_TRACE_VERSION */
+  uint32_t event_size;   /* sizeof(fal_trace_event_t) */
+  uint32_t rings;
+  uint32_t reserved;
+  uint64_t dropped;      /* events of threads which couldn't get ring */
+};
+
+typedef struct fal_trace_ring_t fal_trace_ring_t;
+struct fal_trace_ring_t {
+  uint32_t thread;       /* ring number, threads reuse rings of exited ones */
+  uint32_t reserved;
+  uint64_t events;       /* events in dump */
+  uint64_t total;        /* events ever recorded, older are overwritten */
+};
+
+typedef struct fal_trace__ring_t fal_trace__ring_t;
+struct fal_trace__ring_t {
+  volatile size_t head;     /* events written, only owner thread stores it */
+  size_t number;            /* order of mapping */
+  fal_trace__ring_t* next;  /* next in list of all rings, never changes */
+  fal_trace__ring_t* spare; /* next ring left by exited thread */
+  char pad[64 - 2 * sizeof(size_t) - 2 * sizeof(void*)];
+  fal_trace_event_t events[FAL_TRACE_RING_LEN];
+};
+
+/* All rings, newest first, are published with release store of head, so
+   dump walks them without lock. Spare rings and mapping take the lock. */
+static fal_trace__ring_t* volatile fal_trace__rings = 0;
+static fal_trace__ring_t* fal_trace__spare = 0;
+static size_t fal_trace__count = 0;
+static volatile size_t fal_trace__lock = 0;
+static volatile size_t fal_trace__dropped = 0;
+static FAL_TRACE__THREAD_LOCAL fal_trace__ring_t* fal_trace__self = 0;
+
+static inline void fal_trace__acquire() {
+  while (!fal_atomic_cas(&fal_trace__lock, 0, 1)) {
+  }
+}
+
+static inline void fal_trace__release() {
+  fal_atomic_store(&fal_trace__lock, 0, FAL_ATOMIC_RELEASE);
+}
+
+/* Ring of calling thread, spare or newly mapped one, 0 if os is out of
+   memory. */
+static inline fal_trace__ring_t* fal_trace__ring() {
+  if (fal_trace__self) {
+    return fal_trace__self;
+  }
+
+  fal_trace__acquire();
+  fal_trace__ring_t* ring = fal_trace__spare;
+  if (ring) {
+    fal_trace__spare = ring->spare;
+  } else {
+    ring = (fal_trace__ring_t*)FAL_TRACE_DEF_MAP(sizeof(fal_trace__ring_t));
+    if (ring) {
+      ring->number = fal_trace__count++;
+      ring->next = fal_trace__rings;
+      fal_atomic_store_ptr((void* volatile*)&fal_trace__rings, ring,
+        FAL_ATOMIC_RELEASE);
+    }
+  }
+  fal_trace__release();
+
+  fal_trace__self = ring;
+  return ring;
+}
+
+static inline void fal_trace(unsigned kind, void* ptr, size_t size,
+  size_t arg) {
+  fal_trace__ring_t* ring = fal_trace__ring();
+  if (!ring) {
+    fal_atomic_add(&fal_trace__dropped, 1);
+    return;
+  }
+
+  size_t head = ring->head;
+  fal_trace_event_t* event = &ring->events[head & (FAL_TRACE_RING_LEN - 1)];
+  event->time = FAL_TRACE__CLOCK();
+  event->ptr = (uint64_t)(uintptr_t)ptr;
+  event->size = size;
+  event->arg = arg;
+  event->kind = kind;
+  event->reserved = 0;
+  fal_atomic_store(&ring->head, head + 1, FAL_ATOMIC_RELEASE);
+}
+
+static inline void fal_trace_on_alloc(void* ptr, size_t size) {
+  fal_trace(FAL_TRACE_ALLOC, ptr, size, 0);
+}
+
+static inline void fal_trace_on_free(void* ptr, size_t size) {
+  fal_trace(FAL_TRACE_FREE, ptr, size, 0);
+}
+
+static inline void fal_trace_on_extend(void* ptr, size_t oldsize,
+  size_t size) {
+  fal_trace(FAL_TRACE_EXTEND, ptr, size, oldsize);
+}
+
+static inline void fal_trace_on_os_map(void* ptr, size_t size) {
+  fal_trace(FAL_TRACE_OS_MAP, ptr, size, 0);
+}
+
+static inline void fal_trace_on_os_unmap(void* ptr, size_t size) {
+  fal_trace(FAL_TRACE_OS_UNMAP, ptr, size, 0);
+}
+
+static inline void fal_trace_thread_exit() {
+  fal_trace__ring_t* ring = fal_trace__self;
+  if (!ring) {
+    return;
+  }
+
+  fal_trace__acquire();
+  ring->spare = fal_trace__spare;
+  fal_trace__spare = ring;
+  fal_trace__release();
+  fal_trace__self = 0;
+}
+
+static inline size_t fal_trace_dropped() {
+  return fal_atomic_load(&fal_trace__dropped, FAL_ATOMIC_RELAXED);
+}
+
+static inline size_t fal_trace_dump(FILE* file) {
+  fal_trace_event_t* copy = (fal_trace_event_t*)FAL_TRACE_DEF_MAP(
+    sizeof(fal_trace_event_t) * FAL_TRACE_RING_LEN);
+  if (!copy) {
+    return 0;
+  }
+
+  /* Rings mapped after the head was read are left out. */
+  fal_trace__ring_t* first_ring = (fal_trace__ring_t*)fal_atomic_load_ptr(
+    (void* const volatile*)&fal_trace__rings, FAL_ATOMIC_ACQUIRE);
+  size_t rings = first_ring ? first_ring->number + 1 : 0;
+  size_t written = 0;
+
+  fal_trace_file_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "FALTRACE", sizeof(header.magic));
+  header.version = FAL_TRACE_VERSION;
+  header.event_size = sizeof(fal_trace_event_t);
+  header.rings = (uint32_t)rings;
+  header.dropped = fal_trace_dropped();
+  fwrite(&header, sizeof(header), 1, file);
+
+  for (fal_trace__ring_t* ring = first_ring; ring; ring = ring->next) {
+    size_t head = fal_atomic_load(&ring->head, FAL_ATOMIC_ACQUIRE);
+    size_t first = head > FAL_TRACE_RING_LEN ? head - FAL_TRACE_RING_LEN : 0;
+    for (size_t ix = first; ix < head; ix++) {
+      copy[ix - first] = ring->events[ix & (FAL_TRACE_RING_LEN - 1)];
+    }
+
+    /* Owner may have overwritten copied events meanwhile, and may be in the
+       middle of writing the one after its new head. */
+    size_t after = fal_atomic_load(&ring->head, FAL_ATOMIC_ACQUIRE);
+    size_t valid = after >= FAL_TRACE_RING_LEN ? after - FAL_TRACE_RING_LEN + 1
+      : 0;
+    size_t skip = valid > first ? valid - first : 0;
+    skip = skip < head - first ? skip : head - first;
+
+    fal_trace_ring_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.thread = (uint32_t)ring->number;
+    entry.events = head - first - skip;
+    entry.total = head;
+    fwrite(&entry, sizeof(entry), 1, file);
+    fwrite(copy + skip, sizeof(fal_trace_event_t), head - first - skip, file);
+    written += head - first - skip;
+  }
+
+  FAL_TRACE_DEF_UNMAP(copy, sizeof(fal_trace_event_t) * FAL_TRACE_RING_LEN);
+  return written;
+}
+
+#endif /* __FAL_TRACE_H__ */
@@ -0,0 +1,228 @@
+/*
+  libfalmalloc.so - malloc replacement on top of microalloc.h, to run real
+  programs on it:
+    LD_PRELOAD=./libfalmalloc.so program
+
+  Exports malloc, free, realloc, calloc, posix_memalign, aligned_alloc,
+  malloc_usable_size and obsolete memalign, valloc, pvalloc and
+  reallocarray, which libc would otherwise serve from its own heap.
+
+  microalloc is initialized by the first call from any thread. Threads are
+  tracked with pthread key whose destructor calls mc_thread_exit, so their
+  buckets are reused by next threads. Heap map lock is taken around fork.
+
+  libc malloc aligns to 16 bytes, mc_alloc only to 8 bytes, so sizes above
+  8 bytes are rounded to mc_ALIGN.
+
+  libfalmalloc-trace.so is built with MC_TRACE and dumps fal/trace.h rings
+  at exit to file named by FALMALLOC_TRACE environment variable, see
+  trace-dump.c. Rings of exited threads are reused via mc_thread_exit.
+
+  libfalmalloc-profile.so is built with MC_PROFILE and dumps heap profile at
+  exit to file named by FALMALLOC_PROFILE, sampling one allocation per
+  FALMALLOC_SAMPLE bytes (default: mc_tuning.sample) on average:
+    FALMALLOC_PROFILE=heap.prof LD_PRELOAD=./libfalmalloc-profile.so program
+    pprof program heap.prof
+*/
+#include "microalloc.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define FALMALLOC_EXPORT __attribute__((visibility("default")))
+
+/* Init states. */
+enum {
+  FALMALLOC_NONE = 0,
+  FALMALLOC_BUSY,
+  FALMALLOC_READY
+};
+
+static volatile size_t falmalloc_state = FALMALLOC_NONE;
+static volatile size_t falmalloc_keyed = 0;
+static pthread_key_t falmalloc_key;
+static MC_THREAD_LOCAL mc_thread_t* falmalloc_tracked = 0;
+
+static void falmalloc_thread_exit(void* self) {
+  FAL_UNUSED(self);
+  mc_thread_exit();
+}
+
+static void falmalloc_fork_lock(void) {
+  mc__lock();
+}
+
+static void falmalloc_fork_unlock(void) {
+  mc__unlock();
+}
+
+#if defined(MC_TRACE)
+static void falmalloc_dump(void) {
+  const char* path = getenv("FALMALLOC_TRACE");
+  FILE* file = path ? fopen(path, "wb") : 0;
+  if (file) {
+    fal_trace_dump(file);
+    fclose(file);
+  }
+}
+#endif
+
+#if defined(MC_PROFILE)
+static void falmalloc_profile(void) {
+  const char* path = getenv("FALMALLOC_PROFILE");
+  FILE* file = path ? fopen(path, "w") : 0;
+  if (file) {
+    mc_profile_dump(file);
+    fclose(file);
+  }
+}
+#endif
+
+/* Key and fork handlers may allocate themselves, so they are created after
+   microalloc is ready for other calls. */
+static void falmalloc_init(void) {
+  if (fal_atomic_load(&falmalloc_state, FAL_ATOMIC_ACQUIRE) == FALMALLOC_READY) {
+    return;
+  }
+
+  if (!fal_atomic_cas(&falmalloc_state, FALMALLOC_NONE, FALMALLOC_BUSY)) {
+    while (fal_atomic_load(&falmalloc_state, FAL_ATOMIC_ACQUIRE)
+      != FALMALLOC_READY) {
+    }
+    return;
+  }
+
+#if defined(MC_PROFILE)
+  const char* sample = getenv("FALMALLOC_SAMPLE");
+  if (sample) {
+    mc_tuning.sample = strtoul(sample, 0, 0);
+  }
+#endif
+  mc_init();
+  fal_atomic_store(&falmalloc_state, FALMALLOC_READY, FAL_ATOMIC_RELEASE);
+
+  if (pthread_key_create(&falmalloc_key, falmalloc_thread_exit) == 0) {
+    fal_atomic_store(&falmalloc_keyed, 1, FAL_ATOMIC_RELEASE);
+  }
+  pthread_atfork(falmalloc_fork_lock, falmalloc_fork_unlock,
+    falmalloc_fork_unlock);
+#if defined(MC_TRACE)
+  atexit(falmalloc_dump);
+#endif
+#if defined(MC_PROFILE)
+  atexit(falmalloc_profile);
+#endif
+}
+
+/* Make sure thread set microalloc just gave calling thread is left on
+   thread exit. */
+static void* falmalloc_track(void* mem) {
+  if (falmalloc_tracked != mc_self
+    && fal_atomic_load(&falmalloc_keyed, FAL_ATOMIC_ACQUIRE)) {
+    falmalloc_tracked = mc_self;
+    pthread_setspecific(falmalloc_key, mc_self);
+  }
+  return mem;
+}
+
+static void* falmalloc_result(void* mem) {
+  if (!mem) {
+    errno = ENOMEM;
+  }
+  return falmalloc_track(mem);
+}
+
+/* Size whose class is aligned like libc's malloc. */
+static size_t falmalloc_size(size_t size) {
+  return size <= mc_bucket_BLOCK_SIZE ? size
+    : (size + mc_ALIGN - 1) & ~(size_t)(mc_ALIGN - 1);
+}
+
+static int falmalloc_pow2(size_t align) {
+  return align && !(align & (align - 1));
+}
+
+FALMALLOC_EXPORT void* malloc(size_t size) {
+  falmalloc_init();
+  return falmalloc_result(mc_alloc(falmalloc_size(size)));
+}
+
+FALMALLOC_EXPORT void free(void* ptr) {
+  if (ptr) {
+    mc_free(ptr);
+  }
+}
+
+FALMALLOC_EXPORT void* realloc(void* ptr, size_t size) {
+  if (!ptr) {
+    return malloc(size);
+  }
+  if (!size) {
+    mc_free(ptr);
+    return 0;
+  }
+
+  return falmalloc_result(mc_realloc(ptr, falmalloc_size(size)));
+}
+
+FALMALLOC_EXPORT void* calloc(size_t count, size_t size) {
+  falmalloc_init();
+  if (size && count > (size_t)-1 / size) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  return falmalloc_result(mc_calloc(1, falmalloc_size(count * size)));
+}
+
+FALMALLOC_EXPORT void* reallocarray(void* ptr, size_t count, size_t size) {
+  if (size && count > (size_t)-1 / size) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  return realloc(ptr, count * size);
+}
+
+FALMALLOC_EXPORT int posix_memalign(void** memptr, size_t align, size_t size) {
+  if (!falmalloc_pow2(align) || align % sizeof(void*)) {
+    return EINVAL;
+  }
+
+  falmalloc_init();
+  void* mem = falmalloc_track(mc_aligned_alloc(align, falmalloc_size(size)));
+  if (!mem) {
+    return ENOMEM;
+  }
+
+  *memptr = mem;
+  return 0;
+}
+
+FALMALLOC_EXPORT void* aligned_alloc(size_t align, size_t size) {
+  if (!falmalloc_pow2(align)) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  falmalloc_init();
+  return falmalloc_result(mc_aligned_alloc(align, falmalloc_size(size)));
+}
+
+FALMALLOC_EXPORT void* memalign(size_t align, size_t size) {
+  return aligned_alloc(align, size);
+}
+
+FALMALLOC_EXPORT void* valloc(size_t size) {
+  return aligned_alloc(mc_heap_GRANULE, size);
+}
+
+FALMALLOC_EXPORT void* pvalloc(size_t size) {
+  return aligned_alloc(mc_heap_GRANULE,
+    (size + mc_heap_GRANULE - 1) & ~(size_t)(mc_heap_GRANULE - 1));
+}
+
+FALMALLOC_EXPORT size_t malloc_usable_size(void* ptr) {
+  return ptr ? mc_size(ptr) : 0;
+}
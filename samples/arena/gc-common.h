@@ -47,10 +47,6 @@ typedef struct object_t object_t;
 struct object_t {
   int id;
   struct object_t* next;
-
-#ifdef NEWPOS
-  void* newpos;
-#endif
 };
 
 static void print_objs(space_t* space) {
@@ -63,9 +59,6 @@ static void print_objs(space_t* space) {
       if (space_marked(obj)) {
         printf(" (marked)");
       }
-#ifdef NEWPOS
-      printf(" will be %p", obj->newpos);
-#endif
       printf("\n");
     } else {
       printf("  @%p %zu empty bytes\n", (void*)obj, space_size(obj));
@@ -1,4 +1,3 @@
-#define NEWPOS
 #include "gc-common.h"
 
 int main() {
@@ -25,59 +24,29 @@ int main() {
     }
   }
 
-  /* Calculate new positions for marked objects */ {
-    char* newpos = space_mem_start(space);
-    for (object_t* obj = space_first(space); obj; obj = space_next(obj)) {
-      if (!space_marked(obj)) {
-        continue;
-      }
-
-      obj->newpos = newpos;
-      size_t obj_size = space_size(obj);
-
-      assert(newpos < (char*)space_mem_end(space) && "arena overflow");
-
-      newpos += obj_size;
-    }
-  }
+  /* New position of marked object is start of arena plus size of marked
+     objects before it, table caches those sizes for every 64 blocks. */
+  static space_fwd_t table[space_FWD_LEN];
+  space_forward_build(space, table);
 
   printf("Before GC (but after mark):\n  root = %p\n", (void*)root);
   print_objs(space);
 
   /* Update references */ {
-    for (object_t* obj = space_first(space); obj; obj = space_next(obj)) {
-      if (space_marked(obj) && obj->next) {
-        printf(":: fix %p->next from %p to %p\n", (void*)obj, (void*)obj->next, (void*)obj->next->newpos);
-        obj->next = obj->next->newpos;
+    for (object_t* obj = space_first_marked(space); obj; obj = space_next_marked(obj)) {
+      if (obj->next) {
+        object_t* newpos = space_forward(table, obj->next);
+        printf(":: fix %p->next from %p to %p\n", (void*)obj, (void*)obj->next, (void*)newpos);
+        obj->next = newpos;
       }
     }
 
-    root = root->newpos;
+    root = space_forward(table, root);
   }
 
   /* Compact phase */ {
-    char* newpos;
-    size_t size;
-    object_t* next;
-    for (object_t* obj = space_first(space); obj; obj = next) {
-      next = space_next(obj);
-      if (!space_marked(obj)) {
-        continue;
-      }
-
-      printf(":: moving %p to %p\n", (void*)obj, (void*)obj->newpos);
-      if (obj == obj->newpos) {
-        continue;
-      }
-
-      newpos = obj->newpos;
-      size = space_size(obj);
-      space_emplace(newpos, size);
-      memmove(newpos, obj, size);
-    }
-
-    space_emplace_end(newpos + size);
-    space_mark_all(space, 0);
+    /* Slide marked objects to the start of arena and free everything else. */
+    space_compact(space);
   }
 
   printf("After GC:\n  root = %p\n", (void*)root);
@@ -28,13 +28,8 @@ int main() {
   print_objs(space);
 
   /* Sweep phase */ {
-    for (object_t* obj = space_first(space); obj; obj = space_next(obj)) {
-      if (!space_marked(obj)) {
-        space_free(obj);
-      }
-    }
-
-    space_mark_all(space, 0);
+    /* Frees unmarked objects and unmarks marked ones in one pass. */
+    space_sweep(space);
   }
 
   printf("After GC:\n  root = %p\n", (void*)root);
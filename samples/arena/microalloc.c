@@ -1,218 +1,145 @@
+/* Records every allocation event, see trace-dump.c, and samples heap. */
+#define MC_TRACE
+#define MC_PROFILE
+#include "microalloc.h"
+
+/* Usage: microalloc [trace file] [heap profile file] */
+int main(int argc, char** argv) {
+  /* Dense sampling, so every path of mc_free retires samples. */
+  mc_tuning.sample = 64;
+  mc_init();
 
-#include <stdio.h>
-#include <string.h>
-
-/*
-  mc_alloc is small and dirty alloc/free/realloc implementation.
-  It distinguishes small (< ~1000 bytes) and huge allocation and uses fal/arena
-  for first ones.
-
-
-  For small allocations (< 1000 bytes) mc_alloc uses linked list of
-  arenas called buckets (mc_bucket_t):
-   START BUCKET BUCKET BUCKET ... BUCKET  NULL
-    \----/   \---/  \---/  \--...--/  \---/
-
-  During mc_alloc it walk though them until it finds one that have enough free
-  memory and allocates from it. If none was found it allocates new page from os
-  and appends it to end of list.
-
-  For huge allocations mc_alloc allocates memory directly from os.
-
-  Microalloc can distinguish small allocations from huge by calling
-  arena_can_belong, since huge allocation aligned at start of possible
-  bucket they cannot be possibly allocated from bucket.
-
-  For small allocations mc_free frees memory in bucket and removes bucket from
-  list and returns it to os if it became empty after removal.
-  For huge allocations mc_free simply returns memory to os.
-
-  mc_realloc tries to use arena_extend for small allocations and fallbacks to
-  mc_alloc-memcpy-mc_free if it doesn't work and for all huge allocations.
-*/
-
-#if defined(_WIN32)
-# define __VC_EXTRALEAN
-# include <Windows.h>
-  static inline void* osalloc(size_t size) {
-    void* mem = VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-    return fprintf(stderr, "[trace] VirtualAlloc: %p\n", mem), mem;
-  }
-#elif defined(linux) || defined(__MINGW32__) || defined(__GNUC__)
-# include <sys/mman.h>
-  static inline void* osalloc(size_t size) {
-    void* mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    return fprintf(stderr, "[trace] mmap: %p\n", mem), mem;
-  }
-  static inline void osfree(void* ptr, size_t size) {
-    munmap(ptr, size);
-    fprintf(stderr, "[trace] munmap: %p %zu\n", ptr, size);
-  }
-#else
-# error Dont know how to alloc page on this system.
-#endif
-
-typedef struct mc_header_t mc_header_t;
-struct mc_header_t {
-  mc_header_t* next;
-  mc_header_t* prev;
-};
-
-typedef struct mc_huge_t mc_huge_t;
-struct mc_huge_t {
-  void* ptr;
-  size_t size;
-};
-
-#define FAL_ARENA_DEF_POW         12u /* 4 KiB arena */
-#define FAL_ARENA_DEF_BLOCK_POW   3u  /* 8 byte blocks */
-#define FAL_ARENA_DEF_INCOMPACT   /* 4 KiB arena can't be compact */
-#define FAL_ARENA_DEF_HEADER_SIZE sizeof(mc_header_t)
-#define FAL_ARENA_DEF_NAME        mc_bucket
-#include <fal/arena.h>
-
-static mc_bucket_t* mc_huge = 0;
-static mc_header_t* mc_start = 0;
-void mc_init() {
-  mc_huge = osalloc(mc_bucket_SIZE);
-  assert(mc_huge);
-
-  mc_bucket_init(mc_huge);
-}
-
-void* mc_alloc(size_t size) {
-  if (size > mc_bucket_EFFECTIVE_SIZE / 4) {
-    mc_huge_t* entry = mc_bucket_alloc(mc_huge, sizeof(mc_huge_t));
-    assert(entry && "No more space for huge entries.");
-
-    void* mem = osalloc(size);
-    entry->ptr = mem;
-    entry->size = size;
+  char* str = mc_alloc(8);
+  strcpy(str, "0123456");
 
-    return mem;
-  }
+  str = mc_realloc(str, 16);
+  assert(str && strcmp(str, "0123456") == 0);
 
-  mc_header_t* last = 0;
-  mc_header_t* curr = mc_start;
-  for (; curr; last = curr, curr = curr->next) {
-    mc_bucket_t* bucket = mc_bucket_for(curr);
-    void* mem = mc_bucket_alloc(bucket, size);
-    if (mem) {
-      return mem;
-    }
-  }
+  strcpy(str, "0123456789abcde");
 
-  mc_bucket_t* bucket = osalloc(mc_bucket_SIZE);
-  mc_bucket_init(bucket);
+  str = mc_realloc(str, 32);
+  assert(str && strcmp(str, "0123456789abcde") == 0);
 
-  mc_header_t* header = mc_bucket_header(bucket);
-  header->next = 0;
-  header->prev = last;
+  mc_free(str);
 
-  if (last) {
-    last->next = header;
-  } else {
-    mc_start = header;
+  void* ptrs[128];
+  for (int i = 0; i < 128; i++) {
+    ptrs[i] = mc_alloc(512);
   }
 
-
-  return mc_bucket_alloc(bucket, size);
-}
-
-mc_huge_t* mc__get_huge(void* ptr) {
-  for (mc_huge_t* entry = mc_bucket_first(mc_huge); entry; entry = mc_bucket_next(entry)) {
-    if (entry->ptr == ptr) {
-      return entry;
-    }
+  for (int i = 0; i < 128; i++) {
+    mc_free(ptrs[i]);
   }
 
-  return 0;
-}
-
-void mc_free(void* ptr) {
-  if (!mc_bucket_can_belong(ptr)) {
-    mc_huge_t* entry = mc__get_huge(ptr);
-    assert(entry && "Trying to mc_free memory allocated not with mc_alloc.");
-    osfree(ptr, entry->size);
-
-    mc_bucket_free(entry);
-    return;
+  /* Medium allocations grow in place while arena has room after them. */
+  char* medium = mc_alloc(2048);
+  assert(medium);
+  memset(medium, 'm', 2048);
+  char* grown = mc_realloc(medium, 16384);
+  assert(grown == medium && grown[2047] == 'm');
+  mc_free(grown);
+
+  /* Huge allocations are not limited in number. */
+  static void* huge[4096];
+  for (int i = 0; i < 4096; i++) {
+    huge[i] = mc_alloc(mc_MEDIUM_MAX + 1 + i);
+    assert(huge[i]);
+    memset(huge[i], i & 0xff, 2048);
   }
 
-  mc_bucket_t* bucket = mc_bucket_for(ptr);
-  mc_bucket_free(ptr);
-
-  if (mc_bucket_empty(bucket)) {
-    mc_header_t* header = mc_bucket_header(bucket);
-    if (header->prev) {
-      header->prev->next = header->next;
-    } else {
-      mc_start = header->next;
-    }
-
-    if (header->next) {
-      header->next->prev = header->prev;
-    }
-
-    osfree(bucket, mc_bucket_SIZE);
+  for (int i = 0; i < 4096; i++) {
+    huge[i] = mc_realloc(huge[i], mc_MEDIUM_MAX + 4096 + i);
+    assert(huge[i] && ((unsigned char*)huge[i])[2047] == (i & 0xff));
   }
-}
 
-void* mc_realloc(void* ptr, size_t newsize) {
-  size_t size;
-  if (mc_bucket_can_belong(ptr)) {
-    if (mc_bucket_extend(ptr, newsize)) {
-      return ptr;
-    }
-
-    size = mc_bucket_size(ptr);
-  } else {
-    mc_huge_t* entry = mc__get_huge(ptr);
-    assert(entry && "Trying to mc_realloc memory allocated not with mc_alloc.");
-
-    size = entry->size;
+  for (int i = 0; i < 4096; i++) {
+    mc_free(huge[i]);
   }
 
-  void* newptr = mc_alloc(newsize);
-  if (!newptr) {
-    return 0;
+  /* Huge allocations grow and shrink in their mapping keeping data. */
+  size_t* vec = mc_alloc(65536u);
+  assert(vec);
+  for (size_t len = 65536u; len <= 16 * 65536u; len *= 2) {
+    vec = mc_realloc(vec, len);
+    assert(vec);
+    vec[len / sizeof(size_t) - 1] = len;
   }
+  for (size_t len = 16 * 65536u; len >= 65536u; len /= 2) {
+    assert(vec[len / sizeof(size_t) - 1] == len);
+    vec = mc_realloc(vec, len);
+    assert(vec);
+  }
+  mc_free(vec);
 
-  memcpy(newptr, ptr, newsize < size ? newsize : size);
-  mc_free(ptr);
-
-  return newptr;
-}
-
-int main() {
-  mc_init();
-
-  char* str = mc_alloc(8);
-  strcpy(str, "0123456");
-
-  str = mc_realloc(str, 16);
-  assert(str && strcmp(str, "0123456") == 0);
-
-  strcpy(str, "0123456789abcde");
-
-  str = mc_realloc(str, 32);
-  assert(str && strcmp(str, "0123456789abcde") == 0);
-
-  mc_free(str);
-
-  void* ptrs[128];
+  /* Freed memory comes back zeroed from mc_calloc. */
   for (int i = 0; i < 128; i++) {
     ptrs[i] = mc_alloc(512);
+    memset(ptrs[i], 0xff, 512);
+  }
+  for (int i = 0; i < 128; i++) {
+    mc_free(ptrs[i]);
+  }
+  for (int i = 0; i < 128; i++) {
+    unsigned char* zeroed = mc_calloc(64, 8);
+    assert(zeroed && zeroed[0] == 0 && zeroed[511] == 0);
+    ptrs[i] = zeroed;
   }
-
   for (int i = 0; i < 128; i++) {
     mc_free(ptrs[i]);
   }
 
+  /* Alignment moves allocation to the kind which guarantees it. */
+  for (size_t align = 8; align <= 65536u; align *= 2) {
+    void* aligned = mc_aligned_alloc(align, 24);
+    assert(aligned && ((uintptr_t)aligned & (align - 1)) == 0);
+    assert(mc_size(aligned) >= 24);
+    mc_free(aligned);
+  }
+
   void* mem = mc_alloc(65536u);
   assert(mem);
   mem = mc_realloc(mem, 2*65536u);
   assert(mem);
 
   mc_free(mem);
+
+  /* Everything is freed, so are samples. */
+  assert(mc_stats().samples == 0);
+
+  /* Allocations far above sampling interval are sampled for sure. */
+  for (int i = 0; i < 16; i++) {
+    ptrs[i] = mc_alloc(i % 2 ? mc_SMALL_MAX : 16384);
+  }
+  ptrs[16] = mc_alloc(mc_MEDIUM_MAX * 4);
+  assert(mc_stats().samples == 17);
+
+  FILE* profile = argc > 2 ? fopen(argv[2], "w") : tmpfile();
+  assert(profile && mc_profile_dump(profile) == 17);
+  fclose(profile);
+
+  for (int i = 0; i <= 16; i++) {
+    mc_free(ptrs[i]);
+  }
+  assert(mc_stats().samples == 0);
+
+  /* Side table grows instead of dropping samples of large heap. */
+  {
+    enum { MANY = 10000 };
+    static void* many[MANY];
+    for (int i = 0; i < MANY; i++) {
+      many[i] = mc_alloc(mc_SMALL_MAX);
+      assert(many[i]);
+    }
+    assert(mc_stats().samples == MANY && !mc_stats().samples_dropped);
+    for (int i = 0; i < MANY; i++) {
+      mc_free(many[i]);
+    }
+    assert(mc_stats().samples == 0);
+  }
+
+  FILE* trace = argc > 1 ? fopen(argv[1], "wb") : 0;
+  if (trace) {
+    fal_trace_dump(trace);
+    fclose(trace);
+  }
 }
@@ -0,0 +1,1493 @@
+#ifndef __FAL_SAMPLES_MICROALLOC_H__
+#define __FAL_SAMPLES_MICROALLOC_H__
+
+#include <string.h>
+#include <fal/utils.h>
+#include <fal/atomic.h>
+
+/*
+  mc_alloc is small and dirty alloc/free/realloc implementation.
+  It distinguishes small (< ~1000 bytes), medium (< ~32 KiB) and huge
+  allocation and uses fal/arena for first two.
+
+
+  Small sizes are rounded up to size classes: multiples of 8 bytes up to 64,
+  then four classes per power of two (80, 96, 112, 128, 160, ...) up to
+  mc_SMALL_MAX. Allocations are served from arenas called buckets
+  (mc_bucket_t), bucket only ever holds allocations of one class.
+
+  Every bucket header keeps number of free blocks and upper bound of its
+  longest free run. Allocation lowers the bound to number of free blocks, and
+  allocation which failed despite the bound lowers it below requested size.
+  Freed run may merge with two free neighbours, each not longer than the
+  bound, so free raises it to twice the bound plus freed run.
+
+  Every class has linked list of buckets whose bound fits its size, i.e.
+  which are not known to be full:
+   CLASS[i].first BUCKET BUCKET ... BUCKET  NULL
+               \----/   \---/  \--...--/  \---/
+
+  mc_alloc allocates from first bucket of class list and unlinks buckets
+  which turn out to be full. Full buckets aren't linked anywhere until
+  mc_free makes room in them, so when whole class is full mc_alloc goes to os
+  right away. New page from os is pushed to front of class list.
+
+  Medium allocations come from 256 KiB arenas with 64 byte blocks
+  (mc_medium_t), mapped aligned to their size. Sizes are rounded only to
+  blocks, arena holds any mix of them. Arena header keeps free blocks and
+  longest run bound like bucket's, but free finds run it merged into with
+  mc_medium_prev/mc_medium_next and raises bound only up to it. Every thread
+  has lists of medium arenas binned by power of two of the bound, arenas
+  whose bound can't fit the smallest medium allocation aren't listed.
+  mc_alloc looks through the bin of request size skipping arenas whose bound
+  is shorter, and then takes the first arena of any larger bin, where every
+  bound fits. Thread keeps one empty medium arena as spare
+  instead of returning it to os. mc_tuning.medium_max sets largest medium
+  allocation, 0 sends everything above small to os.
+
+  For huge allocations mc_alloc allocates memory directly from os, with one
+  extra heap map granule in front of it. Granule holds mc_huge_t entry, so
+  entry of huge allocation is found by subtracting granule from pointer.
+  Huge allocations are resized within their mapping: shrinking unmaps the
+  tail, growing asks os to grow or move the mapping (mremap on Linux), so
+  their data is never copied. Entry moves together with the mapping.
+
+  Buckets and medium arenas belong to threads. Every thread has its own set
+  of lists (mc_thread_t) and every bucket and arena header points to its
+  owner, so mc_alloc and mc_free of owned memory touch nothing shared and
+  take no locks. mc_free of memory owned by another thread pushes it to
+  atomic remote-free list of its bucket, and bucket whose list was empty is
+  pushed to pending list of the owner. Owner takes whole pending list and
+  frees everything from remote lists in one batch when its class list runs
+  out, before going to os.
+
+  Thread set is created on first mc_alloc in a thread. Thread which is done
+  with allocations calls mc_thread_exit, its set is left to the next new
+  thread together with its buckets, which may still be used by others.
+  Buckets of thread which exited without it are never reused.
+  Heap map is shared and is modified under spin lock, which is taken only
+  around os calls anyway.
+
+  Every bucket and huge allocation is registered in heap map (fal/heapmap.h)
+  with tag telling its kind, so mc_free and mc_realloc classify pointer
+  in two loads and reject memory which wasn't allocated by mc_alloc.
+
+  For small allocations mc_free frees memory in bucket and removes bucket from
+  class list if it became empty after removal. Empty bucket is retained in
+  per-thread cache instead of being returned to os, and mc_alloc takes
+  buckets from the cache before going to os, so allocations oscillating
+  around bucket boundary don't map and unmap it every time. Cache is bounded
+  by mc_tuning.retain_max buckets, when it overflows oldest buckets are
+  returned to os in one go until mc_tuning.retain_min are left. Every
+  mc_tuning.decay cache events, i.e. buckets put into or taken from cache,
+  half of buckets which stayed in cache all that time is returned to os.
+  mc_stats tells how many os calls were made and avoided.
+  For huge allocations mc_free simply returns memory with its entry to os.
+
+  MC_HOOKS is prefix of hook functions like FAL_ARENA_DEF_HOOKS of
+  fal/arena.h, which both arenas get, and microalloc calls the same hooks
+  for huge allocations (on_free and on_alloc when resizing moved it) and
+  <prefix>_on_os_map/<prefix>_on_os_unmap for every os mapping. Without it
+  hooks compile to nothing. MC_TRACE is shorthand for fal/trace.h rings,
+  mc_thread_exit gives ring of the thread to the next one.
+
+  MC_PROFILE compiles in sampling heap profiler. Every thread counts down
+  bytes to its next sample, interval is exponentially distributed with mean
+  mc_tuning.sample, so every allocated byte is equally likely to be sampled
+  and unsampled mc_alloc costs a compare and a subtraction. Sampled
+  allocation gets short backtrace in side table keyed by pointer (under
+  heap map lock, samples are rare), which doubles when 3/4 full, and small
+  and medium ones get arena mark bit, so mc_free of unsampled allocation
+  costs a bit test. Huge allocations are looked up on every mc_free, which
+  unmaps them anyway. Allocations freed by another thread leave table when
+  owner collects them.
+  mc_profile_dump writes live samples as pprof heap profile.
+
+  mc_realloc keeps small allocations in place while new size fits their class,
+  uses arena_extend for medium allocations of calling thread, resizes huge
+  allocations which stay huge in their mapping and fallbacks to
+  mc_alloc-memcpy-mc_free otherwise. mc_tuning.remap = 0 sends huge
+  allocations through the copy too.
+
+  mc_calloc skips memset of memory which is still zeroed by os: every bucket
+  and medium arena header keeps end of memory ever freed in it, allocation
+  past it was never handed out before. mc_aligned_alloc relies on allocations
+  of one class being laid back to back from 16 byte aligned bucket memory
+  start, so sizes rounded to mc_ALIGN stay aligned to it. Larger alignment
+  goes to medium arena (64 byte blocks) or huge allocation (granules,
+  over-mapped and trimmed above that).
+*/
+
+/* MC_TRACE records events into per-thread rings of fal/trace.h. */
+#if defined(MC_TRACE) && !defined(MC_HOOKS)
+# include <fal/trace.h>
+# define MC_HOOKS fal_trace
+#endif
+
+/* Hooks compile to nothing without MC_HOOKS. */
+#if defined(MC_HOOKS)
+# define MC__ON_ALLOC(Ptr, Size) FAL_CONCAT(MC_HOOKS, _on_alloc)(Ptr, Size)
+# define MC__ON_FREE(Ptr, Size) FAL_CONCAT(MC_HOOKS, _on_free)(Ptr, Size)
+# define MC__ON_EXTEND(Ptr, OldSize, Size) \
+  FAL_CONCAT(MC_HOOKS, _on_extend)(Ptr, OldSize, Size)
+# define MC__ON_OS_MAP(Ptr, Size) FAL_CONCAT(MC_HOOKS, _on_os_map)(Ptr, Size)
+# define MC__ON_OS_UNMAP(Ptr, Size) \
+  FAL_CONCAT(MC_HOOKS, _on_os_unmap)(Ptr, Size)
+#else
+# define MC__ON_ALLOC(Ptr, Size) ((void)0)
+# define MC__ON_FREE(Ptr, Size) ((void)0)
+# define MC__ON_EXTEND(Ptr, OldSize, Size) ((void)0)
+# define MC__ON_OS_MAP(Ptr, Size) ((void)0)
+# define MC__ON_OS_UNMAP(Ptr, Size) ((void)0)
+#endif
+
+#if defined(_WIN32)
+# define __VC_EXTRALEAN
+# include <Windows.h>
+  static inline void* osalloc(size_t size) {
+    void* mem = VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (mem) {
+      MC__ON_OS_MAP(mem, size);
+    }
+    return mem;
+  }
+  static inline void* osrealloc(void* ptr, size_t size, size_t newsize) {
+    (void)ptr, (void)size, (void)newsize;
+    return 0; /* no way to grow mapping, mc_realloc copies */
+  }
+#elif defined(linux) || defined(__MINGW32__) || defined(__GNUC__)
+# include <sys/mman.h>
+  static inline void* osalloc(size_t size) {
+    void* mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+      return 0;
+    }
+    MC__ON_OS_MAP(mem, size);
+    return mem;
+  }
+  static inline void osfree(void* ptr, size_t size) {
+    MC__ON_OS_UNMAP(ptr, size);
+    munmap(ptr, size);
+  }
+# if defined(__linux__)
+#  if !defined(MREMAP_MAYMOVE)
+    /* Declared by sys/mman.h only with _GNU_SOURCE. */
+#   define MREMAP_MAYMOVE 1
+    extern void* mremap(void* addr, size_t size, size_t newsize, int flags, ...);
+#  endif
+  /* Grow mapping in place or move it, returns 0 if os can't. */
+  static inline void* osrealloc(void* ptr, size_t size, size_t newsize) {
+    void* mem = mremap(ptr, size, newsize, MREMAP_MAYMOVE);
+    if (mem == MAP_FAILED) {
+      return 0;
+    }
+    MC__ON_OS_UNMAP(ptr, size);
+    MC__ON_OS_MAP(mem, newsize);
+    return mem;
+  }
+# else
+  static inline void* osrealloc(void* ptr, size_t size, size_t newsize) {
+    (void)ptr, (void)size, (void)newsize;
+    return 0; /* no way to grow mapping, mc_realloc copies */
+  }
+# endif
+#else
+# error Dont know how to alloc page on this system.
+#endif
+
+/* Sampling compiles to nothing without MC_PROFILE. */
+#if defined(MC_PROFILE)
+# define MC__SAMPLE(Mem, Size) ((Size) < mc__sample_left \
+  ? (void)(mc__sample_left -= (Size)) : mc__sample(Mem, Size))
+# define MC__UNSAMPLE(Sampled, Ptr) ((Sampled) ? mc__unsample(Ptr) : (void)0)
+#else
+# define MC__SAMPLE(Mem, Size) ((void)0)
+# define MC__UNSAMPLE(Sampled, Ptr) ((void)0)
+#endif
+
+#if defined(MC_PROFILE)
+# include <stdio.h>
+# include <stdlib.h>
+# if defined(_WIN32)
+  /* Return addresses of callers of calling function, innermost first. */
+  static inline size_t mc__backtrace(uintptr_t* frames, size_t max) {
+    void* pcs[64];
+    size_t depth = CaptureStackBackTrace(1, (DWORD)(max < 64 ? max : 64),
+      pcs, 0);
+    for (size_t i = 0; i < depth; i++) {
+      frames[i] = (uintptr_t)pcs[i];
+    }
+    return depth;
+  }
+# else
+#  include <unwind.h>
+  typedef struct mc__unwind_t mc__unwind_t;
+  struct mc__unwind_t {
+    uintptr_t* frames;
+    size_t depth;
+    size_t max;
+    size_t skip;
+  };
+
+  static inline _Unwind_Reason_Code mc__unwind_frame(
+    struct _Unwind_Context* context, void* arg) {
+    mc__unwind_t* unwind = arg;
+    uintptr_t ip = (uintptr_t)_Unwind_GetIP(context);
+    if (!ip || unwind->depth == unwind->max) {
+      return _URC_END_OF_STACK;
+    }
+
+    if (unwind->skip) {
+      unwind->skip--;
+    } else {
+      unwind->frames[unwind->depth++] = ip;
+    }
+    return _URC_NO_REASON;
+  }
+
+  /* Return addresses of callers of calling function, innermost first. */
+  static inline size_t mc__backtrace(uintptr_t* frames, size_t max) {
+    mc__unwind_t unwind = {frames, 0, max, 1};
+    _Unwind_Backtrace(mc__unwind_frame, &unwind);
+    return unwind.depth;
+  }
+# endif
+#endif
+
+#if defined(_MSC_VER)
+# define MC_THREAD_LOCAL __declspec(thread)
+#else
+# define MC_THREAD_LOCAL __thread
+#endif
+
+typedef struct mc_thread_t mc_thread_t;
+
+typedef struct mc_header_t mc_header_t;
+struct mc_header_t {
+  mc_header_t* next;  /* next bucket of class list */
+  mc_header_t* prev;  /* previous bucket of class list */
+  unsigned cls;       /* size class of all allocations in bucket or
+                         mc_MEDIUM_CLASS for medium arena */
+  unsigned listed;    /* whether bucket is in class list, for medium arena
+                         1 + bin of its list or 0 */
+  unsigned free;      /* number of free blocks */
+  unsigned run;       /* upper bound of longest free run in blocks */
+  unsigned dirty;     /* end of memory ever freed as offset in bucket or
+                         arena, memory past it is still zeroed by os */
+  mc_thread_t* owner; /* thread which allocates from bucket */
+  volatile size_t remote;  /* blocks freed by other threads */
+  mc_header_t* pending;    /* next bucket of owner's pending list */
+};
+
+/* Entry in granule in front of huge allocation. */
+typedef struct mc_huge_t mc_huge_t;
+struct mc_huge_t {
+  void* ptr;          /* allocation itself, i.e. entry + granule */
+  size_t size;        /* requested size */
+};
+
+#define FAL_ARENA_DEF_POW         12u /* 4 KiB arena */
+#define FAL_ARENA_DEF_BLOCK_POW   3u  /* 8 byte blocks */
+#define FAL_ARENA_DEF_INCOMPACT   /* 4 KiB arena can't be compact */
+/* Header follows 2 byte bump top, room to align it for atomics. */
+#define FAL_ARENA_DEF_HEADER_SIZE (sizeof(mc_header_t) + sizeof(uint64_t))
+#define FAL_ARENA_DEF_NAME        mc_bucket
+#if defined(MC_HOOKS)
+# define FAL_ARENA_DEF_HOOKS      MC_HOOKS
+#endif
+#include <fal/arena.h>
+
+#define FAL_ARENA_DEF_POW         18u /* 256 KiB arena */
+#define FAL_ARENA_DEF_BLOCK_POW   6u  /* 64 byte blocks */
+#define FAL_ARENA_DEF_HEADER_SIZE sizeof(mc_header_t)
+#define FAL_ARENA_DEF_NAME        mc_medium
+#if defined(MC_HOOKS)
+# define FAL_ARENA_DEF_HOOKS      MC_HOOKS
+#endif
+#include <fal/arena.h>
+
+enum mc_owner_t {
+  MC_OWNER_NONE = 0,
+  MC_OWNER_BUCKET,
+  MC_OWNER_MEDIUM,
+  MC_OWNER_HUGE
+};
+
+#define FAL_HEAPMAP_DEF_POW             12u /* granule is one bucket */
+#define FAL_HEAPMAP_DEF_ALLOC(Size)     osalloc(Size)
+#define FAL_HEAPMAP_DEF_FREE(Ptr, Size) osfree(Ptr, Size)
+#define FAL_HEAPMAP_DEF_NAME            mc_heap
+#include <fal/heapmap.h>
+
+enum mc_defs_t {
+  /* Allocations whose size is multiple of it are aligned to it. */
+  mc_ALIGN = 2 * mc_bucket_BLOCK_SIZE,
+  /* Largest small allocation. */
+  mc_SMALL_MAX = mc_bucket_EFFECTIVE_SIZE / 4 & ~(mc_ALIGN - 1),
+  /* Largest medium allocation, everything above goes directly to os. */
+  mc_MEDIUM_MAX = mc_medium_EFFECTIVE_SIZE / 8 & ~(mc_medium_BLOCK_SIZE - 1),
+  /* 8 classes up to 64 bytes, then 4 per power of two up to 1 KiB. */
+  mc_CLASSES = 8 + 4 * 4,
+  mc_MEDIUM_CLASS = mc_CLASSES,
+  /* Blocks of the smallest medium allocation. */
+  mc__MEDIUM_MIN = (mc_SMALL_MAX + mc_medium_BLOCK_SIZE) / mc_medium_BLOCK_SIZE,
+  /* Medium arena lists, bin of run bound is its log2 - log2(mc__MEDIUM_MIN). */
+  mc__MEDIUM_BINS = 8,
+  /* Frames of profile sample backtrace. */
+  mc_PROFILE_DEPTH = 16,
+  /* Initial slots of profile side table, it doubles when 3/4 are used. */
+  mc__PROFILE_SLOTS = 4096
+};
+
+typedef struct mc_class_t mc_class_t;
+struct mc_class_t {
+  mc_header_t* first; /* list of buckets which are not known to be full */
+};
+
+/* Sampled allocation in profile side table, slot is free if ptr is 0. */
+typedef struct mc_sample_t mc_sample_t;
+struct mc_sample_t {
+  void* ptr;
+  size_t size;        /* requested size */
+  size_t depth;       /* frames captured */
+  uintptr_t frames[mc_PROFILE_DEPTH]; /* return addresses, innermost first */
+};
+
+struct mc_thread_t {
+  mc_class_t classes[mc_CLASSES];
+  volatile size_t pending; /* buckets with nonempty remote-free lists */
+  mc_thread_t* next;       /* next set left by exited thread */
+
+  mc_header_t* medium[mc__MEDIUM_BINS]; /* medium arenas by run bound */
+  mc_header_t* medium_spare;            /* retained empty medium arena */
+
+  mc_header_t* empty;      /* retained empty buckets, newest first */
+  mc_header_t* empty_last; /* oldest retained empty bucket */
+  size_t empty_len;
+  size_t empty_low;        /* fewest retained buckets since last decay */
+  size_t events;           /* cache events since last decay */
+};
+
+typedef struct mc_tuning_t mc_tuning_t;
+struct mc_tuning_t {
+  size_t retain_max; /* most empty buckets retained per thread, 0 disables */
+  size_t retain_min; /* retained buckets left after overflow */
+  size_t decay;      /* cache events between decays, 0 disables */
+  size_t medium_max; /* largest medium allocation, at most mc_MEDIUM_MAX */
+  int remap;         /* resize huge allocations without copying */
+  size_t sample;     /* mean bytes between profile samples, 0 disables,
+                        thread picks it up at its next sample */
+};
+
+typedef struct mc_stats_t mc_stats_t;
+struct mc_stats_t {
+  volatile size_t maps;           /* os mappings of buckets, arenas, huge */
+  volatile size_t unmaps;         /* os unmappings of buckets, arenas, huge */
+  volatile size_t maps_avoided;   /* buckets taken from cache */
+  volatile size_t unmaps_avoided; /* buckets put into cache */
+  volatile size_t remaps;         /* huge allocations grown by os */
+  volatile size_t samples;        /* live profile samples */
+  volatile size_t samples_dropped; /* samples lost as os refused memory */
+};
+
+static mc_tuning_t mc_tuning = {64, 32, 1024, mc_MEDIUM_MAX, 1, 512 * 1024};
+static mc_stats_t mc__stats;
+static mc_heap_t mc_heap;
+static volatile size_t mc_lock = 0;
+static mc_thread_t* mc_exited = 0;
+static MC_THREAD_LOCAL mc_thread_t* mc_self = 0;
+
+static inline mc_header_t* mc__header(mc_bucket_t* bucket) {
+  uintptr_t header = (uintptr_t)mc_bucket_header(bucket);
+  return (mc_header_t*)((header + sizeof(uint64_t) - 1)
+    & ~(uintptr_t)(sizeof(uint64_t) - 1));
+}
+
+/* Size class of small allocation. */
+static inline size_t mc__class(size_t size) {
+  if (size <= 64) {
+    return size ? (size - 1) >> 3 : 0;
+  }
+
+  /* 2^pow < size <= 2^(pow + 1), two bits below pow pick the quarter. */
+  size_t pow = 63 - fal_clz64(size - 1);
+  return 8 + (pow - 6) * 4 + ((size - 1) >> (pow - 2) & 3);
+}
+
+/* Size of allocations in size class. */
+static inline size_t mc__class_size(size_t cls) {
+  if (cls < 8) {
+    return (cls + 1) * 8;
+  }
+
+  size_t pow = 6 + (cls - 8) / 4;
+  size_t size = (5 + (cls - 8) % 4) << (pow - 2);
+  return size < mc_SMALL_MAX ? size : mc_SMALL_MAX;
+}
+
+static inline void mc_init() {
+  FAL_STATIC_ASSERT(mc_SMALL_MAX <= 1024 && mc_SMALL_MAX > 512);
+  FAL_STATIC_ASSERT(sizeof(mc_huge_t) <= mc_heap_GRANULE);
+  /* Allocations of one class are laid back to back from memory start. */
+  FAL_STATIC_ASSERT(mc_bucket_BEGIN * mc_bucket_BLOCK_SIZE % mc_ALIGN == 0);
+  FAL_STATIC_ASSERT(mc_medium_BLOCK_SIZE % mc_ALIGN == 0);
+
+  mc_heap_init(&mc_heap);
+}
+
+/* Snapshot of counters of all threads. */
+static inline mc_stats_t mc_stats() {
+  mc_stats_t stats;
+  stats.maps = fal_atomic_load(&mc__stats.maps, FAL_ATOMIC_RELAXED);
+  stats.unmaps = fal_atomic_load(&mc__stats.unmaps, FAL_ATOMIC_RELAXED);
+  stats.maps_avoided = fal_atomic_load(&mc__stats.maps_avoided,
+    FAL_ATOMIC_RELAXED);
+  stats.unmaps_avoided = fal_atomic_load(&mc__stats.unmaps_avoided,
+    FAL_ATOMIC_RELAXED);
+  stats.remaps = fal_atomic_load(&mc__stats.remaps, FAL_ATOMIC_RELAXED);
+  stats.samples = fal_atomic_load(&mc__stats.samples, FAL_ATOMIC_RELAXED);
+  stats.samples_dropped = fal_atomic_load(&mc__stats.samples_dropped,
+    FAL_ATOMIC_RELAXED);
+  return stats;
+}
+
+static inline void* mc__map(size_t size) {
+  fal_atomic_add(&mc__stats.maps, 1);
+  return osalloc(size);
+}
+
+static inline void mc__unmap(void* ptr, size_t size) {
+  fal_atomic_add(&mc__stats.unmaps, 1);
+  osfree(ptr, size);
+}
+
+static inline void* mc__remap(void* ptr, size_t size, size_t newsize) {
+  void* mem = osrealloc(ptr, size, newsize);
+  if (mem) {
+    fal_atomic_add(&mc__stats.remaps, 1);
+  }
+  return mem;
+}
+
+/* Map size bytes aligned to size. */
+static inline void* mc__map_aligned(size_t size) {
+  char* mem = mc__map(2 * size);
+  if (!mem) {
+    return 0;
+  }
+
+  char* aligned = (char*)(((uintptr_t)mem + size - 1) & ~(uintptr_t)(size - 1));
+  if (aligned != mem) {
+    mc__unmap(mem, aligned - mem);
+  }
+  mc__unmap(aligned + size, mem + size - aligned);
+
+  return aligned;
+}
+
+static inline void mc__lock() {
+  while (!fal_atomic_cas(&mc_lock, 0, 1)) {
+  }
+}
+
+static inline void mc__unlock() {
+  fal_atomic_store(&mc_lock, 0, FAL_ATOMIC_RELEASE);
+}
+
+#if defined(MC_PROFILE)
+static mc_sample_t* mc__samples = 0; /* side table, mapped on first sample */
+static size_t mc__sample_slots = 0;  /* its size, power of 2 */
+static MC_THREAD_LOCAL size_t mc__sample_left = 0; /* 0 until first alloc */
+static MC_THREAD_LOCAL uint64_t mc__sample_seed = 0;
+
+/* Slot where probing for ptr starts. */
+static inline size_t mc__sample_home(void* ptr) {
+  return (size_t)(((uint64_t)(uintptr_t)ptr >> 3) * 0x9e3779b97f4a7c15ull
+    >> 32) & (mc__sample_slots - 1);
+}
+
+/* Slot of ptr in side table or free slot it would take. */
+static inline size_t mc__sample_slot(void* ptr) {
+  size_t slot = mc__sample_home(ptr);
+  while (mc__samples[slot].ptr && mc__samples[slot].ptr != ptr) {
+    slot = (slot + 1) & (mc__sample_slots - 1);
+  }
+  return slot;
+}
+
+/* Free slot under lock, entries after it are shifted back so that no probe
+   run has a hole. */
+static inline void mc__sample_remove(size_t slot) {
+  size_t hole = slot;
+  size_t next = (hole + 1) & (mc__sample_slots - 1);
+  while (mc__samples[next].ptr) {
+    /* Entry may fill the hole if hole is between its home and it. */
+    size_t home = mc__sample_home(mc__samples[next].ptr);
+    if (((next - home) & (mc__sample_slots - 1))
+      >= ((next - hole) & (mc__sample_slots - 1))) {
+      mc__samples[hole] = mc__samples[next];
+      hole = next;
+    }
+    next = (next + 1) & (mc__sample_slots - 1);
+  }
+  mc__samples[hole].ptr = 0;
+}
+
+/* Bytes to the next sample, exponentially distributed with mean
+   mc_tuning.sample: -ln(u) for uniform u, with log2 approximated to 0.01. */
+static inline size_t mc__sample_interval() {
+  if (!mc_tuning.sample) {
+    return (size_t)-1;
+  }
+
+  uint64_t seed = mc__sample_seed;
+  if (!seed) {
+    seed = (uint64_t)(uintptr_t)&mc__sample_seed * 0x9e3779b97f4a7c15ull | 1;
+  }
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  mc__sample_seed = seed;
+
+  /* u = r / 2^52, log2(1 + f) ~ f + 0.34 f (1 - f). */
+  uint64_t r = (seed >> 12) + 1;
+  unsigned pow = 63 - fal_clz64(r);
+  double base = (double)((uint64_t)1 << pow);
+  double frac = (double)(r - ((uint64_t)1 << pow)) / base;
+  double lg = pow + frac + 0.34 * frac * (1 - frac);
+  double interval = (52 - lg) * 0.6931471805599453 * (double)mc_tuning.sample;
+  return interval < 1 ? 1 : (size_t)interval;
+}
+
+/* Map side table twice as large under lock and move samples there,
+   returns 0 if os is out of memory. Dropping samples instead would bias
+   profile towards call sites sampled first. */
+static inline int mc__sample_grow() {
+  size_t slots = mc__sample_slots ? 2 * mc__sample_slots : mc__PROFILE_SLOTS;
+  mc_sample_t* samples = osalloc(slots * sizeof(mc_sample_t));
+  if (!samples) {
+    return 0;
+  }
+
+  mc_sample_t* old = mc__samples;
+  size_t old_slots = mc__sample_slots;
+  mc__samples = samples;
+  mc__sample_slots = slots;
+  for (size_t slot = 0; slot < old_slots; slot++) {
+    if (old[slot].ptr) {
+      mc__samples[mc__sample_slot(old[slot].ptr)] = old[slot];
+    }
+  }
+  if (old) {
+    osfree(old, old_slots * sizeof(mc_sample_t));
+  }
+  return 1;
+}
+
+/* Put sampled allocation into side table and mark it. */
+static inline void mc__record(void* mem, size_t size) {
+  mc_sample_t sample;
+  sample.ptr = mem;
+  sample.size = size;
+  sample.depth = mc__backtrace(sample.frames, mc_PROFILE_DEPTH);
+
+  mc__lock();
+  if (mc__stats.samples >= mc__sample_slots / 4 * 3 && !mc__sample_grow()) {
+    mc__unlock();
+    fal_atomic_add(&mc__stats.samples_dropped, 1);
+    return;
+  }
+
+  mc__samples[mc__sample_slot(mem)] = sample;
+  fal_atomic_add(&mc__stats.samples, 1);
+  mc__unlock();
+
+  /* Memory of calling thread, nobody else touches its bitsets. */
+  unsigned owner = mc_heap_owner(&mc_heap, mem);
+  if (owner == MC_OWNER_BUCKET) {
+    mc_bucket_mark(mem);
+  } else if (owner == MC_OWNER_MEDIUM) {
+    mc_medium_mark(mem);
+  }
+}
+
+/* Slow path of MC__SAMPLE: sample mem if size crossed countdown and start
+   the next one. Allocations made meanwhile, e.g. by unwinder, aren't
+   sampled. */
+static inline void mc__sample(void* mem, size_t size) {
+  int first = !mc__sample_seed;
+  mc__sample_left = (size_t)-1;
+
+  /* Fresh thread has no countdown yet. */
+  if (first) {
+    size_t left = mc__sample_interval();
+    if (size < left) {
+      mc__sample_left = left - size;
+      return;
+    }
+  }
+
+  if (mem && mc_tuning.sample) {
+    mc__record(mem, size);
+  }
+  mc__sample_left = mc__sample_interval();
+}
+
+/* Retire sample of ptr, if any. */
+static inline void mc__unsample(void* ptr) {
+  if (!fal_atomic_load(&mc__stats.samples, FAL_ATOMIC_RELAXED)) {
+    return;
+  }
+
+  mc__lock();
+  size_t slot = mc__sample_slot(ptr);
+  if (mc__samples[slot].ptr) {
+    mc__sample_remove(slot);
+    fal_atomic_add(&mc__stats.samples, (size_t)-1);
+  }
+  mc__unlock();
+}
+
+/* Rekey sample of huge allocation which os moved. */
+static inline void mc__resample(void* ptr, void* newptr) {
+  if (!fal_atomic_load(&mc__stats.samples, FAL_ATOMIC_RELAXED)) {
+    return;
+  }
+
+  mc__lock();
+  size_t slot = mc__sample_slot(ptr);
+  if (mc__samples[slot].ptr) {
+    mc_sample_t sample = mc__samples[slot];
+    mc__sample_remove(slot);
+    sample.ptr = newptr;
+    mc__samples[mc__sample_slot(newptr)] = sample;
+  }
+  mc__unlock();
+}
+
+static inline int mc__sample_cmp(const void* a, const void* b) {
+  const mc_sample_t* x = a;
+  const mc_sample_t* y = b;
+  if (x->depth != y->depth) {
+    return x->depth < y->depth ? -1 : 1;
+  }
+  return memcmp(x->frames, y->frames, x->depth * sizeof(uintptr_t));
+}
+
+/* Write live samples as legacy pprof heap profile, samples with the same
+   stack merged, followed by mappings to symbolize addresses:
+     pprof <program> <file>
+   scales them by sampling rate. Returns number of samples written. */
+static inline size_t mc_profile_dump(FILE* file) {
+  /* Copy is mapped without lock, table may grow meanwhile. */
+  size_t bytes = 0;
+  mc_sample_t* copy = 0;
+  mc__lock();
+  while (bytes < mc__sample_slots * sizeof(mc_sample_t)) {
+    size_t slots = mc__sample_slots;
+    mc__unlock();
+    if (copy) {
+      osfree(copy, bytes);
+    }
+    bytes = slots * sizeof(mc_sample_t);
+    copy = osalloc(bytes);
+    if (!copy) {
+      return 0;
+    }
+    mc__lock();
+  }
+
+  /* File is written after lock is released, stdio may allocate. */
+  size_t count = 0;
+  size_t total = 0;
+  for (size_t slot = 0; slot < mc__sample_slots; slot++) {
+    if (mc__samples[slot].ptr) {
+      copy[count++] = mc__samples[slot];
+      total += mc__samples[slot].size;
+    }
+  }
+  mc__unlock();
+
+  if (count) {
+    qsort(copy, count, sizeof(mc_sample_t), mc__sample_cmp);
+  }
+
+  fprintf(file, "heap profile: %zu: %zu [0: 0] @ heap_v2/%zu\n",
+    count, total, mc_tuning.sample);
+  for (size_t i = 0, j; i < count; i = j) {
+    size_t size = 0;
+    for (j = i; j < count && !mc__sample_cmp(&copy[i], &copy[j]); j++) {
+      size += copy[j].size;
+    }
+
+    fprintf(file, "%zu: %zu [0: 0] @", j - i, size);
+    for (size_t frame = 0; frame < copy[i].depth; frame++) {
+      fprintf(file, " 0x%llx", (unsigned long long)copy[i].frames[frame]);
+    }
+    fprintf(file, "\n");
+  }
+
+#if defined(__linux__)
+  FILE* maps = fopen("/proc/self/maps", "r");
+  if (maps) {
+    char buf[4096];
+    size_t len;
+    fprintf(file, "\nMAPPED_LIBRARIES:\n");
+    while ((len = fread(buf, 1, sizeof(buf), maps))) {
+      fwrite(buf, 1, len, file);
+    }
+    fclose(maps);
+  }
+#endif
+
+  if (copy) {
+    osfree(copy, bytes);
+  }
+  return count;
+}
+#endif
+
+/* Get set of the calling thread, adopt exited one or map new if needed,
+   returns 0 if os is out of memory. */
+static inline mc_thread_t* mc__thread() {
+  if (mc_self) {
+    return mc_self;
+  }
+
+  mc__lock();
+  mc_self = mc_exited;
+  if (mc_self) {
+    mc_exited = mc_self->next;
+  }
+  mc__unlock();
+
+  if (!mc_self) {
+    FAL_STATIC_ASSERT(sizeof(mc_thread_t) <= mc_bucket_SIZE);
+    mc_self = osalloc(mc_bucket_SIZE); /* zeroed by os */
+  }
+
+  return mc_self;
+}
+
+static inline void mc__link(mc_header_t** first, mc_header_t* header) {
+  header->prev = 0;
+  header->next = *first;
+  if (*first) {
+    (*first)->prev = header;
+  }
+  *first = header;
+  header->listed = 1;
+}
+
+static inline void mc__unlink(mc_header_t** first, mc_header_t* header) {
+  if (header->prev) {
+    header->prev->next = header->next;
+  } else {
+    *first = header->next;
+  }
+
+  if (header->next) {
+    header->next->prev = header->prev;
+  }
+  header->listed = 0;
+}
+
+/* Size of os mapping for huge allocation with its entry, rounded to heap
+   map granules. */
+static inline size_t mc__huge_span(size_t size) {
+  return mc_heap_GRANULE
+    + ((size + mc_heap_GRANULE - 1) & ~(size_t)(mc_heap_GRANULE - 1));
+}
+
+/* Return empty bucket to os. */
+static inline void mc__release(mc_header_t* header) {
+  mc_bucket_t* bucket = mc_bucket_for(header);
+  mc__lock();
+  mc_heap_clear(&mc_heap, bucket, mc_bucket_SIZE);
+  mc__unlock();
+  mc__unmap(bucket, mc_bucket_SIZE);
+}
+
+/* Return empty medium arena to os. */
+static inline void mc__release_medium(mc_header_t* header) {
+  mc_medium_t* arena = mc_medium_for(header);
+  mc__lock();
+  mc_heap_clear(&mc_heap, arena, mc_medium_SIZE);
+  mc__unlock();
+  mc__unmap(arena, mc_medium_SIZE);
+}
+
+/* Release oldest retained buckets until keep are left. */
+static inline void mc__trim(mc_thread_t* self, size_t keep) {
+  while (self->empty_len > keep) {
+    mc_header_t* header = self->empty_last;
+    self->empty_last = header->prev;
+    if (header->prev) {
+      header->prev->next = 0;
+    } else {
+      self->empty = 0;
+    }
+    self->empty_len--;
+
+    mc__release(header);
+  }
+
+  if (self->empty_low > self->empty_len) {
+    self->empty_low = self->empty_len;
+  }
+}
+
+/* Count cache event, release half of buckets untouched since last decay. */
+static inline void mc__tick(mc_thread_t* self) {
+  if (!mc_tuning.decay || ++self->events < mc_tuning.decay) {
+    return;
+  }
+
+  mc__trim(self, self->empty_len - (self->empty_low + 1) / 2);
+  self->events = 0;
+  self->empty_low = self->empty_len;
+}
+
+/* Put empty bucket into cache or release it. */
+static inline void mc__retain(mc_thread_t* self, mc_header_t* header) {
+  if (!mc_tuning.retain_max) {
+    mc__release(header);
+    return;
+  }
+
+  header->prev = 0;
+  header->next = self->empty;
+  if (self->empty) {
+    self->empty->prev = header;
+  } else {
+    self->empty_last = header;
+  }
+  self->empty = header;
+  self->empty_len++;
+  fal_atomic_add(&mc__stats.unmaps_avoided, 1);
+
+  if (self->empty_len > mc_tuning.retain_max) {
+    mc__trim(self, mc_tuning.retain_min);
+  }
+  mc__tick(self);
+}
+
+/* Take newest bucket from cache or map new one, returns 0 if os is out of
+   memory. */
+static inline mc_bucket_t* mc__reuse(mc_thread_t* self) {
+  mc_header_t* header = self->empty;
+  if (!header) {
+    mc_bucket_t* bucket = mc__map(mc_bucket_SIZE);
+    if (!bucket) {
+      return 0;
+    }
+
+    mc__lock();
+    int registered = mc_heap_set(&mc_heap, bucket, mc_bucket_SIZE, MC_OWNER_BUCKET);
+    mc__unlock();
+    assert(registered && "No memory for heap map.");
+    FAL_UNUSED(registered);
+    return bucket;
+  }
+
+  self->empty = header->next;
+  if (header->next) {
+    header->next->prev = 0;
+  } else {
+    self->empty_last = 0;
+  }
+  self->empty_len--;
+  fal_atomic_add(&mc__stats.maps_avoided, 1);
+
+  if (self->empty_low > self->empty_len) {
+    self->empty_low = self->empty_len;
+  }
+  mc__tick(self);
+
+  return mc_bucket_for(header);
+}
+
+static inline void mc__free_small(mc_bucket_t* bucket, void* ptr);
+static inline void mc__free_medium(mc_medium_t* arena, void* ptr);
+
+/* Free everything other threads returned to buckets of self. */
+static inline void mc__collect(mc_thread_t* self) {
+  size_t list;
+  do {
+    list = fal_atomic_load(&self->pending, FAL_ATOMIC_ACQUIRE);
+  } while (list && !fal_atomic_cas(&self->pending, list, 0));
+
+  mc_header_t* header = (mc_header_t*)list;
+  while (header) {
+    mc_header_t* next = header->pending;
+    mc_bucket_t* bucket = mc_bucket_for(header); /* only for small */
+
+    /* Last block may free bucket, so header isn't touched after it. */
+    size_t remote;
+    do {
+      remote = fal_atomic_load(&header->remote, FAL_ATOMIC_ACQUIRE);
+    } while (!fal_atomic_cas(&header->remote, remote, 0));
+
+    while (remote) {
+      void* ptr = (void*)remote;
+      remote = *(size_t*)ptr;
+      if (header->cls == mc_MEDIUM_CLASS) {
+        mc__free_medium(mc_medium_for(ptr), ptr);
+      } else {
+        mc__free_small(bucket, ptr);
+      }
+    }
+
+    header = next;
+  }
+}
+
+/* Blocks of medium allocation. */
+static inline unsigned mc__medium_blocks(size_t size) {
+  return (unsigned)((size + mc_medium_BLOCK_SIZE - 1) / mc_medium_BLOCK_SIZE);
+}
+
+/* Bin of medium arena list for run bound. */
+static inline unsigned mc__medium_bin(unsigned run) {
+  unsigned bin = fal_clz64(mc__MEDIUM_MIN) - fal_clz64(run);
+  return bin < mc__MEDIUM_BINS ? bin : mc__MEDIUM_BINS - 1;
+}
+
+/* Move medium arena to the list of its bound, unlink it if bound can't fit
+   any medium allocation. */
+static inline void mc__relist_medium(mc_thread_t* self, mc_header_t* header) {
+  unsigned listed = header->run >= mc__MEDIUM_MIN
+    ? mc__medium_bin(header->run) + 1 : 0;
+  if (listed == header->listed) {
+    return;
+  }
+
+  if (header->listed) {
+    mc__unlink(&self->medium[header->listed - 1], header);
+  }
+  if (listed) {
+    mc__link(&self->medium[listed - 1], header);
+  }
+  header->listed = listed;
+}
+
+/* Allocate in the first medium arena which fits, returns 0 if none does. */
+static inline void* mc__find_medium(mc_thread_t* self, size_t size) {
+  unsigned blocks = mc__medium_blocks(size);
+  for (unsigned bin = mc__medium_bin(blocks); bin < mc__MEDIUM_BINS; bin++) {
+    mc_header_t* header = self->medium[bin];
+    while (header) {
+      mc_header_t* next = header->next;
+      if (header->run >= blocks) {
+        void* mem = mc_medium_alloc(mc_medium_for(header), size);
+        if (mem) {
+          header->free -= blocks;
+          header->run = header->run < header->free ? header->run : header->free;
+          mc__relist_medium(self, header);
+          return mem;
+        }
+
+        /* Bound was too optimistic, no run is that long. */
+        header->run = blocks - 1;
+        mc__relist_medium(self, header);
+      }
+
+      header = next;
+    }
+  }
+
+  return 0;
+}
+
+static inline void* mc__alloc_medium(mc_thread_t* self, size_t size) {
+  void* mem = mc__find_medium(self, size);
+  if (!mem && fal_atomic_load(&self->pending, FAL_ATOMIC_RELAXED)) {
+    mc__collect(self);
+    mem = mc__find_medium(self, size);
+  }
+  if (mem) {
+    return mem;
+  }
+
+  mc_medium_t* arena;
+  if (self->medium_spare) {
+    arena = mc_medium_for(self->medium_spare);
+    self->medium_spare = 0;
+  } else {
+    arena = mc__map_aligned(mc_medium_SIZE);
+    if (!arena) {
+      return 0;
+    }
+
+    mc__lock();
+    int registered = mc_heap_set(&mc_heap, arena, mc_medium_SIZE, MC_OWNER_MEDIUM);
+    mc__unlock();
+    assert(registered && "No memory for heap map.");
+    FAL_UNUSED(registered);
+  }
+
+  mc_medium_init(arena);
+  mc_header_t* header = mc_medium_header(arena);
+  header->owner = self;
+  header->remote = 0;
+  header->cls = mc_MEDIUM_CLASS;
+  header->listed = 0;
+  header->free = mc_medium_TOTAL - mc__medium_blocks(size);
+  header->run = header->free;
+  mc__relist_medium(self, header);
+
+  return mc_medium_alloc(arena, size);
+}
+
+/* Whether mc_alloc of size goes directly to os. */
+static inline int mc__is_huge(size_t size) {
+  return size > mc_SMALL_MAX
+    && (size > mc_tuning.medium_max || size > mc_MEDIUM_MAX);
+}
+
+/* Map huge allocation aligned to align, which is power of two. Mapping is
+   granule aligned anyway, for larger align head and tail are trimmed. */
+static inline void* mc__alloc_huge(size_t size, size_t align) {
+  size_t span = mc__huge_span(size);
+  size_t extra = align > mc_heap_GRANULE ? align - mc_heap_GRANULE : 0;
+  char* mem = mc__map(span + extra);
+  if (!mem) {
+    return 0;
+  }
+
+  mc_huge_t* entry = (mc_huge_t*)mem;
+  if (extra) {
+    uintptr_t ptr = ((uintptr_t)mem + mc_heap_GRANULE + align - 1)
+      & ~(uintptr_t)(align - 1);
+    entry = (mc_huge_t*)(ptr - mc_heap_GRANULE);
+    if ((char*)entry != mem) {
+      mc__unmap(mem, (char*)entry - mem);
+    }
+    if ((char*)entry + span != mem + span + extra) {
+      mc__unmap((char*)entry + span, mem + extra - (char*)entry);
+    }
+  }
+
+  entry->ptr = (char*)entry + mc_heap_GRANULE;
+  entry->size = size;
+
+  mc__lock();
+  int registered = mc_heap_set(&mc_heap, entry, span, MC_OWNER_HUGE);
+  mc__unlock();
+  assert(registered && "No memory for heap map.");
+  FAL_UNUSED(registered);
+
+  MC__ON_ALLOC(entry->ptr, size);
+  return entry->ptr;
+}
+
+static inline void* mc__alloc(size_t size) {
+  if (size > mc_SMALL_MAX && !mc__is_huge(size)) {
+    mc_thread_t* self = mc__thread();
+    return self ? mc__alloc_medium(self, size) : 0;
+  }
+
+  if (size > mc_SMALL_MAX) {
+    return mc__alloc_huge(size, mc_heap_GRANULE);
+  }
+
+  mc_thread_t* self = mc__thread();
+  if (!self) {
+    return 0;
+  }
+
+  size_t cls = mc__class(size);
+  mc_class_t* class = &self->classes[cls];
+  size = mc__class_size(cls);
+  unsigned blocks = (unsigned)(size / mc_bucket_BLOCK_SIZE);
+
+  if (!class->first
+    && fal_atomic_load(&self->pending, FAL_ATOMIC_RELAXED)) {
+    mc__collect(self);
+  }
+
+  while (class->first) {
+    mc_header_t* header = class->first;
+    void* mem = mc_bucket_alloc(mc_bucket_for(header), size);
+    if (mem) {
+      header->free -= blocks;
+      header->run = header->run < header->free ? header->run : header->free;
+      if (header->run < blocks) {
+        mc__unlink(&class->first, header);
+      }
+
+      return mem;
+    }
+
+    /* Bound was too optimistic, no run is that long. */
+    header->run = blocks - 1;
+    mc__unlink(&class->first, header);
+  }
+
+  mc_bucket_t* bucket = mc__reuse(self);
+  if (!bucket) {
+    return 0;
+  }
+
+  mc_bucket_init(bucket);
+  mc_header_t* header = mc__header(bucket);
+  header->owner = self;
+  header->remote = 0;
+  header->cls = (unsigned)cls;
+  header->listed = 0;
+  header->free = mc_bucket_TOTAL - blocks;
+  header->run = header->free;
+  if (header->run >= blocks) {
+    mc__link(&class->first, header);
+  }
+
+  return mc_bucket_alloc(bucket, size);
+}
+
+static inline void* mc_alloc(size_t size) {
+  void* mem = mc__alloc(size);
+  MC__SAMPLE(mem, size);
+  return mem;
+}
+
+/* Entry of huge allocation or 0 if ptr points inside of it. */
+static inline mc_huge_t* mc__get_huge(void* ptr) {
+  mc_huge_t* entry = (mc_huge_t*)((char*)ptr - mc_heap_GRANULE);
+  return ((uintptr_t)ptr & (mc_heap_GRANULE - 1)) || entry->ptr != ptr
+    ? 0 : entry;
+}
+
+/* Resize huge allocation within its mapping, which may move. Returns new
+   pointer or 0 if os can't grow mapping, allocation is intact then. */
+static inline void* mc__resize_huge(mc_huge_t* entry, size_t newsize) {
+  void* ptr = entry->ptr;
+  size_t span = mc__huge_span(entry->size);
+  size_t newspan = mc__huge_span(newsize);
+
+  if (newspan < span) {
+    char* tail = (char*)entry + newspan;
+    mc__lock();
+    mc_heap_clear(&mc_heap, tail, span - newspan);
+    mc__unlock();
+
+    mc__unmap(tail, span - newspan);
+  } else if (newspan > span) {
+    /* Old range is unregistered before os may give it to someone else. */
+    mc__lock();
+    mc_heap_clear(&mc_heap, entry, span);
+    mc__unlock();
+
+    mc_huge_t* moved = mc__remap(entry, span, newspan);
+    if (moved) {
+      entry = moved;
+      entry->ptr = (char*)entry + mc_heap_GRANULE;
+      span = newspan;
+    }
+
+    mc__lock();
+    int registered = mc_heap_set(&mc_heap, entry, span, MC_OWNER_HUGE);
+    mc__unlock();
+    assert(registered && "No memory for heap map.");
+    FAL_UNUSED(registered);
+
+    if (!moved) {
+      return 0;
+    }
+  }
+
+  if (entry->ptr != ptr) {
+#if defined(MC_PROFILE)
+    mc__resample(ptr, entry->ptr);
+#endif
+    MC__ON_FREE(ptr, entry->size);
+    MC__ON_ALLOC(entry->ptr, newsize);
+  } else {
+    MC__ON_EXTEND(ptr, entry->size, newsize);
+  }
+  entry->size = newsize;
+  return entry->ptr;
+}
+
+/* Free small allocation in bucket owned by calling thread. */
+static inline void mc__free_small(mc_bucket_t* bucket, void* ptr) {
+  mc_header_t* header = mc__header(bucket);
+  mc_class_t* class = &header->owner->classes[header->cls];
+  unsigned blocks = (unsigned)(mc_bucket_size(ptr) / mc_bucket_BLOCK_SIZE);
+  unsigned end = (unsigned)((char*)ptr - (char*)bucket)
+    + blocks * mc_bucket_BLOCK_SIZE;
+  header->dirty = header->dirty > end ? header->dirty : end;
+  MC__UNSAMPLE(mc_bucket_marked(ptr), ptr);
+  mc_bucket_free(ptr);
+
+  if (mc_bucket_empty(bucket)) {
+    if (header->listed) {
+      mc__unlink(&class->first, header);
+    }
+
+    mc__retain(header->owner, header);
+    return;
+  }
+
+  header->free += blocks;
+  header->run = 2 * header->run + blocks;
+  header->run = header->run < header->free ? header->run : header->free;
+  if (!header->listed
+    && header->run >= mc__class_size(header->cls) / mc_bucket_BLOCK_SIZE) {
+    mc__link(&class->first, header);
+  }
+}
+
+/* Free medium allocation in arena owned by calling thread. */
+static inline void mc__free_medium(mc_medium_t* arena, void* ptr) {
+  mc_header_t* header = mc_medium_header(arena);
+  mc_thread_t* self = header->owner;
+  unsigned blocks = mc__medium_blocks(mc_medium_size(ptr));
+
+  /* Arena holds any sizes, so loose bound would send most requests to
+     arenas which can't fit them. Freed run merges with free neighbours,
+     which are found with a couple of bitset scans. */
+  char* prev = mc_medium_prev(ptr);
+  char* next = mc_medium_next(ptr);
+  char* start = prev ? prev + mc_medium_size(prev) : mc_medium_mem_start(arena);
+  char* end = next ? next : mc_medium_mem_end(arena);
+  unsigned run = (unsigned)((end - start) / mc_medium_BLOCK_SIZE);
+  unsigned used = (unsigned)((char*)ptr - (char*)arena)
+    + blocks * mc_medium_BLOCK_SIZE;
+  header->dirty = header->dirty > used ? header->dirty : used;
+  MC__UNSAMPLE(mc_medium_marked(ptr), ptr);
+  mc_medium_free(ptr);
+
+  if (mc_medium_empty(arena)) {
+    header->run = 0;
+    mc__relist_medium(self, header);
+
+    if (self->medium_spare) {
+      mc__release_medium(self->medium_spare);
+    }
+    self->medium_spare = header;
+    return;
+  }
+
+  header->free += blocks;
+  header->run = header->run > run ? header->run : run;
+  header->run = header->run < header->free ? header->run : header->free;
+  mc__relist_medium(self, header);
+}
+
+/* Return small allocation to bucket owned by another thread. */
+static inline void mc__free_remote(mc_header_t* header, void* ptr) {
+  size_t head;
+  do {
+    head = fal_atomic_load(&header->remote, FAL_ATOMIC_ACQUIRE);
+    *(size_t*)ptr = head;
+  } while (!fal_atomic_cas(&header->remote, head, (size_t)ptr));
+
+  /* Only the first free since owner's last collection queues bucket, and
+     bucket can't be freed before owner collects ptr. */
+  if (!head) {
+    mc_thread_t* owner = header->owner;
+    size_t pending;
+    do {
+      pending = fal_atomic_load(&owner->pending, FAL_ATOMIC_ACQUIRE);
+      header->pending = (mc_header_t*)pending;
+    } while (!fal_atomic_cas(&owner->pending, pending, (size_t)header));
+  }
+}
+
+static inline void mc_free(void* ptr) {
+  unsigned owner = mc_heap_owner(&mc_heap, ptr);
+  assert(owner && "Trying to mc_free memory allocated not with mc_alloc.");
+
+  if (owner == MC_OWNER_HUGE) {
+    mc_huge_t* entry = mc__get_huge(ptr);
+    assert(entry && "Trying to mc_free memory allocated not with mc_alloc.");
+    size_t span = mc__huge_span(entry->size);
+    MC__UNSAMPLE(1, ptr);
+    MC__ON_FREE(ptr, entry->size);
+
+    mc__lock();
+    mc_heap_clear(&mc_heap, entry, span);
+    mc__unlock();
+
+    mc__unmap(entry, span);
+    return;
+  }
+
+  if (owner == MC_OWNER_MEDIUM) {
+    mc_medium_t* arena = mc_medium_for(ptr);
+    mc_header_t* header = mc_medium_header(arena);
+    if (header->owner != mc_self) {
+      mc__free_remote(header, ptr);
+      return;
+    }
+
+    mc__free_medium(arena, ptr);
+    return;
+  }
+
+  mc_bucket_t* bucket = mc_bucket_for(ptr);
+  mc_header_t* header = mc__header(bucket);
+  if (header->owner != mc_self) {
+    mc__free_remote(header, ptr);
+    return;
+  }
+
+  mc__free_small(bucket, ptr);
+}
+
+static inline void* mc_realloc(void* ptr, size_t newsize) {
+  size_t size;
+  unsigned owner = mc_heap_owner(&mc_heap, ptr);
+  assert(owner && "Trying to mc_realloc memory allocated not with mc_alloc.");
+
+  if (owner == MC_OWNER_BUCKET) {
+    /* Growing in place would put foreign size into class bucket. */
+    size = mc_bucket_size(ptr);
+    if (newsize <= size) {
+      return ptr;
+    }
+  } else if (owner == MC_OWNER_MEDIUM) {
+    size = mc_medium_size(ptr);
+    if (newsize <= size) {
+      return ptr;
+    }
+
+    /* Only owner may touch arena, and grown allocation must stay medium. */
+    mc_header_t* header = mc_medium_header(mc_medium_for(ptr));
+    if (header->owner == mc_self && !mc__is_huge(newsize)
+      && mc_medium_extend(ptr, newsize)) {
+      header->free -= mc__medium_blocks(mc_medium_size(ptr) - size);
+      header->run = header->run < header->free ? header->run : header->free;
+      mc__relist_medium(mc_self, header);
+
+      return ptr;
+    }
+  } else {
+    mc_huge_t* entry = mc__get_huge(ptr);
+    assert(entry && "Trying to mc_realloc memory allocated not with mc_alloc.");
+    size = entry->size;
+
+    /* Shrunk below huge it belongs to arena, which saves the whole span. */
+    if (mc_tuning.remap && mc__is_huge(newsize)) {
+      void* newptr = mc__resize_huge(entry, newsize);
+      if (newptr) {
+        return newptr;
+      }
+    }
+  }
+
+  void* newptr = mc_alloc(newsize);
+  if (!newptr) {
+    return 0;
+  }
+
+  memcpy(newptr, ptr, newsize < size ? newsize : size);
+  mc_free(ptr);
+
+  return newptr;
+}
+
+/* Usable size of allocation, at least requested size. */
+static inline size_t mc_size(void* ptr) {
+  unsigned owner = mc_heap_owner(&mc_heap, ptr);
+  assert(owner && "Trying to mc_size memory allocated not with mc_alloc.");
+
+  if (owner == MC_OWNER_BUCKET) {
+    return mc_bucket_size(ptr);
+  } else if (owner == MC_OWNER_MEDIUM) {
+    return mc_medium_size(ptr);
+  }
+
+  mc_huge_t* entry = mc__get_huge(ptr);
+  assert(entry && "Trying to mc_size memory allocated not with mc_alloc.");
+  return entry->size;
+}
+
+/* Whether allocation may hold anything but zeroes, i.e. its memory was
+   allocated and freed since os mapped it. Huge allocations are always fresh
+   mappings. */
+static inline int mc__dirty(void* ptr) {
+  unsigned owner = mc_heap_owner(&mc_heap, ptr);
+  if (owner == MC_OWNER_BUCKET) {
+    mc_bucket_t* bucket = mc_bucket_for(ptr);
+    return (size_t)((char*)ptr - (char*)bucket) < mc__header(bucket)->dirty;
+  } else if (owner == MC_OWNER_MEDIUM) {
+    mc_medium_t* arena = mc_medium_for(ptr);
+    mc_header_t* header = mc_medium_header(arena);
+    return (size_t)((char*)ptr - (char*)arena) < header->dirty;
+  }
+  return 0;
+}
+
+/* Zeroed allocation of count elements of size, returns 0 on overflow.
+   Memory which was never freed since os mapped it is zero already. */
+static inline void* mc_calloc(size_t count, size_t size) {
+  if (size && count > (size_t)-1 / size) {
+    return 0;
+  }
+
+  size *= count;
+  void* mem = mc_alloc(size);
+  if (mem && mc__dirty(mem)) {
+    memset(mem, 0, size);
+  }
+
+  return mem;
+}
+
+/* Allocation aligned to align, which is power of two. Allocation of multiple
+   of mc_ALIGN is aligned to it, medium allocations to medium block and huge
+   to heap map granule, so larger alignment moves allocation to the next
+   kind. */
+static inline void* mc_aligned_alloc(size_t align, size_t size) {
+  size = size ? size : 1;
+  if (align <= mc_ALIGN && size <= mc_SMALL_MAX) {
+    return mc_alloc(align <= mc_bucket_BLOCK_SIZE ? size
+      : (size + mc_ALIGN - 1) & ~(size_t)(mc_ALIGN - 1));
+  }
+
+  size = size > mc_SMALL_MAX ? size : mc_SMALL_MAX + 1;
+  if (align <= mc_medium_BLOCK_SIZE && !mc__is_huge(size)) {
+    return mc_alloc(size);
+  }
+
+  void* mem = mc__alloc_huge(size, align);
+  MC__SAMPLE(mem, size);
+  return mem;
+}
+
+/* Return empty buckets and medium arena retained by calling thread to os. */
+static inline void mc_trim() {
+  if (!mc_self) {
+    return;
+  }
+
+  mc__trim(mc_self, 0);
+  if (mc_self->medium_spare) {
+    mc__release_medium(mc_self->medium_spare);
+    mc_self->medium_spare = 0;
+  }
+}
+
+/* Leave thread's buckets to the next new thread. Calling thread may still
+   use mc_*, next mc_alloc gets it another set. */
+static inline void mc_thread_exit() {
+  if (!mc_self) {
+    return;
+  }
+
+  mc__collect(mc_self);
+  mc_trim();
+
+  mc__lock();
+  mc_self->next = mc_exited;
+  mc_exited = mc_self;
+  mc__unlock();
+
+  mc_self = 0;
+#if defined(__FAL_TRACE_H__)
+  fal_trace_thread_exit();
+#endif
+}
+
+#endif /* __FAL_SAMPLES_MICROALLOC_H__ */
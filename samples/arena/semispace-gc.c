@@ -31,20 +31,20 @@ int main() {
   /* Collect phase */ {
     space_init(newspace);
 
-    /* Run copying garbage collector and move marked objects to NEW space. */
-    for (object_t* obj = space_first(oldspace); obj; obj = space_next(obj)) {
-      if (!space_marked(obj)) {
-        continue;
-      }
-
-      /* Create copy of the object in NEW space. */
-      size_t size = space_size(obj);
-      void* newobj = space_bumpalloc(newspace, size);
-      memcpy(newobj, obj, size);
+    /* Run copying garbage collector and move marked objects to NEW space.
+       Adjacent marked objects form runs, every run is copied at once. */
+    size_t size;
+    for (char* run = space_first_run(oldspace, &size); run;
+      run = space_next_run(run, &size)) {
+      char* newrun = space_evacuate_run(newspace, run, size);
 
       /* Object memory in OLD space will now point to location
         of the same object in NEW space. */
-      *(object_t**)obj = newobj;
+      for (char* obj = run; obj < run + size; ) {
+        char* newobj = newrun + (obj - run);
+        *(object_t**)obj = (object_t*)newobj;
+        obj += space_size(newobj);
+      }
     }
 
     /* After all objects are moved to NEW space fix object references. */
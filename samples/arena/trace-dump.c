@@ -0,0 +1,103 @@
+/*
+  Prints dump written by fal_trace_dump (fal/trace.h) as text, events of all
+  rings merged by time, one per line:
+    <time since first event> <ring> <kind> <ptr> <size> [<old size>]
+  and count of events of every kind at the end. Time is in ticks of
+  FAL_TRACE_DEF_CLOCK of traced program (TSC on x86, ns otherwise).
+
+  Usage: trace-dump <file>
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fal/trace.h>
+
+typedef struct record_t {
+  fal_trace_event_t event;
+  uint32_t thread;
+} record_t;
+
+static int by_time(const void* a, const void* b) {
+  uint64_t ta = ((const record_t*)a)->event.time;
+  uint64_t tb = ((const record_t*)b)->event.time;
+  return ta < tb ? -1 : ta > tb;
+}
+
+static const char* kind_name(uint32_t kind) {
+  static const char* names[] = {
+    "?", "alloc", "free", "extend", "os_map", "os_unmap"
+  };
+  return kind < FAL_ARRLEN(names) ? names[kind] : "user";
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: trace-dump <file>\n");
+    return 2;
+  }
+
+  FILE* file = fopen(argv[1], "rb");
+  if (!file) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  fal_trace_file_t header;
+  if (fread(&header, sizeof(header), 1, file) != 1
+    || memcmp(header.magic, "FALTRACE", sizeof(header.magic)) != 0
+    || header.version != FAL_TRACE_VERSION
+    || header.event_size != sizeof(fal_trace_event_t)) {
+    fprintf(stderr, "%s: not a fal trace of this version\n", argv[1]);
+    return 1;
+  }
+
+  record_t* records = 0;
+  size_t count = 0;
+  uint64_t lost = 0;
+  for (uint32_t i = 0; i < header.rings; i++) {
+    fal_trace_ring_t ring;
+    if (fread(&ring, sizeof(ring), 1, file) != 1) {
+      fprintf(stderr, "%s: truncated\n", argv[1]);
+      return 1;
+    }
+
+    records = realloc(records, (count + ring.events) * sizeof(record_t));
+    for (uint64_t ix = 0; ix < ring.events; ix++, count++) {
+      if (fread(&records[count].event, sizeof(fal_trace_event_t), 1, file)
+        != 1) {
+        fprintf(stderr, "%s: truncated\n", argv[1]);
+        return 1;
+      }
+      records[count].thread = ring.thread;
+    }
+    lost += ring.total - ring.events;
+  }
+  fclose(file);
+
+  qsort(records, count, sizeof(record_t), by_time);
+
+  size_t kinds[FAL_TRACE_OS_UNMAP + 2] = {0};
+  for (size_t i = 0; i < count; i++) {
+    const fal_trace_event_t* e = &records[i].event;
+    printf("%12llu %4u %-8s 0x%012llx %10llu",
+      (unsigned long long)(e->time - records[0].event.time),
+      (unsigned)records[i].thread, kind_name(e->kind),
+      (unsigned long long)e->ptr, (unsigned long long)e->size);
+    if (e->kind == FAL_TRACE_EXTEND) {
+      printf(" %10llu", (unsigned long long)e->arg);
+    }
+    printf("\n");
+
+    kinds[e->kind <= FAL_TRACE_OS_UNMAP ? e->kind : FAL_TRACE_OS_UNMAP + 1]++;
+  }
+
+  printf("%zu events of %u rings, %llu overwritten, %llu dropped\n",
+    count, (unsigned)header.rings, (unsigned long long)lost,
+    (unsigned long long)header.dropped);
+  for (uint32_t kind = 1; kind < FAL_ARRLEN(kinds); kind++) {
+    printf("  %-8s %zu\n", kind_name(kind), kinds[kind]);
+  }
+
+  free(records);
+  return 0;
+}
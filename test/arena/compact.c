@@ -0,0 +1,74 @@
+#include "testlib.h"
+
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW       16u /* 64 KiB */
+#define FAL_ARENA_DEF_NAME      arena
+#include <fal/arena.h>
+
+enum { COUNT = 300 };
+
+int main() {
+  arena_t* arena = (arena_t*)testlib_alloc_arena(arena_SIZE);
+  arena_init(arena);
+
+  /* Allocations of 1..7 blocks, so runs cross bitset words, every third one
+     and every one bigger than 5 blocks is marked. */
+  size_t* objs[COUNT];
+  size_t sizes[COUNT];
+  for (size_t i = 0; i < COUNT; i++) {
+    sizes[i] = (i * 5 % 7 + 1) * arena_BLOCK_SIZE;
+    objs[i] = arena_bumpalloc(arena, sizes[i]);
+    assert(objs[i]);
+    for (size_t j = 0; j < sizes[i] / sizeof(size_t); j++) {
+      objs[i][j] = i;
+    }
+
+    if (i % 3 == 0 || sizes[i] > 5 * arena_BLOCK_SIZE) {
+      arena_mark(objs[i]);
+    }
+  }
+
+  static arena_fwd_t table[arena_FWD_LEN];
+  size_t live = arena_forward_build(arena, table);
+
+  /* Forwarding address is start of arena plus marked blocks before. */
+  size_t* to[COUNT];
+  size_t expected = 0;
+  for (size_t i = 0; i < COUNT; i++) {
+    if (!arena_marked(objs[i])) {
+      continue;
+    }
+
+    to[i] = arena_forward(table, objs[i]);
+    fal_asserteq((size_t)((char*)to[i] - (char*)arena_mem_start(arena)), expected,
+      size_t, "%zu");
+    expected += sizes[i];
+  }
+  fal_asserteq(live * arena_BLOCK_SIZE, expected, size_t, "%zu");
+
+  arena_compact(arena);
+  fal_asserteq(arena_bumptop(arena), arena_BEGIN + live, size_t, "%zu");
+
+  size_t count = 0;
+  for (size_t* obj = arena_first(arena); obj; obj = arena_next(obj)) {
+    assert(!arena_marked(obj));
+    size_t i = obj[0];
+    assert(obj == to[i]);
+    fal_asserteq(arena_size(obj), sizes[i], size_t, "%zu");
+    for (size_t j = 0; j < sizes[i] / sizeof(size_t); j++) {
+      fal_asserteq(obj[j], i, size_t, "%zu");
+    }
+    count++;
+  }
+  assert(count > COUNT / 3);
+
+  /* Freed space is reusable. */
+  assert(arena_bumpalloc(arena, arena_BLOCK_SIZE * (arena_END - arena_bumptop(arena))));
+
+  /* Nothing marked, nothing left. */
+  arena_init(arena);
+  assert(arena_bumpalloc(arena, 100));
+  fal_asserteq(arena_forward_build(arena, table), 0u, size_t, "%zu");
+  arena_compact(arena);
+  assert(arena_empty(arena));
+}
@@ -0,0 +1,126 @@
+#include "testlib.h"
+
+#define FAL_ARENA_DEF_BLOCK_POW  4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW        14u /* 16 KiB */
+#define FAL_ARENA_DEF_NAME       plain
+#include <fal/arena.h>
+
+#define FAL_ARENA_DEF_BLOCK_POW  4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW        14u /* 16 KiB */
+#define FAL_ARENA_DEF_EXTRA_BITS 3
+#define FAL_ARENA_DEF_NAME       arena
+#include <fal/arena.h>
+
+enum { COUNT = 200 };
+
+/* Allocations of 1..3 blocks holding their index. */
+static size_t* objs[COUNT];
+
+static size_t value_of(size_t i) {
+  return (i * 5 + 1) % 8;
+}
+
+static void fill(arena_t* arena) {
+  arena_init(arena);
+  for (size_t i = 0; i < COUNT; i++) {
+    objs[i] = arena_bumpalloc(arena, (i % 3 + 1) * arena_BLOCK_SIZE);
+    assert(objs[i]);
+    *objs[i] = i;
+    fal_asserteq(arena_extra_load(objs[i]), 0u, unsigned, "%u");
+    arena_extra_store(objs[i], (unsigned)value_of(i));
+    if (i % 2) {
+      arena_mark(objs[i]);
+    }
+  }
+}
+
+/* Check that every marked allocation got its bits along, in place or at
+   address from its forwarding in objs. */
+static void check_moved(void* first, size_t expected) {
+  size_t count = 0;
+  for (size_t* obj = first; obj; obj = arena_next(obj)) {
+    fal_asserteq(arena_extra_load(obj), (unsigned)value_of(*obj),
+      unsigned, "%u");
+    assert(*obj % 2);
+    count++;
+  }
+  fal_asserteq(count, expected, size_t, "%zu");
+}
+
+int main() {
+  /* Each extra bit takes another bitset from effective space. */
+  fal_asserteq(arena_EXTRA_BITS, 3u, unsigned, "%u");
+  fal_asserteq((size_t)plain_EXTRA_BITS, 0u, size_t, "%zu");
+  fal_asserteq((size_t)(plain_EFFECTIVE_SIZE - arena_EFFECTIVE_SIZE),
+    (size_t)3 * (arena_SIZE / arena_BLOCK_SIZE / 8), size_t, "%zu");
+
+  arena_t* arena = (arena_t*)testlib_alloc_arena(arena_SIZE);
+  arena_t* other = (arena_t*)testlib_alloc_arena(arena_SIZE);
+
+  /* Get, set, load and store. */
+  fill(arena);
+  for (size_t i = 0; i < COUNT; i++) {
+    fal_asserteq(arena_extra_load(objs[i]), (unsigned)value_of(i),
+      unsigned, "%u");
+    for (unsigned bit = 0; bit < arena_EXTRA_BITS; bit++) {
+      fal_asserteq(arena_extra_get(objs[i], bit), (int)(value_of(i) >> bit & 1),
+        int, "%d");
+    }
+    assert(arena_marked(objs[i]) == (int)(i % 2));
+  }
+  arena_extra_set(objs[0], 2, 1);
+  fal_asserteq(arena_extra_load(objs[0]), 5u, unsigned, "%u");
+  arena_extra_set(objs[0], 0, 0);
+  fal_asserteq(arena_extra_load(objs[0]), 4u, unsigned, "%u");
+
+  /* Bulk clear of one bit leaves others. */
+  arena_extra_clear_all(arena, 1);
+  for (size_t i = 1; i < COUNT; i++) {
+    fal_asserteq(arena_extra_load(objs[i]), (unsigned)(value_of(i) & 5),
+      unsigned, "%u");
+  }
+
+  /* Raw bitset is indexed by start block. */
+  uint64_t* bs = arena_extra_bitset(arena, 2);
+  size_t ix = ((char*)objs[7] - (char*)arena) / arena_BLOCK_SIZE;
+  assert((bs[ix / 64] >> (ix % 64) & 1) == (value_of(7) >> 2 & 1));
+
+  /* Freed and reallocated memory starts with zero bits, as does emplaced. */
+  while (arena_bumpalloc(arena, arena_BLOCK_SIZE)) {
+  }
+  arena_free(objs[5]);
+  void* again = arena_alloc(arena, 3 * arena_BLOCK_SIZE);
+  assert(again == objs[5]);
+  fal_asserteq(arena_extra_load(again), 0u, unsigned, "%u");
+  arena_extra_store(objs[9], 7);
+  arena_emplace(objs[9], 3 * arena_BLOCK_SIZE);
+  fal_asserteq(arena_extra_load(objs[9]), 0u, unsigned, "%u");
+
+  /* Sliding compaction carries bits. */
+  fill(arena);
+  arena_compact(arena);
+  check_moved(arena_first(arena), COUNT / 2);
+
+  /* Evacuation of runs carries bits into other arena. */
+  fill(arena);
+  arena_init(other);
+  size_t size;
+  for (void* run = arena_first_run(arena, &size); run;
+    run = arena_next_run(run, &size)) {
+    assert(arena_evacuate_run(other, run, size));
+  }
+  check_moved(arena_first(other), COUNT / 2);
+
+  /* Two-finger compaction of same-size allocations too. */
+  arena_init(arena);
+  for (size_t i = 0; i < COUNT; i++) {
+    objs[i] = arena_bumpalloc(arena, 2 * arena_BLOCK_SIZE);
+    *objs[i] = i;
+    arena_extra_store(objs[i], (unsigned)value_of(i));
+    if (i % 2) {
+      arena_mark(objs[i]);
+    }
+  }
+  arena_compact_twofinger(arena, 2 * arena_BLOCK_SIZE);
+  check_moved(arena_first(arena), COUNT / 2);
+}
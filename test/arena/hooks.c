@@ -0,0 +1,82 @@
+#include "testlib.h"
+
+/* Counts and last event seen by hooks. */
+static int allocs, frees, extends;
+static void* last_ptr;
+static size_t last_size, last_oldsize;
+
+static void rec_on_alloc(void* ptr, size_t size) {
+  allocs++;
+  last_ptr = ptr;
+  last_size = size;
+}
+
+static void rec_on_free(void* ptr, size_t size) {
+  frees++;
+  last_ptr = ptr;
+  last_size = size;
+}
+
+static void rec_on_extend(void* ptr, size_t oldsize, size_t size) {
+  extends++;
+  last_ptr = ptr;
+  last_size = size;
+  last_oldsize = oldsize;
+}
+
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW       14u /* 16 KiB */
+#define FAL_ARENA_DEF_HOOKS     rec
+#define FAL_ARENA_DEF_NAME      arena
+#include <fal/arena.h>
+
+/* Same arena without hooks calls nothing. */
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW       14u /* 16 KiB */
+#define FAL_ARENA_DEF_NAME      plain
+#include <fal/arena.h>
+
+int main() {
+  arena_t* arena = (arena_t*)testlib_alloc_arena(arena_SIZE);
+  arena_init(arena);
+  fal_asserteq(allocs + frees + extends, 0, int, "%d");
+
+  char* a = arena_bumpalloc(arena, 20);
+  fal_asserteq(allocs, 1, int, "%d");
+  assert(last_ptr == a);
+  fal_asserteq(last_size, 2 * arena_BLOCK_SIZE, size_t, "%zu");
+
+  char* b = arena_alloc(arena, arena_BLOCK_SIZE);
+  fal_asserteq(allocs, 2, int, "%d");
+  assert(last_ptr == b);
+
+  arena_free(a);
+  fal_asserteq(frees, 1, int, "%d");
+  assert(last_ptr == a);
+  fal_asserteq(last_size, 2 * arena_BLOCK_SIZE, size_t, "%zu");
+
+  char* c = arena_alloc(arena, arena_BLOCK_SIZE);
+  fal_asserteq(allocs, 3, int, "%d");
+  assert(last_ptr == c);
+
+  /* Extend hook sees both sizes, failed and no-op extend are not events. */
+  assert(arena_extend(c, 3 * arena_BLOCK_SIZE));
+  fal_asserteq(extends, 1, int, "%d");
+  assert(last_ptr == c);
+  fal_asserteq(last_oldsize, arena_BLOCK_SIZE, size_t, "%zu");
+  fal_asserteq(last_size, 3 * arena_BLOCK_SIZE, size_t, "%zu");
+
+  assert(arena_extend(c, 3 * arena_BLOCK_SIZE));
+  assert(!arena_extend(b, 2 * arena_BLOCK_SIZE));
+  fal_asserteq(extends, 1, int, "%d");
+
+  assert(arena_extend(c, arena_BLOCK_SIZE));
+  fal_asserteq(extends, 2, int, "%d");
+  fal_asserteq(last_size, arena_BLOCK_SIZE, size_t, "%zu");
+
+  plain_t* other = (plain_t*)testlib_alloc_arena(plain_SIZE);
+  plain_init(other);
+  plain_free(plain_alloc(other, 100));
+  fal_asserteq(allocs, 3, int, "%d");
+  fal_asserteq(frees, 1, int, "%d");
+}
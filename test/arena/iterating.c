@@ -12,6 +12,9 @@ int main() {
   assert("arena_first() must return NULL for empty arena"
     && !arena_first(arena));
   assert("arena_next(NULL) must return NULL" && !arena_next(0));
+  assert("arena_last() must return NULL for empty arena"
+    && !arena_last(arena));
+  assert("arena_prev(NULL) must return NULL" && !arena_prev(0));
   assert("arena_next_noskip(NULL) must return NULL" && !arena_next_noskip(0));
 
   assert("arena_first_noskip() must return first block of empty arena"
@@ -55,8 +58,39 @@ int main() {
       && first == a && second == b && third == c && !fourth);
   }
 
+  {
+    void* last = arena_last(arena);
+    void* second = arena_prev(last);
+    void* third = arena_prev(second);
+    void* fourth = arena_prev(third);
+
+    assert("iterating backwards"
+      && last == c && second == b && third == a && !fourth);
+  }
+
+  arena_mark(a);
+  arena_mark(c);
+  {
+    void* last = arena_last_marked(arena);
+    void* second = arena_prev_marked(last);
+    void* third = arena_prev_marked(second);
+
+    assert("iterating marked backwards"
+      && last == c && second == a && !third);
+  }
+  arena_unmark(a);
+  arena_unmark(c);
+
   arena_free(a);
   arena_free(c);
+  {
+    void* last = arena_last(arena);
+    void* second = arena_prev(last);
+
+    assert("iterating backwards after freeing"
+      && last == b && !second);
+  }
+
   {
     void* first = arena_first(arena);
     void* second = arena_next(first);
@@ -45,4 +45,12 @@ int main() {
   for (int i = 0; i < (int)FAL_ARRLEN(p); i++) {
     assert(!arena_marked(p[i]));
   }
+
+  /* Only starts change, allocations keep their sizes. */
+  arena_free(b);
+  arena_mark_all(arena, 1);
+  assert(!arena_used(b) && arena_marked(a) && arena_marked(c));
+  fal_asserteq(arena_size(a), 64u, size_t, "%zu");
+  fal_asserteq(arena_size(e), arena_BLOCK_SIZE*arena_TOTAL - 256, size_t, "%zu");
+  fal_asserteq(arena_next(a), c, void*, "%p");
 }
@@ -0,0 +1,36 @@
+#include "testlib.h"
+
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW       16u /* 64 KiB */
+#define FAL_ARENA_DEF_NAME      arena
+#include <fal/arena.h>
+
+int main() {
+  arena_t* arena = (arena_t*)testlib_alloc_arena(arena_SIZE);
+  arena_init(arena);
+
+  assert("nothing is allocated in empty arena"
+    && !arena_owner(arena_mem_start(arena)));
+
+  /* Allocation spanning several bitset words. */
+  char* a = arena_bumpalloc(arena, arena_BLOCK_SIZE);
+  char* b = arena_bumpalloc(arena, 200 * arena_BLOCK_SIZE);
+  char* c = arena_bumpalloc(arena, 3 * arena_BLOCK_SIZE);
+  assert(a && b && c);
+
+  assert("start of allocation" && arena_owner(a) == a && arena_owner(b) == b);
+  assert("inside of allocation" && arena_owner(a + 7) == a);
+  assert("guts in other words" && arena_owner(b + 100 * arena_BLOCK_SIZE) == b
+    && arena_owner(b + 200 * arena_BLOCK_SIZE - 1) == b);
+  assert("last allocation" && arena_owner(c + 2 * arena_BLOCK_SIZE) == c);
+  assert("above top" && !arena_owner(c + 3 * arena_BLOCK_SIZE));
+  assert("bitsets" && !arena_owner(arena));
+
+  /* Marks don't matter. */
+  arena_mark(b);
+  assert(arena_owner(b + 150 * arena_BLOCK_SIZE) == b);
+
+  arena_free(b);
+  assert("freed blocks" && !arena_owner(b) && !arena_owner(b + 150 * arena_BLOCK_SIZE));
+  assert(arena_owner(c + 1) == c);
+}
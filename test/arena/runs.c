@@ -0,0 +1,115 @@
+#include "testlib.h"
+
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW       16u /* 64 KiB */
+#define FAL_ARENA_DEF_NAME      arena
+#include <fal/arena.h>
+
+enum { COUNT = 300 };
+
+int main() {
+  arena_t* from = (arena_t*)testlib_alloc_arena(arena_SIZE);
+  arena_t* to = (arena_t*)testlib_alloc_arena(arena_SIZE);
+  arena_init(from);
+  arena_init(to);
+
+  /* Allocations of 1..7 blocks, so runs cross bitset words. Every fourth
+     one is freed, every one bigger than 5 blocks and two of every three
+     others are marked. */
+  size_t* objs[COUNT];
+  size_t sizes[COUNT];
+  int marked[COUNT];
+  for (size_t i = 0; i < COUNT; i++) {
+    sizes[i] = (i * 5 % 7 + 1) * arena_BLOCK_SIZE;
+    objs[i] = arena_bumpalloc(from, sizes[i]);
+    assert(objs[i]);
+    for (size_t j = 0; j < sizes[i] / sizeof(size_t); j++) {
+      objs[i][j] = i;
+    }
+
+    marked[i] = i % 4 != 3 && (i % 3 != 0 || sizes[i] > 5 * arena_BLOCK_SIZE);
+    if (marked[i]) {
+      arena_mark(objs[i]);
+    }
+  }
+  for (size_t i = 3; i < COUNT; i += 4) {
+    arena_free(objs[i]);
+  }
+
+  /* Runs are maximal sequences of adjacent marked allocations. */
+  size_t i = 0;
+  size_t runs = 0;
+  size_t total = 0;
+  size_t size = 0;
+  for (char* run = arena_first_run(from, &size); run;
+    run = arena_next_run(run, &size)) {
+    while (!marked[i]) {
+      i++;
+    }
+    assert(run == (char*)objs[i]);
+
+    size_t expected = 0;
+    for (; i < COUNT && marked[i]; i++) {
+      expected += sizes[i];
+    }
+    fal_asserteq(size, expected, size_t, "%zu");
+
+    /* Evacuated run keeps allocations at the same offsets, unmarked. */
+    char* copy = arena_evacuate_run(to, run, size);
+    assert(copy);
+    fal_asserteq((size_t)(copy - (char*)arena_mem_start(to)), total,
+      size_t, "%zu");
+    for (size_t* obj = (size_t*)run; obj && (char*)obj < run + size;
+      obj = arena_next(obj)) {
+      size_t* moved = (size_t*)(copy + ((char*)obj - run));
+      assert(!arena_marked(moved));
+      fal_asserteq(arena_size(moved), sizes[obj[0]], size_t, "%zu");
+      fal_asserteq(moved[0], obj[0], size_t, "%zu");
+    }
+
+    total += size;
+    runs++;
+  }
+  for (; i < COUNT; i++) {
+    assert(!marked[i]);
+  }
+  assert(runs > COUNT / 8);
+
+  /* To-space holds exactly marked allocations in order. */
+  fal_asserteq(arena_bumptop(to) * arena_BLOCK_SIZE,
+    arena_BEGIN * arena_BLOCK_SIZE + total, size_t, "%zu");
+  i = 0;
+  for (size_t* obj = arena_first(to); obj; obj = arena_next(obj)) {
+    while (!marked[i]) {
+      i++;
+    }
+    fal_asserteq(obj[0], i, size_t, "%zu");
+    fal_asserteq(arena_size(obj), sizes[i], size_t, "%zu");
+    for (size_t j = 0; j < sizes[i] / sizeof(size_t); j++) {
+      fal_asserteq(obj[j], i, size_t, "%zu");
+    }
+    i++;
+  }
+
+  /* Run which doesn't fit isn't copied. */
+  size = 0;
+  char* run = arena_first_run(from, &size);
+  while (arena_bumpalloc(to, arena_BLOCK_SIZE)) {
+  }
+  assert(!arena_evacuate_run(to, run, size));
+
+  /* Emplaced run in the middle of bitset word at unaligned position. */
+  arena_init(to);
+  char* where = arena_bumpalloc(to, 5 * arena_BLOCK_SIZE);
+  memcpy(where, run, size);
+  arena_emplace_run(where, run, size);
+  arena_emplace_end(where + size);
+  fal_asserteq(arena_size(where), arena_size(run), size_t, "%zu");
+  fal_asserteq(*(size_t*)arena_next(where), *(size_t*)arena_next(run),
+    size_t, "%zu");
+
+  /* Nothing marked, no runs. */
+  arena_init(from);
+  assert(arena_bumpalloc(from, 100));
+  assert(!arena_first_run(from, &size));
+}
@@ -0,0 +1,32 @@
+#include "testlib.h"
+
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW       20u /* 1 MiB = 65536 blocks */
+#define FAL_ARENA_DEF_NAME      arena
+#include <fal/arena.h>
+
+int main() {
+  arena_t* arena = (arena_t*)testlib_alloc_arena(arena_SIZE);
+  arena_init(arena);
+
+  fal_asserteq(arena_SIZE, 1048576u, size_t, "%zu");
+  fal_asserteq(arena_BLOCK_SIZE, 16u, size_t, "%zu");
+  fal_asserteq(arena_BEGIN, 1024u, size_t, "%zu");
+  fal_asserteq(arena_END, 65536u, size_t, "%zu");
+  fal_asserteq(arena_TOTAL, 64512u, size_t, "%zu");
+  fal_asserteq(arena_USER_LO_BYTES, 124u, size_t, "%zu");
+  fal_asserteq(arena_USER_HI_BYTES, 128u, size_t, "%zu");
+  fal_asserteq(arena_bumptop(arena), arena_BEGIN, size_t, "%zu");
+
+  /* Bump top must be able to reach arena_END. */
+  void* a = arena_bumpalloc(arena, arena_EFFECTIVE_SIZE - arena_BLOCK_SIZE);
+  void* b = arena_bumpalloc(arena, arena_BLOCK_SIZE);
+  assert(a && b);
+  fal_asserteq(arena_bumptop(arena), arena_END, size_t, "%zu");
+  assert(!arena_bumpalloc(arena, arena_BLOCK_SIZE));
+  assert(!arena_alloc(arena, arena_BLOCK_SIZE));
+
+  arena_free(a);
+  assert(arena_alloc(arena, arena_BLOCK_SIZE) == a);
+  fal_asserteq(arena_bumptop(arena), arena_END, size_t, "%zu");
+}
@@ -0,0 +1,121 @@
+#include "testlib.h"
+
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW       14u /* 16 KiB */
+#define FAL_ARENA_DEF_NAME      arena
+#include <fal/arena.h>
+
+int main() {
+  arena_t* arena = (arena_t*)testlib_alloc_arena(arena_SIZE);
+
+  /* Allocations of various sizes crossing bitset words. */
+  {
+    arena_init(arena);
+
+    void* p[64];
+    size_t total = 0;
+    for (int i = 0; i < (int)FAL_ARRLEN(p); i++) {
+      size_t bsize = 1 + (i * 7) % 13;
+      p[i] = arena_bumpalloc(arena, bsize * arena_BLOCK_SIZE);
+      assert(p[i]);
+      total += bsize;
+    }
+
+    assert(arena_bumptop(arena) == arena_BEGIN + total);
+    assert(!arena_first_marked(arena));
+
+    size_t live = 0;
+    for (int i = 0; i < (int)FAL_ARRLEN(p); i++) {
+      if (i % 3 == 0) {
+        arena_mark(p[i]);
+        live += arena_bsize(p[i]);
+      }
+    }
+
+    /* Iterating marked allocations. */
+    {
+      int i = 0;
+      for (void* m = arena_first_marked(arena); m; m = arena_next_marked(m)) {
+        assert(m == p[i]);
+        i += 3;
+      }
+      assert(i == 66);
+    }
+
+    fal_asserteq(arena_sweep(arena), live, size_t, "%zu");
+
+    /* Survivors are unmarked and keep their sizes, others are freed. */
+    for (int i = 0; i < (int)FAL_ARRLEN(p); i++) {
+      if (i % 3 == 0) {
+        assert(arena_used(p[i]) && !arena_marked(p[i]));
+        fal_asserteq(arena_bsize(p[i]), (size_t)(1 + (i * 7) % 13), size_t, "%zu");
+      } else {
+        assert(!arena_used(p[i]));
+      }
+    }
+
+    /* Last allocation was freed, so bump top must go down to last survivor. */
+    fal_asserteq(arena_bumptop(arena),
+      (size_t)(((char*)p[63] - (char*)arena) / arena_BLOCK_SIZE + arena_bsize(p[63])),
+      size_t, "%zu");
+
+    {
+      int i = 0;
+      for (void* a = arena_first(arena); a; a = arena_next(a)) {
+        assert(a == p[i]);
+        i += 3;
+      }
+      assert(i == 66);
+    }
+
+    /* Freed space can be reused. */
+    assert(arena_extend(p[0], arena_size(p[0]) + arena_size(p[1])));
+  }
+
+  /* Sweeping unmarked arena frees everything. */
+  {
+    arena_init(arena);
+    assert(arena_bumpalloc(arena, 100));
+    assert(arena_bumpalloc(arena, 2000));
+    assert(arena_bumpalloc(arena, 16));
+
+    fal_asserteq(arena_sweep(arena), 0u, size_t, "%zu");
+    assert(arena_empty(arena));
+    assert(!arena_first(arena));
+    fal_asserteq(arena_bsize(arena_first_noskip(arena)), (size_t)arena_TOTAL,
+      size_t, "%zu");
+  }
+
+  /* First fit allocation doesn't cross bump top unnoticed. */
+  {
+    arena_init(arena);
+    void* a = arena_bumpalloc(arena, arena_BLOCK_SIZE * (arena_TOTAL - 4));
+    void* b = arena_bumpalloc(arena, arena_BLOCK_SIZE * 2);
+    assert(a && b);
+
+    arena_free(a);
+    assert(!arena_bumpalloc(arena, arena_BLOCK_SIZE * 4));
+
+    void* c = arena_alloc(arena, arena_BLOCK_SIZE * 8);
+    assert(c == a);
+
+    assert(!arena_alloc(arena, arena_BLOCK_SIZE * arena_TOTAL));
+  }
+
+  /* Looking for free blocks can start after given block. */
+  {
+    arena_init(arena);
+    char* a = arena_bumpalloc(arena, arena_BLOCK_SIZE * 100);
+    char* b = arena_bumpalloc(arena, arena_BLOCK_SIZE * 100);
+    char* c = arena_bumpalloc(arena, arena_BLOCK_SIZE * (arena_TOTAL - 200));
+    assert(a && b && c);
+
+    arena_free(a);
+    arena_free(b);
+    size_t from = arena_BEGIN + 150;
+    assert(arena_alloc_from(arena, arena_BLOCK_SIZE, from)
+      == b + 50 * arena_BLOCK_SIZE);
+    assert(!arena_alloc_from(arena, arena_BLOCK_SIZE * 100, from));
+    assert(arena_alloc_from(arena, arena_BLOCK_SIZE, 0) == a);
+  }
+}
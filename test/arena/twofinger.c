@@ -0,0 +1,97 @@
+#include "testlib.h"
+
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW       16u /* 64 KiB */
+#define FAL_ARENA_DEF_NAME      arena
+#include <fal/arena.h>
+
+/* Two-block object, its first word gets forwarding address when moved. */
+typedef struct obj_t obj_t;
+struct obj_t {
+  obj_t* ref;
+  size_t id;
+  size_t pad[2];
+};
+
+enum { COUNT = 1000 };
+
+int main() {
+  arena_t* arena = (arena_t*)testlib_alloc_arena(arena_SIZE);
+  arena_init(arena);
+
+  /* Marked objects are spread unevenly: none in the first 100, every third
+     in the middle, all of the last 100. */
+  obj_t* objs[COUNT];
+  int marked[COUNT];
+  size_t live = 0;
+  for (size_t i = 0; i < COUNT; i++) {
+    objs[i] = arena_bumpalloc(arena, sizeof(obj_t));
+    assert(objs[i]);
+    objs[i]->id = i;
+
+    marked[i] = i >= COUNT - 100 || (i >= 100 && i % 3 == 0);
+    if (marked[i]) {
+      arena_mark(objs[i]);
+      live++;
+    }
+  }
+  for (size_t i = 0; i < COUNT; i++) {
+    objs[i]->ref = objs[(i * 7 + 13) % COUNT];
+  }
+  /* Freed slots are reused too. */
+  arena_free(objs[50]);
+
+  char* end = arena_compact_twofinger(arena, sizeof(obj_t));
+  fal_asserteq((size_t)(end - (char*)arena_mem_start(arena)),
+    live * sizeof(obj_t), size_t, "%zu");
+  fal_asserteq(arena_bumptop(arena) * arena_BLOCK_SIZE,
+    (size_t)(end - (char*)arena), size_t, "%zu");
+
+  /* Moved objects are found by forwarding addresses. */
+  for (size_t i = 0; i < COUNT; i++) {
+    if (marked[i]) {
+      obj_t* obj = (char*)objs[i] >= end ? objs[i]->ref : objs[i];
+      fal_asserteq(obj->id, i, size_t, "%zu");
+      objs[i] = obj;
+    }
+  }
+
+  /* Fixing references of live objects. */
+  size_t count = 0;
+  for (obj_t* obj = arena_first(arena); obj; obj = arena_next(obj)) {
+    assert(!arena_marked(obj));
+    fal_asserteq(arena_size(obj), sizeof(obj_t), size_t, "%zu");
+    assert(marked[obj->id] && objs[obj->id] == obj);
+    if ((char*)obj->ref >= end) {
+      obj->ref = obj->ref->ref;
+    }
+    count++;
+  }
+  fal_asserteq(count, live, size_t, "%zu");
+
+  for (size_t i = 0; i < COUNT; i++) {
+    if (marked[i] && marked[(i * 7 + 13) % COUNT]) {
+      fal_asserteq(objs[i]->ref->id, (i * 7 + 13) % COUNT, size_t, "%zu");
+    }
+  }
+
+  /* Freed space is reusable. */
+  assert(arena_bumpalloc(arena, arena_BLOCK_SIZE * (arena_END - arena_bumptop(arena))));
+
+  /* Already compact arena stays as is. */
+  arena_init(arena);
+  for (size_t i = 0; i < 10; i++) {
+    objs[i] = arena_bumpalloc(arena, sizeof(obj_t));
+    objs[i]->id = i;
+    if (i < 5) {
+      arena_mark(objs[i]);
+    }
+  }
+  end = arena_compact_twofinger(arena, sizeof(obj_t));
+  assert(end == (char*)objs[5]);
+  fal_asserteq(objs[4]->id, 4u, size_t, "%zu");
+
+  /* Nothing marked, nothing left. */
+  end = arena_compact_twofinger(arena, sizeof(obj_t));
+  assert(end == arena_mem_start(arena) && arena_empty(arena));
+}
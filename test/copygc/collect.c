@@ -0,0 +1,159 @@
+#include "testlib.h"
+
+#define FAL_COPYGC_DEF_POW       14u /* 16 KiB */
+#define FAL_COPYGC_DEF_BLOCK_POW 4u  /* 16 bytes */
+#define FAL_COPYGC_DEF_NAME      cgc
+#include <fal/copygc.h>
+
+static void trace(cgc_t* gc, void* obj) {
+  node_t* node = obj;
+  cgc_visit(gc, (void**)&node->left);
+  cgc_visit(gc, (void**)&node->right);
+}
+
+static node_t* mknode(cgc_t* gc, size_t id) {
+  node_t* node = cgc_alloc(gc, sizeof(node_t));
+  if (node) {
+    node->id = id;
+  }
+  return node;
+}
+
+static int owned(cgc_t* gc, void* ptr) {
+  for (cgc_arena_t* arena = cgc_first_arena(gc); arena;
+    arena = cgc_next_arena(arena)) {
+    if (cgc_arena_for(ptr) == arena) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+enum { ARENAS = 8, NODES = 1200 };
+
+/* Check if node id is in subtree of node root of heap-ordered tree. */
+static int in_subtree(size_t id, size_t root) {
+  while (id > root) {
+    id = (id - 1) / 2;
+  }
+  return id == root;
+}
+
+int main() {
+  static cgc_t gc;
+  cgc_init(&gc, trace);
+  for (size_t i = 0; i < ARENAS; i++) {
+    cgc_add_arena(&gc, testlib_alloc_arena(cgc_arena_SIZE));
+  }
+
+  const cgc_stats_t* stats = cgc_stats(&gc);
+  fal_asserteq(stats->arenas, (size_t)ARENAS, size_t, "%zu");
+  fal_asserteq(stats->used_arenas, 0u, size_t, "%zu");
+
+  /* Mutator may use only half of arenas, less tail of each to-space arena
+     which may be too short for the largest object. */
+  size_t capacity = 0;
+  while (mknode(&gc, capacity)) {
+    capacity++;
+  }
+  fal_asserteq(stats->used_arenas, (size_t)ARENAS / 2, size_t, "%zu");
+  fal_asserteq(capacity, ARENAS / 2
+    * (cgc_arena_EFFECTIVE_SIZE - cgc_arena_BLOCK_SIZE)
+    / (2 * cgc_arena_BLOCK_SIZE), size_t, "%zu");
+
+  /* Nothing is reachable, everything is freed. */
+  cgc_collect(&gc);
+  fal_asserteq(stats->collections, 1u, size_t, "%zu");
+  fal_asserteq(stats->copied_bytes, 0u, size_t, "%zu");
+  fal_asserteq(stats->used_arenas, 0u, size_t, "%zu");
+  assert(!cgc_first_arena(&gc));
+
+  /* Tree spanning several arenas, interleaved with garbage, with subtree of
+     node 5 shared and closed in cycle. */
+  static node_t* nodes[NODES];
+  for (size_t i = 0; i < FAL_ARRLEN(nodes); i++) {
+    nodes[i] = mknode(&gc, i);
+    assert(nodes[i] && (i % 2 || mknode(&gc, NODES + i)));
+  }
+  for (size_t i = 0; i < FAL_ARRLEN(nodes); i++) {
+    if (2*i + 1 < FAL_ARRLEN(nodes)) {
+      nodes[i]->left = nodes[2*i + 1];
+    }
+    if (2*i + 2 < FAL_ARRLEN(nodes)) {
+      nodes[i]->right = nodes[2*i + 2];
+    }
+  }
+  size_t cycle = NODES - 1, shared = NODES - 1;
+  while (!in_subtree(cycle, 5)) {
+    cycle--;
+  }
+  while (!in_subtree(shared, 1)) {
+    shared--;
+  }
+  nodes[cycle]->left = nodes[5];
+  nodes[shared]->left = nodes[5];
+
+  void* slots[2] = { nodes[0], nodes[5] };
+  cgc_root_t root;
+  cgc_add_root(&gc, &root, slots, 2);
+
+  size_t size = cgc_arena_size(nodes[0]);
+  cgc_collect(&gc);
+  fal_asserteq(stats->copied_objects, FAL_ARRLEN(nodes), size_t, "%zu");
+  fal_asserteq(stats->copied_bytes, FAL_ARRLEN(nodes) * size, size_t, "%zu");
+  assert(stats->used_arenas > 1);
+
+  /* Objects are copied breadth-first, so tree is laid out level by level. */
+  node_t* tree = slots[0];
+  assert(slots[1] == tree->right->left);
+  assert(tree != nodes[0] && owned(&gc, tree));
+  fal_asserteq(tree->id, 0u, size_t, "%zu");
+  fal_asserteq(tree->left->id, 1u, size_t, "%zu");
+  fal_asserteq((char*)tree->right - (char*)tree->left, (ptrdiff_t)size,
+    ptrdiff_t, "%td");
+
+  {
+    /* Walk tree in heap order and check links. */
+    static node_t* queue[NODES];
+    size_t head = 0, tail = 0;
+    queue[tail++] = tree;
+    while (head < tail) {
+      node_t* node = queue[head++];
+      assert(owned(&gc, node));
+      size_t id = node->id;
+      if (2*id + 1 < FAL_ARRLEN(nodes)) {
+        fal_asserteq(node->left->id, 2*id + 1, size_t, "%zu");
+        queue[tail++] = node->left;
+      }
+      if (2*id + 2 < FAL_ARRLEN(nodes)) {
+        fal_asserteq(node->right->id, 2*id + 2, size_t, "%zu");
+        queue[tail++] = node->right;
+      }
+    }
+    fal_asserteq(tail, FAL_ARRLEN(nodes), size_t, "%zu");
+    assert(queue[cycle]->left == slots[1]);
+    assert(queue[shared]->left == slots[1]);
+  }
+
+  /* Second collection copies everything again and keeps heap as is. */
+  size_t used = stats->used_arenas;
+  cgc_collect(&gc);
+  fal_asserteq(stats->copied_objects, FAL_ARRLEN(nodes), size_t, "%zu");
+  fal_asserteq(stats->used_arenas, used, size_t, "%zu");
+  tree = slots[0];
+  fal_asserteq(tree->right->left->id, 5u, size_t, "%zu");
+  assert(tree->right->left == slots[1]);
+
+  /* Dropping root leaves only subtree of node 5. */
+  cgc_remove_root(&gc, &root);
+  slots[0] = 0;
+  cgc_add_root(&gc, &root, slots, 2);
+  cgc_collect(&gc);
+  size_t subtree = 0;
+  for (size_t id = 0; id < NODES; id++) {
+    subtree += in_subtree(id, 5);
+  }
+  fal_asserteq(stats->copied_objects, subtree, size_t, "%zu");
+  fal_asserteq(((node_t*)slots[1])->id, 5u, size_t, "%zu");
+  fal_asserteq(((node_t*)slots[1])->left->id, 11u, size_t, "%zu");
+}
@@ -0,0 +1,117 @@
+#include "testlib.h"
+
+#define FAL_COPYGC_DEF_POW       14u /* 16 KiB */
+#define FAL_COPYGC_DEF_BLOCK_POW 4u  /* 16 bytes */
+#define FAL_COPYGC_DEF_NAME      cgc
+#include <fal/copygc.h>
+
+/* Node followed by payload of its size - sizeof(node_t) bytes. */
+static void trace(cgc_t* gc, void* obj) {
+  node_t* node = obj;
+  cgc_visit(gc, (void**)&node->left);
+  cgc_visit(gc, (void**)&node->right);
+}
+
+static uint64_t next_rand(uint64_t* seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 7;
+  *seed ^= *seed << 17;
+  return *seed;
+}
+
+enum { ARENAS = 16, SLOTS = 64, MAX_SIZE = 6 * 1024 };
+
+int main() {
+  static cgc_t gc;
+  cgc_init(&gc, trace);
+  for (size_t i = 0; i < ARENAS; i++) {
+    cgc_add_arena(&gc, testlib_alloc_arena(cgc_arena_SIZE));
+  }
+
+  static node_t* slots[SLOTS];
+  static size_t sizes[SLOTS];
+  cgc_root_t root;
+  cgc_add_root(&gc, &root, (void**)slots, SLOTS);
+
+  /* Mixed sizes up to third of arena pack differently in to-space, which
+     must still have room for every live object. */
+  for (uint64_t seed = 1; seed <= 8; seed++) {
+    uint64_t rnd = seed * 0x9e3779b97f4a7c15ull;
+    for (size_t step = 0; step < 1000; step++) {
+      size_t slot = next_rand(&rnd) % SLOTS;
+      size_t size = sizeof(node_t) + next_rand(&rnd) % MAX_SIZE;
+
+      node_t* node = cgc_alloc(&gc, size);
+      if (!node) {
+        cgc_collect(&gc);
+        node = cgc_alloc(&gc, size);
+        if (!node) {
+          /* Live set doesn't leave enough reserve, drop some of it. */
+          slots[slot] = 0;
+          continue;
+        }
+      }
+
+      node->id = slot;
+      node->left = slots[next_rand(&rnd) % SLOTS];
+      slots[slot] = node;
+      sizes[slot] = size;
+    }
+
+    cgc_collect(&gc);
+    for (size_t slot = 0; slot < SLOTS; slot++) {
+      if (slots[slot]) {
+        fal_asserteq(slots[slot]->id, slot, size_t, "%zu");
+        assert(cgc_arena_size(slots[slot]) >= sizes[slot]);
+      }
+    }
+  }
+
+  for (size_t slot = 0; slot < SLOTS; slot++) {
+    slots[slot] = 0;
+  }
+  cgc_collect(&gc);
+
+  /* Small objects alternating with ones close to arena size leave only
+     small object in every other to-space arena, reservation holds on
+     average over pairs. Live set is a list, so it is copied in order. */
+  {
+    enum { SMALL = 2 * cgc_arena_BLOCK_SIZE };
+    size_t sizes_near[] = {
+      cgc_arena_EFFECTIVE_SIZE,
+      cgc_arena_EFFECTIVE_SIZE - SMALL + cgc_arena_BLOCK_SIZE,
+      cgc_arena_EFFECTIVE_SIZE - cgc_arena_BLOCK_SIZE
+    };
+    for (size_t round = 0; round < FAL_ARRLEN(sizes_near); round++) {
+      size_t count = 0;
+      slots[0] = 0;
+      for (;;) {
+        size_t size = count % 2 ? sizes_near[round] : SMALL;
+        node_t* node = cgc_alloc(&gc, size);
+        if (!node) {
+          cgc_collect(&gc);
+          node = cgc_alloc(&gc, size);
+          if (!node) {
+            break;
+          }
+        }
+        node->id = count++;
+        node->left = slots[0];
+        slots[0] = node;
+      }
+
+      /* Half of heap is spare, every second arena holds one large object
+         in both spaces. */
+      assert(count >= ARENAS / 2 - 1);
+      for (size_t i = 0; i < 3; i++) {
+        cgc_collect(&gc);
+        size_t id = count;
+        for (node_t* node = slots[0]; node; node = node->left) {
+          fal_asserteq(node->id, --id, size_t, "%zu");
+          assert(cgc_arena_size(node) >= (id % 2 ? sizes_near[round] : SMALL));
+        }
+        fal_asserteq(id, 0u, size_t, "%zu");
+      }
+    }
+  }
+}
@@ -0,0 +1,136 @@
+#include "testlib.h"
+
+#define FAL_GC_DEF_POW        14u /* 16 KiB */
+#define FAL_GC_DEF_BLOCK_POW  4u  /* 16 bytes */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+static void trace(gc_t* gc, void* obj) {
+  node_t* node = obj;
+  gc_visit(gc, (void**)&node->left);
+  gc_visit(gc, (void**)&node->right);
+}
+
+static node_t* mknode(gc_t* gc, size_t id) {
+  node_t* node = gc_alloc(gc, sizeof(node_t));
+  if (node) {
+    node->id = id;
+  }
+  return node;
+}
+
+int main() {
+  static gc_t gc;
+  gc_init(&gc, trace);
+
+  assert("no arenas, no memory" && !gc_alloc(&gc, sizeof(node_t)));
+
+  gc_add_arena(&gc, testlib_alloc_arena(gc_arena_SIZE));
+  fal_asserteq(gc_stats(&gc)->arenas, 1u, size_t, "%zu");
+
+  /* Fill the arena with garbage and one live list. */
+  node_t* list = 0;
+  size_t allocated = 0;
+  for (;;) {
+    node_t* node = mknode(&gc, allocated);
+    if (!node) {
+      break;
+    }
+
+    allocated++;
+    if (allocated % 4 == 0) {
+      node->left = list;
+      list = node;
+    }
+  }
+
+  assert(allocated > 100);
+
+  gc_root_t root;
+  gc_add_root(&gc, &root, (void**)&list, 1);
+
+  gc_collect(&gc);
+
+  const gc_stats_t* stats = gc_stats(&gc);
+  const size_t node_size = gc_arena_size(list);
+  fal_asserteq(stats->collections, 1u, size_t, "%zu");
+  fal_asserteq(stats->live_bytes, (allocated / 4) * gc_arena_size(list),
+    size_t, "%zu");
+  fal_asserteq(stats->freed_bytes,
+    (allocated - allocated / 4) * gc_arena_size(list), size_t, "%zu");
+
+  /* List survived and is unmarked. */
+  {
+    size_t id = (allocated / 4) * 4;
+    for (node_t* node = list; node; node = node->left) {
+      fal_asserteq(node->id, id - 1, size_t, "%zu");
+      assert(!gc_arena_marked(node));
+      id -= 4;
+    }
+    fal_asserteq(id, 0u, size_t, "%zu");
+  }
+
+  /* Cycles and shared nodes. */
+  {
+    node_t* a = mknode(&gc, 1000);
+    node_t* b = mknode(&gc, 1001);
+    node_t* c = mknode(&gc, 1002);
+    assert(a && b && c);
+    a->left = b;
+    a->right = c;
+    b->left = a;
+    c->left = c;
+    c->right = b;
+    list->right = a;
+  }
+
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->live_bytes, (allocated / 4 + 3) * gc_arena_size(list),
+    size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->freed_bytes, 0u, size_t, "%zu");
+  fal_asserteq(list->right->right->right->id, 1001u, size_t, "%zu");
+
+  /* Dropping roots frees everything. */
+  gc_remove_root(&gc, &root);
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->live_bytes, 0u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->freed_bytes,
+    (allocated / 4 + 3) * node_size, size_t, "%zu");
+  assert(gc_arena_empty(gc_first_arena(&gc)));
+
+  /* Arena full of garbage allocated since last sweep is all freed. */
+  for (size_t i = 0; i < allocated; i++) {
+    assert(mknode(&gc, i));
+  }
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->live_bytes, 0u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->freed_bytes, allocated * node_size,
+    size_t, "%zu");
+
+  /* Second arena is used when first one is full. */
+  gc_add_root(&gc, &root, (void**)&list, 1);
+  list = 0;
+  for (size_t i = 0; i < allocated + 10; i++) {
+    node_t* node = mknode(&gc, i);
+    if (!node) {
+      gc_add_arena(&gc, testlib_alloc_arena(gc_arena_SIZE));
+      node = mknode(&gc, i);
+    }
+
+    assert(node);
+    node->left = list;
+    list = node;
+  }
+
+  fal_asserteq(gc_stats(&gc)->arenas, 2u, size_t, "%zu");
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->live_bytes, (allocated + 10) * gc_arena_size(list),
+    size_t, "%zu");
+
+  size_t arenas = 0;
+  for (gc_arena_t* arena = gc_first_arena(&gc); arena; arena = gc_next_arena(arena)) {
+    assert(!gc_arena_empty(arena));
+    arenas++;
+  }
+  fal_asserteq(arenas, 2u, size_t, "%zu");
+}
@@ -0,0 +1,111 @@
+#include "testlib.h"
+
+#define FAL_GC_DEF_POW        14u /* 16 KiB */
+#define FAL_GC_DEF_BLOCK_POW  4u  /* 16 bytes */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+enum { ARENAS = 4 };
+
+static gc_arena_t* arenas[ARENAS];
+
+static void trace(gc_t* gc, void* obj) {
+  node_t* node = obj;
+  gc_visit(gc, (void**)&node->left);
+  gc_visit(gc, (void**)&node->right);
+}
+
+static size_t count_used(gc_arena_t* arena) {
+  size_t used = 0;
+  for (void* obj = gc_arena_first(arena); obj; obj = gc_arena_next(obj)) {
+    used++;
+  }
+  return used;
+}
+
+static size_t count_list(node_t* list) {
+  size_t count = 0;
+  for (node_t* node = list; node; node = node->left) {
+    assert(gc_arena_used(node));
+    count++;
+  }
+  return count;
+}
+
+int main() {
+  static gc_t gc;
+  gc_init(&gc, trace);
+  for (size_t a = 0; a < ARENAS; a++) {
+    arenas[a] = testlib_alloc_arena(gc_arena_SIZE);
+    gc_add_arena(&gc, arenas[a]);
+  }
+
+  node_t* list = 0;
+  gc_root_t root;
+  gc_add_root(&gc, &root, (void**)&list, 1);
+
+  /* Live list only in the first filled arena, everything else is garbage. */
+  gc_arena_t* hot = arenas[ARENAS - 1];
+  size_t live = 0;
+  size_t used[ARENAS];
+  node_t* node;
+  while ((node = gc_alloc(&gc, sizeof(node_t)))) {
+    if (gc_arena_for(node) == hot && live < 100) {
+      node->id = live++;
+      node->left = list;
+      list = node;
+    }
+  }
+  for (size_t a = 0; a < ARENAS; a++) {
+    used[a] = count_used(arenas[a]);
+  }
+
+  /* Marking doesn't clear anything, cold arenas aren't touched. */
+  gc_collect_lazy(&gc);
+  for (size_t a = 0; a < ARENAS; a++) {
+    fal_asserteq(count_used(arenas[a]), used[a], size_t, "%zu");
+  }
+
+  /* Next marking sweeps hot arena by marks of previous cycle first. Half
+     of the list is dropped. */
+  for (node = list; node->id != 50; node = node->left) {
+  }
+  node->left = 0;
+  gc_collect_lazy(&gc);
+  fal_asserteq(count_used(hot), live, size_t, "%zu");
+  fal_asserteq(count_list(list), live - 50, size_t, "%zu");
+  for (size_t a = 0; a < ARENAS - 1; a++) {
+    fal_asserteq(count_used(arenas[a]), used[a], size_t, "%zu");
+  }
+
+  gc_collect_lazy(&gc);
+  fal_asserteq(count_used(hot), live - 50, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->collections, 2u, size_t, "%zu");
+
+  /* Allocation reuses hot arena first and resets cold ones without
+     sweeping, nothing was marked there for many cycles. */
+  size_t allocated = 0;
+  while (gc_alloc(&gc, sizeof(node_t))) {
+    allocated++;
+  }
+  size_t total = 0;
+  for (size_t a = 0; a < ARENAS; a++) {
+    total += count_used(arenas[a]);
+  }
+  fal_asserteq(total, allocated + live - 50, size_t, "%zu");
+  fal_asserteq(count_list(list), live - 50, size_t, "%zu");
+  for (node = list; node; node = node->left) {
+    assert(!gc_arena_marked(node));
+  }
+
+  /* Full collection frees everything allocated above. */
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->collections, 4u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->live_bytes,
+    (live - 50) * gc_arena_size(list), size_t, "%zu");
+  total = 0;
+  for (size_t a = 0; a < ARENAS; a++) {
+    total += count_used(arenas[a]);
+  }
+  fal_asserteq(total, live - 50, size_t, "%zu");
+}
@@ -0,0 +1,148 @@
+#include "testlib.h"
+
+#define FAL_GC_DEF_POW        14u /* 16 KiB */
+#define FAL_GC_DEF_BLOCK_POW  4u  /* 16 bytes */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+/* Same collector with fake clock ticking 1us per reading. */
+static uint64_t fake_now = 0;
+#define FAL_GC_DEF_POW        14u /* 16 KiB */
+#define FAL_GC_DEF_BLOCK_POW  4u  /* 16 bytes */
+#define FAL_GC_DEF_CLOCK()    (fake_now += 1000)
+#define FAL_GC_DEF_STEP_SLICE 1
+#define FAL_GC_DEF_NAME       tgc
+#include <fal/gc.h>
+
+static void trace(gc_t* gc, void* obj) {
+  node_t* node = obj;
+  gc_visit(gc, (void**)&node->left);
+  gc_visit(gc, (void**)&node->right);
+}
+
+static void ttrace(tgc_t* gc, void* obj) {
+  node_t* node = obj;
+  tgc_visit(gc, (void**)&node->left);
+  tgc_visit(gc, (void**)&node->right);
+}
+
+static node_t* mknode(gc_t* gc, size_t id) {
+  node_t* node = gc_alloc(gc, sizeof(node_t));
+  assert(node);
+  node->id = id;
+  return node;
+}
+
+int main() {
+  static gc_t gc;
+  gc_init(&gc, trace);
+  gc_add_arena(&gc, testlib_alloc_arena(gc_arena_SIZE));
+  gc_add_arena(&gc, testlib_alloc_arena(gc_arena_SIZE));
+
+  node_t* roots[2] = { 0, 0 };
+  gc_root_t root;
+  gc_add_root(&gc, &root, (void**)roots, FAL_ARRLEN(roots));
+
+  /* List of 100 nodes and the same amount of garbage. */
+  for (size_t i = 0; i < 100; i++) {
+    node_t* node = mknode(&gc, i);
+    node->left = roots[0];
+    roots[0] = node;
+    mknode(&gc, 1000 + i);
+  }
+
+  size_t node_size = gc_arena_size(roots[0]);
+
+  assert(!gc_collecting(&gc));
+  assert(gc_step(&gc, 1));
+  assert(gc_collecting(&gc));
+
+  /* Move tail of the list to another root while list is being traced,
+     write barrier must keep it alive. */
+  node_t* middle = roots[0];
+  for (int i = 0; i < 50; i++) {
+    middle = middle->left;
+  }
+  roots[1] = middle->left;
+  gc_write(&gc, (void**)&middle->left, 0);
+
+  /* Objects allocated during marking survive current cycle. */
+  node_t* fresh = mknode(&gc, 2000);
+  assert(gc_arena_marked(fresh));
+  gc_write(&gc, (void**)&fresh->left, roots[1]);
+  roots[1] = fresh;
+
+  size_t steps = 1;
+  while (gc_step(&gc, 1)) {
+    steps++;
+  }
+  assert(steps > 100);
+  assert(!gc_collecting(&gc));
+
+  fal_asserteq(gc_stats(&gc)->collections, 1u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->live_bytes, 101 * node_size, size_t, "%zu");
+
+  size_t count = 0;
+  for (node_t* node = roots[0]; node; node = node->left) {
+    assert(!gc_arena_marked(node));
+    count++;
+  }
+  for (node_t* node = roots[1]; node; node = node->left) {
+    assert(!gc_arena_marked(node));
+    count++;
+  }
+  fal_asserteq(count, 101u, size_t, "%zu");
+
+  /* Now unreachable fresh node is collected by next cycle. */
+  roots[1] = roots[1]->left;
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->live_bytes, 100 * node_size, size_t, "%zu");
+
+  /* Arena added during marking is swept after it, so marks of objects
+     allocated there don't hide their children from next cycle. */
+  {
+    assert(gc_step(&gc, 1));
+    gc_arena_t* arena = testlib_alloc_arena(gc_arena_SIZE);
+    gc_add_arena(&gc, arena);
+    node_t* added = mknode(&gc, 3000);
+    assert(gc_arena_for(added) == arena && gc_arena_marked(added));
+    added->left = roots[1];
+    gc_write(&gc, (void**)&roots[1], added);
+    gc_finish(&gc);
+    fal_asserteq(gc_stats(&gc)->live_bytes, 101 * node_size, size_t, "%zu");
+
+    node_t* child = mknode(&gc, 3001);
+    added->right = child;
+    gc_collect(&gc);
+    assert(gc_arena_used(child) && !gc_arena_marked(child));
+    fal_asserteq(gc_stats(&gc)->live_bytes, 102 * node_size, size_t, "%zu");
+    assert(mknode(&gc, 3002) != child);
+    fal_asserteq(roots[1]->right->id, 3001u, size_t, "%zu");
+  }
+
+  /* Time-budgeted steps. */
+  {
+    static tgc_t tgc;
+    tgc_init(&tgc, ttrace);
+    tgc_add_arena(&tgc, testlib_alloc_arena(tgc_arena_SIZE));
+
+    node_t* list = 0;
+    tgc_root_t troot;
+    tgc_add_root(&tgc, &troot, (void**)&list, 1);
+    for (size_t i = 0; i < 10; i++) {
+      node_t* node = tgc_alloc(&tgc, sizeof(node_t));
+      node->left = list;
+      list = node;
+    }
+
+    /* Clock ticks on each reading, so every call does only a few units. */
+    size_t calls = 0;
+    while (tgc_step_ns(&tgc, 3000)) {
+      calls++;
+    }
+
+    fal_asserteq(tgc_stats(&tgc)->live_bytes, 10 * tgc_arena_size(list),
+      size_t, "%zu");
+    assert(calls >= 3);
+  }
+}
@@ -0,0 +1,159 @@
+#include "../parmark/testlib.h"
+
+#define FAL_GC_DEF_POW        14u /* 16 KiB */
+#define FAL_GC_DEF_BLOCK_POW  4u  /* 16 bytes */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+enum { ARENAS = 4, PARTS = 3 };
+
+static gc_t gc;
+static gc_arena_t* arenas[ARENAS];
+
+static void trace(gc_t* gc, void* obj) {
+  node_t* node = obj;
+  gc_visit(gc, (void**)&node->left);
+  gc_visit(gc, (void**)&node->right);
+}
+
+/* Fill all arenas, every 4th node goes to the list, returns their number. */
+static size_t fill(node_t** list) {
+  size_t allocated = 0;
+  node_t* node;
+  while ((node = gc_alloc(&gc, sizeof(node_t)))) {
+    node->id = allocated++;
+    if (node->id % 4 == 0) {
+      node->left = *list;
+      *list = node;
+    }
+  }
+
+  assert(allocated > 100);
+  return (allocated + 3) / 4;
+}
+
+static size_t count_used(gc_arena_t* arena) {
+  size_t used = 0;
+  for (void* obj = gc_arena_first(arena); obj; obj = gc_arena_next(obj)) {
+    used++;
+  }
+  return used;
+}
+
+static void check(node_t* list, size_t live) {
+  size_t count = 0;
+  for (node_t* node = list; node; node = node->left) {
+    assert(!gc_arena_marked(node) && node->id % 4 == 0);
+    count++;
+  }
+  fal_asserteq(count, live, size_t, "%zu");
+
+  size_t used = 0;
+  for (size_t a = 0; a < ARENAS; a++) {
+    used += count_used(arenas[a]);
+  }
+  fal_asserteq(used, live, size_t, "%zu");
+}
+
+typedef struct part_t {
+  size_t part;
+  size_t swept;
+} part_t;
+
+static void sweep(void* arg) {
+  part_t* part = arg;
+  part->swept = gc_sweep_part(&gc, part->part, PARTS);
+}
+
+int main() {
+  gc_init(&gc, trace);
+  for (size_t a = 0; a < ARENAS; a++) {
+    arenas[a] = testlib_alloc_arena(gc_arena_SIZE);
+    gc_add_arena(&gc, arenas[a]);
+  }
+
+  node_t* list = 0;
+  gc_root_t root;
+  gc_add_root(&gc, &root, (void**)&list, 1);
+
+  size_t live = fill(&list);
+  size_t node_size = gc_arena_size(list);
+  size_t used = 0;
+  for (size_t a = 0; a < ARENAS; a++) {
+    used += count_used(arenas[a]);
+  }
+
+  /* Lazy collection only marks, nothing is freed yet. */
+  gc_collect_lazy(&gc);
+  assert(gc_collecting(&gc));
+  fal_asserteq(gc_stats(&gc)->collections, 0u, size_t, "%zu");
+  assert(gc_arena_marked(list));
+  {
+    size_t still_used = 0;
+    for (size_t a = 0; a < ARENAS; a++) {
+      still_used += count_used(arenas[a]);
+    }
+    fal_asserteq(still_used, used, size_t, "%zu");
+  }
+
+  /* Allocation sweeps only the arena it allocates from. First arena of
+     the list is the last one added. */
+  node_t* fresh = gc_alloc(&gc, sizeof(node_t));
+  assert(fresh && gc_arena_for(fresh) == arenas[ARENAS - 1]);
+  assert(!gc_arena_marked(fresh));
+  assert(gc_arena_marked(list)); /* filled last, in the first added arena */
+  {
+    size_t in_arena = 0;
+    for (node_t* node = list; node; node = node->left) {
+      in_arena += gc_arena_for(node) == arenas[ARENAS - 1];
+    }
+    fal_asserteq(count_used(arenas[ARENAS - 1]), in_arena + 1, size_t, "%zu");
+  }
+
+  /* Finishing sweeps the rest, fresh node isn't counted as live since it
+     was allocated after its arena was swept. */
+  gc_finish(&gc);
+  assert(!gc_collecting(&gc));
+  fal_asserteq(gc_stats(&gc)->collections, 1u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->live_bytes, live * node_size, size_t, "%zu");
+  gc_arena_free(fresh);
+  check(list, live);
+
+  /* Refill and sweep in parts on threads. */
+  live += fill(&list);
+  gc_collect_lazy(&gc);
+
+  part_t parts[PARTS];
+  void* args[PARTS];
+  for (size_t i = 0; i < PARTS; i++) {
+    parts[i].part = i;
+    args[i] = &parts[i];
+  }
+  testlib_run_threads(PARTS, sweep, args);
+
+  size_t swept = 0;
+  for (size_t i = 0; i < PARTS; i++) {
+    swept += parts[i].swept;
+  }
+  fal_asserteq(swept, (size_t)ARENAS, size_t, "%zu");
+  fal_asserteq(gc_sweep_part(&gc, 0, 1), 0u, size_t, "%zu");
+
+  gc_finish(&gc);
+  fal_asserteq(gc_stats(&gc)->collections, 2u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->live_bytes, live * node_size, size_t, "%zu");
+  check(list, live);
+
+  /* Lazy collection closing previous one counts its unswept arenas. */
+  gc_collect_lazy(&gc);
+  gc_collect_lazy(&gc);
+  fal_asserteq(gc_stats(&gc)->collections, 3u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->live_bytes, live * node_size, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->freed_bytes, 0u, size_t, "%zu");
+
+  /* Full collection sweeps what lazy one left first. */
+  list = 0;
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->collections, 5u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->live_bytes, 0u, size_t, "%zu");
+  check(list, 0);
+}
@@ -0,0 +1,67 @@
+#include "testlib.h"
+
+#define FAL_GC_DEF_POW        16u /* 64 KiB */
+#define FAL_GC_DEF_BLOCK_POW  4u  /* 16 bytes */
+#define FAL_GC_DEF_MARK_STACK 4   /* tiny stack to overflow it */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+static void trace(gc_t* gc, void* obj) {
+  node_t* node = obj;
+  gc_visit(gc, (void**)&node->left);
+  gc_visit(gc, (void**)&node->right);
+}
+
+int main() {
+  static gc_t gc;
+  gc_init(&gc, trace);
+  gc_add_arena(&gc, testlib_alloc_arena(gc_arena_SIZE));
+  gc_add_arena(&gc, testlib_alloc_arena(gc_arena_SIZE));
+
+  /* Complete binary tree interleaved with garbage. */
+  enum { NODES = 1023 };
+  node_t* nodes[NODES];
+  for (size_t i = 0; i < NODES; i++) {
+    nodes[i] = gc_alloc(&gc, sizeof(node_t));
+    assert(nodes[i] && gc_alloc(&gc, sizeof(node_t)));
+    nodes[i]->id = i;
+  }
+
+  for (size_t i = 0; 2 * i + 2 < NODES; i++) {
+    nodes[i]->left = nodes[2 * i + 1];
+    nodes[i]->right = nodes[2 * i + 2];
+  }
+
+  gc_root_t root;
+  gc_add_root(&gc, &root, (void**)&nodes[0], 1);
+  gc_collect(&gc);
+
+  assert(gc_stats(&gc)->mark_overflows > 0);
+  fal_asserteq(gc_stats(&gc)->live_bytes, NODES * gc_arena_size(nodes[0]),
+    size_t, "%zu");
+
+  for (size_t i = 0; i < NODES; i++) {
+    assert(gc_arena_used(nodes[i]) && !gc_arena_marked(nodes[i]));
+    fal_asserteq(nodes[i]->id, i, size_t, "%zu");
+  }
+
+  /* Retracing is budgeted too, small steps do bounded work each. */
+  enum { BUDGET = 8 };
+  size_t overflows = gc_stats(&gc)->mark_overflows;
+  size_t steps = gc_stats(&gc)->steps;
+  assert(gc_step(&gc, BUDGET));
+  while (gc.marked != gc.cycle) {
+    assert(gc_step(&gc, BUDGET));
+  }
+  assert(gc_stats(&gc)->mark_overflows > overflows);
+  assert(gc_stats(&gc)->steps - steps >= NODES / BUDGET);
+  while (gc_step(&gc, BUDGET)) {
+  }
+
+  fal_asserteq(gc_stats(&gc)->live_bytes, NODES * gc_arena_size(nodes[0]),
+    size_t, "%zu");
+  for (size_t i = 0; i < NODES; i++) {
+    assert(gc_arena_used(nodes[i]) && !gc_arena_marked(nodes[i]));
+    fal_asserteq(nodes[i]->id, i, size_t, "%zu");
+  }
+}
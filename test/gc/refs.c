@@ -0,0 +1,100 @@
+#include "testlib.h"
+
+#define FAL_GC_DEF_POW        14u /* 16 KiB */
+#define FAL_GC_DEF_BLOCK_POW  4u  /* 16 bytes */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+enum { ARENAS = 4 };
+
+/* Node with compressed references, 16 bytes instead of 24 (32 allocated). */
+typedef struct cnode_t {
+  gc_ref_t left;
+  gc_ref_t right;
+  size_t id;
+} cnode_t;
+
+static gc_t gc;
+static gc_ref_heap_t heap;
+
+static void trace(gc_t* gc, void* obj) {
+  cnode_t* node = obj;
+  gc_visit_ref(gc, &heap, &node->left);
+  gc_visit_ref(gc, &heap, &node->right);
+}
+
+static cnode_t* deref(gc_ref_t ref) {
+  return gc_ref_decompress(&heap, ref);
+}
+
+static size_t count_list(cnode_t* list) {
+  size_t count = 0;
+  for (cnode_t* node = list; node; node = deref(node->left)) {
+    assert(gc_ref_contains(&heap, node));
+    count++;
+  }
+  return count;
+}
+
+int main() {
+  /* Arenas are carved from one reserved range. */
+  char* base = testlib_alloc_arena(ARENAS * gc_arena_SIZE);
+  gc_ref_init(&heap, base, ARENAS * gc_arena_SIZE);
+
+  gc_init(&gc, trace);
+  for (size_t a = 0; a < ARENAS; a++) {
+    gc_add_arena(&gc, base + a * gc_arena_SIZE);
+  }
+
+  /* Roots stay full pointers. */
+  cnode_t* list = 0;
+  gc_root_t root;
+  gc_add_root(&gc, &root, (void**)&list, 1);
+
+  size_t live = 0;
+  size_t allocated = 0;
+  cnode_t* node;
+  while ((node = gc_alloc(&gc, sizeof(cnode_t)))) {
+    fal_asserteq(gc_arena_size(node), sizeof(cnode_t), size_t, "%zu");
+    node->id = allocated++;
+    if (node->id % 3 == 0) {
+      node->left = gc_ref_compress(&heap, list);
+      list = node;
+      live++;
+    } else if (list) {
+      list->right = gc_ref_compress(&heap, node); /* every 3rd survives too */
+    }
+  }
+  assert(allocated > 1000);
+
+  /* Each list node also holds one node via right. */
+  gc_collect(&gc);
+  fal_asserteq(count_list(list), live, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->live_bytes, 2 * live * sizeof(cnode_t) -
+    (deref(list->right) ? 0 : sizeof(cnode_t)), size_t, "%zu");
+  for (cnode_t* it = list; it; it = deref(it->left)) {
+    assert(it->id % 3 == 0);
+    assert(!it->right || deref(it->right)->id % 3 == 2);
+  }
+
+  /* Write barrier keeps overwritten reference alive during marking. */
+  for (cnode_t* it = list; it; it = deref(it->left)) {
+    it->right = 0;
+  }
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->live_bytes, live * sizeof(cnode_t),
+    size_t, "%zu");
+
+  cnode_t* second = deref(list->left);
+  assert(gc_step(&gc, 1));
+  gc_write_ref(&gc, &heap, &list->left, 0);
+  while (gc_step(&gc, 1)) {
+  }
+  assert(gc_ref_contains(&heap, second));
+  fal_asserteq(gc_stats(&gc)->live_bytes, live * sizeof(cnode_t),
+    size_t, "%zu");
+
+  /* Unreachable without barrier in the next cycle. */
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->live_bytes, sizeof(cnode_t), size_t, "%zu");
+}
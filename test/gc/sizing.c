@@ -0,0 +1,214 @@
+#include "testlib.h"
+
+/* Arenas come from fixed pool, so test controls how many are available. */
+enum { POOL = 64 };
+static char* pool;
+static void* free_arenas[POOL];
+static size_t free_len;
+static size_t pool_limit = POOL;
+static size_t in_use;
+
+static void* pool_alloc(void) {
+  if (!free_len || in_use == pool_limit) {
+    return 0;
+  }
+  in_use++;
+  return free_arenas[--free_len];
+}
+
+static void pool_free(void* mem) {
+  in_use--;
+  free_arenas[free_len++] = mem;
+}
+
+/* Same collector with fake clock which ticks once per reading, collections
+   take long compared to time between them unless ticks are added. */
+static uint64_t fake_now = 0;
+
+#define FAL_GC_DEF_POW          14u /* 16 KiB */
+#define FAL_GC_DEF_BLOCK_POW    4u  /* 16 bytes */
+#define FAL_GC_DEF_ARENA_ALLOC()  pool_alloc()
+#define FAL_GC_DEF_ARENA_FREE(Mem) pool_free(Mem)
+#define FAL_GC_DEF_NAME         gc
+#include <fal/gc.h>
+
+#define FAL_GC_DEF_POW          14u /* 16 KiB */
+#define FAL_GC_DEF_BLOCK_POW    4u  /* 16 bytes */
+#define FAL_GC_DEF_ARENA_ALLOC()  pool_alloc()
+#define FAL_GC_DEF_ARENA_FREE(Mem) pool_free(Mem)
+#define FAL_GC_DEF_CLOCK()      (fake_now += 1000)
+#define FAL_GC_DEF_NAME         tgc
+#include <fal/gc.h>
+
+static void trace(gc_t* gc, void* obj) {
+  node_t* node = obj;
+  gc_visit(gc, (void**)&node->left);
+  gc_visit(gc, (void**)&node->right);
+}
+
+static void ttrace(tgc_t* gc, void* obj) {
+  node_t* node = obj;
+  tgc_visit(gc, (void**)&node->left);
+  tgc_visit(gc, (void**)&node->right);
+}
+
+/* Keep list of live nodes and allocate garbage between them. */
+static void churn(gc_t* gc, node_t** list, size_t live, size_t garbage) {
+  for (size_t i = 0; i < live; i++) {
+    node_t* node = gc_alloc(gc, sizeof(node_t));
+    assert(node);
+    node->id = i;
+    node->left = *list;
+    *list = node;
+    for (size_t g = 0; g < garbage; g++) {
+      assert(gc_alloc(gc, sizeof(node_t)));
+    }
+  }
+}
+
+int main() {
+  pool = testlib_alloc_arena(POOL * gc_arena_SIZE);
+  for (size_t i = 0; i < POOL; i++) {
+    free_arenas[free_len++] = pool + (POOL - 1 - i) * gc_arena_SIZE;
+  }
+
+  size_t per_arena = gc_arena_EFFECTIVE_SIZE / 32; /* node_t takes 2 blocks */
+  static gc_t gc;
+  gc_init(&gc, trace);
+  fal_asserteq(gc_tuning(&gc)->heap_ratio, 200u, size_t, "%zu");
+
+  /* Heap grows from nothing on demand. */
+  node_t* list = 0;
+  gc_root_t root;
+  gc_add_root(&gc, &root, (void**)&list, 1);
+  assert(gc_alloc(&gc, sizeof(node_t)));
+  fal_asserteq(gc_stats(&gc)->arenas, 1u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->arenas_grown, 1u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->allocated_bytes, 32u, size_t, "%zu");
+
+  /* With 4 arenas of live data and 3 garbage nodes per live one heap
+     settles at about twice the live size instead of growing to 16 arenas. */
+  churn(&gc, &list, 4 * per_arena, 3);
+  assert(gc_stats(&gc)->triggered > 2);
+  fal_asserteq(gc_stats(&gc)->collections, gc_stats(&gc)->triggered,
+    size_t, "%zu");
+  assert(gc_stats(&gc)->arenas >= 4 && gc_stats(&gc)->arenas <= 10);
+  fal_asserteq(in_use, gc_stats(&gc)->arenas, size_t, "%zu");
+
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->live_bytes, 4 * per_arena * 32, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->trigger_bytes, 4 * per_arena * 32,
+    size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->allocated_bytes, 0u, size_t, "%zu");
+
+  /* Higher ratio means fewer collections. */
+  size_t before = gc_stats(&gc)->triggered;
+  gc_tuning(&gc)->heap_ratio = 400;
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->trigger_bytes, 3 * 4 * per_arena * 32,
+    size_t, "%zu");
+  for (size_t i = 0; i < 4 * per_arena * 3; i++) {
+    assert(gc_alloc(&gc, sizeof(node_t)));
+  }
+  fal_asserteq(gc_stats(&gc)->triggered, before, size_t, "%zu");
+  assert(gc_alloc(&gc, sizeof(node_t)));
+  fal_asserteq(gc_stats(&gc)->triggered, before + 1, size_t, "%zu");
+
+  /* Heap shrinks when live set drops, but not below min_arenas. */
+  size_t grown = gc_stats(&gc)->arenas;
+  size_t released = gc_stats(&gc)->arenas_released;
+  gc_tuning(&gc)->heap_ratio = 200;
+  gc_tuning(&gc)->min_arenas = 2;
+  list = 0;
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->arenas, 2u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->arenas_released - released, grown - 2,
+    size_t, "%zu");
+  fal_asserteq(in_use, 2u, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->trigger_bytes, 2 * gc_arena_EFFECTIVE_SIZE,
+    size_t, "%zu");
+
+  /* Heap doesn't grow above max_arenas, allocation fails when live set
+     doesn't fit. */
+  gc_tuning(&gc)->max_arenas = 3;
+  size_t allocated = 0;
+  node_t* node;
+  while ((node = gc_alloc(&gc, sizeof(node_t)))) {
+    node->left = list;
+    list = node;
+    allocated++;
+  }
+  fal_asserteq(gc_stats(&gc)->arenas, 3u, size_t, "%zu");
+  fal_asserteq(allocated, 3 * per_arena, size_t, "%zu");
+
+  /* Allocator running out works like max_arenas. */
+  gc_tuning(&gc)->max_arenas = 0;
+  pool_limit = 4;
+  while ((node = gc_alloc(&gc, sizeof(node_t)))) {
+    node->left = list;
+    list = node;
+    allocated++;
+  }
+  fal_asserteq(gc_stats(&gc)->arenas, 4u, size_t, "%zu");
+  fal_asserteq(allocated, 4 * per_arena, size_t, "%zu");
+  assert(!gc_alloc(&gc, gc_arena_EFFECTIVE_SIZE + 1));
+
+  list = 0;
+  gc_collect(&gc);
+  pool_limit = POOL;
+
+  /* Heap grows in the middle of incremental cycle, objects allocated in new
+     arena keep their children alive in the next cycle. */
+  churn(&gc, &list, per_arena, 0);
+  gc_collect(&gc);
+  assert(gc_step(&gc, 1));
+  size_t arenas_grown = gc_stats(&gc)->arenas_grown;
+  size_t live = per_arena;
+  while (gc_stats(&gc)->arenas_grown == arenas_grown) {
+    node = gc_alloc(&gc, sizeof(node_t));
+    assert(node && gc_arena_marked(node));
+    node->left = list;
+    list = node;
+    live++;
+  }
+  assert(gc_collecting(&gc));
+  assert(gc_arena_for(list) == gc_first_arena(&gc));
+  gc_finish(&gc);
+
+  node_t* child = gc_alloc(&gc, sizeof(node_t));
+  assert(child);
+  child->id = 42;
+  list->right = child;
+  gc_collect(&gc);
+  assert(gc_arena_used(child) && list->right->id == 42);
+  fal_asserteq(gc_stats(&gc)->live_bytes, (live + 1) * 32, size_t, "%zu");
+
+  list = 0;
+  gc_collect(&gc);
+
+  /* With clock, collections over cpu budget raise the ratio. */
+  static tgc_t tgc;
+  tgc_init(&tgc, ttrace);
+  node_t* tlist = 0;
+  tgc_root_t troot;
+  tgc_add_root(&tgc, &troot, (void**)&tlist, 1);
+  for (size_t i = 0; i < 2 * per_arena; i++) {
+    node_t* tnode = tgc_alloc(&tgc, sizeof(node_t));
+    tnode->left = tlist;
+    tlist = tnode;
+  }
+  for (size_t i = 0; i < 20 * per_arena; i++) {
+    assert(tgc_alloc(&tgc, sizeof(node_t)));
+  }
+  assert(tgc_stats(&tgc)->heap_ratio > 200);
+  assert(tgc_stats(&tgc)->gc_ns > 0);
+  size_t boosted = tgc_stats(&tgc)->heap_ratio;
+
+  /* Cheap collections bring it back. */
+  for (size_t i = 0; i < 200 * per_arena; i++) {
+    fake_now += 1000000;
+    assert(tgc_alloc(&tgc, sizeof(node_t)));
+  }
+  assert(tgc_stats(&tgc)->heap_ratio < boosted);
+  fal_asserteq(tgc_stats(&tgc)->heap_ratio, 200u, size_t, "%zu");
+}
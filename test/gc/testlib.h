@@ -0,0 +1,14 @@
+#ifndef __FAL_TEST_GC_TESTLIB_H__
+#define __FAL_TEST_GC_TESTLIB_H__
+
+#include "../arena/testlib.h"
+
+/* Object used by gc tests: two references and an id. */
+typedef struct node_t node_t;
+struct node_t {
+  node_t* left;
+  node_t* right;
+  size_t id;
+};
+
+#endif /* __FAL_TEST_GC_TESTLIB_H__ */
@@ -0,0 +1,148 @@
+#include "testlib.h"
+
+#define FAL_GC_DEF_POW        14u /* 16 KiB */
+#define FAL_GC_DEF_BLOCK_POW  4u  /* 16 bytes */
+#define FAL_GC_DEF_NAME       gc
+#include <fal/gc.h>
+
+enum { ARENAS = 6 };
+
+/* Leaf without references, its type has no trace callback. */
+typedef struct leaf_t {
+  size_t id;
+  size_t pad[3];
+} leaf_t;
+
+static gc_t gc;
+static gc_arena_t* arenas[ARENAS];
+static gc_type_t node_type;
+static gc_type_t leaf_type;
+static size_t traced_nodes;
+static size_t traced_untyped;
+
+static void trace_node(gc_t* gc, void* obj) {
+  node_t* node = obj;
+  assert(gc_type_of(obj) == &node_type);
+  traced_nodes++;
+  gc_visit(gc, (void**)&node->left);
+  gc_visit(gc, (void**)&node->right);
+}
+
+static void trace_untyped(gc_t* gc, void* obj) {
+  node_t* node = obj;
+  assert(!gc_type_of(obj));
+  traced_untyped++;
+  gc_visit(gc, (void**)&node->left);
+  gc_visit(gc, (void**)&node->right);
+}
+
+static size_t arenas_of(gc_type_t* type) {
+  size_t count = 0;
+  for (size_t a = 0; a < ARENAS; a++) {
+    count += gc_arena_first(arenas[a])
+      && gc_type_of(gc_arena_first(arenas[a])) == type;
+  }
+  return count;
+}
+
+int main() {
+  gc_init(&gc, trace_untyped);
+  for (size_t a = 0; a < ARENAS; a++) {
+    arenas[a] = testlib_alloc_arena(gc_arena_SIZE);
+    gc_add_arena(&gc, arenas[a]);
+  }
+  gc_add_type(&gc, &node_type, sizeof(node_t), trace_node);
+  gc_add_type(&gc, &leaf_type, sizeof(leaf_t), 0);
+
+  /* Interleaved allocations of different types go to different arenas. */
+  node_t* list = 0;
+  gc_root_t root;
+  gc_add_root(&gc, &root, (void**)&list, 1);
+
+  size_t nodes = 0;
+  size_t leaves = 0;
+  for (size_t i = 0; i < 300; i++) {
+    node_t* node = gc_alloc_typed(&gc, &node_type);
+    leaf_t* leaf = gc_alloc_typed(&gc, &leaf_type);
+    node_t* untyped = gc_alloc(&gc, sizeof(node_t));
+    assert(node && leaf && untyped);
+    assert(gc_type_of(node) == &node_type);
+    assert(gc_type_of(leaf) == &leaf_type);
+    assert(!gc_type_of(untyped));
+    assert(gc_arena_for(node) != gc_arena_for(leaf));
+    assert(gc_arena_for(node) != gc_arena_for(untyped));
+    assert(gc_arena_for(leaf) != gc_arena_for(untyped));
+    fal_asserteq(gc_arena_size(leaf), sizeof(leaf_t), size_t, "%zu");
+
+    /* Every 2nd triple lives: node -> untyped -> leaf. */
+    if (i % 2 == 0) {
+      node->id = i;
+      node->left = list;
+      node->right = untyped;
+      untyped->right = (node_t*)leaf;
+      leaf->id = i;
+      list = node;
+      nodes++;
+      leaves++;
+    }
+  }
+
+  fal_asserteq(arenas_of(&node_type), 1u, size_t, "%zu");
+  fal_asserteq(arenas_of(&leaf_type), 1u, size_t, "%zu");
+
+  /* Each object is traced by callback of its arena's type, leaves are
+     only marked. */
+  gc_collect(&gc);
+  fal_asserteq(traced_nodes, nodes, size_t, "%zu");
+  fal_asserteq(traced_untyped, nodes, size_t, "%zu");
+  fal_asserteq(gc_stats(&gc)->live_bytes,
+    2 * nodes * gc_arena_size(list) + leaves * sizeof(leaf_t), size_t, "%zu");
+
+  /* Typed allocation fills holes of its own arenas, then claims empty ones
+     and leaves arenas of other types and used untyped arenas alone. */
+  size_t allocated = 0;
+  while (gc_alloc_typed(&gc, &leaf_type)) {
+    allocated++;
+  }
+  assert(allocated > 100);
+  fal_asserteq(arenas_of(&node_type), 1u, size_t, "%zu");
+  fal_asserteq(arenas_of(&leaf_type) + 2, (size_t)ARENAS, size_t, "%zu");
+
+  /* Untyped allocation doesn't go to typed arenas. */
+  assert(!gc_alloc(&gc, gc_arena_EFFECTIVE_SIZE));
+
+  /* Arena becomes untyped once nothing in it survives, all arenas are
+     usable by any type after everything dies. */
+  list = 0;
+  gc_collect(&gc);
+  fal_asserteq(gc_stats(&gc)->live_bytes, 0u, size_t, "%zu");
+  for (size_t a = 0; a < ARENAS; a++) {
+    assert(gc_arena_empty(arenas[a]));
+  }
+
+  size_t untyped = 0;
+  while (gc_alloc(&gc, sizeof(node_t))) {
+    untyped++;
+  }
+  fal_asserteq(untyped, ARENAS * (gc_arena_EFFECTIVE_SIZE / gc_arena_size(
+    gc_arena_first(arenas[0]))), size_t, "%zu");
+  for (size_t a = 0; a < ARENAS; a++) {
+    assert(!gc_type_of(gc_arena_first(arenas[a])));
+  }
+  assert(!gc_alloc_typed(&gc, &node_type));
+
+  /* Typed allocation during incremental marking, new objects survive. */
+  gc_collect(&gc);
+  for (size_t i = 0; i < 100; i++) {
+    node_t* node = gc_alloc_typed(&gc, &node_type);
+    node->left = list;
+    list = node;
+  }
+  assert(gc_step(&gc, 1));
+  node_t* fresh = gc_alloc_typed(&gc, &node_type);
+  assert(fresh && gc_arena_marked(fresh));
+  while (gc_step(&gc, 1)) {
+  }
+  fal_asserteq(gc_stats(&gc)->live_bytes, 101 * gc_arena_size(list),
+    size_t, "%zu");
+}
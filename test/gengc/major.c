@@ -0,0 +1,119 @@
+#include "testlib.h"
+
+#define FAL_GENGC_DEF_POW           14u /* 16 KiB */
+#define FAL_GENGC_DEF_BLOCK_POW     4u  /* 16 bytes */
+#define FAL_GENGC_DEF_PROMOTE_STACK 4   /* tiny stack to overflow it */
+#define FAL_GENGC_DEF_NAME          gen
+#include <fal/gengc.h>
+
+static void trace(gen_t* gc, void* obj) {
+  node_t* node = obj;
+  gen_visit(gc, (void**)&node->left);
+  gen_visit(gc, (void**)&node->right);
+}
+
+static node_t* mknode(gen_t* gc, size_t id) {
+  node_t* node = gen_alloc(gc, sizeof(node_t));
+  if (node) {
+    node->id = id;
+  }
+  return node;
+}
+
+static void check_list(node_t* list, size_t len) {
+  for (node_t* node = list; node; node = node->left) {
+    fal_asserteq(node->id, --len, size_t, "%zu");
+  }
+  fal_asserteq(len, 0u, size_t, "%zu");
+}
+
+int main() {
+  static gen_t gc;
+  gen_init(&gc, trace,
+    testlib_alloc_arena(gen_nursery_SIZE), testlib_alloc_arena(gen_nursery_SIZE));
+  gen_add_arena(&gc, testlib_alloc_arena(gen_old_arena_SIZE));
+
+  const gen_stats_t* stats = gen_stats(&gc);
+  const gen_old_stats_t* old_stats = gen_old_stats(gen_old(&gc));
+
+  /* Promoting many roots at once overflows promote stack, so promoted nodes
+     are traced via cards. */
+  enum { LEN = 200 };
+  node_t* nodes[LEN];
+  for (size_t i = 0; i < LEN; i++) {
+    nodes[i] = mknode(&gc, i);
+    assert(nodes[i]);
+    nodes[i]->left = i ? nodes[i - 1] : 0;
+  }
+
+  node_t* list = nodes[LEN - 1];
+  gen_root_t root;
+  gen_add_root(&gc, &root, (void**)&list, 1);
+  gen_root_t nodes_root;
+  gen_add_root(&gc, &nodes_root, (void**)nodes, LEN);
+
+  gen_minor(&gc);
+  gen_minor(&gc);
+  fal_asserteq(stats->promoted_bytes, LEN * gen_old_arena_size(list), size_t, "%zu");
+  assert(stats->dirty_cards > 0);
+  assert(gen_nursery_empty(gc.from));
+  assert(list == nodes[LEN - 1]);
+  check_list(list, LEN);
+  gen_remove_root(&gc, &nodes_root);
+
+  /* Major collection promotes everything at once and frees old garbage. */
+  {
+    gen_write(&gc, (void**)&list->right, mknode(&gc, 1000));
+    list->left->left = 0;
+    for (size_t i = 0; i < LEN; i++) {
+      assert(mknode(&gc, i));
+    }
+
+    gen_collect(&gc);
+    fal_asserteq(stats->major_collections, 1u, size_t, "%zu");
+    fal_asserteq(stats->promoted_bytes, gen_old_arena_size(list), size_t, "%zu");
+    fal_asserteq(old_stats->live_bytes, 3 * gen_old_arena_size(list), size_t, "%zu");
+    assert(!gen_young(&gc, list->right));
+    fal_asserteq(list->right->id, 1000u, size_t, "%zu");
+  }
+
+  /* Nothing is promoted when old space is full. */
+  {
+    size_t garbage = 0;
+    while (gen_alloc(&gc, gen_PRETENURE)) {
+      garbage++;
+    }
+
+    node_t* young = mknode(&gc, 2000);
+    assert(young);
+    young->left = list->left;
+    list->left = 0;
+    list = young;
+
+    gen_minor(&gc);
+    gen_minor(&gc);
+    fal_asserteq(stats->promotion_failures, 1u, size_t, "%zu");
+    assert(gen_young(&gc, list));
+
+    /* Old objects referenced by nursery only survive major collection. */
+    gen_collect(&gc);
+    fal_asserteq(stats->promotion_failures, 1u, size_t, "%zu");
+    fal_asserteq(old_stats->live_bytes, gen_old_arena_size(list->left),
+      size_t, "%zu");
+    assert(gen_young(&gc, list));
+    fal_asserteq(list->left->id, LEN - 2, size_t, "%zu");
+
+    /* Major collection freed garbage, so now there's room. */
+    gen_minor(&gc);
+    fal_asserteq(stats->promotion_failures, 0u, size_t, "%zu");
+    assert(!gen_young(&gc, list));
+    fal_asserteq(list->id, 2000u, size_t, "%zu");
+    fal_asserteq(list->left->id, LEN - 2, size_t, "%zu");
+  }
+
+  /* Dropping roots frees everything. */
+  gen_remove_root(&gc, &root);
+  gen_collect(&gc);
+  fal_asserteq(old_stats->live_bytes, 0u, size_t, "%zu");
+  assert(gen_nursery_empty(gc.from));
+}
@@ -0,0 +1,116 @@
+#include "testlib.h"
+
+#define FAL_GENGC_DEF_POW       14u /* 16 KiB */
+#define FAL_GENGC_DEF_BLOCK_POW 4u  /* 16 bytes */
+#define FAL_GENGC_DEF_NAME      gen
+#include <fal/gengc.h>
+
+static void trace(gen_t* gc, void* obj) {
+  node_t* node = obj;
+  gen_visit(gc, (void**)&node->left);
+  gen_visit(gc, (void**)&node->right);
+}
+
+static node_t* mknode(gen_t* gc, size_t id) {
+  node_t* node = gen_alloc(gc, sizeof(node_t));
+  if (node) {
+    node->id = id;
+  }
+  return node;
+}
+
+static void check_list(node_t* list, size_t len) {
+  for (node_t* node = list; node; node = node->left) {
+    fal_asserteq(node->id, --len, size_t, "%zu");
+  }
+  fal_asserteq(len, 0u, size_t, "%zu");
+}
+
+int main() {
+  static gen_t gc;
+  gen_init(&gc, trace,
+    testlib_alloc_arena(gen_nursery_SIZE), testlib_alloc_arena(gen_nursery_SIZE));
+  gen_add_arena(&gc, testlib_alloc_arena(gen_old_arena_SIZE));
+
+  fal_asserteq(gen_CARD_SIZE * gen_CARDS, gen_old_arena_SIZE, size_t, "%zu");
+
+  /* List of 10 nodes interleaved with garbage. */
+  enum { LEN = 10 };
+  node_t* list = 0;
+  for (size_t i = 0; i < LEN; i++) {
+    node_t* node = mknode(&gc, i);
+    assert(node && mknode(&gc, 100 + i));
+    node->left = list;
+    list = node;
+  }
+
+  gen_root_t root;
+  gen_add_root(&gc, &root, (void**)&list, 1);
+
+  /* First minor collection copies survivors within nursery. */
+  node_t* before = list;
+  gen_minor(&gc);
+
+  const gen_stats_t* stats = gen_stats(&gc);
+  fal_asserteq(stats->minor_collections, 1u, size_t, "%zu");
+  fal_asserteq(stats->survived_bytes, LEN * gen_nursery_size(list), size_t, "%zu");
+  fal_asserteq(stats->promoted_bytes, 0u, size_t, "%zu");
+  assert(list != before && gen_young(&gc, list));
+  check_list(list, LEN);
+
+  /* Second one promotes them. */
+  gen_minor(&gc);
+  fal_asserteq(stats->survived_bytes, 0u, size_t, "%zu");
+  fal_asserteq(stats->promoted_bytes, LEN * gen_old_arena_size(list), size_t, "%zu");
+  assert(!gen_young(&gc, list));
+  assert(gen_nursery_empty(gc.from));
+  check_list(list, LEN);
+
+  /* Young object reachable only from old one survives due to card. */
+  {
+    node_t* young = mknode(&gc, 1000);
+    assert(young && gen_young(&gc, young));
+    gen_write(&gc, (void**)&list->left->right, young);
+
+    gen_minor(&gc);
+    fal_asserteq(stats->dirty_cards, 1u, size_t, "%zu");
+    fal_asserteq(stats->survived_bytes, gen_nursery_size(young), size_t, "%zu");
+    assert(gen_young(&gc, list->left->right));
+    fal_asserteq(list->left->right->id, 1000u, size_t, "%zu");
+
+    /* Card stays dirty while it points to nursery. */
+    gen_minor(&gc);
+    fal_asserteq(stats->dirty_cards, 1u, size_t, "%zu");
+    assert(!gen_young(&gc, list->left->right));
+    fal_asserteq(list->left->right->id, 1000u, size_t, "%zu");
+
+    gen_minor(&gc);
+    fal_asserteq(stats->dirty_cards, 0u, size_t, "%zu");
+  }
+
+  /* Storing old object doesn't dirty cards. */
+  gen_write(&gc, (void**)&list->right, list->left);
+  gen_minor(&gc);
+  fal_asserteq(stats->dirty_cards, 0u, size_t, "%zu");
+
+  /* Big objects are allocated in old space directly. */
+  {
+    void* big = gen_alloc(&gc, gen_PRETENURE);
+    assert(big && !gen_young(&gc, big));
+  }
+
+  /* Full nursery is emptied by minor collection. */
+  {
+    size_t allocated = 0;
+    while (mknode(&gc, allocated)) {
+      allocated++;
+    }
+
+    assert(allocated > 100);
+    gen_minor(&gc);
+    fal_asserteq(stats->survived_bytes, 0u, size_t, "%zu");
+    assert(mknode(&gc, 0));
+  }
+
+  check_list(list, LEN);
+}
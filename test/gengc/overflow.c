@@ -0,0 +1,75 @@
+#include "testlib.h"
+
+#define FAL_GENGC_DEF_POW           14u /* 16 KiB */
+#define FAL_GENGC_DEF_BLOCK_POW     4u  /* 16 bytes */
+#define FAL_GENGC_DEF_PROMOTE_STACK 2   /* overflows on every promotion */
+#define FAL_GENGC_DEF_NAME          gen
+#include <fal/gengc.h>
+
+static void trace(gen_t* gc, void* obj) {
+  node_t* node = obj;
+  gen_visit(gc, (void**)&node->left);
+  gen_visit(gc, (void**)&node->right);
+}
+
+static node_t* mknode(gen_t* gc, size_t id) {
+  node_t* node = gen_alloc(gc, sizeof(node_t));
+  assert(node);
+  node->id = id;
+  return node;
+}
+
+enum { LEN = 120 };
+
+static void check(gen_t* gc, node_t** olds) {
+  for (size_t i = 0; i < LEN; i++) {
+    node_t* child = olds[i]->left;
+    assert(child && child->left);
+    fal_asserteq(olds[i]->id, i, size_t, "%zu");
+    fal_asserteq(child->id, 1000 + i, size_t, "%zu");
+    fal_asserteq(child->left->id, 2000 + i, size_t, "%zu");
+    assert(!gen_young(gc, olds[i]));
+  }
+}
+
+int main() {
+  static gen_t gc;
+  gen_init(&gc, trace,
+    testlib_alloc_arena(gen_nursery_SIZE), testlib_alloc_arena(gen_nursery_SIZE));
+  for (int i = 0; i < 4; i++) {
+    gen_add_arena(&gc, testlib_alloc_arena(gen_old_arena_SIZE));
+  }
+
+  static node_t* olds[LEN];
+  gen_root_t root;
+  gen_add_root(&gc, &root, (void**)olds, LEN);
+
+  for (size_t i = 0; i < LEN; i++) {
+    olds[i] = mknode(&gc, i);
+  }
+  gen_minor(&gc);
+  gen_minor(&gc);
+
+  /* Every old node gets young child with young grandchild, so promotions
+     which overflow stack land in cards which are being scanned. */
+  for (size_t i = 0; i < LEN; i++) {
+    node_t* child = mknode(&gc, 1000 + i);
+    gen_write(&gc, (void**)&child->left, mknode(&gc, 2000 + i));
+    gen_write(&gc, (void**)&olds[i]->left, child);
+  }
+  gen_minor(&gc);
+  gen_minor(&gc);
+  check(&gc, olds);
+
+  /* Garbage recycles nursery, promoted objects must not be there. */
+  for (int round = 0; round < 4; round++) {
+    for (size_t i = 0; i < 2 * LEN; i++) {
+      mknode(&gc, 5000);
+    }
+    gen_minor(&gc);
+    check(&gc, olds);
+  }
+
+  gen_collect(&gc);
+  check(&gc, olds);
+}
@@ -0,0 +1,6 @@
+#ifndef __FAL_TEST_GENGC_TESTLIB_H__
+#define __FAL_TEST_GENGC_TESTLIB_H__
+
+#include "../gc/testlib.h"
+
+#endif /* __FAL_TEST_GENGC_TESTLIB_H__ */
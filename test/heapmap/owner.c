@@ -0,0 +1,61 @@
+#include "../assertlib.h"
+#include <stdint.h>
+#include <assert.h>
+
+#define FAL_HEAPMAP_DEF_POW   12u /* 4 KiB granules */
+#define FAL_HEAPMAP_DEF_NAME  heap
+#include <fal/heapmap.h>
+
+static heap_t map;
+
+#define ADDR(X) ((void*)(uintptr_t)(X))
+
+int main() {
+  fal_asserteq(heap_GRANULE, 4096u, size_t, "%zu");
+  assert("map covers 48-bit address space"
+    && (sizeof(void*) == 4
+      || (uint64_t)heap_ROOT_LEN * heap_LEAF_LEN == (uint64_t)1 << (48 - 12)));
+
+  assert("empty map owns nothing"
+    && !heap_owner(&map, 0)
+    && !heap_owner(&map, ADDR(0x7f0000001234))
+    && !heap_owner(&map, ADDR(UINTPTR_MAX)));
+
+  /* 4 KiB arena. */
+  assert(heap_set(&map, ADDR(0x10000), 0x1000, 1));
+  fal_asserteq(heap_owner(&map, ADDR(0x10000)), 1u, unsigned, "%u");
+  fal_asserteq(heap_owner(&map, ADDR(0x10fff)), 1u, unsigned, "%u");
+  fal_asserteq(heap_owner(&map, ADDR(0x11000)), 0u, unsigned, "%u");
+  fal_asserteq(heap_owner(&map, ADDR(0x0ffff)), 0u, unsigned, "%u");
+
+  /* 64 KiB arena right after it. */
+  assert(heap_set(&map, ADDR(0x20000), 0x10000, 2));
+  fal_asserteq(heap_owner(&map, ADDR(0x20000)), 2u, unsigned, "%u");
+  fal_asserteq(heap_owner(&map, ADDR(0x2abcd)), 2u, unsigned, "%u");
+  fal_asserteq(heap_owner(&map, ADDR(0x2ffff)), 2u, unsigned, "%u");
+  fal_asserteq(heap_owner(&map, ADDR(0x30000)), 0u, unsigned, "%u");
+
+  if (sizeof(void*) > 4) {
+    /* Range crossing leaf boundary. */
+    uintptr_t leaf = (uintptr_t)heap_LEAF_LEN * heap_GRANULE;
+    assert(heap_set(&map, ADDR(leaf * 3 - 0x2000), 0x4000, 3));
+    fal_asserteq(heap_owner(&map, ADDR(leaf * 3 - 0x2001)), 0u, unsigned, "%u");
+    fal_asserteq(heap_owner(&map, ADDR(leaf * 3 - 0x2000)), 3u, unsigned, "%u");
+    fal_asserteq(heap_owner(&map, ADDR(leaf * 3 + 0x1fff)), 3u, unsigned, "%u");
+    fal_asserteq(heap_owner(&map, ADDR(leaf * 3 + 0x2000)), 0u, unsigned, "%u");
+
+    heap_clear(&map, ADDR(leaf * 3 - 0x2000), 0x4000);
+    fal_asserteq(heap_owner(&map, ADDR(leaf * 3)), 0u, unsigned, "%u");
+    fal_asserteq(heap_owner(&map, ADDR(leaf * 3 - 0x1000)), 0u, unsigned, "%u");
+  }
+
+  /* Clearing a range without leaves is no-op. */
+  heap_clear(&map, ADDR(0x7f0000000000), 0x100000);
+
+  heap_clear(&map, ADDR(0x10000), 0x1000);
+  fal_asserteq(heap_owner(&map, ADDR(0x10000)), 0u, unsigned, "%u");
+  fal_asserteq(heap_owner(&map, ADDR(0x20000)), 2u, unsigned, "%u");
+
+  heap_destroy(&map);
+  fal_asserteq(heap_owner(&map, ADDR(0x20000)), 0u, unsigned, "%u");
+}
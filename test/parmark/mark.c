@@ -0,0 +1,134 @@
+#include "testlib.h"
+
+#define FAL_ARENA_DEF_POW       16u /* 64 KiB */
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes */
+#define FAL_ARENA_DEF_NAME      space
+#include <fal/arena.h>
+
+#define FAL_PARMARK_DEF_NAME      pm
+#define FAL_PARMARK_DEF_MARK(Ptr) space_mark_atomic(Ptr)
+#ifndef _WIN32
+#define FAL_PARMARK_DEF_YIELD()   sched_yield()
+#endif
+#include <fal/parmark.h>
+
+enum { ARENAS = 8, WORKERS = 4 };
+
+static space_t* spaces[ARENAS];
+
+static void trace(pm_worker_t* worker, void* obj) {
+  node_t* node = obj;
+  pm_visit(worker, node->left);
+  pm_visit(worker, node->right);
+}
+
+static void work(void* worker) {
+  pm_work(worker);
+}
+
+/* Fill arenas with nodes pointing to random ones, return number of nodes. */
+static size_t fill(node_t** nodes, size_t cap) {
+  size_t count = 0;
+  for (size_t a = 0; a < ARENAS; a++) {
+    space_init(spaces[a]);
+    node_t* node;
+    while (count < cap && (node = space_bumpalloc(spaces[a], sizeof(node_t)))) {
+      node->id = count;
+      nodes[count++] = node;
+    }
+  }
+
+  uint64_t seed = 12345;
+  for (size_t i = 0; i < count; i++) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    /* About a third of nodes are unreachable. */
+    nodes[i]->left = (seed >> 60) < 10 ? nodes[(seed >> 8) % count] : 0;
+    nodes[i]->right = (seed >> 56) % 16 < 10 ? nodes[(seed >> 24) % count] : 0;
+  }
+
+  return count;
+}
+
+/* Reference marking with plain recursion-free walk. */
+static size_t reachable(node_t** nodes, size_t count, node_t** roots,
+  size_t len, char* seen) {
+  static node_t* stack[1 << 20];
+  size_t sp = 0;
+  size_t found = 0;
+  (void)nodes;
+  memset(seen, 0, count);
+
+  for (size_t i = 0; i < len; i++) {
+    stack[sp++] = roots[i];
+  }
+  while (sp) {
+    node_t* node = stack[--sp];
+    if (!node || seen[node->id]) {
+      continue;
+    }
+    seen[node->id] = 1;
+    found++;
+    stack[sp++] = node->left;
+    stack[sp++] = node->right;
+  }
+
+  return found;
+}
+
+static void run(size_t workers_count) {
+  static node_t* nodes[ARENAS * space_EFFECTIVE_SIZE / 32];
+  static char seen[FAL_ARRLEN(nodes)];
+  static pm_worker_t workers[WORKERS];
+  static pm_t marker;
+
+  size_t count = fill(nodes, FAL_ARRLEN(nodes));
+  node_t* roots[] = { nodes[0], nodes[count / 2], nodes[count - 1] };
+  size_t live = reachable(nodes, count, roots, FAL_ARRLEN(roots), seen);
+  assert(live > 1000 && live < count);
+
+  pm_init(&marker, trace, workers, workers_count);
+  for (size_t i = 0; i < FAL_ARRLEN(roots); i++) {
+    pm_root(&marker, roots[i]);
+  }
+
+  void* args[WORKERS];
+  for (size_t i = 0; i < workers_count; i++) {
+    args[i] = &workers[i];
+  }
+  testlib_run_threads(workers_count, work, args);
+  assert(!pm_overflowed(&marker));
+
+  /* Marked are exactly reachable ones, each traced once. */
+  for (size_t i = 0; i < count; i++) {
+    fal_asserteq(space_marked(nodes[i]), seen[i], int, "%d");
+  }
+
+  size_t traced = 0;
+  for (size_t i = 0; i < workers_count; i++) {
+    traced += pm_stats(&workers[i])->traced;
+  }
+  fal_asserteq(traced, live, size_t, "%zu");
+}
+
+int main() {
+  for (size_t a = 0; a < ARENAS; a++) {
+    spaces[a] = testlib_alloc_arena(space_SIZE);
+  }
+
+  run(1);
+  run(WORKERS);
+
+  /* Nothing to mark, everybody just finishes. */
+  {
+    static pm_worker_t workers[WORKERS];
+    static pm_t marker;
+    void* args[WORKERS];
+
+    pm_init(&marker, trace, workers, WORKERS);
+    pm_root(&marker, 0);
+    for (size_t i = 0; i < WORKERS; i++) {
+      args[i] = &workers[i];
+    }
+    testlib_run_threads(WORKERS, work, args);
+  }
+}
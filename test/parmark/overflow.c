@@ -0,0 +1,78 @@
+#include "testlib.h"
+
+#define FAL_ARENA_DEF_POW       16u /* 64 KiB */
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes */
+#define FAL_ARENA_DEF_NAME      space
+#include <fal/arena.h>
+
+/* Tiny deques overflow all the time. */
+#define FAL_PARMARK_DEF_NAME      pm
+#define FAL_PARMARK_DEF_MARK(Ptr) space_mark_atomic(Ptr)
+#define FAL_PARMARK_DEF_DEQUE_POW 2
+#ifndef _WIN32
+#define FAL_PARMARK_DEF_YIELD()   sched_yield()
+#endif
+#include <fal/parmark.h>
+
+enum { WORKERS = 3 };
+
+static void trace(pm_worker_t* worker, void* obj) {
+  node_t* node = obj;
+  pm_visit(worker, node->left);
+  pm_visit(worker, node->right);
+}
+
+static void work(void* worker) {
+  pm_work(worker);
+}
+
+int main() {
+  space_t* space = testlib_alloc_arena(space_SIZE);
+  space_init(space);
+
+  /* Complete binary tree plus garbage. */
+  static node_t* nodes[1000];
+  for (size_t i = 0; i < FAL_ARRLEN(nodes); i++) {
+    nodes[i] = space_bumpalloc(space, sizeof(node_t));
+    assert(nodes[i] && space_bumpalloc(space, sizeof(node_t)));
+    nodes[i]->id = i;
+  }
+  for (size_t i = 0; i < FAL_ARRLEN(nodes); i++) {
+    nodes[i]->left = 2*i + 1 < FAL_ARRLEN(nodes) ? nodes[2*i + 1] : 0;
+    nodes[i]->right = 2*i + 2 < FAL_ARRLEN(nodes) ? nodes[2*i + 2] : 0;
+  }
+
+  static pm_worker_t workers[WORKERS];
+  static pm_t marker;
+  void* args[WORKERS];
+  for (size_t i = 0; i < WORKERS; i++) {
+    args[i] = &workers[i];
+  }
+
+  pm_init(&marker, trace, workers, WORKERS);
+  pm_root(&marker, nodes[0]);
+
+  size_t rounds = 0;
+  do {
+    testlib_run_threads(WORKERS, work, args);
+    rounds++;
+
+    if (!pm_overflowed(&marker)) {
+      break;
+    }
+    for (void* obj = space_first_marked(space); obj;
+      obj = space_next_marked(obj)) {
+      pm_retrace(&marker, obj);
+    }
+  } while (1);
+  assert(rounds > 1);
+
+  size_t marked = 0;
+  for (void* obj = space_first(space); obj; obj = space_next(obj)) {
+    marked += space_marked(obj);
+  }
+  fal_asserteq(marked, FAL_ARRLEN(nodes), size_t, "%zu");
+  for (size_t i = 0; i < FAL_ARRLEN(nodes); i++) {
+    assert(space_marked(nodes[i]));
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef __FAL_TEST_PARMARK_TESTLIB_H__
+#define __FAL_TEST_PARMARK_TESTLIB_H__
+
+#include "../gc/testlib.h"
+
+typedef void (*testlib_thread_fn)(void* arg);
+
+/* Run fn(args[i]) on count threads and wait for all of them. */
+static inline void testlib_run_threads(size_t count, testlib_thread_fn fn,
+  void** args);
+
+#if defined(_WIN32)
+
+typedef struct testlib_thread_t {
+  testlib_thread_fn fn;
+  void* arg;
+} testlib_thread_t;
+
+static DWORD WINAPI testlib__thread(LPVOID arg) {
+  testlib_thread_t* thread = (testlib_thread_t*)arg;
+  thread->fn(thread->arg);
+  return 0;
+}
+
+static inline void testlib_run_threads(size_t count, testlib_thread_fn fn,
+  void** args) {
+  testlib_thread_t threads[64];
+  HANDLE handles[64];
+  assert(count <= 64);
+
+  for (size_t i = 0; i < count; i++) {
+    threads[i].fn = fn;
+    threads[i].arg = args[i];
+    handles[i] = CreateThread(0, 0, testlib__thread, &threads[i], 0, 0);
+    assert(handles[i]);
+  }
+  WaitForMultipleObjects((DWORD)count, handles, TRUE, INFINITE);
+  for (size_t i = 0; i < count; i++) {
+    CloseHandle(handles[i]);
+  }
+}
+
+#else
+
+#include <pthread.h>
+#include <sched.h>
+
+typedef struct testlib_thread_t {
+  testlib_thread_fn fn;
+  void* arg;
+} testlib_thread_t;
+
+static void* testlib__thread(void* arg) {
+  testlib_thread_t* thread = (testlib_thread_t*)arg;
+  thread->fn(thread->arg);
+  return 0;
+}
+
+static inline void testlib_run_threads(size_t count, testlib_thread_fn fn,
+  void** args) {
+  testlib_thread_t threads[64];
+  pthread_t handles[64];
+  assert(count <= 64);
+
+  for (size_t i = 0; i < count; i++) {
+    threads[i].fn = fn;
+    threads[i].arg = args[i];
+    int err = pthread_create(&handles[i], 0, testlib__thread, &threads[i]);
+    assert(!err);
+    (void)err;
+  }
+  for (size_t i = 0; i < count; i++) {
+    pthread_join(handles[i], 0);
+  }
+}
+
+#endif /* defined(_WIN32) */
+
+#endif /* __FAL_TEST_PARMARK_TESTLIB_H__ */
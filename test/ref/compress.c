@@ -0,0 +1,57 @@
+#include "../assertlib.h"
+#include <stdint.h>
+#include <assert.h>
+
+#define FAL_REF_DEF_SHIFT 4u /* 16 byte blocks */
+#define FAL_REF_DEF_NAME  ref
+#include <fal/ref.h>
+
+#define FAL_REF_DEF_SHIFT 0u
+#define FAL_REF_DEF_NAME  bref
+#include <fal/ref.h>
+
+#define ADDR(X) ((void*)(uintptr_t)(X))
+
+int main() {
+  fal_asserteq(ref_SCALE, 16u, size_t, "%zu");
+  fal_asserteq(sizeof(ref_t), 4u, size_t, "%zu");
+
+  /* Only arithmetic, nothing is dereferenced. */
+  ref_heap_t heap;
+  ref_init(&heap, ADDR(0x100000), 0x100000);
+
+  assert("null is 0 both ways"
+    && ref_compress(&heap, 0) == 0 && ref_decompress(&heap, 0) == 0);
+
+  fal_asserteq(ref_compress(&heap, ADDR(0x100010)), 1u, unsigned, "%u");
+  fal_asserteq(ref_compress(&heap, ADDR(0x1ffff0)), 0xffffu, unsigned, "%u");
+  assert(ref_decompress(&heap, 1) == ADDR(0x100010));
+  assert(ref_decompress(&heap, 0xffff) == ADDR(0x1ffff0));
+  for (uintptr_t addr = 0x100010; addr < 0x200000; addr += 0x1230) {
+    uintptr_t aligned = addr & ~(uintptr_t)15;
+    assert(ref_decompress(&heap, ref_compress(&heap, ADDR(aligned)))
+      == ADDR(aligned));
+  }
+
+  assert(ref_contains(&heap, ADDR(0x100000)));
+  assert(ref_contains(&heap, ADDR(0x1fffff)));
+  assert(!ref_contains(&heap, ADDR(0x200000)));
+  assert(!ref_contains(&heap, ADDR(0x0fffff)));
+  assert(!ref_contains(&heap, 0));
+
+  if (sizeof(void*) > 4) {
+    /* Full 64 GiB range, last block is addressable. */
+    uintptr_t base = (uintptr_t)1 << 40;
+    ref_init(&heap, ADDR(base), (size_t)1 << 36);
+    uintptr_t last = base + ((uintptr_t)1 << 36) - 16;
+    fal_asserteq(ref_compress(&heap, ADDR(last)), UINT32_MAX, unsigned, "%u");
+    assert(ref_decompress(&heap, UINT32_MAX) == ADDR(last));
+
+    /* Unscaled refs cover 4 GiB. */
+    bref_heap_t bheap;
+    bref_init(&bheap, ADDR(base), (size_t)1 << 32);
+    fal_asserteq(bref_compress(&bheap, ADDR(base + 12345)), 12345u,
+      unsigned, "%u");
+    assert(bref_decompress(&bheap, UINT32_MAX) == ADDR(base + UINT32_MAX));
+  }
+}
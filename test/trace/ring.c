@@ -0,0 +1,104 @@
+#include "../parmark/testlib.h"
+
+#define FAL_TRACE_DEF_RING_POW 4 /* 16 events */
+#include <fal/trace.h>
+
+#define FAL_ARENA_DEF_BLOCK_POW 4u  /* 16 bytes*/
+#define FAL_ARENA_DEF_POW       14u /* 16 KiB */
+#define FAL_ARENA_DEF_HOOKS     fal_trace
+#define FAL_ARENA_DEF_NAME      arena
+#include <fal/arena.h>
+
+/* Dump read back: its header, ring header and events of main thread and
+   events ever recorded in other rings. */
+static fal_trace_file_t header;
+static fal_trace_ring_t ring;
+static fal_trace_event_t events[FAL_TRACE_RING_LEN];
+static unsigned long long others;
+
+static void dump() {
+  FILE* file = tmpfile();
+  assert(file);
+  size_t written = fal_trace_dump(file);
+  rewind(file);
+
+  assert(fread(&header, sizeof(header), 1, file) == 1);
+  assert(memcmp(header.magic, "FALTRACE", 8) == 0);
+  fal_asserteq(header.version, FAL_TRACE_VERSION, unsigned, "%u");
+
+  /* Main thread took the first ring. */
+  size_t read = 0;
+  others = 0;
+  for (unsigned i = 0; i < header.rings; i++) {
+    fal_trace_ring_t entry;
+    assert(fread(&entry, sizeof(entry), 1, file) == 1);
+    if (entry.thread == 0) {
+      ring = entry;
+      assert(fread(events, sizeof(fal_trace_event_t), entry.events, file)
+        == entry.events);
+    } else {
+      others += entry.total;
+      assert(!fseek(file, (long)(entry.events * sizeof(fal_trace_event_t)),
+        SEEK_CUR));
+    }
+    read += entry.events;
+  }
+  fal_asserteq(read, written, size_t, "%zu");
+  fclose(file);
+}
+
+/* Record event and leave ring to the next thread. */
+static void worker(void* arg) {
+  fal_trace(FAL_TRACE_USER, arg, 1, 0);
+  fal_trace_thread_exit();
+}
+
+int main() {
+  arena_t* arena = (arena_t*)testlib_alloc_arena(arena_SIZE);
+  arena_init(arena);
+
+  void* a = arena_alloc(arena, 40);
+  arena_extend(a, 64);
+  arena_free(a);
+  fal_trace_on_os_map(arena, arena_SIZE);
+
+  dump();
+  fal_asserteq(header.rings, 1u, unsigned, "%u");
+  fal_asserteq(ring.total, 4u, unsigned long long, "%llu");
+  fal_asserteq(events[0].kind, FAL_TRACE_ALLOC, unsigned, "%u");
+  assert(events[0].ptr == (uintptr_t)a);
+  fal_asserteq(events[0].size, 48u, unsigned long long, "%llu");
+  fal_asserteq(events[1].kind, FAL_TRACE_EXTEND, unsigned, "%u");
+  fal_asserteq(events[1].size, 64u, unsigned long long, "%llu");
+  fal_asserteq(events[1].arg, 48u, unsigned long long, "%llu");
+  fal_asserteq(events[2].kind, FAL_TRACE_FREE, unsigned, "%u");
+  fal_asserteq(events[3].kind, FAL_TRACE_OS_MAP, unsigned, "%u");
+  assert(events[0].time <= events[3].time);
+
+  /* Ring keeps only the last events, one of them may be in writing. */
+  for (size_t i = 0; i < 100; i++) {
+    fal_trace(FAL_TRACE_USER, 0, i, 0);
+  }
+
+  dump();
+  fal_asserteq(ring.total, 104u, unsigned long long, "%llu");
+  fal_asserteq(ring.events, (uint64_t)FAL_TRACE_RING_LEN - 1, unsigned long long, "%llu");
+  fal_asserteq(events[0].size, 100u - FAL_TRACE_RING_LEN + 1, unsigned long long, "%llu");
+  fal_asserteq(events[ring.events - 1].size, 99u, unsigned long long, "%llu");
+  fal_asserteq(fal_trace_dropped(), 0u, size_t, "%zu");
+
+  /* Threads exiting one after another reuse rings instead of running out,
+     memory is bounded by threads alive at once. */
+  enum { ROUNDS = 100, THREADS = 4 };
+  void* args[THREADS] = { 0 };
+  for (size_t round = 0; round < ROUNDS; round++) {
+    testlib_run_threads(THREADS, worker, args);
+  }
+
+  dump();
+  assert(header.rings >= 2 && header.rings <= 1 + THREADS);
+  fal_asserteq(others, (unsigned long long)ROUNDS * THREADS,
+    unsigned long long, "%llu");
+  fal_asserteq(ring.total, 104u, unsigned long long, "%llu");
+  fal_asserteq(fal_trace_dropped(), 0u, size_t, "%zu");
+}